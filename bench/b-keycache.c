@@ -0,0 +1,272 @@
+/*!
+ * b-keycache.c - key cache benchmark for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ *
+ * Usage:
+ *   $ mako getblock <hash> 0 > block.hex
+ *   $ ./b-keycache block.hex
+ *
+ * Every P2PKH input of the block is re-verified with
+ * and without the key cache. The previous output script
+ * follows from the pubkey, and legacy sighashing does
+ * not commit to the value, so no coins are needed.
+ * Without a file, a synthetic workload is used.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <io/core.h>
+#include <mako/block.h>
+#include <mako/crypto/ecc.h>
+#include <mako/crypto/hash.h>
+#include <mako/encoding.h>
+#include <mako/keycache.h>
+#include <mako/script.h>
+#include <mako/tx.h>
+
+#define ROUNDS 10
+
+typedef struct bench_sig_s {
+  uint8_t msg[32];
+  uint8_t sig[64];
+  uint8_t pub[65];
+  size_t pub_len;
+} bench_sig_t;
+
+typedef struct bench_set_s {
+  bench_sig_t *items;
+  size_t alloc;
+  size_t length;
+} bench_set_t;
+
+static bench_sig_t *
+bench_push(bench_set_t *set) {
+  if (set->length == set->alloc) {
+    set->alloc = set->alloc == 0 ? 256 : set->alloc * 2;
+    set->items = realloc(set->items, set->alloc * sizeof(bench_sig_t));
+
+    if (set->items == NULL)
+      abort();
+  }
+
+  return &set->items[set->length++];
+}
+
+static int
+bench_input(bench_sig_t *item, const btc_tx_t *tx, size_t index) {
+  const btc_script_t *script = &tx->inputs.items[index]->script;
+  const uint8_t *sig, *pub;
+  size_t sig_len, pub_len;
+  btc_script_t prev;
+  uint8_t hash[20];
+  int type;
+
+  /* <sig> <pubkey> */
+  if (script->length < 2)
+    return 0;
+
+  sig_len = script->data[0];
+  sig = script->data + 1;
+
+  if (sig_len < 9 || sig_len > 73 || 1 + sig_len >= script->length)
+    return 0;
+
+  pub_len = script->data[1 + sig_len];
+  pub = sig + sig_len + 1;
+
+  if (pub_len != 33 && pub_len != 65)
+    return 0;
+
+  if (2 + sig_len + pub_len != script->length)
+    return 0;
+
+  if (!btc_ecdsa_sig_import_lax(item->sig, sig, sig_len - 1))
+    return 0;
+
+  if (!btc_ecdsa_sig_normalize(item->sig, item->sig))
+    return 0;
+
+  type = sig[sig_len - 1];
+
+  btc_hash160(hash, pub, pub_len);
+  btc_script_init(&prev);
+  btc_script_set_p2pkh(&prev, hash);
+  btc_tx_sighash(item->msg, tx, index, &prev, 0, type, 0, NULL);
+  btc_script_clear(&prev);
+
+  memcpy(item->pub, pub, pub_len);
+
+  item->pub_len = pub_len;
+
+  return btc_ecdsa_verify(item->msg, 32, item->sig, item->pub, pub_len);
+}
+
+static int
+bench_load(bench_set_t *set, const char *file) {
+  unsigned char *hex;
+  btc_block_t *block;
+  size_t i, j, len;
+  uint8_t *raw;
+
+  if (!btc_fs_read_file(file, &hex, &len))
+    return 0;
+
+  while (len > 0 && (hex[len - 1] == '\n' || hex[len - 1] == '\r'))
+    len--;
+
+  raw = malloc(len / 2 + 1);
+
+  if (raw == NULL)
+    abort();
+
+  if ((len & 1) || !btc_base16_decode(raw, (const char *)hex, len)) {
+    free(raw);
+    free(hex);
+    return 0;
+  }
+
+  block = btc_block_decode(raw, len / 2);
+
+  free(raw);
+  free(hex);
+
+  if (block == NULL)
+    return 0;
+
+  for (i = 1; i < block->txs.length; i++) {
+    const btc_tx_t *tx = block->txs.items[i];
+
+    for (j = 0; j < tx->inputs.length; j++) {
+      if (!bench_input(bench_push(set), tx, j))
+        set->length--;
+    }
+  }
+
+  btc_block_destroy(block);
+
+  return 1;
+}
+
+static void
+bench_synthetic(bench_set_t *set) {
+  uint8_t priv[32];
+  uint32_t x = 1;
+  size_t i, k;
+
+  /* A hot set of 16 keys takes most of the spends
+     and a tail of 256 keys gets the remainder. */
+  for (i = 0; i < 4000; i++) {
+    bench_sig_t *item = bench_push(set);
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    k = (x & 7) != 0 ? (x >> 8) % 16 : 16 + (x >> 8) % 256;
+
+    memset(priv, 0, 32);
+
+    priv[31] = k & 0xff;
+    priv[30] = (k >> 8) + 1;
+
+    memset(item->msg, 0, 32);
+    memcpy(item->msg, &i, sizeof(i));
+
+    item->pub_len = 33;
+
+    if (!btc_ecdsa_pubkey_create(item->pub, priv, 1))
+      abort();
+
+    if (!btc_ecdsa_sign(item->sig, NULL, item->msg, 32, priv))
+      abort();
+  }
+}
+
+static double
+bench_verify(const bench_set_t *set, btc_keycache_t *cache) {
+  int64_t start, elapsed;
+  size_t i;
+
+  start = btc_time_usec();
+
+  for (i = 0; i < set->length; i++) {
+    const bench_sig_t *item = &set->items[i];
+
+    if (!btc_keycache_verify(cache, item->msg, item->sig,
+                                    item->pub, item->pub_len)) {
+      abort();
+    }
+  }
+
+  elapsed = btc_time_usec() - start;
+
+  return (double)elapsed / (double)set->length;
+}
+
+int
+main(int argc, char **argv) {
+  bench_set_t set = {NULL, 0, 0};
+  btc_keycache_t *cache;
+  size_t i, j, compressed = 0, unique = 0;
+  double plain = 0, cached = 0;
+  int r;
+
+  if (argc > 1) {
+    if (!bench_load(&set, argv[1])) {
+      fprintf(stderr, "Could not read block: %s\n", argv[1]);
+      return 1;
+    }
+  } else {
+    bench_synthetic(&set);
+  }
+
+  if (set.length == 0) {
+    fprintf(stderr, "No P2PKH inputs found.\n");
+    return 1;
+  }
+
+  for (i = 0; i < set.length; i++) {
+    const bench_sig_t *item = &set.items[i];
+
+    compressed += (item->pub_len == 33);
+
+    for (j = 0; j < i; j++) {
+      if (set.items[j].pub_len == item->pub_len
+          && memcmp(set.items[j].pub, item->pub, item->pub_len) == 0) {
+        break;
+      }
+    }
+
+    unique += (j == i);
+  }
+
+  cache = btc_keycache_create(BTC_KEYCACHE_SIZE);
+
+  /* Alternate the two and keep the best pass of each. */
+  for (r = 0; r < ROUNDS; r++) {
+    double x = bench_verify(&set, NULL);
+    double y = bench_verify(&set, cache);
+
+    if (r == 0 || x < plain)
+      plain = x;
+
+    if (r == 0 || y < cached)
+      cached = y;
+  }
+
+  printf("sigs=%lu compressed=%lu unique_keys=%lu\n",
+         (unsigned long)set.length,
+         (unsigned long)compressed,
+         (unsigned long)unique);
+
+  printf("plain=%.2fus/sig cached=%.2fus/sig speedup=%.1f%%\n",
+         plain, cached, (plain / cached - 1.0) * 100.0);
+
+  btc_keycache_destroy(cache);
+  free(set.items);
+
+  return 0;
+}
@@ -0,0 +1,69 @@
+/*!
+ * b-workers.c - workers benchmark for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <io/core.h>
+#include <io/workers.h>
+
+#define TASKS (1 << 22)
+#define BATCH 1024
+
+static volatile uint32_t sink[BATCH];
+
+static void
+bench_work(void *arg) {
+  volatile uint32_t *x = arg;
+  *x += 1;
+}
+
+static void
+bench_workers(int threads) {
+  btc_workers_t *pool = btc_workers_create(threads, 128);
+  btc_workq_t batch;
+  int64_t start, elapsed;
+  int i, j;
+
+  btc_workq_init(&batch);
+
+  start = btc_time_usec();
+
+  for (i = 0; i < TASKS / BATCH; i++) {
+    for (j = 0; j < BATCH; j++)
+      btc_workq_push(&batch, bench_work, (void *)&sink[j]);
+
+    btc_workers_batch(pool, &batch);
+    btc_workers_wait(pool);
+  }
+
+  elapsed = btc_time_usec() - start;
+
+  if (elapsed <= 0)
+    elapsed = 1;
+
+  printf("threads=%-3d tasks=%d time=%.3fs rate=%.2fM tasks/s (%.1f ns/task)\n",
+         threads, TASKS, (double)elapsed / 1e6,
+         (double)TASKS / (double)elapsed,
+         (double)elapsed * 1000.0 / (double)TASKS);
+
+  btc_workq_clear(&batch);
+  btc_workers_destroy(pool);
+}
+
+int
+main(int argc, char **argv) {
+  static const int threads[] = { 2, 8, 32 };
+  size_t i;
+
+  (void)argc;
+  (void)argv;
+
+  for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++)
+    bench_workers(threads[i]);
+
+  return 0;
+}
@@ -194,6 +194,7 @@ pub fn build(b: *Builder) void {
     "src/crypto/hmac256.c",
     "src/crypto/hmac512.c",
     "src/crypto/merkle.c",
+    "src/crypto/muhash.c",
     "src/crypto/poly1305.c",
     "src/crypto/pbkdf256.c",
     "src/crypto/pbkdf512.c",
@@ -232,6 +233,7 @@ pub fn build(b: *Builder) void {
     "src/bip37.c",
     "src/bip39.c",
     "src/bip152.c",
+    "src/bip158.c",
     "src/block.c",
     "src/bloom.c",
     "src/buffer.c",
@@ -247,6 +249,7 @@ pub fn build(b: *Builder) void {
     "src/inspect.c",
     "src/internal.c",
     "src/json.c",
+    "src/keycache.c",
     "src/mainnet.c",
     "src/mpi.c",
     "src/murmur3.c",
@@ -259,6 +262,7 @@ pub fn build(b: *Builder) void {
     "src/policy.c",
     "src/printf.c",
     "src/printf_core.c",
+    "src/rawblock.c",
     "src/regtest.c",
     "src/script.c",
     "src/select.c",
@@ -291,6 +295,7 @@ pub fn build(b: *Builder) void {
     "src/base/addrman.c",
     "src/base/config.c",
     "src/base/logger.c",
+    "src/base/sigcache.c",
     "src/base/timedata.c"
   };
 
@@ -345,13 +350,20 @@ pub fn build(b: *Builder) void {
   };
 
   const node_sources = [_][]const u8{
+    "src/node/addrindex.c",
+    "src/node/addrindex.c",
+    "src/node/addrindex.c",
     "src/node/chain.c",
     "src/node/chaindb.c",
+    "src/node/filterindex.c",
+    "src/node/indexer.c",
     "src/node/mempool.c",
     "src/node/miner.c",
     "src/node/node.c",
     "src/node/pool.c",
-    "src/node/rpc.c"
+    "src/node/rpc.c",
+    "src/node/snapshot.c",
+    "src/node/txindex.c"
   };
 
   const wallet_sources = [_][]const u8{
@@ -468,6 +480,10 @@ pub fn build(b: *Builder) void {
     defines.append("BTC_HAVE_RFC3493") catch unreachable;
   }
 
+  if (enable_node) {
+    defines.append("BTC_HAVE_SNAPPY") catch unreachable;
+  }
+
   //
   // Targets
   //
@@ -569,6 +585,7 @@ pub fn build(b: *Builder) void {
       // base
       "addrman",
       "config",
+      "sigcache",
       "timedata",
       // node
       "chaindb",
@@ -621,6 +638,7 @@ pub fn build(b: *Builder) void {
     "hash256",
     "hmac",
     "merkle",
+    "muhash",
     "poly1305",
     "pbkdf2",
     "rand",
@@ -641,6 +659,7 @@ pub fn build(b: *Builder) void {
     "bip37",
     "bip39",
     "bip152",
+    "bip158",
     "block",
     "bloom",
     "coin",
@@ -648,6 +667,7 @@ pub fn build(b: *Builder) void {
     "header",
     "heap",
     "input",
+    "keycache",
     "list",
     "map",
     "mpi",
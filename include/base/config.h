@@ -28,7 +28,14 @@ struct btc_conf_s {
   int disable_wallet;
   int cache_size;
   int checkpoints;
+  int assume_valid;
+  uint8_t assume_hash[32];
   int prune;
+  int txindex;
+  int addrindex;
+  int filterindex;
+  char snapshot[1024];
+  uint8_t snapshot_hash[32];
   int workers;
   int listen;
   int port;
@@ -0,0 +1,60 @@
+/*!
+ * sigcache.h - script verification cache for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#ifndef BTC_SIGCACHE_H
+#define BTC_SIGCACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "types.h"
+#include "../mako/common.h"
+
+/*
+ * Constants
+ */
+
+#define BTC_SIGCACHE_SIZE (1 << 17)
+
+/*
+ * Signature Cache
+ */
+
+BTC_EXTERN btc_sigcache_t *
+btc_sigcache_create(size_t size);
+
+BTC_EXTERN void
+btc_sigcache_destroy(btc_sigcache_t *cache);
+
+BTC_EXTERN void
+btc_sigcache_reset(btc_sigcache_t *cache);
+
+BTC_EXTERN size_t
+btc_sigcache_size(const btc_sigcache_t *cache);
+
+BTC_EXTERN void
+btc_sigcache_add(btc_sigcache_t *cache,
+                 const btc_tx_t *tx,
+                 unsigned int flags);
+
+BTC_EXTERN int
+btc_sigcache_has(const btc_sigcache_t *cache,
+                 const btc_tx_t *tx,
+                 unsigned int flags);
+
+BTC_EXTERN int
+btc_sigcache_take(btc_sigcache_t *cache,
+                  const btc_tx_t *tx,
+                  unsigned int flags);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BTC_SIGCACHE_H */
@@ -24,6 +24,7 @@ struct btc_network_s;
 typedef struct btc_addrman_s btc_addrman_t;
 typedef struct btc_conf_s btc_conf_t;
 typedef struct btc_logger_s btc_logger_t;
+typedef struct btc_sigcache_s btc_sigcache_t;
 
 typedef struct btc_timedata_s {
   int64_t samples[200];
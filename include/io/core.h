@@ -198,12 +198,21 @@ btc_fs_seek(btc_fd_t fd, int64_t pos);
 BTC_EXTERN int64_t
 btc_fs_read(btc_fd_t fd, void *dst, size_t len);
 
+/* Reads at `pos`. The file offset is left where it was. On Windows it
+   is saved and restored around the read, so a descriptor shared between
+   threads must only be read with btc_fs_pread. */
+BTC_EXTERN int64_t
+btc_fs_pread(btc_fd_t fd, void *dst, size_t len, int64_t pos);
+
 BTC_EXTERN int64_t
 btc_fs_write(btc_fd_t fd, const void *src, size_t len);
 
 BTC_EXTERN int
 btc_fs_fsync(btc_fd_t fd);
 
+BTC_EXTERN int
+btc_fs_fallocate(btc_fd_t fd, int64_t size);
+
 BTC_EXTERN btc_fd_t
 btc_fs_lock(const char *name);
 
@@ -22,12 +22,11 @@ typedef void btc_work_f(void *arg);
 typedef struct btc_work_s {
   btc_work_f *func;
   void *arg;
-  struct btc_work_s *next;
 } btc_work_t;
 
 typedef struct btc_workq_s {
-  btc_work_t *head;
-  btc_work_t *tail;
+  btc_work_t *items;
+  int alloc;
   int length;
 } btc_workq_t;
 
@@ -46,6 +45,9 @@ btc_workq_clear(btc_workq_t *queue);
 BTC_EXTERN void
 btc_workq_push(btc_workq_t *queue, btc_work_f *func, void *arg);
 
+BTC_EXTERN void
+btc_workq_concat(btc_workq_t *z, btc_workq_t *x);
+
 /*
  * Workers
  */
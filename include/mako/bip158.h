@@ -0,0 +1,78 @@
+/*!
+ * bip158.h - bip158 for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#ifndef BTC_BIP158_H
+#define BTC_BIP158_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "types.h"
+#include "common.h"
+
+/*
+ * Constants
+ */
+
+#define BTC_FILTER_BASIC 0
+#define BTC_FILTER_P 19
+#define BTC_FILTER_M 784931
+
+/*
+ * Block Filter
+ */
+
+BTC_EXTERN void
+btc_blockfilter_init(btc_blockfilter_t *z);
+
+BTC_EXTERN void
+btc_blockfilter_clear(btc_blockfilter_t *z);
+
+BTC_EXTERN void
+btc_blockfilter_reset(btc_blockfilter_t *z, const uint8_t *hash);
+
+BTC_EXTERN void
+btc_blockfilter_add(btc_blockfilter_t *z, const uint8_t *data, size_t size);
+
+BTC_EXTERN void
+btc_blockfilter_finalize(btc_blockfilter_t *z);
+
+BTC_EXTERN void
+btc_blockfilter_set_block(btc_blockfilter_t *z,
+                          const btc_block_t *block,
+                          const btc_undo_t *undo);
+
+BTC_EXTERN int
+btc_blockfilter_set(btc_blockfilter_t *z,
+                    const uint8_t *hash,
+                    const uint8_t *data,
+                    size_t size);
+
+BTC_EXTERN int
+btc_blockfilter_match(const btc_blockfilter_t *z,
+                      const uint8_t *data,
+                      size_t size);
+
+BTC_EXTERN int
+btc_blockfilter_match_any(const btc_blockfilter_t *z,
+                          const btc_vector_t *items);
+
+BTC_EXTERN void
+btc_blockfilter_hash(uint8_t *hash, const btc_blockfilter_t *z);
+
+BTC_EXTERN void
+btc_blockfilter_header(uint8_t *header,
+                       const btc_blockfilter_t *z,
+                       const uint8_t *prev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BTC_BIP158_H */
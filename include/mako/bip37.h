@@ -67,6 +67,11 @@ btc_merkleblock_set_hashes(btc_merkleblock_t *tree,
                            const btc_block_t *block,
                            const btc_vector_t *hashes);
 
+BTC_EXTERN btc_vector_t *
+btc_merkleblock_set_raw(btc_merkleblock_t *tree,
+                        const btc_rawblock_t *block,
+                        btc_bloom_t *filter);
+
 #ifdef __cplusplus
 }
 #endif
@@ -85,11 +85,33 @@ btc_block_write(uint8_t *zp, const btc_block_t *x);
 BTC_EXTERN int
 btc_block_read(btc_block_t *z, const uint8_t **xp, size_t *xn);
 
+BTC_EXTERN int
+btc_block_read_deferred(btc_block_t *z, const uint8_t **xp, size_t *xn);
+
+BTC_EXTERN int
+btc_block_import_deferred(btc_block_t *z, const uint8_t *xp, size_t xn);
+
 BTC_EXTERN void
 btc_block_inspect(const btc_block_t *block,
                   const btc_view_t *view,
                   const btc_network_t *network);
 
+/*
+ * Raw Block
+ */
+
+BTC_EXTERN int
+btc_rawblock_read(btc_rawblock_t *z, const uint8_t **xp, size_t *xn);
+
+BTC_EXTERN int
+btc_rawblock_import(btc_rawblock_t *z, const uint8_t *xp, size_t xn);
+
+BTC_EXTERN btc_block_t *
+btc_rawblock_decode(const btc_rawblock_t *blk);
+
+BTC_EXTERN size_t
+btc_rawblock_base_size(const btc_rawblock_t *blk);
+
 #ifdef __cplusplus
 }
 #endif
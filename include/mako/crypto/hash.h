@@ -45,6 +45,10 @@ btc_hash256(uint8_t *out, const void *data, size_t size);
 BTC_EXTERN void
 btc_hash256_root(uint8_t *out, const void *left, const void *right);
 
+/* Hashes `count` 64 byte inputs. `out` may overlap `in` if out <= in. */
+BTC_EXTERN void
+btc_hash256_roots(uint8_t *out, const uint8_t *in, size_t count);
+
 BTC_EXTERN uint32_t
 btc_checksum(const void *data, size_t size);
 
@@ -84,6 +88,18 @@ btc_sha1(uint8_t *out, const void *data, size_t size);
  * SHA256
  */
 
+#define BTC_SHA256_GENERIC 0
+#define BTC_SHA256_SHANI 1
+#define BTC_SHA256_ARMV8 2
+#define BTC_SHA256_SSE2 3
+#define BTC_SHA256_AVX2 4
+
+BTC_EXTERN int
+btc_sha256_backend(void);
+
+BTC_EXTERN int
+btc_sha256_select(int backend);
+
 BTC_EXTERN void
 btc_sha256_init(btc_sha256_t *ctx);
 
@@ -138,6 +154,25 @@ btc_hmac512_update(btc_hmac512_t *hmac, const void *data, size_t len);
 BTC_EXTERN void
 btc_hmac512_final(btc_hmac512_t *hmac, uint8_t *out);
 
+/*
+ * MuHash3072
+ */
+
+BTC_EXTERN void
+btc_muhash_init(btc_muhash_t *ctx);
+
+BTC_EXTERN void
+btc_muhash_insert(btc_muhash_t *ctx, const void *data, size_t len);
+
+BTC_EXTERN void
+btc_muhash_remove(btc_muhash_t *ctx, const void *data, size_t len);
+
+BTC_EXTERN void
+btc_muhash_combine(btc_muhash_t *z, const btc_muhash_t *x);
+
+BTC_EXTERN void
+btc_muhash_final(const btc_muhash_t *ctx, uint8_t *out);
+
 /*
  * PBKDF256
  */
@@ -28,6 +28,9 @@ btc_siphash_mod(const uint8_t *data,
                 const uint8_t *key,
                 uint64_t mod);
 
+BTC_EXTERN uint64_t
+btc_siphash_reduce(uint64_t x, uint64_t mod);
+
 #ifdef __cplusplus
 }
 #endif
@@ -53,6 +53,11 @@ typedef struct btc_sha512_s {
 typedef btc_sha256_t btc_hash160_t;
 typedef btc_sha256_t btc_hash256_t;
 
+typedef struct btc_muhash_s {
+  uint8_t num[384];
+  uint8_t den[384];
+} btc_muhash_t;
+
 typedef struct btc_hmac256_s {
   btc_sha256_t inner;
   btc_sha256_t outer;
@@ -55,6 +55,7 @@
 #define json_entry_new btc_json_entry_new
 #define json_entry_new_ex btc_json_entry_new_ex
 #define json_block_new_ex btc_json_block_new_ex
+#define json_rawblock_new_ex btc_json_rawblock_new_ex
 
 #define json_tx_base btc_json_tx_base
 #define json_tx_base_get btc_json_tx_base_get
@@ -232,6 +233,12 @@ json_block_new_ex(const btc_block_t *block,
                   int details,
                   const btc_network_t *network);
 
+BTC_EXTERN json_value *
+json_rawblock_new_ex(const btc_rawblock_t *block,
+                     const btc_entry_t *entry,
+                     int confirmations,
+                     const uint8_t *next);
+
 /*
  * Hexification
  */
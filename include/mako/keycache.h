@@ -0,0 +1,46 @@
+/*!
+ * keycache.h - public key cache for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#ifndef BTC_KEYCACHE_H
+#define BTC_KEYCACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "common.h"
+#include "types.h"
+
+/*
+ * Constants
+ */
+
+#define BTC_KEYCACHE_SIZE (1 << 14)
+
+/*
+ * Key Cache
+ */
+
+BTC_EXTERN btc_keycache_t *
+btc_keycache_create(size_t size);
+
+BTC_EXTERN void
+btc_keycache_destroy(btc_keycache_t *cache);
+
+BTC_EXTERN int
+btc_keycache_verify(btc_keycache_t *cache,
+                    const uint8_t *msg,
+                    const uint8_t *sig,
+                    const uint8_t *pub,
+                    size_t pub_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BTC_KEYCACHE_H */
@@ -88,6 +88,12 @@ enum btc_net_services {
 
   BTC_NET_SERVICE_WITNESS = 1 << 3,
 
+  /**
+   * Whether the peer serves BIP157 compact filters.
+   */
+
+  BTC_NET_SERVICE_COMPACT_FILTERS = 1 << 6,
+
   /**
    * Default services.
    */
@@ -25,6 +25,9 @@ enum btc_msgtype {
   BTC_MSG_ADDR,
   BTC_MSG_BLOCK,
   BTC_MSG_BLOCKTXN,
+  BTC_MSG_CFCHECKPT,
+  BTC_MSG_CFHEADERS,
+  BTC_MSG_CFILTER,
   BTC_MSG_CMPCTBLOCK,
   BTC_MSG_FEEFILTER,
   BTC_MSG_FILTERADD,
@@ -33,6 +36,9 @@ enum btc_msgtype {
   BTC_MSG_GETADDR,
   BTC_MSG_GETBLOCKS,
   BTC_MSG_GETBLOCKTXN,
+  BTC_MSG_GETCFCHECKPT,
+  BTC_MSG_GETCFHEADERS,
+  BTC_MSG_GETCFILTERS,
   BTC_MSG_GETDATA,
   BTC_MSG_GETHEADERS,
   BTC_MSG_HEADERS,
@@ -172,6 +178,37 @@ typedef struct btc_sendcmpct_s {
   uint64_t version;
 } btc_sendcmpct_t;
 
+typedef struct btc_getcfilters_s {
+  uint8_t filter_type;
+  uint32_t start_height;
+  const uint8_t *stop;
+} btc_getcfilters_t;
+
+typedef struct btc_cfilter_s {
+  uint8_t filter_type;
+  const uint8_t *hash;
+  const uint8_t *data;
+  size_t length;
+} btc_cfilter_t;
+
+typedef struct btc_cfheaders_s {
+  uint8_t filter_type;
+  const uint8_t *stop;
+  const uint8_t *prev;
+  btc_vector_t hashes;
+} btc_cfheaders_t;
+
+typedef struct btc_getcfcheckpt_s {
+  uint8_t filter_type;
+  const uint8_t *stop;
+} btc_getcfcheckpt_t;
+
+typedef struct btc_cfcheckpt_s {
+  uint8_t filter_type;
+  const uint8_t *stop;
+  btc_vector_t headers;
+} btc_cfcheckpt_t;
+
 typedef struct btc_unknown_s {
   const uint8_t *data;
   size_t length;
@@ -549,6 +586,132 @@ btc_sendcmpct_read(btc_sendcmpct_t *z, const uint8_t **xp, size_t *xn);
 
 /* TODO */
 
+/*
+ * GetCFilters
+ */
+
+BTC_DEFINE_SERIALIZABLE_OBJECT(btc_getcfilters, BTC_SCOPE_EXTERN)
+
+BTC_EXTERN void
+btc_getcfilters_init(btc_getcfilters_t *msg);
+
+BTC_EXTERN void
+btc_getcfilters_clear(btc_getcfilters_t *msg);
+
+BTC_EXTERN void
+btc_getcfilters_copy(btc_getcfilters_t *z, const btc_getcfilters_t *x);
+
+BTC_EXTERN size_t
+btc_getcfilters_size(const btc_getcfilters_t *x);
+
+BTC_EXTERN uint8_t *
+btc_getcfilters_write(uint8_t *zp, const btc_getcfilters_t *x);
+
+BTC_EXTERN int
+btc_getcfilters_read(btc_getcfilters_t *z, const uint8_t **xp, size_t *xn);
+
+/*
+ * CFilter
+ */
+
+BTC_DEFINE_SERIALIZABLE_OBJECT(btc_cfilter, BTC_SCOPE_EXTERN)
+
+BTC_EXTERN void
+btc_cfilter_init(btc_cfilter_t *msg);
+
+BTC_EXTERN void
+btc_cfilter_clear(btc_cfilter_t *msg);
+
+BTC_EXTERN void
+btc_cfilter_copy(btc_cfilter_t *z, const btc_cfilter_t *x);
+
+BTC_EXTERN size_t
+btc_cfilter_size(const btc_cfilter_t *x);
+
+BTC_EXTERN uint8_t *
+btc_cfilter_write(uint8_t *zp, const btc_cfilter_t *x);
+
+BTC_EXTERN int
+btc_cfilter_read(btc_cfilter_t *z, const uint8_t **xp, size_t *xn);
+
+/*
+ * GetCFHeaders
+ */
+
+/* inherits btc_getcfilters_t */
+
+/*
+ * CFHeaders
+ */
+
+BTC_DEFINE_SERIALIZABLE_OBJECT(btc_cfheaders, BTC_SCOPE_EXTERN)
+
+BTC_EXTERN void
+btc_cfheaders_init(btc_cfheaders_t *msg);
+
+BTC_EXTERN void
+btc_cfheaders_clear(btc_cfheaders_t *msg);
+
+BTC_EXTERN void
+btc_cfheaders_copy(btc_cfheaders_t *z, const btc_cfheaders_t *x);
+
+BTC_EXTERN size_t
+btc_cfheaders_size(const btc_cfheaders_t *x);
+
+BTC_EXTERN uint8_t *
+btc_cfheaders_write(uint8_t *zp, const btc_cfheaders_t *x);
+
+BTC_EXTERN int
+btc_cfheaders_read(btc_cfheaders_t *z, const uint8_t **xp, size_t *xn);
+
+/*
+ * GetCFCheckpt
+ */
+
+BTC_DEFINE_SERIALIZABLE_OBJECT(btc_getcfcheckpt, BTC_SCOPE_EXTERN)
+
+BTC_EXTERN void
+btc_getcfcheckpt_init(btc_getcfcheckpt_t *msg);
+
+BTC_EXTERN void
+btc_getcfcheckpt_clear(btc_getcfcheckpt_t *msg);
+
+BTC_EXTERN void
+btc_getcfcheckpt_copy(btc_getcfcheckpt_t *z, const btc_getcfcheckpt_t *x);
+
+BTC_EXTERN size_t
+btc_getcfcheckpt_size(const btc_getcfcheckpt_t *x);
+
+BTC_EXTERN uint8_t *
+btc_getcfcheckpt_write(uint8_t *zp, const btc_getcfcheckpt_t *x);
+
+BTC_EXTERN int
+btc_getcfcheckpt_read(btc_getcfcheckpt_t *z, const uint8_t **xp, size_t *xn);
+
+/*
+ * CFCheckpt
+ */
+
+BTC_DEFINE_SERIALIZABLE_OBJECT(btc_cfcheckpt, BTC_SCOPE_EXTERN)
+
+BTC_EXTERN void
+btc_cfcheckpt_init(btc_cfcheckpt_t *msg);
+
+BTC_EXTERN void
+btc_cfcheckpt_clear(btc_cfcheckpt_t *msg);
+
+BTC_EXTERN void
+btc_cfcheckpt_copy(btc_cfcheckpt_t *z, const btc_cfcheckpt_t *x);
+
+BTC_EXTERN size_t
+btc_cfcheckpt_size(const btc_cfcheckpt_t *x);
+
+BTC_EXTERN uint8_t *
+btc_cfcheckpt_write(uint8_t *zp, const btc_cfcheckpt_t *x);
+
+BTC_EXTERN int
+btc_cfcheckpt_read(btc_cfcheckpt_t *z, const uint8_t **xp, size_t *xn);
+
 /*
  * Unknown
  */
@@ -37,6 +37,12 @@ typedef struct btc_checkpoint_s {
   uint8_t hash[32];
 } btc_checkpoint_t;
 
+typedef struct btc_assumeutxo_s {
+  int32_t height;
+  uint8_t hash[32];
+  uint8_t muhash[32];
+} btc_assumeutxo_t;
+
 typedef struct btc_deployment_s {
   const char *name;
   int bit;
@@ -90,6 +96,21 @@ struct btc_network_s {
    */
   int32_t last_checkpoint;
 
+  /**
+   * Block whose ancestors are assumed
+   * to have valid scripts.
+   */
+  btc_checkpoint_t assume_valid;
+
+  /**
+   * Coin set commitments (MuHash) of
+   * blocks we accept UTXO snapshots for.
+   */
+  struct btc_network_assume_utxo_s {
+    const btc_assumeutxo_t *items;
+    size_t length;
+  } assume_utxo;
+
   /**
    * Block subsidy halving interval.
    */
@@ -311,6 +332,9 @@ typedef struct btc_network_pow_s btc_network_pow_t;
 BTC_EXTERN const btc_checkpoint_t *
 btc_network_checkpoint(const btc_network_t *network, int32_t height);
 
+BTC_EXTERN const btc_assumeutxo_t *
+btc_network_assumeutxo(const btc_network_t *network, int32_t height);
+
 BTC_EXTERN const btc_checkpoint_t *
 btc_network_bip30(const btc_network_t *network, int32_t height);
 
@@ -203,6 +203,15 @@ btc_tx_sighash(uint8_t *hash,
                int version,
                btc_tx_cache_t *cache);
 
+BTC_EXTERN void
+btc_tx_cache_init(btc_tx_cache_t *cache);
+
+BTC_EXTERN void
+btc_tx_cache_clear(btc_tx_cache_t *cache);
+
+BTC_EXTERN void
+btc_tx_precompute(const btc_tx_t *tx, btc_tx_cache_t *cache);
+
 BTC_EXTERN int
 btc_tx_verify(const btc_tx_t *tx, const btc_view_t *view, unsigned int flags);
 
@@ -335,6 +344,9 @@ btc_tx_write(uint8_t *zp, const btc_tx_t *tx);
 BTC_EXTERN int
 btc_tx_read(btc_tx_t *z, const uint8_t **xp, size_t *xn);
 
+BTC_EXTERN int
+btc_tx_read_deferred(btc_tx_t *z, const uint8_t **xp, size_t *xn);
+
 BTC_EXTERN int
 btc_tx_base_read(btc_tx_t *z, const uint8_t **xp, size_t *xn);
 
@@ -364,6 +376,72 @@ btc_txvec_base_write(uint8_t *zp, const btc_txvec_t *x);
 BTC_EXTERN size_t
 btc_txvec_witness_size(const btc_txvec_t *txs);
 
+/*
+ * Raw Input
+ */
+
+BTC_EXTERN int
+btc_rawinput_read(btc_rawinput_t *z, const uint8_t **xp, size_t *xn);
+
+BTC_EXTERN int
+btc_rawinput_import(btc_rawinput_t *z, const uint8_t *xp, size_t xn);
+
+/*
+ * Raw Output
+ */
+
+BTC_EXTERN int
+btc_rawoutput_read(btc_output_t *z, const uint8_t **xp, size_t *xn);
+
+/*
+ * Raw Witness
+ */
+
+BTC_EXTERN int
+btc_rawwitness_read(btc_rawvec_t *z, const uint8_t **xp, size_t *xn);
+
+BTC_EXTERN int
+btc_rawitem_read(btc_buffer_t *z, const uint8_t **xp, size_t *xn);
+
+/*
+ * Raw Transaction
+ */
+
+BTC_EXTERN int
+btc_rawtx_read(btc_rawtx_t *z, const uint8_t **xp, size_t *xn);
+
+BTC_EXTERN int
+btc_rawtx_import(btc_rawtx_t *z, const uint8_t *xp, size_t xn);
+
+BTC_EXTERN btc_tx_t *
+btc_rawtx_decode(const btc_rawtx_t *tx);
+
+BTC_EXTERN int
+btc_rawtx_has_witness(const btc_rawtx_t *tx);
+
+BTC_EXTERN int
+btc_rawtx_is_coinbase(const btc_rawtx_t *tx);
+
+BTC_EXTERN void
+btc_rawtx_txid(uint8_t *hash, const btc_rawtx_t *tx);
+
+BTC_EXTERN void
+btc_rawtx_wtxid(uint8_t *hash, const btc_rawtx_t *tx);
+
+BTC_EXTERN void
+btc_rawtx_refresh(btc_tx_t *z, const btc_rawtx_t *tx);
+
+BTC_EXTERN int
+btc_rawtx_matches(const btc_rawtx_t *tx,
+                  const uint8_t *hash,
+                  btc_bloom_t *filter);
+
+BTC_EXTERN size_t
+btc_rawtx_base_size(const btc_rawtx_t *tx);
+
+BTC_EXTERN size_t
+btc_rawtx_witness_size(const btc_rawtx_t *tx);
+
 /*
  * Signing
  */
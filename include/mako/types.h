@@ -161,6 +161,35 @@ typedef struct btc_block_s {
   int _refs;
 } btc_block_t;
 
+typedef struct btc_rawvec_s {
+  const uint8_t *data;
+  size_t size;
+  size_t length;
+} btc_rawvec_t;
+
+typedef struct btc_rawinput_s {
+  btc_outpoint_t prevout;
+  btc_script_t script;
+  uint32_t sequence;
+} btc_rawinput_t;
+
+typedef struct btc_rawtx_s {
+  const uint8_t *data;
+  size_t size;
+  uint32_t version;
+  btc_rawvec_t inputs;
+  btc_rawvec_t outputs;
+  btc_rawvec_t witness;
+  uint32_t locktime;
+} btc_rawtx_t;
+
+typedef struct btc_rawblock_s {
+  const uint8_t *data;
+  size_t size;
+  btc_header_t header;
+  btc_rawvec_t txs;
+} btc_rawblock_t;
+
 typedef struct btc_entry_s {
   uint8_t hash[32];
   btc_header_t header;
@@ -172,6 +201,7 @@ typedef struct btc_entry_s {
   int32_t undo_pos;
   struct btc_entry_s *prev;
   struct btc_entry_s *next;
+  struct btc_entry_s *skip;
 } btc_entry_t;
 
 typedef struct btc_coin_s {
@@ -199,6 +229,8 @@ typedef struct btc_multikey_s {
   size_t length;
 } btc_multikey_t;
 
+typedef struct btc_keycache_s btc_keycache_t;
+
 typedef struct btc_tx_cache_s {
   uint8_t prevouts[32];
   uint8_t sequences[32];
@@ -206,6 +238,12 @@ typedef struct btc_tx_cache_s {
   int has_prevouts;
   int has_sequences;
   int has_outputs;
+  uint8_t *legacy;
+  size_t legacy_size;
+  size_t legacy_start;
+  uint32_t *midstates;
+  int has_legacy;
+  btc_keycache_t *keys;
 } btc_tx_cache_t;
 
 typedef struct btc_verify_error_s {
@@ -244,6 +282,22 @@ typedef struct btc_filter_s {
   uint32_t tweak;
 } btc_filter_t;
 
+typedef struct btc_gcsitem_s {
+  const uint8_t *data;
+  size_t size;
+  uint64_t hash;
+} btc_gcsitem_t;
+
+typedef struct btc_blockfilter_s {
+  uint8_t key[16];
+  uint64_t n;
+  uint8_t *data;
+  size_t size;
+  btc_gcsitem_t *items;
+  size_t alloc;
+  size_t length;
+} btc_blockfilter_t;
+
 typedef struct btc_mpentry_s {
   const uint8_t *hash;
   const uint8_t *whash;
@@ -80,12 +80,26 @@ btc_chain_set_logger(btc_chain_t *chain, btc_logger_t *logger);
 BTC_EXTERN void
 btc_chain_set_timedata(btc_chain_t *chain, const btc_timedata_t *td);
 
+BTC_EXTERN void
+btc_chain_set_sigcache(btc_chain_t *chain, btc_sigcache_t *cache);
+
 BTC_EXTERN void
 btc_chain_set_threads(btc_chain_t *chain, int threads);
 
 BTC_EXTERN void
 btc_chain_set_cache(btc_chain_t *chain, size_t cache_size);
 
+BTC_EXTERN void
+btc_chain_set_prune(btc_chain_t *chain, uint64_t target);
+
+BTC_EXTERN void
+btc_chain_set_assume_valid(btc_chain_t *chain, const uint8_t *hash);
+
+BTC_EXTERN void
+btc_chain_set_snapshot(btc_chain_t *chain,
+                       const char *path,
+                       const uint8_t *muhash);
+
 BTC_EXTERN void
 btc_chain_on_block(btc_chain_t *chain, btc_chain_block_cb *handler);
 
@@ -143,18 +157,33 @@ btc_chain_verify_locks(btc_chain_t *chain,
                        const btc_view_t *view,
                        unsigned int flags);
 
+BTC_EXTERN int
+btc_chain_read_block(btc_chain_t *chain,
+                     btc_block_t *block,
+                     const uint8_t *xp,
+                     size_t xn);
+
 BTC_EXTERN int
 btc_chain_add(btc_chain_t *chain,
               const btc_block_t *block,
               unsigned int flags,
               unsigned int id);
 
+BTC_EXTERN void
+btc_chain_add_header(btc_chain_t *chain, const btc_header_t *hdr);
+
+BTC_EXTERN int
+btc_chain_get_assumed(btc_chain_t *chain, uint8_t *hash, int32_t *height);
+
 BTC_EXTERN const btc_entry_t *
 btc_chain_tip(btc_chain_t *chain);
 
 BTC_EXTERN int32_t
 btc_chain_height(btc_chain_t *chain);
 
+BTC_EXTERN const btc_coinstats_t *
+btc_chain_coinstats(btc_chain_t *chain);
+
 BTC_EXTERN const btc_deployment_state_t *
 btc_chain_state(btc_chain_t *chain);
 
@@ -173,6 +202,9 @@ btc_chain_synced(btc_chain_t *chain);
 BTC_EXTERN int
 btc_chain_pruned(btc_chain_t *chain);
 
+BTC_EXTERN int32_t
+btc_chain_unvalidated(btc_chain_t *chain);
+
 BTC_EXTERN int
 btc_chain_has_hash(btc_chain_t *chain, const uint8_t *hash);
 
@@ -205,11 +237,53 @@ btc_chain_get_raw_block(btc_chain_t *chain,
                         size_t *length,
                         const btc_entry_t *entry);
 
+BTC_EXTERN int
+btc_chain_get_block_data(btc_chain_t *chain,
+                         uint8_t **data,
+                         size_t *length,
+                         const btc_entry_t *entry);
+
 BTC_EXTERN btc_view_t *
 btc_chain_get_undo(btc_chain_t *chain,
                    const btc_entry_t *entry,
                    const btc_block_t *block);
 
+BTC_EXTERN int
+btc_chain_get_tx(btc_chain_t *chain,
+                 btc_tx_t **result,
+                 const btc_entry_t **block,
+                 const uint8_t *hash);
+
+BTC_EXTERN btc_scriptiter_t *
+btc_chain_history(btc_chain_t *chain,
+                  const btc_script_t *script,
+                  int32_t start,
+                  int32_t end);
+
+BTC_EXTERN btc_scriptiter_t *
+btc_chain_unspent(btc_chain_t *chain, const btc_script_t *script);
+
+BTC_EXTERN int
+btc_chain_get_filter(btc_chain_t *chain,
+                     uint8_t **data,
+                     size_t *length,
+                     const btc_entry_t *entry);
+
+BTC_EXTERN int
+btc_chain_get_filter_header(btc_chain_t *chain,
+                            uint8_t *filter_hash,
+                            uint8_t *header,
+                            const btc_entry_t *entry);
+
+BTC_EXTERN int
+btc_chain_prune(btc_chain_t *chain, int32_t height, int32_t *pruned);
+
+BTC_EXTERN int
+btc_chain_export(btc_chain_t *chain,
+                 const char *path,
+                 uint8_t *hash,
+                 uint64_t *count);
+
 BTC_EXTERN const uint8_t *
 btc_chain_get_orphan_root(btc_chain_t *chain, const uint8_t *hash);
 
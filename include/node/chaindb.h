@@ -16,6 +16,12 @@ extern "C" {
 #include "../mako/common.h"
 #include "../mako/types.h"
 
+/*
+ * Types
+ */
+
+struct btc_workers_s;
+
 /*
  * Chain Database
  */
@@ -29,15 +35,35 @@ btc_chaindb_destroy(btc_chaindb_t *db);
 BTC_EXTERN void
 btc_chaindb_set_cache(btc_chaindb_t *db, size_t cache_size);
 
+BTC_EXTERN void
+btc_chaindb_set_prune(btc_chaindb_t *db, uint64_t target);
+
+BTC_EXTERN void
+btc_chaindb_set_file_size(btc_chaindb_t *db, int32_t size);
+
+BTC_EXTERN int
+btc_chaindb_set_undo_version(btc_chaindb_t *db, int version);
+
+BTC_EXTERN void
+btc_chaindb_set_import_limit(btc_chaindb_t *db, size_t limit);
+
 BTC_EXTERN int
 btc_chaindb_open(btc_chaindb_t *db, const char *prefix, unsigned int flags);
 
 BTC_EXTERN void
 btc_chaindb_close(btc_chaindb_t *db);
 
+BTC_EXTERN void
+btc_chaindb_abort(btc_chaindb_t *db);
+
 BTC_EXTERN btc_coin_t *
 btc_chaindb_coin(btc_chaindb_t *db, const uint8_t *hash, size_t index);
 
+BTC_EXTERN void
+btc_chaindb_prefetch(btc_chaindb_t *db,
+                     const btc_block_t *block,
+                     struct btc_workers_s *pool);
+
 BTC_EXTERN int
 btc_chaindb_spend(btc_chaindb_t *db,
                   btc_view_t *view,
@@ -48,6 +74,12 @@ btc_chaindb_fill(btc_chaindb_t *db,
                  btc_view_t *view,
                  const btc_tx_t *tx);
 
+BTC_EXTERN btc_entry_t *
+btc_chaindb_entry_create(btc_chaindb_t *db);
+
+BTC_EXTERN void
+btc_chaindb_entry_destroy(btc_chaindb_t *db, btc_entry_t *entry);
+
 BTC_EXTERN int
 btc_chaindb_save(btc_chaindb_t *db,
                  btc_entry_t *entry,
@@ -74,6 +106,12 @@ btc_chaindb_tail(btc_chaindb_t *db);
 BTC_EXTERN int32_t
 btc_chaindb_height(btc_chaindb_t *db);
 
+BTC_EXTERN const btc_coinstats_t *
+btc_chaindb_coinstats(btc_chaindb_t *db);
+
+BTC_EXTERN int32_t
+btc_chaindb_unvalidated(btc_chaindb_t *db);
+
 BTC_EXTERN const btc_entry_t *
 btc_chaindb_by_hash(btc_chaindb_t *db, const uint8_t *hash);
 
@@ -95,11 +133,84 @@ btc_chaindb_get_raw_block(btc_chaindb_t *db,
                           size_t *length,
                           const btc_entry_t *entry);
 
+BTC_EXTERN int
+btc_chaindb_get_block_data(btc_chaindb_t *db,
+                           uint8_t **data,
+                           size_t *length,
+                           const btc_entry_t *entry);
+
+BTC_EXTERN int
+btc_chaindb_undo_version(btc_chaindb_t *db, const btc_entry_t *entry);
+
 BTC_EXTERN btc_view_t *
 btc_chaindb_get_undo(btc_chaindb_t *db,
                      const btc_entry_t *entry,
                      const btc_block_t *block);
 
+BTC_EXTERN int
+btc_chaindb_get_tx(btc_chaindb_t *db,
+                   btc_tx_t **result,
+                   const btc_entry_t **block,
+                   const uint8_t *hash);
+
+BTC_EXTERN btc_scriptiter_t *
+btc_chaindb_history(btc_chaindb_t *db,
+                    const btc_script_t *script,
+                    int32_t start,
+                    int32_t end);
+
+BTC_EXTERN btc_scriptiter_t *
+btc_chaindb_unspent(btc_chaindb_t *db, const btc_script_t *script);
+
+BTC_EXTERN int
+btc_chaindb_get_filter(btc_chaindb_t *db,
+                       uint8_t **data,
+                       size_t *length,
+                       const uint8_t *hash);
+
+BTC_EXTERN int
+btc_chaindb_get_filter_header(btc_chaindb_t *db,
+                              uint8_t *filter_hash,
+                              uint8_t *header,
+                              const uint8_t *hash);
+
+BTC_EXTERN int
+btc_chaindb_prune(btc_chaindb_t *db, int32_t height, int32_t *pruned);
+
+BTC_EXTERN int
+btc_chaindb_export(btc_chaindb_t *db,
+                   const char *path,
+                   uint8_t *hash,
+                   uint64_t *count);
+
+BTC_EXTERN int
+btc_chaindb_import(btc_chaindb_t *db,
+                   const char *path,
+                   const uint8_t *muhash,
+                   uint8_t *hash);
+
+/*
+ * Script Iterator
+ */
+
+BTC_EXTERN void
+btc_scriptiter_destroy(btc_scriptiter_t *iter);
+
+BTC_EXTERN int
+btc_scriptiter_next(btc_scriptiter_t *iter);
+
+BTC_EXTERN const uint8_t *
+btc_scriptiter_hash(const btc_scriptiter_t *iter);
+
+BTC_EXTERN uint32_t
+btc_scriptiter_index(const btc_scriptiter_t *iter);
+
+BTC_EXTERN int32_t
+btc_scriptiter_height(const btc_scriptiter_t *iter);
+
+BTC_EXTERN const btc_coin_t *
+btc_scriptiter_coin(const btc_scriptiter_t *iter);
+
 #ifdef __cplusplus
 }
 #endif
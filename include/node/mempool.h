@@ -46,6 +46,9 @@ btc_mempool_set_logger(btc_mempool_t *mp, btc_logger_t *logger);
 BTC_EXTERN void
 btc_mempool_set_timedata(btc_mempool_t *mp, const btc_timedata_t *td);
 
+BTC_EXTERN void
+btc_mempool_set_sigcache(btc_mempool_t *mp, btc_sigcache_t *cache);
+
 BTC_EXTERN void
 btc_mempool_on_tx(btc_mempool_t *mp, btc_mempool_tx_cb *handler);
 
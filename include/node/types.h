@@ -14,6 +14,7 @@ extern "C" {
 #include <stddef.h>
 #include <stdint.h>
 #include "../base/types.h"
+#include "../mako/crypto/types.h"
 
 /*
  * Flags
@@ -25,6 +26,9 @@ enum btc_node_flags {
    */
   BTC_CHAIN_CHECKPOINTS = 1 << 0,
   BTC_CHAIN_PRUNE = 1 << 1,
+  BTC_CHAIN_TXINDEX = 1 << 16,
+  BTC_CHAIN_ADDRINDEX = 1 << 17,
+  BTC_CHAIN_FILTERINDEX = 1 << 18,
   BTC_CHAIN_DEFAULT_FLAGS = BTC_CHAIN_CHECKPOINTS,
 
   /*
@@ -80,7 +84,15 @@ typedef struct btc_deployment_state_s {
   int bip148;
 } btc_deployment_state_t;
 
+typedef struct btc_coinstats_s {
+  btc_muhash_t muhash;
+  int64_t count;
+  int64_t value;
+  int64_t size;
+} btc_coinstats_t;
+
 typedef struct btc_chaindb_s btc_chaindb_t;
+typedef struct btc_scriptiter_s btc_scriptiter_t;
 typedef struct btc_chain_s btc_chain_t;
 
 typedef struct btc_pool_s btc_pool_t;
@@ -98,6 +110,7 @@ typedef struct btc_node_s {
   struct btc_loop_s *loop;
   btc_logger_t *logger;
   btc_timedata_t *timedata;
+  btc_sigcache_t *sigcache;
   btc_chain_t *chain;
   btc_mempool_t *mempool;
   btc_miner_t *miner;
@@ -38,6 +38,12 @@ btc_wclient_by_height(const btc_wclient_t *client, int32_t height);
 btc_block_t *
 btc_wclient_get_block(const btc_wclient_t *client, const btc_entry_t *entry);
 
+int
+btc_wclient_get_raw_block(const btc_wclient_t *client,
+                          uint8_t **data,
+                          size_t *length,
+                          const btc_entry_t *entry);
+
 void
 btc_wclient_send(const btc_wclient_t *client, const btc_tx_t *tx);
 
@@ -41,6 +41,7 @@ typedef struct btc_wclient_s {
   const btc_entry_t *(*by_hash)(void *, const uint8_t *);
   const btc_entry_t *(*by_height)(void *, int32_t);
   btc_block_t *(*get_block)(void *, const btc_entry_t *);
+  int (*get_raw_block)(void *, uint8_t **, size_t *, const btc_entry_t *);
   void (*send)(void *, const btc_tx_t *);
   void (*log)(void *, int, const char *, va_list);
 } btc_wclient_t;
@@ -358,11 +358,39 @@ btc_match_range(int *z, const char *xp, const char *yp, int min, int max) {
   return 1;
 }
 
+static int
+btc_match_prune(int *z, const char *xp, const char *yp) {
+  /* Matches `option=0`, `option=1` (manual) and `option=<MiB>`. */
+  if (!btc_match_uint(z, xp, yp))
+    return 0;
+
+  if (*z > 1 && *z < 550)
+    return 0;
+
+  return 1;
+}
+
 static int
 btc_match_port(int *z, const char *xp, const char *yp) {
   return btc_match_range(z, xp, yp, 0, 0xffff);
 }
 
+static int
+btc_match_hash(uint8_t *z, const char *xp, const char *yp) {
+  /* Matches `option=0` and `option=<hash>`. */
+  const char *val;
+
+  if (!btc_match(&val, xp, yp))
+    return 0;
+
+  if (val[0] == '0' && val[1] == '\0') {
+    memset(z, 0, 32);
+    return 1;
+  }
+
+  return btc_hash_import(z, val);
+}
+
 static int
 btc_match_network(const btc_network_t **z, const char *xp, const char *yp) {
   const char *val;
@@ -461,7 +489,14 @@ conf_init(btc_conf_t *conf) {
   conf->disable_wallet = 0;
   conf->cache_size = 128;
   conf->checkpoints = 1;
+  conf->assume_valid = 0;
+  memset(conf->assume_hash, 0, 32);
   conf->prune = 0;
+  conf->txindex = 0;
+  conf->addrindex = 0;
+  conf->filterindex = 0;
+  conf->snapshot[0] = '\0';
+  memset(conf->snapshot_hash, 0, 32);
   conf->workers = 0;
   conf->listen = 1;
   conf->port = 0;
@@ -589,7 +624,27 @@ conf_read_file(btc_conf_t *conf, const char *file) {
     if (btc_match_bool(&conf->checkpoints, opt, "checkpoints="))
       continue;
 
-    if (btc_match_bool(&conf->prune, opt, "prune="))
+    if (btc_match_hash(conf->assume_hash, opt, "assumevalid=")) {
+      conf->assume_valid = 1;
+      continue;
+    }
+
+    if (btc_match_prune(&conf->prune, opt, "prune="))
+      continue;
+
+    if (btc_match_bool(&conf->txindex, opt, "txindex="))
+      continue;
+
+    if (btc_match_bool(&conf->addrindex, opt, "addrindex="))
+      continue;
+
+    if (btc_match_bool(&conf->filterindex, opt, "blockfilterindex="))
+      continue;
+
+    if (btc_match_path(conf->snapshot, opt, "loadsnapshot="))
+      continue;
+
+    if (btc_match_hash(conf->snapshot_hash, opt, "snapshothash="))
       continue;
 
     if (btc_match_range(&conf->workers, opt, "par=", -6, 15))
@@ -733,7 +788,27 @@ conf_parse_args(btc_conf_t *conf, int argc, char **argv, int allow_params) {
     if (btc_match_argbool(&conf->checkpoints, arg, "-checkpoints="))
       continue;
 
-    if (btc_match_argbool(&conf->prune, arg, "-prune="))
+    if (btc_match_hash(conf->assume_hash, arg, "-assumevalid=")) {
+      conf->assume_valid = 1;
+      continue;
+    }
+
+    if (btc_match_prune(&conf->prune, arg, "-prune="))
+      continue;
+
+    if (btc_match_argbool(&conf->txindex, arg, "-txindex="))
+      continue;
+
+    if (btc_match_argbool(&conf->addrindex, arg, "-addrindex="))
+      continue;
+
+    if (btc_match_argbool(&conf->filterindex, arg, "-blockfilterindex="))
+      continue;
+
+    if (btc_match_path(conf->snapshot, arg, "-loadsnapshot="))
+      continue;
+
+    if (btc_match_hash(conf->snapshot_hash, arg, "-snapshothash="))
       continue;
 
     if (btc_match_range(&conf->workers, arg, "-par=", -6, 15))
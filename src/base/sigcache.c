@@ -0,0 +1,176 @@
+/*!
+ * sigcache.c - script verification cache for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <base/sigcache.h>
+#include <mako/crypto/hash.h>
+#include <mako/crypto/rand.h>
+#include <mako/map.h>
+#include <mako/tx.h>
+#include <mako/util.h>
+#include "../impl.h"
+#include "../internal.h"
+
+/*
+ * Signature Cache
+ *
+ * Remembers transactions whose scripts have all
+ * been verified successfully, along with the flags
+ * they were verified under. Every script flag is
+ * a soft-fork restriction, so success under some
+ * set of flags implies success under any subset.
+ *
+ * Keys are salted per-process to keep an attacker
+ * from grinding collisions in the table. Entries
+ * are evicted in insertion order once full.
+ */
+
+struct btc_sigcache_s {
+  btc_hashtab_t map;
+  btc_sha256_t salt;
+  uint8_t (*keys)[32];
+  size_t size;
+  size_t head;
+  size_t length;
+};
+
+btc_sigcache_t *
+btc_sigcache_create(size_t size) {
+  btc_sigcache_t *cache = btc_malloc(sizeof(btc_sigcache_t));
+  uint8_t salt[32];
+
+  if (size < 1)
+    size = 1;
+
+  btc_getrandom(salt, 32);
+
+  btc_hashtab_init(&cache->map);
+  btc_sha256_init(&cache->salt);
+  btc_sha256_update(&cache->salt, salt, 32);
+
+  cache->keys = btc_malloc(size * 32);
+  cache->size = size;
+  cache->head = 0;
+  cache->length = 0;
+
+  btc_memzero(salt, 32);
+
+  return cache;
+}
+
+void
+btc_sigcache_destroy(btc_sigcache_t *cache) {
+  btc_hashtab_clear(&cache->map);
+  btc_free(cache->keys);
+  btc_free(cache);
+}
+
+void
+btc_sigcache_reset(btc_sigcache_t *cache) {
+  btc_hashtab_reset(&cache->map);
+  cache->head = 0;
+  cache->length = 0;
+}
+
+size_t
+btc_sigcache_size(const btc_sigcache_t *cache) {
+  return cache->map.size;
+}
+
+static void
+btc_sigcache_key(uint8_t *key,
+                 const btc_sigcache_t *cache,
+                 const btc_tx_t *tx) {
+  btc_sha256_t ctx = cache->salt;
+
+  btc_sha256_update(&ctx, tx->whash, 32);
+  btc_sha256_final(&ctx, key);
+}
+
+void
+btc_sigcache_add(btc_sigcache_t *cache,
+                 const btc_tx_t *tx,
+                 unsigned int flags) {
+  uint8_t key[32];
+  btc_mapiter_t it;
+  uint8_t *slot;
+  int exists;
+
+  btc_sigcache_key(key, cache, tx);
+
+  it = btc_hashtab_lookup(&cache->map, key);
+
+  /* Each entry holds exactly one set of flags which
+     was verified as a whole. Merging two sets would
+     claim success under flags nobody checked. Keep
+     the old set only if it already covers the new. */
+  if (it != cache->map.n_buckets) {
+    if (((unsigned int)cache->map.vals[it] & flags) != flags)
+      cache->map.vals[it] = flags;
+    return;
+  }
+
+  /* Evict the oldest key. It may have been taken
+     already, in which case this is a no-op. */
+  if (cache->length == cache->size) {
+    btc_hashtab_del(&cache->map, cache->keys[cache->head]);
+
+    cache->head = (cache->head + 1) % cache->size;
+    cache->length--;
+  }
+
+  slot = cache->keys[(cache->head + cache->length) % cache->size];
+
+  memcpy(slot, key, 32);
+
+  cache->length++;
+
+  it = btc_hashtab_insert(&cache->map, slot, &exists);
+
+  cache->map.vals[it] = flags;
+}
+
+int
+btc_sigcache_has(const btc_sigcache_t *cache,
+                 const btc_tx_t *tx,
+                 unsigned int flags) {
+  uint8_t key[32];
+  int64_t val;
+
+  btc_sigcache_key(key, cache, tx);
+
+  val = btc_hashtab_get(&cache->map, key);
+
+  if (val < 0)
+    return 0;
+
+  return ((unsigned int)val & flags) == flags;
+}
+
+int
+btc_sigcache_take(btc_sigcache_t *cache,
+                  const btc_tx_t *tx,
+                  unsigned int flags) {
+  uint8_t key[32];
+  int64_t val;
+
+  btc_sigcache_key(key, cache, tx);
+
+  val = btc_hashtab_get(&cache->map, key);
+
+  if (val < 0)
+    return 0;
+
+  if (((unsigned int)val & flags) != flags)
+    return 0;
+
+  /* A transaction is only ever connected once. */
+  btc_hashtab_del(&cache->map, key);
+
+  return 1;
+}
@@ -0,0 +1,450 @@
+/*!
+ * bip158.c - bip158 for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ *
+ * Resources:
+ *   https://github.com/bitcoin/bips/blob/master/bip-0158.mediawiki
+ *   https://github.com/bitcoin/bitcoin/blob/master/src/blockfilter.cpp
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <mako/bip158.h>
+#include <mako/block.h>
+#include <mako/coins.h>
+#include <mako/crypto/hash.h>
+#include <mako/crypto/siphash.h>
+#include <mako/header.h>
+#include <mako/script.h>
+#include <mako/tx.h>
+#include <mako/util.h>
+#include <mako/vector.h>
+#include "impl.h"
+#include "internal.h"
+
+/*
+ * Bit Writer
+ */
+
+typedef struct bitwriter_s {
+  uint8_t *data;
+  size_t pos;
+  int bit;
+} bitwriter_t;
+
+static void
+bitwriter_init(bitwriter_t *w, uint8_t *data) {
+  w->data = data;
+  w->pos = 0;
+  w->bit = 0;
+}
+
+static void
+bitwriter_write(bitwriter_t *w, uint64_t x, int bits) {
+  while (bits--) {
+    if (w->bit == 0)
+      w->data[w->pos] = 0;
+
+    w->data[w->pos] |= ((x >> bits) & 1) << (7 - w->bit);
+
+    if (++w->bit == 8) {
+      w->pos += 1;
+      w->bit = 0;
+    }
+  }
+}
+
+static void
+bitwriter_golomb(bitwriter_t *w, uint64_t x) {
+  uint64_t q = x >> BTC_FILTER_P;
+
+  while (q--)
+    bitwriter_write(w, 1, 1);
+
+  bitwriter_write(w, 0, 1);
+  bitwriter_write(w, x, BTC_FILTER_P);
+}
+
+static size_t
+bitwriter_size(const bitwriter_t *w) {
+  return w->pos + (w->bit != 0);
+}
+
+/*
+ * Bit Reader
+ */
+
+typedef struct bitreader_s {
+  const uint8_t *data;
+  size_t size;
+  size_t pos;
+  int bit;
+} bitreader_t;
+
+static void
+bitreader_init(bitreader_t *r, const uint8_t *data, size_t size) {
+  r->data = data;
+  r->size = size;
+  r->pos = 0;
+  r->bit = 0;
+}
+
+static int
+bitreader_read(bitreader_t *r, uint64_t *z, int bits) {
+  uint64_t x = 0;
+
+  while (bits--) {
+    if (r->pos == r->size)
+      return 0;
+
+    x = (x << 1) | ((r->data[r->pos] >> (7 - r->bit)) & 1);
+
+    if (++r->bit == 8) {
+      r->pos += 1;
+      r->bit = 0;
+    }
+  }
+
+  *z = x;
+
+  return 1;
+}
+
+static int
+bitreader_golomb(bitreader_t *r, uint64_t *z) {
+  uint64_t q = 0;
+  uint64_t bit;
+
+  for (;;) {
+    if (!bitreader_read(r, &bit, 1))
+      return 0;
+
+    if (bit == 0)
+      break;
+
+    q += 1;
+  }
+
+  if (!bitreader_read(r, &bit, BTC_FILTER_P))
+    return 0;
+
+  *z = (q << BTC_FILTER_P) | bit;
+
+  return 1;
+}
+
+/*
+ * Helpers
+ */
+
+static int
+gcsitem_cmp(const void *x, const void *y) {
+  const btc_gcsitem_t *a = (const btc_gcsitem_t *)x;
+  const btc_gcsitem_t *b = (const btc_gcsitem_t *)y;
+  size_t len;
+  int cmp;
+
+  if (a->hash != b->hash)
+    return a->hash < b->hash ? -1 : 1;
+
+  len = BTC_MIN(a->size, b->size);
+  cmp = len > 0 ? memcmp(a->data, b->data, len) : 0;
+
+  if (cmp != 0)
+    return cmp;
+
+  return (a->size > b->size) - (a->size < b->size);
+}
+
+static int
+uint64_cmp(const void *x, const void *y) {
+  uint64_t a = *((const uint64_t *)x);
+  uint64_t b = *((const uint64_t *)y);
+
+  return (a > b) - (a < b);
+}
+
+static int
+btc_blockfilter_start(const btc_blockfilter_t *z, bitreader_t *r) {
+  const uint8_t *xp = z->data;
+  size_t xn = z->size;
+  uint64_t n;
+
+  if (!btc_compact_read(&n, &xp, &xn))
+    return 0;
+
+  bitreader_init(r, xp, xn);
+
+  return 1;
+}
+
+/*
+ * Block Filter
+ */
+
+void
+btc_blockfilter_init(btc_blockfilter_t *z) {
+  memset(z->key, 0, sizeof(z->key));
+  z->n = 0;
+  z->data = NULL;
+  z->size = 0;
+  z->items = NULL;
+  z->alloc = 0;
+  z->length = 0;
+}
+
+void
+btc_blockfilter_clear(btc_blockfilter_t *z) {
+  if (z->data != NULL)
+    btc_free(z->data);
+
+  if (z->items != NULL)
+    btc_free(z->items);
+
+  btc_blockfilter_init(z);
+}
+
+void
+btc_blockfilter_reset(btc_blockfilter_t *z, const uint8_t *hash) {
+  /* The siphash key is the first half of the block hash. */
+  memcpy(z->key, hash, 16);
+
+  z->n = 0;
+  z->size = 0;
+  z->length = 0;
+}
+
+void
+btc_blockfilter_add(btc_blockfilter_t *z, const uint8_t *data, size_t size) {
+  btc_gcsitem_t *item;
+
+  if (size == 0)
+    return;
+
+  if (z->length == z->alloc) {
+    z->alloc = z->alloc == 0 ? 64 : z->alloc * 2;
+    z->items = (btc_gcsitem_t *)btc_realloc(z->items,
+                                            z->alloc * sizeof(btc_gcsitem_t));
+  }
+
+  /* Items are borrowed until the filter is finalized. */
+  item = &z->items[z->length++];
+  item->data = data;
+  item->size = size;
+  item->hash = btc_siphash_sum(data, size, z->key);
+}
+
+void
+btc_blockfilter_finalize(btc_blockfilter_t *z) {
+  uint64_t f, x, last = 0;
+  bitwriter_t w;
+  size_t i, n;
+  uint8_t *zp;
+
+  /* Sorting by the raw hash also sorts by the reduced value. */
+  qsort(z->items, z->length, sizeof(btc_gcsitem_t), gcsitem_cmp);
+
+  /* Drop duplicate elements. Equal hashes are not enough:
+     distinct elements that collide are both kept and both
+     counted in N, as bitcoin core does with its element set. */
+  for (i = 0, n = 0; i < z->length; i++) {
+    if (n > 0 && gcsitem_cmp(&z->items[n - 1], &z->items[i]) == 0)
+      continue;
+
+    z->items[n++] = z->items[i];
+  }
+
+  z->n = n;
+  z->length = 0;
+
+  f = z->n * BTC_FILTER_M;
+
+  /* Each value costs at most P + 1 bits plus its share of F >> P. */
+  z->size = 9 + (n * (BTC_FILTER_P + 1) + (f >> BTC_FILTER_P)) / 8 + 1;
+  z->data = (uint8_t *)btc_realloc(z->data, z->size);
+
+  zp = btc_compact_write(z->data, z->n);
+
+  bitwriter_init(&w, zp);
+
+  for (i = 0; i < n; i++) {
+    x = btc_siphash_reduce(z->items[i].hash, f);
+
+    bitwriter_golomb(&w, x - last);
+
+    last = x;
+  }
+
+  z->size = (zp - z->data) + bitwriter_size(&w);
+}
+
+void
+btc_blockfilter_set_block(btc_blockfilter_t *z,
+                          const btc_block_t *block,
+                          const btc_undo_t *undo) {
+  uint8_t hash[32];
+  size_t i, j, k = 0;
+
+  btc_header_hash(hash, &block->header);
+  btc_blockfilter_reset(z, hash);
+
+  for (i = 0; i < block->txs.length; i++) {
+    const btc_tx_t *tx = block->txs.items[i];
+
+    if (i > 0) {
+      for (j = 0; j < tx->inputs.length; j++) {
+        const btc_coin_t *coin;
+
+        CHECK(k < undo->length);
+
+        coin = undo->items[k++];
+
+        btc_blockfilter_add(z, coin->output.script.data,
+                               coin->output.script.length);
+      }
+    }
+
+    for (j = 0; j < tx->outputs.length; j++) {
+      const btc_script_t *script = &tx->outputs.items[j]->script;
+
+      if (script->length > 0 && script->data[0] == BTC_OP_RETURN)
+        continue;
+
+      btc_blockfilter_add(z, script->data, script->length);
+    }
+  }
+
+  CHECK(k == undo->length);
+
+  btc_blockfilter_finalize(z);
+}
+
+int
+btc_blockfilter_set(btc_blockfilter_t *z,
+                    const uint8_t *hash,
+                    const uint8_t *data,
+                    size_t size) {
+  const uint8_t *xp = data;
+  size_t xn = size;
+  uint64_t n;
+
+  if (!btc_compact_read(&n, &xp, &xn))
+    return 0;
+
+  if (n > UINT32_MAX)
+    return 0;
+
+  btc_blockfilter_reset(z, hash);
+
+  z->n = n;
+  z->data = (uint8_t *)btc_realloc(z->data, size);
+  z->size = size;
+
+  memcpy(z->data, data, size);
+
+  return 1;
+}
+
+int
+btc_blockfilter_match(const btc_blockfilter_t *z,
+                      const uint8_t *data,
+                      size_t size) {
+  uint64_t target, x, value = 0;
+  bitreader_t r;
+  uint64_t i;
+
+  if (z->n == 0)
+    return 0;
+
+  target = btc_siphash_mod(data, size, z->key, z->n * BTC_FILTER_M);
+
+  if (!btc_blockfilter_start(z, &r))
+    return 0;
+
+  for (i = 0; i < z->n; i++) {
+    if (!bitreader_golomb(&r, &x))
+      return 0;
+
+    value += x;
+
+    if (value == target)
+      return 1;
+
+    if (value > target)
+      break;
+  }
+
+  return 0;
+}
+
+int
+btc_blockfilter_match_any(const btc_blockfilter_t *z,
+                          const btc_vector_t *items) {
+  uint64_t f = z->n * BTC_FILTER_M;
+  uint64_t x, value = 0;
+  uint64_t *targets;
+  bitreader_t r;
+  size_t i, j;
+  int ret = 0;
+
+  if (z->n == 0 || items->length == 0)
+    return 0;
+
+  if (!btc_blockfilter_start(z, &r))
+    return 0;
+
+  targets = (uint64_t *)btc_malloc(items->length * sizeof(uint64_t));
+
+  for (i = 0; i < items->length; i++) {
+    const btc_buffer_t *item = (const btc_buffer_t *)items->items[i];
+
+    targets[i] = btc_siphash_mod(item->data, item->length, z->key, f);
+  }
+
+  qsort(targets, items->length, sizeof(uint64_t), uint64_cmp);
+
+  /* Walk both sorted sets at once. */
+  for (i = 0, j = 0; i < z->n; i++) {
+    if (!bitreader_golomb(&r, &x))
+      break;
+
+    value += x;
+
+    while (j < items->length && targets[j] < value)
+      j++;
+
+    if (j == items->length)
+      break;
+
+    if (targets[j] == value) {
+      ret = 1;
+      break;
+    }
+  }
+
+  btc_free(targets);
+
+  return ret;
+}
+
+void
+btc_blockfilter_hash(uint8_t *hash, const btc_blockfilter_t *z) {
+  btc_hash256(hash, z->data, z->size);
+}
+
+void
+btc_blockfilter_header(uint8_t *header,
+                       const btc_blockfilter_t *z,
+                       const uint8_t *prev) {
+  btc_hash256_t ctx;
+  uint8_t hash[32];
+
+  btc_blockfilter_hash(hash, z);
+
+  btc_hash256_init(&ctx);
+  btc_hash256_update(&ctx, hash, 32);
+  btc_hash256_update(&ctx, prev, 32);
+  btc_hash256_final(&ctx, header);
+}
@@ -266,9 +266,9 @@ tree_hash(uint8_t *root,
           const btc_merkleblock_t *tree,
           int32_t height,
           uint32_t pos,
-          btc_tx_t **leaves) {
+          const uint8_t **leaves) {
   if (height == 0) {
-    btc_hash_copy(root, leaves[pos]->hash);
+    btc_hash_copy(root, leaves[pos]);
   } else {
     uint8_t left[32], right[32];
 
@@ -299,7 +299,7 @@ static void
 tree_build(btc_merkleblock_t *tree,
            int32_t height,
            uint32_t pos,
-           btc_tx_t **leaves,
+           const uint8_t **leaves,
            const uint8_t *matches,
            int *bits) {
   int parent = 0;
@@ -326,21 +326,35 @@ tree_build(btc_merkleblock_t *tree,
 
 static void
 btc_merkleblock_set_matches(btc_merkleblock_t *tree,
-                            const btc_block_t *block,
+                            const btc_header_t *header,
+                            const uint8_t **leaves,
+                            size_t length,
                             const uint8_t *matches) {
   int32_t height = 0;
   int bits = 0;
 
   btc_merkleblock_reset(tree);
 
-  btc_header_copy(&tree->header, &block->header);
+  btc_header_copy(&tree->header, header);
 
-  tree->total = block->txs.length;
+  tree->total = length;
 
   while (tree_width(tree, height) > 1)
     height += 1;
 
-  tree_build(tree, height, 0, block->txs.items, matches, &bits);
+  tree_build(tree, height, 0, leaves, matches, &bits);
+}
+
+static const uint8_t **
+btc_merkleblock_leaves(const btc_block_t *block) {
+  size_t size = BTC_MAX(block->txs.length, 1);
+  const uint8_t **leaves = btc_malloc(size * sizeof(uint8_t *));
+  size_t i;
+
+  for (i = 0; i < block->txs.length; i++)
+    leaves[i] = block->txs.items[i]->hash;
+
+  return leaves;
 }
 
 btc_vector_t *
@@ -349,7 +363,8 @@ btc_merkleblock_set_block(btc_merkleblock_t *tree,
                           btc_bloom_t *filter) {
   btc_vector_t *txs = btc_vector_create();
   size_t size = block->txs.length;
-  uint8_t *matches = btc_malloc(size);
+  uint8_t *matches = btc_malloc(BTC_MAX(size, 1));
+  const uint8_t **leaves;
   size_t i;
 
   memset(matches, 0, size);
@@ -366,8 +381,11 @@ btc_merkleblock_set_block(btc_merkleblock_t *tree,
     }
   }
 
-  btc_merkleblock_set_matches(tree, block, matches);
+  leaves = btc_merkleblock_leaves(block);
+
+  btc_merkleblock_set_matches(tree, &block->header, leaves, size, matches);
 
+  btc_free(leaves);
   btc_free(matches);
 
   return txs;
@@ -378,7 +396,8 @@ btc_merkleblock_set_hashes(btc_merkleblock_t *tree,
                            const btc_block_t *block,
                            const btc_vector_t *hashes) {
   size_t size = block->txs.length;
-  uint8_t *matches = btc_malloc(size);
+  uint8_t *matches = btc_malloc(BTC_MAX(size, 1));
+  const uint8_t **leaves;
   btc_hashset_t filter;
   size_t i;
 
@@ -395,8 +414,50 @@ btc_merkleblock_set_hashes(btc_merkleblock_t *tree,
     matches[i] = btc_hashset_has(&filter, tx->hash);
   }
 
-  btc_merkleblock_set_matches(tree, block, matches);
+  leaves = btc_merkleblock_leaves(block);
+
+  btc_merkleblock_set_matches(tree, &block->header, leaves, size, matches);
 
   btc_hashset_clear(&filter);
+  btc_free(leaves);
   btc_free(matches);
 }
+
+btc_vector_t *
+btc_merkleblock_set_raw(btc_merkleblock_t *tree,
+                        const btc_rawblock_t *block,
+                        btc_bloom_t *filter) {
+  btc_vector_t *txs = btc_vector_create();
+  size_t size = block->txs.length;
+  uint8_t *matches = btc_malloc(BTC_MAX(size, 1));
+  uint8_t *hashes = btc_malloc(BTC_MAX(size, 1) * 32);
+  const uint8_t **leaves = btc_malloc(BTC_MAX(size, 1) * sizeof(uint8_t *));
+  const uint8_t *xp = block->txs.data;
+  size_t xn = block->txs.size;
+  btc_rawtx_t tx;
+  size_t i;
+
+  /* Only the matching transactions are decoded. */
+  for (i = 0; i < size; i++) {
+    CHECK(btc_rawtx_read(&tx, &xp, &xn));
+
+    leaves[i] = &hashes[i * 32];
+
+    btc_rawtx_txid(&hashes[i * 32], &tx);
+
+    matches[i] = 0;
+
+    if (filter != NULL && btc_rawtx_matches(&tx, leaves[i], filter)) {
+      btc_vector_push(txs, btc_rawtx_decode(&tx));
+      matches[i] = 1;
+    }
+  }
+
+  btc_merkleblock_set_matches(tree, &block->header, leaves, size, matches);
+
+  btc_free(leaves);
+  btc_free(hashes);
+  btc_free(matches);
+
+  return txs;
+}
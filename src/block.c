@@ -307,3 +307,35 @@ btc_block_read(btc_block_t *z, const uint8_t **xp, size_t *xn) {
 
   return 1;
 }
+
+int
+btc_block_read_deferred(btc_block_t *z, const uint8_t **xp, size_t *xn) {
+  btc_tx_t *tx;
+  size_t i, count;
+
+  if (!btc_header_read(&z->header, xp, xn))
+    return 0;
+
+  btc_txvec_reset(&z->txs);
+
+  if (!btc_size_read(&count, xp, xn))
+    return 0;
+
+  for (i = 0; i < count; i++) {
+    tx = btc_tx_create();
+
+    if (!btc_tx_read_deferred(tx, xp, xn)) {
+      btc_tx_destroy(tx);
+      return 0;
+    }
+
+    btc_txvec_push(&z->txs, tx);
+  }
+
+  return 1;
+}
+
+int
+btc_block_import_deferred(btc_block_t *z, const uint8_t *xp, size_t xn) {
+  return btc_block_read_deferred(z, &xp, &xn);
+}
@@ -0,0 +1,179 @@
+/*!
+ * muhash.c - muhash3072 for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ *
+ * Parts of this software are based on bitcoin/bitcoin:
+ *   Copyright (c) 2009-2021, The Bitcoin Core Developers (MIT License).
+ *   Copyright (c) 2009-2021, The Bitcoin Developers (MIT License).
+ *   https://github.com/bitcoin/bitcoin
+ *
+ * Resources:
+ *   https://cseweb.ucsd.edu/~mihir/papers/inchash.pdf
+ *   https://lists.linuxfoundation.org/pipermail/bitcoin-dev/2017-May/014337.html
+ *   https://github.com/bitcoin/bitcoin/blob/master/src/crypto/muhash.cpp
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <mako/crypto/hash.h>
+#include <mako/crypto/stream.h>
+#include <mako/mpi.h>
+#include <mako/util.h>
+
+#include "../internal.h"
+
+/*
+ * Constants
+ */
+
+#define MUHASH_BYTES 384
+#define MUHASH_LIMBS (MUHASH_BYTES / MP_LIMB_BYTES)
+
+/* p = 2^3072 - 1103717 */
+#define MUHASH_C 1103717
+
+/*
+ * Helpers
+ */
+
+static void
+muhash_prime(mp_limb_t *zp) {
+  mp_size_t i;
+
+  for (i = 0; i < MUHASH_LIMBS; i++)
+    zp[i] = MP_LIMB_MAX;
+
+  zp[0] -= MUHASH_C - 1;
+}
+
+static void
+muhash_reduce(mp_limb_t *zp) {
+  /* Values are kept below 2^3072, which is
+     less than 2p. One subtraction suffices. */
+  mp_limb_t pp[MUHASH_LIMBS];
+
+  muhash_prime(pp);
+
+  if (mpn_cmp(zp, pp, MUHASH_LIMBS) >= 0)
+    mpn_sub_n(zp, zp, pp, MUHASH_LIMBS);
+}
+
+static void
+muhash_mul(mp_limb_t *zp, const mp_limb_t *xp, const mp_limb_t *yp) {
+  mp_limb_t tp[MUHASH_LIMBS * 2];
+  mp_limb_t cp[2];
+  mp_limb_t cy;
+
+  mpn_mul_n(tp, xp, yp, MUHASH_LIMBS);
+
+  /* Fold the high half back in using 2^3072 = c (mod p). */
+  cy = mpn_addmul_1(tp, tp + MUHASH_LIMBS, MUHASH_LIMBS, MUHASH_C);
+
+  while (cy != 0) {
+    cp[1] = mpn_mul_1(cp, &cy, 1, MUHASH_C);
+    cy = mpn_add(tp, tp, MUHASH_LIMBS, cp, 2);
+  }
+
+  mpn_copyi(zp, tp, MUHASH_LIMBS);
+}
+
+static void
+muhash_expand(mp_limb_t *zp, const void *data, size_t len) {
+  static const uint8_t nonce[12] = {0};
+  uint8_t raw[MUHASH_BYTES];
+  btc_chacha20_t ctx;
+  uint8_t key[32];
+
+  btc_sha256(key, data, len);
+
+  memset(raw, 0, sizeof(raw));
+
+  btc_chacha20_init(&ctx, key, 32, nonce, 12, 0);
+  btc_chacha20_crypt(&ctx, raw, raw, sizeof(raw));
+
+  mpn_import(zp, MUHASH_LIMBS, raw, sizeof(raw), -1);
+}
+
+static void
+muhash_update(uint8_t *acc, const void *data, size_t len) {
+  mp_limb_t xp[MUHASH_LIMBS];
+  mp_limb_t yp[MUHASH_LIMBS];
+
+  mpn_import(xp, MUHASH_LIMBS, acc, MUHASH_BYTES, -1);
+
+  muhash_expand(yp, data, len);
+  muhash_mul(xp, xp, yp);
+
+  mpn_export(acc, MUHASH_BYTES, xp, MUHASH_LIMBS, -1);
+}
+
+static void
+muhash_combine(uint8_t *acc, const uint8_t *raw) {
+  mp_limb_t xp[MUHASH_LIMBS];
+  mp_limb_t yp[MUHASH_LIMBS];
+
+  mpn_import(xp, MUHASH_LIMBS, acc, MUHASH_BYTES, -1);
+  mpn_import(yp, MUHASH_LIMBS, raw, MUHASH_BYTES, -1);
+
+  muhash_mul(xp, xp, yp);
+
+  mpn_export(acc, MUHASH_BYTES, xp, MUHASH_LIMBS, -1);
+}
+
+/*
+ * MuHash3072
+ */
+
+void
+btc_muhash_init(btc_muhash_t *ctx) {
+  memset(ctx->num, 0, sizeof(ctx->num));
+  memset(ctx->den, 0, sizeof(ctx->den));
+
+  ctx->num[0] = 1;
+  ctx->den[0] = 1;
+}
+
+void
+btc_muhash_insert(btc_muhash_t *ctx, const void *data, size_t len) {
+  muhash_update(ctx->num, data, len);
+}
+
+void
+btc_muhash_remove(btc_muhash_t *ctx, const void *data, size_t len) {
+  muhash_update(ctx->den, data, len);
+}
+
+void
+btc_muhash_combine(btc_muhash_t *z, const btc_muhash_t *x) {
+  muhash_combine(z->num, x->num);
+  muhash_combine(z->den, x->den);
+}
+
+void
+btc_muhash_final(const btc_muhash_t *ctx, uint8_t *out) {
+  mp_limb_t scratch[MPN_INVERT_ITCH(MUHASH_LIMBS)];
+  mp_limb_t np[MUHASH_LIMBS];
+  mp_limb_t dp[MUHASH_LIMBS];
+  mp_limb_t ip[MUHASH_LIMBS];
+  mp_limb_t pp[MUHASH_LIMBS];
+  uint8_t raw[MUHASH_BYTES];
+
+  mpn_import(np, MUHASH_LIMBS, ctx->num, MUHASH_BYTES, -1);
+  mpn_import(dp, MUHASH_LIMBS, ctx->den, MUHASH_BYTES, -1);
+
+  muhash_reduce(dp);
+  muhash_prime(pp);
+
+  /* The denominator is zero with negligible probability. */
+  CHECK(mpn_invert_n(ip, dp, pp, MUHASH_LIMBS, scratch));
+
+  muhash_mul(np, np, ip);
+  muhash_reduce(np);
+
+  mpn_export(raw, MUHASH_BYTES, np, MUHASH_LIMBS, -1);
+
+  btc_sha256(out, raw, MUHASH_BYTES);
+}
@@ -9,6 +9,11 @@
  *
  * Unrolled loops generated with:
  *   https://gist.github.com/chjj/338a5ee212eefdff4431e4da65a2d4f7
+ *
+ * Hardware backends based on:
+ *   https://github.com/noloader/SHA-Intrinsics
+ *   https://github.com/bitcoin/bitcoin/blob/master/src/crypto/sha256_x86_shani.cpp
+ *   https://github.com/bitcoin/bitcoin/blob/master/src/crypto/sha256_arm_shani.cpp
  */
 
 #include <stddef.h>
@@ -16,34 +21,82 @@
 #include <string.h>
 #include <mako/crypto/hash.h>
 #include "../bio.h"
+#include "../internal.h"
 
 /*
- * SHA256
+ * Backends
  */
 
-void
-btc_sha256_init(btc_sha256_t *ctx) {
-  ctx->state[0] = 0x6a09e667;
-  ctx->state[1] = 0xbb67ae85;
-  ctx->state[2] = 0x3c6ef372;
-  ctx->state[3] = 0xa54ff53a;
-  ctx->state[4] = 0x510e527f;
-  ctx->state[5] = 0x9b05688c;
-  ctx->state[6] = 0x1f83d9ab;
-  ctx->state[7] = 0x5be0cd19;
-  ctx->size = 0;
-}
+/* SHA-NI and AVX2 are selected at runtime (cpuid needs inline asm). */
+#if defined(BTC_HAVE_ASM) && (defined(__x86_64__) || defined(__amd64__))
+#  if BTC_GNUC_PREREQ(4, 9) || BTC_HAS_BUILTIN(__builtin_ia32_sha256rnds2)
+#    include <immintrin.h>
+#    define SHA256_USE_CPUID
+#    define SHA256_USE_SHANI
+#    define SHA256_USE_AVX2
+#  endif
+#endif
+
+/* SSE2 is part of the x86-64 baseline. */
+#if defined(__SSE2__) && (defined(__x86_64__) || defined(__amd64__))
+#  include <emmintrin.h>
+#  define SHA256_USE_SSE2
+#endif
+
+/* The ARMv8 extensions must be enabled at compile time. */
+#if defined(__aarch64__) && (defined(__ARM_FEATURE_SHA2) \
+                          || defined(__ARM_FEATURE_CRYPTO))
+#  include <arm_neon.h>
+#  define SHA256_USE_ARMV8
+#endif
+
+typedef void sha256_compress_f(uint32_t *state,
+                               const uint8_t *data,
+                               size_t blocks);
+
+typedef void sha256_roots_f(uint8_t *out, const uint8_t *in, size_t count);
+
+static const uint32_t sha256_iv[8] = {
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+  0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+#if defined(SHA256_USE_SHANI) || defined(SHA256_USE_ARMV8) \
+                              || defined(SHA256_USE_SSE2)
+static const uint32_t sha256_k[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+  0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+  0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+  0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+  0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+  0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+  0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+#endif
+
+/*
+ * SHA256 (Generic)
+ */
 
 static void
-sha256_transform(btc_sha256_t *ctx, const uint8_t *chunk) {
-  uint32_t A = ctx->state[0];
-  uint32_t B = ctx->state[1];
-  uint32_t C = ctx->state[2];
-  uint32_t D = ctx->state[3];
-  uint32_t E = ctx->state[4];
-  uint32_t F = ctx->state[5];
-  uint32_t G = ctx->state[6];
-  uint32_t H = ctx->state[7];
+sha256_transform(uint32_t *state, const uint8_t *chunk) {
+  uint32_t A = state[0];
+  uint32_t B = state[1];
+  uint32_t C = state[2];
+  uint32_t D = state[3];
+  uint32_t E = state[4];
+  uint32_t F = state[5];
+  uint32_t G = state[6];
+  uint32_t H = state[7];
   uint32_t W[16];
   uint32_t w;
 
@@ -180,14 +233,670 @@ sha256_transform(btc_sha256_t *ctx, const uint8_t *chunk) {
 #undef WORD
 #undef R
 
-  ctx->state[0] += A;
-  ctx->state[1] += B;
-  ctx->state[2] += C;
-  ctx->state[3] += D;
-  ctx->state[4] += E;
-  ctx->state[5] += F;
-  ctx->state[6] += G;
-  ctx->state[7] += H;
+  state[0] += A;
+  state[1] += B;
+  state[2] += C;
+  state[3] += D;
+  state[4] += E;
+  state[5] += F;
+  state[6] += G;
+  state[7] += H;
+}
+
+static void
+sha256_compress_generic(uint32_t *state, const uint8_t *data, size_t blocks) {
+  while (blocks--) {
+    sha256_transform(state, data);
+    data += 64;
+  }
+}
+
+/*
+ * CPU Features
+ */
+
+#if defined(SHA256_USE_CPUID)
+static void
+sha256_cpuid(uint32_t *out, uint32_t leaf, uint32_t subleaf) {
+  uint32_t a, b, c, d;
+
+  __asm__ __volatile__ (
+    "cpuid\n"
+    : "=a" (a), "=b" (b), "=c" (c), "=d" (d)
+    : "a" (leaf), "c" (subleaf)
+  );
+
+  out[0] = a;
+  out[1] = b;
+  out[2] = c;
+  out[3] = d;
+}
+
+static uint32_t
+sha256_xgetbv(void) {
+  uint32_t a, d;
+
+  /* xgetbv (encoded for older assemblers) */
+  __asm__ __volatile__ (
+    ".byte 0x0f, 0x01, 0xd0\n"
+    : "=a" (a), "=d" (d)
+    : "c" (0)
+  );
+
+  (void)d;
+
+  return a;
+}
+
+static int
+sha256_has_shani(void) {
+  uint32_t regs[4];
+
+  sha256_cpuid(regs, 0, 0);
+
+  if (regs[0] < 7)
+    return 0;
+
+  sha256_cpuid(regs, 1, 0);
+
+  /* SSSE3 (pshufb) and SSE4.1 (pblendw). */
+  if (!((regs[2] >> 9) & 1) || !((regs[2] >> 19) & 1))
+    return 0;
+
+  sha256_cpuid(regs, 7, 0);
+
+  return (regs[1] >> 29) & 1;
+}
+
+static int
+sha256_has_avx2(void) {
+  uint32_t regs[4];
+
+  sha256_cpuid(regs, 0, 0);
+
+  if (regs[0] < 7)
+    return 0;
+
+  sha256_cpuid(regs, 1, 0);
+
+  /* The OS must save the ymm registers (osxsave + xcr0). */
+  if (!((regs[2] >> 27) & 1) || (sha256_xgetbv() & 6) != 6)
+    return 0;
+
+  sha256_cpuid(regs, 7, 0);
+
+  return (regs[1] >> 5) & 1;
+}
+#endif /* SHA256_USE_CPUID */
+
+/*
+ * SHA256 (SHA-NI)
+ */
+
+#if defined(SHA256_USE_SHANI)
+__attribute__((__target__("sha,sse4.1"))) static void
+sha256_compress_shani(uint32_t *state, const uint8_t *data, size_t blocks) {
+  const __m128i mask = _mm_set_epi32(0x0c0d0e0f, 0x08090a0b,
+                                     0x04050607, 0x00010203);
+  __m128i s0, s1, t0, t1, m0, m1, m2, m3, msg;
+  int i;
+
+  /* Rearrange into ABEF/CDGH as the sha256rnds2 instruction expects. */
+  t0 = _mm_loadu_si128((const void *)&state[0]);
+  s1 = _mm_loadu_si128((const void *)&state[4]);
+  t0 = _mm_shuffle_epi32(t0, 0xb1);
+  s1 = _mm_shuffle_epi32(s1, 0x1b);
+  s0 = _mm_alignr_epi8(t0, s1, 8);
+  s1 = _mm_blend_epi16(s1, t0, 0xf0);
+
+#define ROUNDS(m, i) do {                                              \
+  msg = _mm_add_epi32(m, _mm_loadu_si128((const void *)&sha256_k[i])); \
+  s1 = _mm_sha256rnds2_epu32(s1, s0, msg);                             \
+  s0 = _mm_sha256rnds2_epu32(s0, s1, _mm_shuffle_epi32(msg, 0x0e));    \
+} while (0)
+
+#define SCHEDULE(m0, m1, m2, m3) do {                  \
+  m0 = _mm_sha256msg1_epu32(m0, m1);                   \
+  m0 = _mm_add_epi32(m0, _mm_alignr_epi8(m3, m2, 4)); \
+  m0 = _mm_sha256msg2_epu32(m0, m3);                   \
+} while (0)
+
+  while (blocks--) {
+    t0 = s0;
+    t1 = s1;
+
+    m0 = _mm_loadu_si128((const void *)(data +  0));
+    m1 = _mm_loadu_si128((const void *)(data + 16));
+    m2 = _mm_loadu_si128((const void *)(data + 32));
+    m3 = _mm_loadu_si128((const void *)(data + 48));
+
+    m0 = _mm_shuffle_epi8(m0, mask);
+    m1 = _mm_shuffle_epi8(m1, mask);
+    m2 = _mm_shuffle_epi8(m2, mask);
+    m3 = _mm_shuffle_epi8(m3, mask);
+
+    ROUNDS(m0, 0);
+    ROUNDS(m1, 4);
+    ROUNDS(m2, 8);
+    ROUNDS(m3, 12);
+
+    for (i = 16; i < 64; i += 16) {
+      SCHEDULE(m0, m1, m2, m3);
+      ROUNDS(m0, i + 0);
+      SCHEDULE(m1, m2, m3, m0);
+      ROUNDS(m1, i + 4);
+      SCHEDULE(m2, m3, m0, m1);
+      ROUNDS(m2, i + 8);
+      SCHEDULE(m3, m0, m1, m2);
+      ROUNDS(m3, i + 12);
+    }
+
+    s0 = _mm_add_epi32(s0, t0);
+    s1 = _mm_add_epi32(s1, t1);
+
+    data += 64;
+  }
+
+#undef ROUNDS
+#undef SCHEDULE
+
+  t0 = _mm_shuffle_epi32(s0, 0x1b);
+  s1 = _mm_shuffle_epi32(s1, 0xb1);
+  s0 = _mm_blend_epi16(t0, s1, 0xf0);
+  s1 = _mm_alignr_epi8(s1, t0, 8);
+
+  _mm_storeu_si128((void *)&state[0], s0);
+  _mm_storeu_si128((void *)&state[4], s1);
+}
+#endif /* SHA256_USE_SHANI */
+
+/*
+ * SHA256 (ARMv8)
+ */
+
+#if defined(SHA256_USE_ARMV8)
+static void
+sha256_compress_armv8(uint32_t *state, const uint8_t *data, size_t blocks) {
+  uint32x4_t s0, s1, t0, t1, m0, m1, m2, m3, msg, tmp;
+  int i;
+
+  s0 = vld1q_u32(&state[0]);
+  s1 = vld1q_u32(&state[4]);
+
+#define LOAD(x) vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(x)))
+
+#define ROUNDS(m, i) do {                      \
+  msg = vaddq_u32(m, vld1q_u32(&sha256_k[i])); \
+  tmp = s0;                                    \
+  s0 = vsha256hq_u32(s0, s1, msg);             \
+  s1 = vsha256h2q_u32(s1, tmp, msg);           \
+} while (0)
+
+#define SCHEDULE(m0, m1, m2, m3) \
+  m0 = vsha256su1q_u32(vsha256su0q_u32(m0, m1), m2, m3)
+
+  while (blocks--) {
+    t0 = s0;
+    t1 = s1;
+
+    m0 = LOAD(data +  0);
+    m1 = LOAD(data + 16);
+    m2 = LOAD(data + 32);
+    m3 = LOAD(data + 48);
+
+    ROUNDS(m0, 0);
+    ROUNDS(m1, 4);
+    ROUNDS(m2, 8);
+    ROUNDS(m3, 12);
+
+    for (i = 16; i < 64; i += 16) {
+      SCHEDULE(m0, m1, m2, m3);
+      ROUNDS(m0, i + 0);
+      SCHEDULE(m1, m2, m3, m0);
+      ROUNDS(m1, i + 4);
+      SCHEDULE(m2, m3, m0, m1);
+      ROUNDS(m2, i + 8);
+      SCHEDULE(m3, m0, m1, m2);
+      ROUNDS(m3, i + 12);
+    }
+
+    s0 = vaddq_u32(s0, t0);
+    s1 = vaddq_u32(s1, t1);
+
+    data += 64;
+  }
+
+#undef LOAD
+#undef ROUNDS
+#undef SCHEDULE
+
+  vst1q_u32(&state[0], s0);
+  vst1q_u32(&state[4], s1);
+}
+#endif /* SHA256_USE_ARMV8 */
+
+/*
+ * SHA256D64
+ */
+
+static void
+sha256_d64(uint8_t *out,
+           const uint8_t *in,
+           size_t count,
+           sha256_compress_f *compress) {
+  /* Padding for a 64 byte message and for a 32 byte digest. */
+  static const uint8_t pad64[64] = {
+    0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00
+  };
+  uint32_t state[8];
+  uint8_t block[64];
+  int i;
+
+  memset(block + 32, 0, 32);
+
+  block[32] = 0x80;
+  block[62] = 0x01;
+
+  while (count--) {
+    memcpy(state, sha256_iv, sizeof(state));
+
+    compress(state, in, 1);
+    compress(state, pad64, 1);
+
+    for (i = 0; i < 8; i++)
+      btc_write32be(block + i * 4, state[i]);
+
+    memcpy(state, sha256_iv, sizeof(state));
+
+    compress(state, block, 1);
+
+    for (i = 0; i < 8; i++)
+      btc_write32be(out + i * 4, state[i]);
+
+    out += 32;
+    in += 64;
+  }
+}
+
+static void
+sha256_roots_generic(uint8_t *out, const uint8_t *in, size_t count) {
+  sha256_d64(out, in, count, sha256_compress_generic);
+}
+
+#if defined(SHA256_USE_SHANI)
+static void
+sha256_roots_shani(uint8_t *out, const uint8_t *in, size_t count) {
+  sha256_d64(out, in, count, sha256_compress_shani);
+}
+#endif
+
+#if defined(SHA256_USE_ARMV8)
+static void
+sha256_roots_armv8(uint8_t *out, const uint8_t *in, size_t count) {
+  sha256_d64(out, in, count, sha256_compress_armv8);
+}
+#endif
+
+/*
+ * SHA256D64 (Multi-Buffer)
+ */
+
+#if defined(SHA256_USE_SSE2) || defined(SHA256_USE_AVX2)
+/* K plus the message schedule of the padding block for a 64 byte input. */
+static const uint32_t sha256_kpad[64] = {
+  0xc28a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+  0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf374,
+  0x649b69c1, 0xf0fe4786, 0x0fe1edc6, 0x240cf254,
+  0x4fe9346f, 0x6cc984be, 0x61b9411e, 0x16f988fa,
+  0xf2c65152, 0xa88e5a6d, 0xb019fc65, 0xb9d99ec7,
+  0x9a1231c3, 0xe70eeaa0, 0xfdb1232b, 0xc7353eb0,
+  0x3069bad5, 0xcb976d5f, 0x5a0f118f, 0xdc1eeefd,
+  0x0a35b689, 0xde0b7a04, 0x58f4ca9d, 0xe15d5b16,
+  0x007f3e86, 0x37088980, 0xa507ea32, 0x6fab9537,
+  0x17406110, 0x0d8cd6f1, 0xcdaa3b6d, 0xc0bbbe37,
+  0x83613bda, 0xdb48a363, 0x0b02e931, 0x6fd15ca7,
+  0x521afaca, 0x31338431, 0x6ed41a95, 0x6d437890,
+  0xc39c91f2, 0x9eccabbd, 0xb5c9a0e6, 0x532fb63c,
+  0xd2c741c6, 0x07237ea3, 0xa4954b68, 0x4c191d76
+};
+
+/* Each lane of a vector holds one message. The
+ * operations below are defined per instruction set.
+ */
+#define VROTR(x, n) VOR(VSHR(x, n), VSHL(x, 32 - (n)))
+#define VCh(x, y, z) VXOR(z, VAND(x, VXOR(y, z)))
+#define VMaj(x, y, z) VOR(VAND(x, y), VAND(z, VOR(x, y)))
+#define VSigma0(x) VXOR(VXOR(VROTR(x, 2), VROTR(x, 13)), VROTR(x, 22))
+#define VSigma1(x) VXOR(VXOR(VROTR(x, 6), VROTR(x, 11)), VROTR(x, 25))
+#define Vsigma0(x) VXOR(VXOR(VROTR(x, 7), VROTR(x, 18)), VSHR(x, 3))
+#define Vsigma1(x) VXOR(VXOR(VROTR(x, 17), VROTR(x, 19)), VSHR(x, 10))
+
+#define VSCHEDULE(w) do {                                  \
+  for (i = 16; i < 64; i++) {                              \
+    w[i] = VADD(VADD(Vsigma1(w[i - 2]), w[i - 7]),         \
+                VADD(Vsigma0(w[i - 15]), w[i - 16]));      \
+  }                                                        \
+} while (0)
+
+#define VR(a, b, c, d, e, f, g, h, kw) do {                \
+  h = VADD(VADD(h, VSigma1(e)), VADD(VCh(e, f, g), kw));   \
+  d = VADD(d, h);                                          \
+  h = VADD(h, VADD(VSigma0(a), VMaj(a, b, c)));            \
+} while (0)
+
+#define VKW_MSG(i) VADD(VSET1(sha256_k[i]), w[i])
+#define VKW_PAD(i) VSET1(sha256_kpad[i])
+
+#define VROUNDS(s, KW) do {                                \
+  A = s[0]; B = s[1]; C = s[2]; D = s[3];                  \
+  E = s[4]; F = s[5]; G = s[6]; H = s[7];                  \
+                                                           \
+  for (i = 0; i < 64; i += 8) {                            \
+    VR(A, B, C, D, E, F, G, H, KW(i + 0));                 \
+    VR(H, A, B, C, D, E, F, G, KW(i + 1));                 \
+    VR(G, H, A, B, C, D, E, F, KW(i + 2));                 \
+    VR(F, G, H, A, B, C, D, E, KW(i + 3));                 \
+    VR(E, F, G, H, A, B, C, D, KW(i + 4));                 \
+    VR(D, E, F, G, H, A, B, C, KW(i + 5));                 \
+    VR(C, D, E, F, G, H, A, B, KW(i + 6));                 \
+    VR(B, C, D, E, F, G, H, A, KW(i + 7));                 \
+  }                                                        \
+                                                           \
+  s[0] = VADD(s[0], A); s[1] = VADD(s[1], B);              \
+  s[2] = VADD(s[2], C); s[3] = VADD(s[3], D);              \
+  s[4] = VADD(s[4], E); s[5] = VADD(s[5], F);              \
+  s[6] = VADD(s[6], G); s[7] = VADD(s[7], H);              \
+} while (0)
+
+/* hash256 of each 64 byte input: the first hash consumes the
+ * input and a constant padding block, the second hashes the
+ * resulting digest (padded in place) from a fresh state.
+ */
+#define VD64(lanes, VLOAD, VSTORE) do {                    \
+  for (i = 0; i < 16; i++)                                 \
+    w[i] = VLOAD(in, i);                                   \
+                                                           \
+  VSCHEDULE(w);                                            \
+                                                           \
+  for (i = 0; i < 8; i++)                                  \
+    s[i] = VSET1(sha256_iv[i]);                            \
+                                                           \
+  VROUNDS(s, VKW_MSG);                                     \
+  VROUNDS(s, VKW_PAD);                                     \
+                                                           \
+  for (i = 0; i < 8; i++) {                                \
+    w[i] = s[i];                                           \
+    s[i] = VSET1(sha256_iv[i]);                            \
+  }                                                        \
+                                                           \
+  w[8] = VSET1(0x80000000);                                \
+                                                           \
+  for (i = 9; i < 15; i++)                                 \
+    w[i] = VSET1(0);                                       \
+                                                           \
+  w[15] = VSET1(256);                                      \
+                                                           \
+  VSCHEDULE(w);                                            \
+  VROUNDS(s, VKW_MSG);                                     \
+                                                           \
+  for (i = 0; i < 8; i++) {                                \
+    VSTORE(lane, s[i]);                                    \
+                                                           \
+    for (j = 0; j < lanes; j++)                            \
+      btc_write32be(out + j * 32 + i * 4, lane[j]);        \
+  }                                                        \
+} while (0)
+
+#define VWORD(in, j, i) ((int)btc_read32be((in) + (j) * 64 + (i) * 4))
+#endif /* SHA256_USE_SSE2 || SHA256_USE_AVX2 */
+
+#if defined(SHA256_USE_SSE2)
+#define VADD _mm_add_epi32
+#define VXOR _mm_xor_si128
+#define VOR _mm_or_si128
+#define VAND _mm_and_si128
+#define VSHR _mm_srli_epi32
+#define VSHL _mm_slli_epi32
+#define VSET1(x) _mm_set1_epi32((int)(x))
+
+#define VLOAD(in, i) _mm_set_epi32(VWORD(in, 3, i), VWORD(in, 2, i), \
+                                   VWORD(in, 1, i), VWORD(in, 0, i))
+
+#define VSTORE(z, x) _mm_storeu_si128((void *)(z), x)
+
+static void
+sha256_d64_sse2(uint8_t *out, const uint8_t *in) {
+  __m128i A, B, C, D, E, F, G, H;
+  __m128i s[8], w[64];
+  uint32_t lane[4];
+  int i, j;
+
+  VD64(4, VLOAD, VSTORE);
+}
+
+#undef VADD
+#undef VXOR
+#undef VOR
+#undef VAND
+#undef VSHR
+#undef VSHL
+#undef VSET1
+#undef VLOAD
+#undef VSTORE
+
+static void
+sha256_roots_sse2(uint8_t *out, const uint8_t *in, size_t count) {
+  while (count >= 4) {
+    sha256_d64_sse2(out, in);
+    out += 4 * 32;
+    in += 4 * 64;
+    count -= 4;
+  }
+
+  sha256_roots_generic(out, in, count);
+}
+#endif /* SHA256_USE_SSE2 */
+
+#if defined(SHA256_USE_AVX2)
+#define VADD _mm256_add_epi32
+#define VXOR _mm256_xor_si256
+#define VOR _mm256_or_si256
+#define VAND _mm256_and_si256
+#define VSHR _mm256_srli_epi32
+#define VSHL _mm256_slli_epi32
+#define VSET1(x) _mm256_set1_epi32((int)(x))
+
+#define VLOAD(in, i) _mm256_set_epi32(VWORD(in, 7, i), VWORD(in, 6, i), \
+                                      VWORD(in, 5, i), VWORD(in, 4, i), \
+                                      VWORD(in, 3, i), VWORD(in, 2, i), \
+                                      VWORD(in, 1, i), VWORD(in, 0, i))
+
+#define VSTORE(z, x) _mm256_storeu_si256((void *)(z), x)
+
+__attribute__((__target__("avx2"))) static void
+sha256_d64_avx2(uint8_t *out, const uint8_t *in) {
+  __m256i A, B, C, D, E, F, G, H;
+  __m256i s[8], w[64];
+  uint32_t lane[8];
+  int i, j;
+
+  VD64(8, VLOAD, VSTORE);
+}
+
+#undef VADD
+#undef VXOR
+#undef VOR
+#undef VAND
+#undef VSHR
+#undef VSHL
+#undef VSET1
+#undef VLOAD
+#undef VSTORE
+
+static void
+sha256_roots_avx2(uint8_t *out, const uint8_t *in, size_t count) {
+  while (count >= 8) {
+    sha256_d64_avx2(out, in);
+    out += 8 * 32;
+    in += 8 * 64;
+    count -= 8;
+  }
+
+  sha256_roots_sse2(out, in, count);
+}
+#endif /* SHA256_USE_AVX2 */
+
+#if defined(SHA256_USE_SSE2) || defined(SHA256_USE_AVX2)
+#undef VROTR
+#undef VCh
+#undef VMaj
+#undef VSigma0
+#undef VSigma1
+#undef Vsigma0
+#undef Vsigma1
+#undef VSCHEDULE
+#undef VR
+#undef VKW_MSG
+#undef VKW_PAD
+#undef VROUNDS
+#undef VD64
+#undef VWORD
+#endif
+
+/*
+ * Dispatch
+ */
+
+static sha256_compress_f *sha256_compress = NULL;
+static sha256_roots_f *sha256_roots = NULL;
+static int sha256_backend = BTC_SHA256_GENERIC;
+
+static int
+sha256_lookup(sha256_compress_f **compress,
+              sha256_roots_f **roots,
+              int backend) {
+  switch (backend) {
+    case BTC_SHA256_GENERIC: {
+      *compress = sha256_compress_generic;
+      *roots = sha256_roots_generic;
+      return 1;
+    }
+
+#if defined(SHA256_USE_SHANI)
+    case BTC_SHA256_SHANI: {
+      if (!sha256_has_shani())
+        return 0;
+
+      *compress = sha256_compress_shani;
+      *roots = sha256_roots_shani;
+
+      return 1;
+    }
+#endif
+
+#if defined(SHA256_USE_ARMV8)
+    case BTC_SHA256_ARMV8: {
+      *compress = sha256_compress_armv8;
+      *roots = sha256_roots_armv8;
+      return 1;
+    }
+#endif
+
+#if defined(SHA256_USE_AVX2)
+    case BTC_SHA256_AVX2: {
+      if (!sha256_has_avx2())
+        return 0;
+
+      *compress = sha256_compress_generic;
+      *roots = sha256_roots_avx2;
+
+      return 1;
+    }
+#endif
+
+#if defined(SHA256_USE_SSE2)
+    case BTC_SHA256_SSE2: {
+      *compress = sha256_compress_generic;
+      *roots = sha256_roots_sse2;
+      return 1;
+    }
+#endif
+  }
+
+  return 0;
+}
+
+static void
+sha256_detect(void) {
+  /* In order of preference. */
+  static const int backends[] = {
+    BTC_SHA256_SHANI,
+    BTC_SHA256_ARMV8,
+    BTC_SHA256_AVX2,
+    BTC_SHA256_SSE2,
+    BTC_SHA256_GENERIC
+  };
+  sha256_compress_f *compress;
+  sha256_roots_f *roots;
+  size_t i;
+
+  for (i = 0; i < lengthof(backends); i++) {
+    if (sha256_lookup(&compress, &roots, backends[i])) {
+      sha256_backend = backends[i];
+      sha256_compress = compress;
+      sha256_roots = roots;
+      return;
+    }
+  }
+}
+
+int
+btc_sha256_backend(void) {
+  if (sha256_compress == NULL)
+    sha256_detect();
+
+  return sha256_backend;
+}
+
+int
+btc_sha256_select(int backend) {
+  sha256_compress_f *compress;
+  sha256_roots_f *roots;
+
+  if (!sha256_lookup(&compress, &roots, backend))
+    return 0;
+
+  sha256_backend = backend;
+  sha256_compress = compress;
+  sha256_roots = roots;
+
+  return 1;
+}
+
+/*
+ * SHA256
+ */
+
+void
+btc_sha256_init(btc_sha256_t *ctx) {
+  ctx->state[0] = 0x6a09e667;
+  ctx->state[1] = 0xbb67ae85;
+  ctx->state[2] = 0x3c6ef372;
+  ctx->state[3] = 0xa54ff53a;
+  ctx->state[4] = 0x510e527f;
+  ctx->state[5] = 0x9b05688c;
+  ctx->state[6] = 0x1f83d9ab;
+  ctx->state[7] = 0x5be0cd19;
+  ctx->size = 0;
 }
 
 void
@@ -196,6 +905,10 @@ btc_sha256_update(btc_sha256_t *ctx, const void *data, size_t len) {
   size_t pos = ctx->size & 63;
   size_t want = 64 - pos;
 
+  /* Detection is idempotent; a racing thread stores the same result. */
+  if (sha256_compress == NULL)
+    sha256_detect();
+
   ctx->size += len;
 
   if (len >= want) {
@@ -206,13 +919,13 @@ btc_sha256_update(btc_sha256_t *ctx, const void *data, size_t len) {
       len -= want;
       pos = 0;
 
-      sha256_transform(ctx, ctx->block);
+      sha256_compress(ctx->state, ctx->block, 1);
     }
 
-    while (len >= 64) {
-      sha256_transform(ctx, raw);
-      raw += 64;
-      len -= 64;
+    if (len >= 64) {
+      sha256_compress(ctx->state, raw, len >> 6);
+      raw += len & ~63;
+      len &= 63;
     }
   }
 
@@ -225,13 +938,16 @@ btc_sha256_final(btc_sha256_t *ctx, uint8_t *out) {
   size_t pos = ctx->size & 63;
   int i;
 
+  if (sha256_compress == NULL)
+    sha256_detect();
+
   ctx->block[pos++] = 0x80;
 
   if (pos > 56) {
     while (pos < 64)
       ctx->block[pos++] = 0x00;
 
-    sha256_transform(ctx, ctx->block);
+    sha256_compress(ctx->state, ctx->block, 1);
 
     pos = 0;
   }
@@ -241,7 +957,7 @@ btc_sha256_final(btc_sha256_t *ctx, uint8_t *out) {
 
   btc_write64be(ctx->block + 56, ctx->size << 3);
 
-  sha256_transform(ctx, ctx->block);
+  sha256_compress(ctx->state, ctx->block, 1);
 
   for (i = 0; i < 8; i++)
     btc_write32be(out + i * 4, ctx->state[i]);
@@ -254,3 +970,16 @@ btc_sha256(uint8_t *out, const void *data, size_t size) {
   btc_sha256_update(&ctx, data, size);
   btc_sha256_final(&ctx, out);
 }
+
+/*
+ * Hash256 (Batched)
+ */
+
+void
+btc_hash256_roots(uint8_t *out, const uint8_t *in, size_t count) {
+  /* Detection is idempotent; a racing thread stores the same result. */
+  if (sha256_roots == NULL)
+    sha256_detect();
+
+  sha256_roots(out, in, count);
+}
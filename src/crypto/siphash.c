@@ -113,7 +113,12 @@ btc_siphash_mod(const uint8_t *data,
                 size_t size,
                 const uint8_t *key,
                 uint64_t mod) {
-  uint64_t a = btc_siphash_sum(data, size, key);
+  return btc_siphash_reduce(btc_siphash_sum(data, size, key), mod);
+}
+
+uint64_t
+btc_siphash_reduce(uint64_t x, uint64_t mod) {
+  uint64_t a = x;
   uint64_t b = mod;
 
 #if defined(BTC_HAVE_INT128)
@@ -33,6 +33,7 @@ btc_entry_init(btc_entry_t *z) {
   z->undo_pos = -1;
   z->prev = NULL;
   z->next = NULL;
+  z->skip = NULL;
 }
 
 void
@@ -52,6 +53,7 @@ btc_entry_copy(btc_entry_t *z, const btc_entry_t *x) {
   z->undo_pos = x->undo_pos;
   z->prev = NULL;
   z->next = NULL;
+  z->skip = NULL;
 }
 
 size_t
@@ -108,6 +110,7 @@ btc_entry_read(btc_entry_t *z, const uint8_t **xp, size_t *xn) {
 
   z->prev = NULL;
   z->next = NULL;
+  z->skip = NULL;
 
   return 1;
 }
@@ -164,6 +167,8 @@ btc_entry_set_header(btc_entry_t *entry,
   btc_entry_get_chainwork(entry->chainwork, entry, prev);
 
   entry->prev = (btc_entry_t *)prev;
+
+  btc_entry_set_skip(entry);
 }
 
 void
@@ -173,6 +178,59 @@ btc_entry_set_block(btc_entry_t *entry,
   btc_entry_set_header(entry, &block->header, prev);
 }
 
+static int32_t
+invert_lowest_one(int32_t n) {
+  return n & (n - 1);
+}
+
+static int32_t
+get_skip_height(int32_t height) {
+  if (height < 2)
+    return 0;
+
+  /* Same as bitcoind: any lower height works, but this
+     one needs at most ~110 steps to go back 2^18 blocks. */
+  if (height & 1)
+    return invert_lowest_one(invert_lowest_one(height - 1)) + 1;
+
+  return invert_lowest_one(height);
+}
+
+void
+btc_entry_set_skip(btc_entry_t *entry) {
+  int32_t height = get_skip_height(entry->height);
+
+  if (entry->prev != NULL)
+    entry->skip = (btc_entry_t *)btc_entry_ancestor(entry->prev, height);
+  else
+    entry->skip = NULL;
+}
+
+const btc_entry_t *
+btc_entry_ancestor(const btc_entry_t *entry, int32_t height) {
+  int32_t skip, prev;
+
+  if (height < 0 || height > entry->height)
+    return NULL;
+
+  while (entry->height > height) {
+    skip = get_skip_height(entry->height);
+    prev = get_skip_height(entry->height - 1);
+
+    /* Only take the skip if following prev
+       will not lead to a better one. */
+    if (entry->skip != NULL
+        && (skip == height || (skip > height && !(prev < skip - 2
+                                                  && prev >= height)))) {
+      entry = entry->skip;
+    } else {
+      entry = entry->prev;
+    }
+  }
+
+  return entry;
+}
+
 static int
 cmptime(const void *x, const void *y) {
   return *((int64_t *)x) - *((int64_t *)y);
@@ -306,6 +306,33 @@ btc_fs_read(btc_fd_t fd, void *dst, size_t len) {
   return cnt;
 }
 
+int64_t
+btc_fs_pread(btc_fd_t fd, void *dst, size_t len, int64_t pos) {
+  unsigned char *buf = dst;
+  int64_t cnt = 0;
+
+  while (len > 0) {
+    size_t max = BTC_MIN(len, 1 << 30);
+    int nread;
+
+    do {
+      nread = pread(fd, buf, max, pos + cnt);
+    } while (nread < 0 && errno == EINTR);
+
+    if (nread < 0)
+      return -1;
+
+    if (nread == 0)
+      break;
+
+    buf += nread;
+    len -= nread;
+    cnt += nread;
+  }
+
+  return cnt;
+}
+
 int64_t
 btc_fs_write(btc_fd_t fd, const void *src, size_t len) {
   const unsigned char *buf = src;
@@ -340,6 +367,41 @@ btc_fs_fsync(btc_fd_t fd) {
   return fsync(fd) == 0;
 }
 
+int
+btc_fs_fallocate(btc_fd_t fd, int64_t size) {
+  /* Reserve space without changing the file size
+     (appends must still land at the current end). */
+#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+  int rc;
+
+  do {
+    rc = fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, size);
+  } while (rc < 0 && errno == EINTR);
+
+  return rc == 0;
+#elif defined(__APPLE__) && defined(F_PREALLOCATE)
+  fstore_t store;
+
+  memset(&store, 0, sizeof(store));
+
+  store.fst_flags = F_ALLOCATECONTIG | F_ALLOCATEALL;
+  store.fst_posmode = F_PEOFPOSMODE;
+  store.fst_offset = 0;
+  store.fst_length = size;
+
+  if (fcntl(fd, F_PREALLOCATE, &store) == 0)
+    return 1;
+
+  store.fst_flags = F_ALLOCATEALL;
+
+  return fcntl(fd, F_PREALLOCATE, &store) == 0;
+#else
+  (void)fd;
+  (void)size;
+  return 0;
+#endif
+}
+
 static int
 btc_flock(int fd, int lock) {
 #if defined(HAVE_SETLK)
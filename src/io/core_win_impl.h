@@ -606,6 +606,52 @@ btc_fs_read(btc_fd_t fd, void *dst, size_t len) {
   return cnt;
 }
 
+int64_t
+btc_fs_pread(btc_fd_t fd, void *dst, size_t len, int64_t pos) {
+  unsigned char *buf = dst;
+  LARGE_INTEGER zero, cur;
+  int64_t cnt = 0;
+
+  /* ReadFile moves the file pointer of a synchronous
+     handle even when given an offset. Put it back. */
+  zero.QuadPart = 0;
+
+  if (!BTCSetFilePointerEx(fd, zero, &cur, FILE_CURRENT))
+    return -1;
+
+  while (len > 0) {
+    DWORD max = BTC_MIN(len, 1 << 30);
+    uint64_t off = pos + cnt;
+    OVERLAPPED ol;
+    DWORD nread;
+
+    memset(&ol, 0, sizeof(ol));
+
+    ol.Offset = (DWORD)off;
+    ol.OffsetHigh = (DWORD)(off >> 32);
+
+    if (!ReadFile(fd, buf, max, &nread, &ol)) {
+      if (GetLastError() == ERROR_HANDLE_EOF)
+        break;
+
+      cnt = -1;
+      break;
+    }
+
+    if (nread == 0)
+      break;
+
+    buf += nread;
+    len -= nread;
+    cnt += nread;
+  }
+
+  if (!BTCSetFilePointerEx(fd, cur, NULL, FILE_BEGIN))
+    return -1;
+
+  return cnt;
+}
+
 int64_t
 btc_fs_write(btc_fd_t fd, const void *src, size_t len) {
   const unsigned char *buf = src;
@@ -631,6 +677,14 @@ btc_fs_fsync(btc_fd_t fd) {
   return FlushFileBuffers(fd) != 0;
 }
 
+int
+btc_fs_fallocate(btc_fd_t fd, int64_t size) {
+  /* FileAllocationInfo requires Vista. */
+  (void)fd;
+  (void)size;
+  return 0;
+}
+
 btc_fd_t
 btc_fs_lock(const char *name) {
   HANDLE handle = BTCCreateFile(name,
@@ -5,6 +5,7 @@
  *
  * Resources:
  *   https://nachtimwald.com/2019/04/12/thread-pool-in-c/
+ *   https://www.dre.vanderbilt.edu/~schmidt/PDF/work-stealing-dequeue.pdf
  */
 
 #include <stdlib.h>
@@ -26,124 +27,218 @@ safe_malloc(size_t size) {
   return ptr;
 }
 
+static void *
+safe_realloc(void *ptr, size_t size) {
+  ptr = realloc(ptr, size);
+
+  if (ptr == NULL)
+    abort(); /* LCOV_EXCL_LINE */
+
+  return ptr;
+}
+
 /*
- * Work
+ * Atomics
+ *
+ * Everything is sequentially consistent. The
+ * sleep/wake handshake below relies on it.
  */
 
-static btc_work_t *
-btc_work_create(btc_work_f *func, void *arg) {
-  btc_work_t *work = safe_malloc(sizeof(btc_work_t));
+#if defined(__GNUC__) && defined(__ATOMIC_SEQ_CST)
 
-  work->func = func;
-  work->arg = arg;
-  work->next = NULL;
+#define btc_atomic_load(p) __atomic_load_n(p, __ATOMIC_SEQ_CST)
+#define btc_atomic_store(p, x) __atomic_store_n(p, x, __ATOMIC_SEQ_CST)
+#define btc_atomic_add(p, x) __atomic_fetch_add(p, x, __ATOMIC_SEQ_CST)
+#define btc_atomic_sub(p, x) __atomic_fetch_sub(p, x, __ATOMIC_SEQ_CST)
+
+static int
+btc_atomic_cas(volatile long *ptr, long expect, long value) {
+  return __atomic_compare_exchange_n(ptr, &expect, value, 0,
+                                     __ATOMIC_SEQ_CST,
+                                     __ATOMIC_SEQ_CST);
+}
+
+#elif defined(_WIN32)
+
+#include <windows.h>
+
+#define btc_atomic_load(p) InterlockedCompareExchange(p, 0, 0)
+#define btc_atomic_store(p, x) ((void)InterlockedExchange(p, x))
+#define btc_atomic_add(p, x) InterlockedExchangeAdd(p, x)
+#define btc_atomic_sub(p, x) InterlockedExchangeAdd(p, -(x))
+
+static int
+btc_atomic_cas(volatile long *ptr, long expect, long value) {
+  return InterlockedCompareExchange(ptr, value, expect) == expect;
+}
+
+#else /* !__ATOMIC_SEQ_CST */
+
+/* No atomics available. Fall back to a global lock. */
+static btc_mutex_t atomic_mutex = BTC_MUTEX_INITIALIZER;
 
-  return work;
+static long
+btc_atomic_load(volatile long *ptr) {
+  long ret;
+  btc_mutex_lock(&atomic_mutex);
+  ret = *ptr;
+  btc_mutex_unlock(&atomic_mutex);
+  return ret;
 }
 
-static btc_work_t *
-btc_work_destroy(btc_work_t *work) {
-  btc_work_t *next = work->next;
-  free(work);
-  return next;
+static void
+btc_atomic_store(volatile long *ptr, long value) {
+  btc_mutex_lock(&atomic_mutex);
+  *ptr = value;
+  btc_mutex_unlock(&atomic_mutex);
+}
+
+static long
+btc_atomic_add(volatile long *ptr, long value) {
+  long ret;
+  btc_mutex_lock(&atomic_mutex);
+  ret = *ptr;
+  *ptr += value;
+  btc_mutex_unlock(&atomic_mutex);
+  return ret;
 }
 
-static btc_work_t *
-btc_work_execute(btc_work_t *work) {
-  work->func(work->arg);
-  return btc_work_destroy(work);
+#define btc_atomic_sub(p, x) btc_atomic_add(p, -(x))
+
+static int
+btc_atomic_cas(volatile long *ptr, long expect, long value) {
+  int ret = 0;
+  btc_mutex_lock(&atomic_mutex);
+  if (*ptr == expect) {
+    *ptr = value;
+    ret = 1;
+  }
+  btc_mutex_unlock(&atomic_mutex);
+  return ret;
 }
 
+#endif /* !__ATOMIC_SEQ_CST */
+
 /*
  * Work Queue
  */
 
 void
 btc_workq_init(btc_workq_t *queue) {
-  queue->head = NULL;
-  queue->tail = NULL;
+  queue->items = NULL;
+  queue->alloc = 0;
   queue->length = 0;
 }
 
 void
 btc_workq_clear(btc_workq_t *queue) {
-  btc_work_t *work, *next;
-
-  for (work = queue->head; work != NULL; work = next)
-    next = btc_work_destroy(work);
+  if (queue->items != NULL)
+    free(queue->items);
 
   btc_workq_init(queue);
 }
 
 void
 btc_workq_push(btc_workq_t *queue, btc_work_f *func, void *arg) {
-  btc_work_t *work = btc_work_create(func, arg);
+  btc_work_t *work;
 
-  if (queue->head == NULL)
-    queue->head = work;
+  if (queue->length == queue->alloc) {
+    int alloc = queue->alloc == 0 ? 16 : queue->alloc * 2;
 
-  if (queue->tail != NULL)
-    queue->tail->next = work;
+    queue->items = safe_realloc(queue->items, alloc * sizeof(btc_work_t));
+    queue->alloc = alloc;
+  }
 
-  queue->tail = work;
-  queue->length++;
+  work = &queue->items[queue->length++];
+  work->func = func;
+  work->arg = arg;
 }
 
-static btc_work_t *
-btc_workq_shift(btc_workq_t *queue) {
-  btc_work_t *work = queue->head;
+void
+btc_workq_concat(btc_workq_t *z, btc_workq_t *x) {
+  int i;
 
-  if (work == NULL)
-    abort(); /* LCOV_EXCL_LINE */
+  for (i = 0; i < x->length; i++)
+    btc_workq_push(z, x->items[i].func, x->items[i].arg);
 
-  queue->head = work->next;
+  /* Storage is kept, as with btc_workers_batch. */
+  x->length = 0;
+}
 
-  if (queue->head == NULL)
-    queue->tail = NULL;
+/*
+ * Deque
+ *
+ * A bounded ring of preallocated task slots with
+ * a single producer (whoever holds the submission
+ * lock) and any number of consumers. The owning
+ * worker and thieves alike claim tasks from the
+ * top with a CAS; no consumer ever takes a lock.
+ *
+ * Tasks never spawn tasks, so the owner has no
+ * need to push to (or pop from) the bottom.
+ */
 
-  queue->length--;
+#define DEQUE_SIZE 1024
+#define DEQUE_MASK (DEQUE_SIZE - 1)
 
-  work->next = NULL;
+typedef struct btc_deque_s {
+  volatile long top;
+  char pad1[64 - sizeof(long)];
+  volatile long bottom;
+  char pad2[64 - sizeof(long)];
+  btc_work_t slots[DEQUE_SIZE];
+} btc_deque_t;
 
-  return work;
+static void
+btc_deque_init(btc_deque_t *dq) {
+  dq->top = 0;
+  dq->bottom = 0;
 }
 
-static void
-btc_workq_concat(btc_workq_t *z, btc_workq_t *x) {
-  if (z->head == NULL) {
-    z->head = x->head;
-    z->tail = x->tail;
-  } else {
-    z->tail->next = x->head;
-    z->tail = x->head;
-  }
+static int
+btc_deque_push(btc_deque_t *dq, const btc_work_t *items, int length) {
+  unsigned long b = (unsigned long)btc_atomic_load(&dq->bottom);
+  unsigned long t = (unsigned long)btc_atomic_load(&dq->top);
+  unsigned long room = DEQUE_SIZE - (b - t);
+  int i;
 
-  z->length += x->length;
+  if ((unsigned long)length > room)
+    length = (int)room;
 
-  btc_workq_init(x);
-}
+  for (i = 0; i < length; i++)
+    dq->slots[(b + i) & DEQUE_MASK] = items[i];
 
-static void
-btc_workq_slice(btc_workq_t *z, btc_workq_t *x, int length) {
-  btc_work_t *work;
+  /* Publish. */
+  if (length > 0)
+    btc_atomic_store(&dq->bottom, (long)(b + length));
 
-  if (length <= 0)
-    abort(); /* LCOV_EXCL_LINE */
+  return length;
+}
+
+static int
+btc_deque_take(btc_deque_t *dq, btc_work_t *items, int max, int half) {
+  for (;;) {
+    unsigned long t = (unsigned long)btc_atomic_load(&dq->top);
+    unsigned long b = (unsigned long)btc_atomic_load(&dq->bottom);
+    unsigned long avail = b - t;
+    int i, length;
 
-  length--;
+    if (avail == 0)
+      return 0;
 
-  work = btc_workq_shift(x);
+    if (half)
+      avail = (avail + 1) / 2;
 
-  z->head = work;
-  z->tail = work;
-  z->length = 1;
+    length = avail < (unsigned long)max ? (int)avail : max;
 
-  while (length--) {
-    work = btc_workq_shift(x);
+    for (i = 0; i < length; i++)
+      items[i] = dq->slots[(t + i) & DEQUE_MASK];
 
-    z->tail->next = work;
-    z->tail = work;
-    z->length++;
+    /* The producer cannot reuse these slots
+       until top moves, so this read is valid
+       if and only if our claim succeeds. */
+    if (btc_atomic_cas(&dq->top, (long)t, (long)(t + length)))
+      return length;
   }
 }
 
@@ -151,16 +246,36 @@ btc_workq_slice(btc_workq_t *z, btc_workq_t *x, int length) {
  * Workers
  */
 
+#define WORKER_STEAL 32
+#define WORKER_SPINS 128
+
+typedef struct btc_worker_s {
+  struct btc_workers_s *pool;
+  int index;
+} btc_worker_t;
+
 struct btc_workers_s {
   btc_mutex_t mutex;
+  btc_mutex_t submit;
   btc_cond_t master;
   btc_cond_t worker;
-  btc_workq_t queue;
+  btc_deque_t *deques;
+  btc_worker_t *workers;
+  int length;
   int threads;
-  int max_batch;
-  int idle;
-  int left;
-  int stop;
+  int max_steal;
+  int max_wake;
+  int cursor;
+  /* Takers, executors and the producer each
+     write a different counter. Keep them on
+     separate cache lines. */
+  char pad1[64];
+  volatile long queued;
+  char pad2[64 - sizeof(long)];
+  volatile long left;
+  char pad3[64 - sizeof(long)];
+  volatile long sleepers;
+  volatile long stop;
 };
 
 static void
@@ -182,20 +297,43 @@ btc_workers_create(int threads, int max_batch) {
   if (max_batch < 1)
     max_batch = 1;
 
+  if (max_batch > WORKER_STEAL)
+    max_batch = WORKER_STEAL;
+
   btc_mutex_init(&pool->mutex);
+  btc_mutex_init(&pool->submit);
   btc_cond_init(&pool->master);
   btc_cond_init(&pool->worker);
 
-  btc_workq_init(&pool->queue);
-
+  pool->deques = NULL;
+  pool->workers = NULL;
+  pool->length = threads;
   pool->threads = threads;
-  pool->max_batch = max_batch;
-  pool->idle = 0;
+  pool->max_steal = max_batch;
+  pool->max_wake = btc_sys_numcpu();
+  pool->cursor = 0;
+  pool->queued = 0;
   pool->left = 0;
+  pool->sleepers = 0;
   pool->stop = 0;
 
+  if (pool->max_wake < 1)
+    pool->max_wake = 1;
+
+  if (threads > 0) {
+    pool->deques = safe_malloc(threads * sizeof(btc_deque_t));
+    pool->workers = safe_malloc(threads * sizeof(btc_worker_t));
+  }
+
   for (i = 0; i < threads; i++) {
-    btc_thread_create(&thread, worker_thread, pool);
+    btc_deque_init(&pool->deques[i]);
+
+    pool->workers[i].pool = pool;
+    pool->workers[i].index = i;
+  }
+
+  for (i = 0; i < threads; i++) {
+    btc_thread_create(&thread, worker_thread, &pool->workers[i]);
     btc_thread_detach(&thread);
   }
 
@@ -206,14 +344,9 @@ void
 btc_workers_destroy(btc_workers_t *pool) {
   btc_mutex_lock(&pool->mutex);
 
-  btc_workq_clear(&pool->queue);
-
-  pool->stop = 1;
+  btc_atomic_store(&pool->stop, 1);
 
   btc_cond_broadcast(&pool->worker);
-  btc_mutex_unlock(&pool->mutex);
-
-  btc_mutex_lock(&pool->mutex);
 
   while (pool->threads > 0)
     btc_cond_wait(&pool->master, &pool->mutex);
@@ -221,20 +354,151 @@ btc_workers_destroy(btc_workers_t *pool) {
   btc_mutex_unlock(&pool->mutex);
 
   btc_mutex_destroy(&pool->mutex);
+  btc_mutex_destroy(&pool->submit);
   btc_cond_destroy(&pool->worker);
   btc_cond_destroy(&pool->master);
 
+  if (pool->deques != NULL)
+    free(pool->deques);
+
+  if (pool->workers != NULL)
+    free(pool->workers);
+
   free(pool);
 }
 
+static void
+btc_workers_execute(btc_workers_t *pool, btc_work_t *items, int length) {
+  int i;
+
+  for (i = 0; i < length; i++)
+    items[i].func(items[i].arg);
+
+  if (btc_atomic_sub(&pool->left, length) == length) {
+    btc_mutex_lock(&pool->mutex);
+    btc_cond_broadcast(&pool->master);
+    btc_mutex_unlock(&pool->mutex);
+  }
+}
+
+static int
+btc_workers_take(btc_workers_t *pool, int index, btc_work_t *items) {
+  int i, j, length;
+
+  /* Our own deque first. Taking half of it at a
+     time leaves the rest for thieves while paying
+     for the CAS and the shared counters once per
+     claim rather than once per task. */
+  if (index >= 0) {
+    length = btc_deque_take(&pool->deques[index], items, pool->max_steal, 1);
+
+    if (length > 0)
+      goto done;
+  }
+
+  /* One load beats scanning every deque. */
+  if (btc_atomic_load(&pool->queued) <= 0)
+    return 0;
+
+  /* Then steal half of someone else's. */
+  for (i = 1; i <= pool->length; i++) {
+    j = (index + i) % pool->length;
+
+    if (j == index)
+      continue;
+
+    length = btc_deque_take(&pool->deques[j], items, pool->max_steal, 1);
+
+    if (length > 0)
+      goto done;
+  }
+
+  return 0;
+done:
+  btc_atomic_sub(&pool->queued, length);
+  return length;
+}
+
+static void
+btc_workers_wake(btc_workers_t *pool, int length) {
+  long sleepers = btc_atomic_load(&pool->sleepers);
+  int i;
+
+  if (sleepers == 0)
+    return;
+
+  /* Waking more threads than there are cores only
+     adds context switches; anyone awake will steal
+     from the deques of those still sleeping. */
+  if (length > pool->max_wake)
+    length = pool->max_wake;
+
+  btc_mutex_lock(&pool->mutex);
+
+  if (length >= sleepers) {
+    btc_cond_broadcast(&pool->worker);
+  } else {
+    for (i = 0; i < length; i++)
+      btc_cond_signal(&pool->worker);
+  }
+
+  btc_mutex_unlock(&pool->mutex);
+}
+
+static void
+btc_workers_submit(btc_workers_t *pool, const btc_work_t *items, int length) {
+  int i, chunk, count, total;
+
+  if (length == 0)
+    return;
+
+  btc_atomic_add(&pool->left, length);
+  btc_atomic_add(&pool->queued, length);
+
+  btc_mutex_lock(&pool->submit);
+
+  chunk = (length + pool->length - 1) / pool->length;
+  total = 0;
+
+  /* Spread the batch across every deque. */
+  for (i = 0; i < pool->length && total < length; i++) {
+    btc_deque_t *dq = &pool->deques[pool->cursor];
+
+    count = length - total;
+
+    if (count > chunk)
+      count = chunk;
+
+    total += btc_deque_push(dq, items + total, count);
+
+    pool->cursor = (pool->cursor + 1) % pool->length;
+  }
+
+  /* Top up whatever deques still have room. */
+  for (i = 0; i < pool->length && total < length; i++)
+    total += btc_deque_push(&pool->deques[i], items + total, length - total);
+
+  btc_mutex_unlock(&pool->submit);
+
+  btc_workers_wake(pool, length);
+
+  /* Everything is full: do the rest ourselves. */
+  if (total < length) {
+    btc_atomic_sub(&pool->queued, length - total);
+
+    btc_workers_execute(pool, (btc_work_t *)items + total, length - total);
+  }
+}
+
 void
 btc_workers_add(btc_workers_t *pool, btc_work_f *func, void *arg) {
 #if defined(_WIN32) || defined(BTC_PTHREAD)
-  btc_mutex_lock(&pool->mutex);
-  btc_workq_push(&pool->queue, func, arg);
-  pool->left++;
-  btc_cond_signal(&pool->worker);
-  btc_mutex_unlock(&pool->mutex);
+  btc_work_t work;
+
+  work.func = func;
+  work.arg = arg;
+
+  btc_workers_submit(pool, &work, 1);
 #else
   (void)pool;
 
@@ -245,105 +509,83 @@ btc_workers_add(btc_workers_t *pool, btc_work_f *func, void *arg) {
 void
 btc_workers_batch(btc_workers_t *pool, btc_workq_t *batch) {
 #if defined(_WIN32) || defined(BTC_PTHREAD)
-  int length = batch->length;
-
-  if (length == 0)
-    return;
-
-  btc_mutex_lock(&pool->mutex);
-
-  btc_workq_concat(&pool->queue, batch);
-
-  pool->left += length;
-
-  if (length == 1)
-    btc_cond_signal(&pool->worker);
-  else
-    btc_cond_broadcast(&pool->worker);
-
-  btc_mutex_unlock(&pool->mutex);
+  btc_workers_submit(pool, batch->items, batch->length);
 #else
-  btc_work_t *work, *next;
+  int i;
 
-  (void)btc_workq_concat;
   (void)pool;
 
-  for (work = batch->head; work != NULL; work = next)
-    next = btc_work_execute(work);
-
-  btc_workq_init(batch);
+  for (i = 0; i < batch->length; i++)
+    batch->items[i].func(batch->items[i].arg);
 #endif
+
+  /* Storage is kept for the next batch. */
+  batch->length = 0;
 }
 
 void
 btc_workers_wait(btc_workers_t *pool) {
-  btc_mutex_lock(&pool->mutex);
+  btc_work_t items[WORKER_STEAL];
+  int length;
 
-  while (pool->left > 0)
-    btc_cond_wait(&pool->master, &pool->mutex);
+  /* Help out rather than sleeping. */
+  while (btc_atomic_load(&pool->left) > 0) {
+    length = btc_workers_take(pool, -1, items);
 
-  btc_mutex_unlock(&pool->mutex);
-}
-
-static int
-btc_workers_slice(btc_workers_t *pool, btc_workq_t *jobs) {
-  /* Same logic as bitcoin core v0.10.0. */
-  int length = pool->queue.length / (pool->threads + pool->idle + 1);
+    if (length == 0)
+      break;
 
-  if (length > pool->max_batch)
-    length = pool->max_batch;
+    btc_workers_execute(pool, items, length);
+  }
 
-  if (length < 1)
-    length = 1;
+  btc_mutex_lock(&pool->mutex);
 
-  btc_workq_slice(jobs, &pool->queue, length);
+  while (btc_atomic_load(&pool->left) > 0)
+    btc_cond_wait(&pool->master, &pool->mutex);
 
-  return length;
+  btc_mutex_unlock(&pool->mutex);
 }
 
 static void
 worker_thread(void *arg) {
-  btc_workers_t *pool = arg;
-  btc_work_t *work, *next;
-  btc_workq_t jobs;
-  int length = 0;
+  btc_worker_t *self = arg;
+  btc_workers_t *pool = self->pool;
+  btc_work_t items[WORKER_STEAL];
+  int spins = 0;
+  int length;
 
   for (;;) {
-    btc_mutex_lock(&pool->mutex);
+    length = btc_workers_take(pool, self->index, items);
 
     if (length > 0) {
-      pool->left -= length;
-
-      if (!pool->stop && pool->left == 0)
-        btc_cond_signal(&pool->master);
+      btc_workers_execute(pool, items, length);
+      spins = 0;
+      continue;
     }
 
-    while (!pool->stop && pool->queue.length == 0) {
-      pool->idle++;
-      btc_cond_wait(&pool->worker, &pool->mutex);
-      pool->idle--;
-    }
-
-    if (pool->stop)
+    if (btc_atomic_load(&pool->stop))
       break;
 
-    if (pool->max_batch > 1) {
-      length = btc_workers_slice(pool, &jobs);
+    if (++spins < WORKER_SPINS)
+      continue;
 
-      btc_mutex_unlock(&pool->mutex);
+    spins = 0;
 
-      for (work = jobs.head; work != NULL; work = next)
-        next = btc_work_execute(work);
-    } else {
-      work = btc_workq_shift(&pool->queue);
-      length = 1;
+    /* Nothing to steal. Go to sleep. */
+    btc_mutex_lock(&pool->mutex);
 
-      btc_mutex_unlock(&pool->mutex);
+    btc_atomic_add(&pool->sleepers, 1);
 
-      btc_work_execute(work);
-    }
+    while (!btc_atomic_load(&pool->stop) && btc_atomic_load(&pool->queued) <= 0)
+      btc_cond_wait(&pool->worker, &pool->mutex);
+
+    btc_atomic_sub(&pool->sleepers, 1);
+
+    btc_mutex_unlock(&pool->mutex);
   }
 
+  btc_mutex_lock(&pool->mutex);
+
   if (--pool->threads == 0)
     btc_cond_signal(&pool->master);
 
@@ -577,6 +577,44 @@ json_block_new_ex(const btc_block_t *block,
   return obj;
 }
 
+json_value *
+json_rawblock_new_ex(const btc_rawblock_t *block,
+                     const btc_entry_t *entry,
+                     int confirmations,
+                     const uint8_t *next) {
+  json_value *obj = json_entry_new_ex(entry, confirmations, next);
+  json_value *txs = json_array_new(block->txs.length);
+  const uint8_t *xp = block->txs.data;
+  size_t xn = block->txs.size;
+  size_t base, weight;
+  size_t wit = 0;
+  uint8_t hash[32];
+  btc_rawtx_t tx;
+  size_t i;
+
+  /* Hash in place rather than decoding every transaction. */
+  for (i = 0; i < block->txs.length; i++) {
+    CHECK(btc_rawtx_read(&tx, &xp, &xn));
+
+    btc_rawtx_txid(hash, &tx);
+
+    json_array_push(txs, json_hash_new(hash));
+
+    wit += btc_rawtx_witness_size(&tx);
+  }
+
+  base = block->size - wit;
+  weight = (base * BTC_WITNESS_SCALE_FACTOR) + wit;
+
+  json_object_push(obj, "strippedsize", json_integer_new(base));
+  json_object_push(obj, "size", json_integer_new(block->size));
+  json_object_push(obj, "weight", json_integer_new(weight));
+  json_object_push(obj, "nTx", json_integer_new(block->txs.length));
+  json_object_push(obj, "tx", txs);
+
+  return obj;
+}
+
 /*
  * Hexification
  */
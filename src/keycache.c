@@ -0,0 +1,147 @@
+/*!
+ * keycache.c - public key cache for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#  include <windows.h>
+#elif defined(BTC_PTHREAD)
+#  include <pthread.h>
+#endif
+
+#include <mako/crypto/ecc.h>
+#include <mako/keycache.h>
+#include <mako/util.h>
+#include "bio.h"
+#include "internal.h"
+
+/*
+ * Key Cache
+ */
+
+/* Maps a compressed public key to its uncompressed
+   form. Verifying against the latter skips the field
+   square root which decompression costs on every
+   signature check. Script verification runs on the
+   chain's workers, so the table is locked. */
+
+typedef struct btc_keyent_s {
+  uint8_t key[33];
+  uint8_t point[65];
+} btc_keyent_t;
+
+struct btc_keycache_s {
+#if defined(_WIN32)
+  CRITICAL_SECTION lock;
+#elif defined(BTC_PTHREAD)
+  pthread_mutex_t lock;
+#endif
+  btc_keyent_t *items;
+  size_t mask;
+};
+
+static void
+btc_keycache_lock(btc_keycache_t *cache) {
+#if defined(_WIN32)
+  EnterCriticalSection(&cache->lock);
+#elif defined(BTC_PTHREAD)
+  if (pthread_mutex_lock(&cache->lock) != 0)
+    btc_abort(); /* LCOV_EXCL_LINE */
+#else
+  (void)cache;
+#endif
+}
+
+static void
+btc_keycache_unlock(btc_keycache_t *cache) {
+#if defined(_WIN32)
+  LeaveCriticalSection(&cache->lock);
+#elif defined(BTC_PTHREAD)
+  if (pthread_mutex_unlock(&cache->lock) != 0)
+    btc_abort(); /* LCOV_EXCL_LINE */
+#else
+  (void)cache;
+#endif
+}
+
+btc_keycache_t *
+btc_keycache_create(size_t size) {
+  btc_keycache_t *cache = btc_malloc(sizeof(btc_keycache_t));
+  size_t length = 1;
+
+  while (length * 2 <= size)
+    length *= 2;
+
+#if defined(_WIN32)
+  InitializeCriticalSection(&cache->lock);
+#elif defined(BTC_PTHREAD)
+  if (pthread_mutex_init(&cache->lock, NULL) != 0)
+    btc_abort(); /* LCOV_EXCL_LINE */
+#endif
+
+  /* A zero prefix never belongs to a compressed key. */
+  cache->items = btc_malloc(length * sizeof(btc_keyent_t));
+  cache->mask = length - 1;
+
+  memset(cache->items, 0, length * sizeof(btc_keyent_t));
+
+  return cache;
+}
+
+void
+btc_keycache_destroy(btc_keycache_t *cache) {
+#if defined(_WIN32)
+  DeleteCriticalSection(&cache->lock);
+#elif defined(BTC_PTHREAD)
+  pthread_mutex_destroy(&cache->lock);
+#endif
+
+  btc_free(cache->items);
+  btc_free(cache);
+}
+
+int
+btc_keycache_verify(btc_keycache_t *cache,
+                    const uint8_t *msg,
+                    const uint8_t *sig,
+                    const uint8_t *pub,
+                    size_t pub_len) {
+  uint8_t point[65];
+  btc_keyent_t *ent;
+  int hit;
+
+  if (cache == NULL || pub_len != 33 || (pub[0] & ~1) != 0x02)
+    return btc_ecdsa_verify(msg, 32, sig, pub, pub_len);
+
+  /* The x coordinate is already uniformly distributed.
+     Direct-mapped: a collision simply evicts. */
+  ent = &cache->items[btc_read32le(pub + 1) & cache->mask];
+
+  btc_keycache_lock(cache);
+
+  hit = memcmp(ent->key, pub, 33) == 0;
+
+  if (hit)
+    memcpy(point, ent->point, 65);
+
+  btc_keycache_unlock(cache);
+
+  if (!hit) {
+    if (!btc_ecdsa_pubkey_convert(point, pub, 33, 0))
+      return 0;
+
+    btc_keycache_lock(cache);
+
+    memcpy(ent->key, pub, 33);
+    memcpy(ent->point, point, 65);
+
+    btc_keycache_unlock(cache);
+  }
+
+  return btc_ecdsa_verify(msg, 32, sig, point, 65);
+}
@@ -554,6 +554,19 @@ static const btc_network_t mainnet = {
     /* .length = */ lengthof(mainnet_checkpoints)
   },
   /* .last_checkpoint = */ 710000,
+  /* .assume_valid = */ {
+    710000,
+    {
+      0x87, 0xf5, 0x75, 0xc2, 0x81, 0x2f, 0x0a, 0xc7,
+      0x84, 0x15, 0xaa, 0x72, 0x00, 0x5f, 0xa5, 0xd6,
+      0xbe, 0xa0, 0xdb, 0x1d, 0x2e, 0x82, 0x07, 0x00,
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    }
+  },
+  /* .assume_utxo = */ {
+    /* .items = */ NULL,
+    /* .length = */ 0
+  },
   /* .halving_interval = */ 210000,
   /* .genesis = */ {
     /* .hash = */ {
@@ -30,6 +30,9 @@ static const char *btc_cmds[] = {
   "addr",
   "block",
   "blocktxn",
+  "cfcheckpt",
+  "cfheaders",
+  "cfilter",
   "cmpctblock",
   "feefilter",
   "filteradd",
@@ -38,6 +41,9 @@ static const char *btc_cmds[] = {
   "getaddr",
   "getblocks",
   "getblocktxn",
+  "getcfcheckpt",
+  "getcfheaders",
+  "getcfilters",
   "getdata",
   "getheaders",
   "headers",
@@ -892,6 +898,317 @@ btc_sendcmpct_read(btc_sendcmpct_t *z, const uint8_t **xp, size_t *xn) {
   return 1;
 }
 
+/*
+ * GetCFilters
+ */
+
+DEFINE_SERIALIZABLE_OBJECT(btc_getcfilters, SCOPE_EXTERN)
+
+void
+btc_getcfilters_init(btc_getcfilters_t *msg) {
+  msg->filter_type = 0;
+  msg->start_height = 0;
+  msg->stop = btc_hash_zero;
+}
+
+void
+btc_getcfilters_clear(btc_getcfilters_t *msg) {
+  (void)msg;
+}
+
+void
+btc_getcfilters_copy(btc_getcfilters_t *z, const btc_getcfilters_t *x) {
+  *z = *x;
+}
+
+size_t
+btc_getcfilters_size(const btc_getcfilters_t *x) {
+  (void)x;
+  return 37;
+}
+
+uint8_t *
+btc_getcfilters_write(uint8_t *zp, const btc_getcfilters_t *x) {
+  zp = btc_uint8_write(zp, x->filter_type);
+  zp = btc_uint32_write(zp, x->start_height);
+  zp = btc_raw_write(zp, x->stop, 32);
+  return zp;
+}
+
+int
+btc_getcfilters_read(btc_getcfilters_t *z, const uint8_t **xp, size_t *xn) {
+  if (!btc_uint8_read(&z->filter_type, xp, xn))
+    return 0;
+
+  if (!btc_uint32_read(&z->start_height, xp, xn))
+    return 0;
+
+  if (!btc_zraw_read(&z->stop, 32, xp, xn))
+    return 0;
+
+  return 1;
+}
+
+/*
+ * CFilter
+ */
+
+DEFINE_SERIALIZABLE_OBJECT(btc_cfilter, SCOPE_EXTERN)
+
+void
+btc_cfilter_init(btc_cfilter_t *msg) {
+  msg->filter_type = 0;
+  msg->hash = btc_hash_zero;
+  msg->data = NULL;
+  msg->length = 0;
+}
+
+void
+btc_cfilter_clear(btc_cfilter_t *msg) {
+  msg->data = NULL;
+  msg->length = 0;
+}
+
+void
+btc_cfilter_copy(btc_cfilter_t *z, const btc_cfilter_t *x) {
+  *z = *x;
+}
+
+size_t
+btc_cfilter_size(const btc_cfilter_t *x) {
+  return 33 + btc_size_size(x->length) + x->length;
+}
+
+uint8_t *
+btc_cfilter_write(uint8_t *zp, const btc_cfilter_t *x) {
+  zp = btc_uint8_write(zp, x->filter_type);
+  zp = btc_raw_write(zp, x->hash, 32);
+  zp = btc_size_write(zp, x->length);
+  zp = btc_raw_write(zp, x->data, x->length);
+  return zp;
+}
+
+int
+btc_cfilter_read(btc_cfilter_t *z, const uint8_t **xp, size_t *xn) {
+  if (!btc_uint8_read(&z->filter_type, xp, xn))
+    return 0;
+
+  if (!btc_zraw_read(&z->hash, 32, xp, xn))
+    return 0;
+
+  if (!btc_size_read(&z->length, xp, xn))
+    return 0;
+
+  if (!btc_zraw_read(&z->data, z->length, xp, xn))
+    return 0;
+
+  return 1;
+}
+
+/*
+ * Hash List
+ */
+
+static size_t
+btc_hashlist_size(const btc_vector_t *x) {
+  return btc_size_size(x->length) + 32 * x->length;
+}
+
+static uint8_t *
+btc_hashlist_write(uint8_t *zp, const btc_vector_t *x) {
+  size_t i;
+
+  zp = btc_size_write(zp, x->length);
+
+  for (i = 0; i < x->length; i++)
+    zp = btc_raw_write(zp, (const uint8_t *)x->items[i], 32);
+
+  return zp;
+}
+
+static int
+btc_hashlist_read(btc_vector_t *z, const uint8_t **xp, size_t *xn) {
+  size_t i, length;
+
+  if (!btc_size_read(&length, xp, xn))
+    return 0;
+
+  if (length > BTC_NET_MAX_INV)
+    return 0;
+
+  if (*xn < length * 32)
+    return 0;
+
+  btc_vector_resize(z, length);
+
+  for (i = 0; i < length; i++) {
+    z->items[i] = (void *)*xp;
+
+    *xp += 32;
+    *xn -= 32;
+  }
+
+  return 1;
+}
+
+/*
+ * CFHeaders
+ */
+
+DEFINE_SERIALIZABLE_OBJECT(btc_cfheaders, SCOPE_EXTERN)
+
+void
+btc_cfheaders_init(btc_cfheaders_t *msg) {
+  msg->filter_type = 0;
+  msg->stop = btc_hash_zero;
+  msg->prev = btc_hash_zero;
+  btc_vector_init(&msg->hashes);
+}
+
+void
+btc_cfheaders_clear(btc_cfheaders_t *msg) {
+  btc_vector_clear(&msg->hashes);
+}
+
+void
+btc_cfheaders_copy(btc_cfheaders_t *z, const btc_cfheaders_t *x) {
+  z->filter_type = x->filter_type;
+  z->stop = x->stop;
+  z->prev = x->prev;
+  btc_vector_copy(&z->hashes, &x->hashes);
+}
+
+size_t
+btc_cfheaders_size(const btc_cfheaders_t *x) {
+  return 65 + btc_hashlist_size(&x->hashes);
+}
+
+uint8_t *
+btc_cfheaders_write(uint8_t *zp, const btc_cfheaders_t *x) {
+  zp = btc_uint8_write(zp, x->filter_type);
+  zp = btc_raw_write(zp, x->stop, 32);
+  zp = btc_raw_write(zp, x->prev, 32);
+  zp = btc_hashlist_write(zp, &x->hashes);
+  return zp;
+}
+
+int
+btc_cfheaders_read(btc_cfheaders_t *z, const uint8_t **xp, size_t *xn) {
+  if (!btc_uint8_read(&z->filter_type, xp, xn))
+    return 0;
+
+  if (!btc_zraw_read(&z->stop, 32, xp, xn))
+    return 0;
+
+  if (!btc_zraw_read(&z->prev, 32, xp, xn))
+    return 0;
+
+  if (!btc_hashlist_read(&z->hashes, xp, xn))
+    return 0;
+
+  return 1;
+}
+
+/*
+ * GetCFCheckpt
+ */
+
+DEFINE_SERIALIZABLE_OBJECT(btc_getcfcheckpt, SCOPE_EXTERN)
+
+void
+btc_getcfcheckpt_init(btc_getcfcheckpt_t *msg) {
+  msg->filter_type = 0;
+  msg->stop = btc_hash_zero;
+}
+
+void
+btc_getcfcheckpt_clear(btc_getcfcheckpt_t *msg) {
+  (void)msg;
+}
+
+void
+btc_getcfcheckpt_copy(btc_getcfcheckpt_t *z, const btc_getcfcheckpt_t *x) {
+  *z = *x;
+}
+
+size_t
+btc_getcfcheckpt_size(const btc_getcfcheckpt_t *x) {
+  (void)x;
+  return 33;
+}
+
+uint8_t *
+btc_getcfcheckpt_write(uint8_t *zp, const btc_getcfcheckpt_t *x) {
+  zp = btc_uint8_write(zp, x->filter_type);
+  zp = btc_raw_write(zp, x->stop, 32);
+  return zp;
+}
+
+int
+btc_getcfcheckpt_read(btc_getcfcheckpt_t *z,
+                      const uint8_t **xp,
+                      size_t *xn) {
+  if (!btc_uint8_read(&z->filter_type, xp, xn))
+    return 0;
+
+  if (!btc_zraw_read(&z->stop, 32, xp, xn))
+    return 0;
+
+  return 1;
+}
+
+/*
+ * CFCheckpt
+ */
+
+DEFINE_SERIALIZABLE_OBJECT(btc_cfcheckpt, SCOPE_EXTERN)
+
+void
+btc_cfcheckpt_init(btc_cfcheckpt_t *msg) {
+  msg->filter_type = 0;
+  msg->stop = btc_hash_zero;
+  btc_vector_init(&msg->headers);
+}
+
+void
+btc_cfcheckpt_clear(btc_cfcheckpt_t *msg) {
+  btc_vector_clear(&msg->headers);
+}
+
+void
+btc_cfcheckpt_copy(btc_cfcheckpt_t *z, const btc_cfcheckpt_t *x) {
+  z->filter_type = x->filter_type;
+  z->stop = x->stop;
+  btc_vector_copy(&z->headers, &x->headers);
+}
+
+size_t
+btc_cfcheckpt_size(const btc_cfcheckpt_t *x) {
+  return 33 + btc_hashlist_size(&x->headers);
+}
+
+uint8_t *
+btc_cfcheckpt_write(uint8_t *zp, const btc_cfcheckpt_t *x) {
+  zp = btc_uint8_write(zp, x->filter_type);
+  zp = btc_raw_write(zp, x->stop, 32);
+  zp = btc_hashlist_write(zp, &x->headers);
+  return zp;
+}
+
+int
+btc_cfcheckpt_read(btc_cfcheckpt_t *z, const uint8_t **xp, size_t *xn) {
+  if (!btc_uint8_read(&z->filter_type, xp, xn))
+    return 0;
+
+  if (!btc_zraw_read(&z->stop, 32, xp, xn))
+    return 0;
+
+  if (!btc_hashlist_read(&z->headers, xp, xn))
+    return 0;
+
+  return 1;
+}
+
 /*
  * Unknown
  */
@@ -1021,6 +1338,22 @@ btc_msg_clear(btc_msg_t *msg) {
     case BTC_MSG_SENDCMPCT:
       btc_sendcmpct_destroy((btc_sendcmpct_t *)msg->body);
       break;
+    case BTC_MSG_GETCFILTERS:
+    case BTC_MSG_GETCFHEADERS:
+      btc_getcfilters_destroy((btc_getcfilters_t *)msg->body);
+      break;
+    case BTC_MSG_CFILTER:
+      btc_cfilter_destroy((btc_cfilter_t *)msg->body);
+      break;
+    case BTC_MSG_CFHEADERS:
+      btc_cfheaders_destroy((btc_cfheaders_t *)msg->body);
+      break;
+    case BTC_MSG_GETCFCHECKPT:
+      btc_getcfcheckpt_destroy((btc_getcfcheckpt_t *)msg->body);
+      break;
+    case BTC_MSG_CFCHECKPT:
+      btc_cfcheckpt_destroy((btc_cfcheckpt_t *)msg->body);
+      break;
     case BTC_MSG_CMPCTBLOCK:
     case BTC_MSG_CMPCTBLOCK_BASE:
       btc_cmpct_destroy((btc_cmpct_t *)msg->body);
@@ -1138,6 +1471,22 @@ btc_msg_alloc(btc_msg_t *msg) {
     case BTC_MSG_SENDCMPCT:
       msg->body = btc_sendcmpct_create();
       break;
+    case BTC_MSG_GETCFILTERS:
+    case BTC_MSG_GETCFHEADERS:
+      msg->body = btc_getcfilters_create();
+      break;
+    case BTC_MSG_CFILTER:
+      msg->body = btc_cfilter_create();
+      break;
+    case BTC_MSG_CFHEADERS:
+      msg->body = btc_cfheaders_create();
+      break;
+    case BTC_MSG_GETCFCHECKPT:
+      msg->body = btc_getcfcheckpt_create();
+      break;
+    case BTC_MSG_CFCHECKPT:
+      msg->body = btc_cfcheckpt_create();
+      break;
     case BTC_MSG_CMPCTBLOCK:
     case BTC_MSG_CMPCTBLOCK_BASE:
       msg->body = btc_cmpct_create();
@@ -1212,6 +1561,17 @@ btc_msg_size(const btc_msg_t *x) {
       return btc_feefilter_size((const btc_feefilter_t *)x->body);
     case BTC_MSG_SENDCMPCT:
       return btc_sendcmpct_size((const btc_sendcmpct_t *)x->body);
+    case BTC_MSG_GETCFILTERS:
+    case BTC_MSG_GETCFHEADERS:
+      return btc_getcfilters_size((const btc_getcfilters_t *)x->body);
+    case BTC_MSG_CFILTER:
+      return btc_cfilter_size((const btc_cfilter_t *)x->body);
+    case BTC_MSG_CFHEADERS:
+      return btc_cfheaders_size((const btc_cfheaders_t *)x->body);
+    case BTC_MSG_GETCFCHECKPT:
+      return btc_getcfcheckpt_size((const btc_getcfcheckpt_t *)x->body);
+    case BTC_MSG_CFCHECKPT:
+      return btc_cfcheckpt_size((const btc_cfcheckpt_t *)x->body);
     case BTC_MSG_CMPCTBLOCK:
       return btc_cmpct_size((const btc_cmpct_t *)x->body);
     case BTC_MSG_CMPCTBLOCK_BASE:
@@ -1283,6 +1643,17 @@ btc_msg_write(uint8_t *zp, const btc_msg_t *x) {
       return btc_feefilter_write(zp, (const btc_feefilter_t *)x->body);
     case BTC_MSG_SENDCMPCT:
       return btc_sendcmpct_write(zp, (const btc_sendcmpct_t *)x->body);
+    case BTC_MSG_GETCFILTERS:
+    case BTC_MSG_GETCFHEADERS:
+      return btc_getcfilters_write(zp, (const btc_getcfilters_t *)x->body);
+    case BTC_MSG_CFILTER:
+      return btc_cfilter_write(zp, (const btc_cfilter_t *)x->body);
+    case BTC_MSG_CFHEADERS:
+      return btc_cfheaders_write(zp, (const btc_cfheaders_t *)x->body);
+    case BTC_MSG_GETCFCHECKPT:
+      return btc_getcfcheckpt_write(zp, (const btc_getcfcheckpt_t *)x->body);
+    case BTC_MSG_CFCHECKPT:
+      return btc_cfcheckpt_write(zp, (const btc_cfcheckpt_t *)x->body);
     case BTC_MSG_CMPCTBLOCK:
       return btc_cmpct_write(zp, (const btc_cmpct_t *)x->body);
     case BTC_MSG_CMPCTBLOCK_BASE:
@@ -1352,6 +1723,17 @@ btc_msg_read(btc_msg_t *z, const uint8_t **xp, size_t *xn) {
       return btc_feefilter_read((btc_feefilter_t *)z->body, xp, xn);
     case BTC_MSG_SENDCMPCT:
       return btc_sendcmpct_read((btc_sendcmpct_t *)z->body, xp, xn);
+    case BTC_MSG_GETCFILTERS:
+    case BTC_MSG_GETCFHEADERS:
+      return btc_getcfilters_read((btc_getcfilters_t *)z->body, xp, xn);
+    case BTC_MSG_CFILTER:
+      return btc_cfilter_read((btc_cfilter_t *)z->body, xp, xn);
+    case BTC_MSG_CFHEADERS:
+      return btc_cfheaders_read((btc_cfheaders_t *)z->body, xp, xn);
+    case BTC_MSG_GETCFCHECKPT:
+      return btc_getcfcheckpt_read((btc_getcfcheckpt_t *)z->body, xp, xn);
+    case BTC_MSG_CFCHECKPT:
+      return btc_cfcheckpt_read((btc_cfcheckpt_t *)z->body, xp, xn);
     case BTC_MSG_CMPCTBLOCK:
     case BTC_MSG_CMPCTBLOCK_BASE:
       return btc_cmpct_read((btc_cmpct_t *)z->body, xp, xn);
@@ -41,6 +41,21 @@ btc_network_checkpoint(const btc_network_t *network, int32_t height) {
   return NULL;
 }
 
+const btc_assumeutxo_t *
+btc_network_assumeutxo(const btc_network_t *network, int32_t height) {
+  const btc_assumeutxo_t *item;
+  size_t i;
+
+  for (i = 0; i < network->assume_utxo.length; i++) {
+    item = &network->assume_utxo.items[i];
+
+    if (item->height == height)
+      return item;
+  }
+
+  return NULL;
+}
+
 const btc_checkpoint_t *
 btc_network_bip30(const btc_network_t *network, int32_t height) {
   const btc_checkpoint_t *chk;
@@ -0,0 +1,449 @@
+/*!
+ * addrindex.c - chaindb address index for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <mako/block.h>
+#include <mako/coins.h>
+#include <mako/entry.h>
+#include <mako/script.h>
+#include <mako/tx.h>
+#include <mako/util.h>
+
+#include <lcdb.h>
+
+#include "../bio.h"
+#include "../impl.h"
+#include "../internal.h"
+
+#include "addrindex.h"
+#include "chaindb_impl.h"
+#include "database.h"
+#include "indexer.h"
+
+/*
+ * Database Keys
+ */
+
+static size_t
+history_key(uint8_t *key,
+            const uint8_t *script_hash,
+            int32_t height,
+            const uint8_t *hash) {
+  key[0] = HISTORY_PREFIX;
+  memcpy(key + 1, script_hash, 32);
+  btc_write32be(key + 33, height);
+  memcpy(key + 37, hash, 32);
+  return HISTORY_KEYLEN;
+}
+
+static size_t
+unspent_key(uint8_t *key,
+            const uint8_t *script_hash,
+            const uint8_t *hash,
+            uint32_t index) {
+  key[0] = UNSPENT_PREFIX;
+  memcpy(key + 1, script_hash, 32);
+  memcpy(key + 33, hash, 32);
+  btc_write32be(key + 65, index);
+  return UNSPENT_KEYLEN;
+}
+
+/*
+ * Address Indexing
+ */
+
+static void
+btc_addrindex_fund(ldb_batch_t *batch,
+                   const uint8_t *hash,
+                   uint32_t index,
+                   const btc_output_t *output,
+                   int32_t height,
+                   int connect) {
+  uint8_t kbuf[HISTORY_KEYLEN];
+  ldb_slice_t key, val;
+  uint8_t sh[32];
+
+  if (btc_script_is_unspendable(&output->script))
+    return;
+
+  btc_script_sha256(sh, &output->script);
+
+  key.data = kbuf;
+  val.data = kbuf;
+  val.size = 0;
+
+  key.size = history_key(kbuf, sh, height, hash);
+
+  if (connect)
+    ldb_batch_put(batch, &key, &val);
+  else
+    ldb_batch_del(batch, &key);
+
+  key.size = unspent_key(kbuf, sh, hash, index);
+
+  if (connect)
+    ldb_batch_put(batch, &key, &val);
+  else
+    ldb_batch_del(batch, &key);
+}
+
+static void
+btc_addrindex_spend(ldb_batch_t *batch,
+                    const uint8_t *hash,
+                    const btc_outpoint_t *prevout,
+                    const btc_coin_t *coin,
+                    int32_t height,
+                    int connect) {
+  uint8_t kbuf[HISTORY_KEYLEN];
+  ldb_slice_t key, val;
+  uint8_t sh[32];
+
+  btc_script_sha256(sh, &coin->output.script);
+
+  key.data = kbuf;
+  val.data = kbuf;
+  val.size = 0;
+
+  key.size = history_key(kbuf, sh, height, hash);
+
+  if (connect)
+    ldb_batch_put(batch, &key, &val);
+  else
+    ldb_batch_del(batch, &key);
+
+  key.size = unspent_key(kbuf, sh, prevout->hash, prevout->index);
+
+  if (connect)
+    ldb_batch_del(batch, &key);
+  else
+    ldb_batch_put(batch, &key, &val);
+}
+
+void
+btc_chaindb_index_scripts(btc_chaindb_t *db,
+                          ldb_batch_t *batch,
+                          const btc_entry_t *entry,
+                          const btc_block_t *block,
+                          const btc_undo_t *undo) {
+  const btc_input_t *input;
+  const btc_tx_t *tx;
+  size_t i, j, k = 0;
+
+  for (i = 0; i < block->txs.length; i++) {
+    tx = block->txs.items[i];
+
+    if (i > 0) {
+      for (j = 0; j < tx->inputs.length; j++) {
+        input = tx->inputs.items[j];
+
+        CHECK(k < undo->length);
+
+        btc_addrindex_spend(batch, tx->hash, &input->prevout,
+                            undo->items[k++], entry->height, 1);
+      }
+    }
+
+    for (j = 0; j < tx->outputs.length; j++) {
+      btc_addrindex_fund(batch, tx->hash, j, tx->outputs.items[j],
+                         entry->height, 1);
+    }
+  }
+
+  CHECK(k == undo->length);
+
+  btc_indexer_connect(&db->addrindex, batch, entry);
+}
+
+void
+btc_chaindb_unindex_scripts(btc_chaindb_t *db,
+                            ldb_batch_t *batch,
+                            const btc_entry_t *entry,
+                            const btc_block_t *block,
+                            const btc_view_t *view) {
+  const btc_input_t *input;
+  const btc_coin_t *coin;
+  const btc_tx_t *tx;
+  size_t i, j;
+
+  /* Walk backwards so that coins created and spent
+     within the block do not reappear as unspent. */
+  for (i = block->txs.length - 1; i != (size_t)-1; i--) {
+    tx = block->txs.items[i];
+
+    for (j = 0; j < tx->outputs.length; j++) {
+      btc_addrindex_fund(batch, tx->hash, j, tx->outputs.items[j],
+                         entry->height, 0);
+    }
+
+    if (i > 0) {
+      for (j = 0; j < tx->inputs.length; j++) {
+        input = tx->inputs.items[j];
+        coin = btc_view_get(view, &input->prevout);
+
+        CHECK(coin != NULL);
+
+        btc_addrindex_spend(batch, tx->hash, &input->prevout,
+                            coin, entry->height, 0);
+      }
+    }
+  }
+
+  btc_indexer_disconnect(&db->addrindex, batch, entry);
+}
+
+int
+btc_addrindex_backfill(btc_indexer_t *ix,
+                       ldb_batch_t *batch,
+                       const btc_blockloc_t *blk) {
+  btc_chaindb_t *db = ix->db;
+  btc_undo_t *undo = NULL;
+  btc_rawblock_t block;
+  btc_rawinput_t input;
+  btc_output_t output;
+  size_t xn, in, size, len;
+  const uint8_t *xp, *ip;
+  uint8_t *data, *buf;
+  uint8_t hash[32];
+  size_t i, j, k = 0;
+  btc_rawtx_t tx;
+  int ret = 0;
+
+  if (!btc_chaindb_pread(db, &data, &size, BLOCK_FILE, blk->block_file,
+                                                       blk->block_pos)) {
+    return 0;
+  }
+
+  if (blk->undo_pos == -1) {
+    undo = btc_undo_create();
+  } else if (btc_chaindb_pread(db, &buf, &len, UNDO_FILE, blk->undo_file,
+                                                          blk->undo_pos)) {
+    undo = btc_chaindb_decode_undo(buf + 24, len - 24,
+                                   blk->undo_version, NULL);
+    free(buf);
+  }
+
+  if (undo == NULL)
+    goto fail;
+
+  if (!btc_rawblock_import(&block, data + 24, size - 24))
+    goto fail;
+
+  xp = block.txs.data;
+  xn = block.txs.size;
+
+  for (i = 0; i < block.txs.length; i++) {
+    CHECK(btc_rawtx_read(&tx, &xp, &xn));
+
+    btc_rawtx_txid(hash, &tx);
+
+    if (i > 0) {
+      ip = tx.inputs.data;
+      in = tx.inputs.size;
+
+      for (j = 0; j < tx.inputs.length; j++) {
+        CHECK(btc_rawinput_read(&input, &ip, &in));
+
+        if (k == undo->length)
+          goto fail;
+
+        btc_addrindex_spend(batch, hash, &input.prevout,
+                            undo->items[k++], blk->height, 1);
+      }
+    }
+
+    ip = tx.outputs.data;
+    in = tx.outputs.size;
+
+    for (j = 0; j < tx.outputs.length; j++) {
+      CHECK(btc_rawoutput_read(&output, &ip, &in));
+
+      btc_addrindex_fund(batch, hash, j, &output, blk->height, 1);
+    }
+  }
+
+  ret = (k == undo->length);
+fail:
+  if (undo != NULL)
+    btc_undo_destroy(undo);
+
+  free(data);
+
+  return ret;
+}
+
+/*
+ * Script Iterator
+ */
+
+struct btc_scriptiter_s {
+  btc_chaindb_t *db;
+  ldb_iter_t *it;
+  uint8_t min[HISTORY_KEYLEN];
+  uint8_t max[HISTORY_KEYLEN];
+  int unspent;
+  int started;
+  uint8_t hash[32];
+  uint32_t index;
+  int32_t height;
+  btc_coin_t *coin;
+};
+
+static btc_scriptiter_t *
+btc_scriptiter_create(btc_chaindb_t *db, int unspent) {
+  btc_scriptiter_t *iter;
+
+  iter = (btc_scriptiter_t *)btc_malloc(sizeof(btc_scriptiter_t));
+
+  memset(iter, 0, sizeof(*iter));
+
+  iter->db = db;
+  iter->it = ldb_iterator(db->lsm, 0);
+  iter->unspent = unspent;
+  iter->index = (uint32_t)-1;
+  iter->height = -1;
+
+  return iter;
+}
+
+void
+btc_scriptiter_destroy(btc_scriptiter_t *iter) {
+  if (iter->coin != NULL)
+    btc_coin_destroy(iter->coin);
+
+  ldb_iter_destroy(iter->it);
+
+  btc_free(iter);
+}
+
+int
+btc_scriptiter_next(btc_scriptiter_t *iter) {
+  ldb_slice_t min, max, key;
+  const uint8_t *kp;
+
+  min.data = iter->min;
+  min.size = HISTORY_KEYLEN;
+
+  max.data = iter->max;
+  max.size = HISTORY_KEYLEN;
+
+  for (;;) {
+    if (iter->started) {
+      ldb_iter_next(iter->it);
+    } else {
+      ldb_iter_seek(iter->it, &min);
+      iter->started = 1;
+    }
+
+    if (!ldb_iter_valid(iter->it))
+      return 0;
+
+    if (ldb_iter_compare(iter->it, &max) > 0)
+      return 0;
+
+    key = ldb_iter_key(iter->it);
+    kp = key.data;
+
+    if (key.size != HISTORY_KEYLEN)
+      continue;
+
+    if (!iter->unspent) {
+      iter->height = btc_read32be(kp + 33);
+      memcpy(iter->hash, kp + 37, 32);
+      return 1;
+    }
+
+    memcpy(iter->hash, kp + 33, 32);
+    iter->index = btc_read32be(kp + 65);
+
+    if (iter->coin != NULL)
+      btc_coin_destroy(iter->coin);
+
+    iter->coin = btc_chaindb_coin(iter->db, iter->hash, iter->index);
+
+    /* The backfill may record outputs which were
+       already spent by the time it reached them. */
+    if (iter->coin == NULL)
+      continue;
+
+    iter->height = iter->coin->height;
+
+    return 1;
+  }
+}
+
+const uint8_t *
+btc_scriptiter_hash(const btc_scriptiter_t *iter) {
+  return iter->hash;
+}
+
+uint32_t
+btc_scriptiter_index(const btc_scriptiter_t *iter) {
+  return iter->index;
+}
+
+int32_t
+btc_scriptiter_height(const btc_scriptiter_t *iter) {
+  return iter->height;
+}
+
+const btc_coin_t *
+btc_scriptiter_coin(const btc_scriptiter_t *iter) {
+  return iter->coin;
+}
+
+btc_scriptiter_t *
+btc_chaindb_history(btc_chaindb_t *db,
+                    const btc_script_t *script,
+                    int32_t start,
+                    int32_t end) {
+  static const uint8_t zero[32] = {0};
+  btc_scriptiter_t *iter;
+  uint8_t ones[32];
+  uint8_t sh[32];
+
+  if (!(db->flags & BTC_CHAIN_ADDRINDEX))
+    return NULL;
+
+  if (start < 0 || end < start)
+    return NULL;
+
+  memset(ones, 0xff, 32);
+
+  btc_script_sha256(sh, script);
+
+  iter = btc_scriptiter_create(db, 0);
+
+  history_key(iter->min, sh, start, zero);
+  history_key(iter->max, sh, end, ones);
+
+  return iter;
+}
+
+btc_scriptiter_t *
+btc_chaindb_unspent(btc_chaindb_t *db, const btc_script_t *script) {
+  static const uint8_t zero[32] = {0};
+  btc_scriptiter_t *iter;
+  uint8_t ones[32];
+  uint8_t sh[32];
+
+  if (!(db->flags & BTC_CHAIN_ADDRINDEX))
+    return NULL;
+
+  memset(ones, 0xff, 32);
+
+  btc_script_sha256(sh, script);
+
+  iter = btc_scriptiter_create(db, 1);
+
+  unspent_key(iter->min, sh, zero, 0);
+  unspent_key(iter->max, sh, ones, (uint32_t)-1);
+
+  return iter;
+}
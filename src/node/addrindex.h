@@ -0,0 +1,36 @@
+/*!
+ * addrindex.h - chaindb address index for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#ifndef BTC_NODE_ADDRINDEX_H_
+#define BTC_NODE_ADDRINDEX_H_
+
+#include <lcdb.h>
+#include "chaindb_impl.h"
+
+/*
+ * Address Indexing
+ */
+
+void
+btc_chaindb_index_scripts(btc_chaindb_t *db,
+                          ldb_batch_t *batch,
+                          const btc_entry_t *entry,
+                          const btc_block_t *block,
+                          const btc_undo_t *undo);
+
+void
+btc_chaindb_unindex_scripts(btc_chaindb_t *db,
+                            ldb_batch_t *batch,
+                            const btc_entry_t *entry,
+                            const btc_block_t *block,
+                            const btc_view_t *view);
+
+int
+btc_addrindex_backfill(btc_indexer_t *ix,
+                       ldb_batch_t *batch,
+                       const btc_blockloc_t *loc);
+
+#endif /* BTC_NODE_ADDRINDEX_H_ */
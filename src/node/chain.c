@@ -15,14 +15,18 @@
 #include <node/chain.h>
 #include <node/chaindb.h>
 #include <base/logger.h>
+#include <base/sigcache.h>
 #include <base/timedata.h>
 
 #include <mako/block.h>
+#include <mako/buffer.h>
 #include <mako/coins.h>
 #include <mako/consensus.h>
 #include <mako/crypto/hash.h>
+#include <mako/encoding.h>
 #include <mako/entry.h>
 #include <mako/header.h>
+#include <mako/keycache.h>
 #include <mako/list.h>
 #include <mako/map.h>
 #include <mako/mpi.h>
@@ -85,25 +89,47 @@ btc_orphan_copy(btc_orphan_t *z, const btc_orphan_t *x) {
  * TX Checker
  */
 
+/* Inputs per work unit. Small enough that one large
+   transaction spreads across every thread, large enough
+   that the pool's locking overhead stays negligible. */
+#ifndef BTC_CHECKER_CHUNK
+#define BTC_CHECKER_CHUNK 8
+#endif
+
+struct btc_txjob_s;
+
 typedef struct btc_txwork_s {
-  const btc_tx_t *tx;
-  const btc_view_t *view;
-  unsigned int flags;
+  const struct btc_txjob_s *job;
+  size_t start;
+  size_t end;
   int result;
-  struct btc_txwork_s *next;
 } btc_txwork_t;
 
+typedef struct btc_txjob_s {
+  const btc_tx_t *tx;
+  const btc_coin_t **coins;
+  btc_tx_cache_t cache;
+  unsigned int flags;
+  btc_txwork_t *units;
+  size_t length;
+  struct btc_txjob_s *next;
+} btc_txjob_t;
+
 typedef struct btc_checker_s {
   btc_workers_t *pool;
-  btc_txwork_t *head;
-  btc_txwork_t *tail;
+  btc_keycache_t *keys;
+  btc_txjob_t *head;
+  btc_txjob_t *tail;
   btc_workq_t batch;
   size_t length;
 } btc_checker_t;
 
 static void
-btc_checker_init(btc_checker_t *checker, btc_workers_t *pool) {
+btc_checker_init(btc_checker_t *checker,
+                 btc_workers_t *pool,
+                 btc_keycache_t *keys) {
   checker->pool = pool;
+  checker->keys = keys;
   btc_queue_init(checker);
   btc_workq_init(&checker->batch);
 }
@@ -111,8 +137,21 @@ btc_checker_init(btc_checker_t *checker, btc_workers_t *pool) {
 static void
 btc_checker_work(void *arg) {
   btc_txwork_t *work = arg;
+  const btc_txjob_t *job = work->job;
+  btc_tx_cache_t *cache = (btc_tx_cache_t *)&job->cache;
+  size_t i;
+
+  work->result = 1;
 
-  work->result = btc_tx_verify(work->tx, work->view, work->flags);
+  /* The cache was filled up front and is only read here. */
+  for (i = work->start; i < work->end; i++) {
+    const btc_coin_t *coin = job->coins[i];
+
+    if (!btc_tx_verify_input(job->tx, i, &coin->output, job->flags, cache)) {
+      work->result = 0;
+      break;
+    }
+  }
 }
 
 static void
@@ -120,37 +159,138 @@ btc_checker_push(btc_checker_t *checker,
                  const btc_tx_t *tx,
                  const btc_view_t *view,
                  unsigned int flags) {
-  btc_txwork_t *work = btc_malloc(sizeof(btc_txwork_t));
+  btc_txjob_t *job = btc_malloc(sizeof(btc_txjob_t));
+  size_t length = tx->inputs.length;
+  size_t start = view->undo.length - length;
+  size_t i;
+
+  /* The view keeps changing underneath the workers,
+     so hand them the coins we just spent instead. The
+     coins themselves are not mutated after spending. */
+  job->tx = tx;
+  job->coins = btc_malloc(length * sizeof(btc_coin_t *));
+  job->flags = flags;
+  job->length = (length + BTC_CHECKER_CHUNK - 1) / BTC_CHECKER_CHUNK;
+  job->units = btc_malloc(job->length * sizeof(btc_txwork_t));
+  job->next = NULL;
 
-  work->tx = tx;
-  work->view = view;
-  work->flags = flags;
-  work->result = 0;
-  work->next = NULL;
+  for (i = 0; i < length; i++)
+    job->coins[i] = view->undo.items[start + i];
 
-  btc_queue_push(checker, work);
-  btc_workq_push(&checker->batch, btc_checker_work, work);
+  btc_tx_precompute(tx, &job->cache);
+
+  job->cache.keys = checker->keys;
+
+  btc_queue_push(checker, job);
+
+  for (i = 0; i < job->length; i++) {
+    btc_txwork_t *work = &job->units[i];
+
+    work->job = job;
+    work->start = i * BTC_CHECKER_CHUNK;
+    work->end = work->start + BTC_CHECKER_CHUNK;
+    work->result = 0;
+
+    if (work->end > length)
+      work->end = length;
+
+    btc_workq_push(&checker->batch, btc_checker_work, work);
+  }
+
+  btc_workers_batch(checker->pool, &checker->batch);
 }
 
 static int
 btc_checker_verify(btc_checker_t *checker) {
-  btc_txwork_t *work, *next;
+  btc_txjob_t *job, *next;
   int ret = 1;
+  size_t i;
 
-  btc_workers_batch(checker->pool, &checker->batch);
   btc_workers_wait(checker->pool);
 
-  for (work = checker->head; work != NULL; work = next) {
-    next = work->next;
-    ret &= work->result;
-    btc_free(work);
+  for (job = checker->head; job != NULL; job = next) {
+    next = job->next;
+
+    for (i = 0; i < job->length; i++)
+      ret &= job->units[i].result;
+
+    btc_tx_cache_clear(&job->cache);
+    btc_free(job->units);
+    btc_free(job->coins);
+    btc_free(job);
   }
 
   btc_queue_init(checker);
+  btc_workq_clear(&checker->batch);
 
   return ret;
 }
 
+/*
+ * TX Hasher
+ */
+
+/* Transactions per work unit. Blocks with fewer
+   than two units are cheaper to hash inline. */
+#ifndef BTC_HASHER_CHUNK
+#define BTC_HASHER_CHUNK 32
+#endif
+
+typedef struct btc_hashwork_s {
+  btc_tx_t **txs;
+  const btc_rawtx_t *raw;
+  size_t length;
+} btc_hashwork_t;
+
+static void
+btc_hasher_work(void *arg) {
+  btc_hashwork_t *work = arg;
+  size_t i;
+
+  for (i = 0; i < work->length; i++)
+    btc_rawtx_refresh(work->txs[i], &work->raw[i]);
+}
+
+static void
+btc_hasher_run(btc_workers_t *pool,
+               btc_block_t *block,
+               const btc_rawtx_t *raw) {
+  size_t length = block->txs.length;
+  size_t i, total;
+  btc_hashwork_t *units;
+  btc_workq_t batch;
+
+  total = (length + BTC_HASHER_CHUNK - 1) / BTC_HASHER_CHUNK;
+
+  if (pool == NULL || total < 2) {
+    for (i = 0; i < length; i++)
+      btc_rawtx_refresh(block->txs.items[i], &raw[i]);
+
+    return;
+  }
+
+  units = btc_malloc(total * sizeof(btc_hashwork_t));
+
+  btc_workq_init(&batch);
+
+  for (i = 0; i < total; i++) {
+    btc_hashwork_t *work = &units[i];
+    size_t start = i * BTC_HASHER_CHUNK;
+
+    work->txs = &block->txs.items[start];
+    work->raw = &raw[start];
+    work->length = BTC_MIN(length - start, BTC_HASHER_CHUNK);
+
+    btc_workq_push(&batch, btc_hasher_work, work);
+  }
+
+  btc_workers_batch(pool, &batch);
+  btc_workers_wait(pool);
+
+  btc_workq_clear(&batch);
+  btc_free(units);
+}
+
 /*
  * State Cache
  */
@@ -218,11 +358,20 @@ struct btc_chain_s {
   btc_logger_t *logger;
   btc_chaindb_t *db;
   const btc_timedata_t *timedata;
+  btc_sigcache_t *sigcache;
+  btc_keycache_t *keys;
   btc_workers_t *workers;
   btc_hashset_t invalid;
   btc_hashmap_t orphan_map;
   btc_hashmap_t orphan_prev;
   btc_statecache_t cache;
+  uint8_t assume_valid[32];
+  int assuming;
+  btc_buffer_t headers;
+  int32_t header_height;
+  int32_t assume_height;
+  char snapshot[BTC_PATH_MAX];
+  uint8_t snapshot_hash[32];
   btc_entry_t *tip;
   int32_t height;
   mpz_t limit;
@@ -251,10 +400,13 @@ btc_chain_create(const btc_network_t *network) {
   chain->logger = NULL;
   chain->db = btc_chaindb_create(network);
   chain->timedata = NULL;
+  chain->sigcache = NULL;
+  chain->keys = btc_keycache_create(BTC_KEYCACHE_SIZE);
   btc_hashset_init(&chain->invalid);
   btc_hashmap_init(&chain->orphan_map);
   btc_hashmap_init(&chain->orphan_prev);
   btc_statecache_init(&chain->cache, network);
+  btc_buffer_init(&chain->headers);
   chain->tip = NULL;
   chain->height = -1;
 
@@ -264,6 +416,7 @@ btc_chain_create(const btc_network_t *network) {
 
   chain->flags = BTC_CHAIN_DEFAULT_FLAGS;
 
+  btc_chain_set_assume_valid(chain, network->assume_valid.hash);
   btc_chain_set_threads(chain, 0);
 
   return chain;
@@ -283,6 +436,8 @@ btc_chain_destroy(btc_chain_t *chain) {
   btc_hashmap_clear(&chain->orphan_map);
   btc_hashmap_clear(&chain->orphan_prev);
   btc_statecache_clear(&chain->cache);
+  btc_buffer_clear(&chain->headers);
+  btc_keycache_destroy(chain->keys);
 
   btc_chaindb_destroy(chain->db);
 
@@ -301,6 +456,11 @@ btc_chain_set_timedata(btc_chain_t *chain, const btc_timedata_t *td) {
   chain->timedata = td;
 }
 
+void
+btc_chain_set_sigcache(btc_chain_t *chain, btc_sigcache_t *cache) {
+  chain->sigcache = cache;
+}
+
 void
 btc_chain_set_threads(btc_chain_t *chain, int threads) {
   if (threads <= 0) {
@@ -325,6 +485,40 @@ btc_chain_set_cache(btc_chain_t *chain, size_t cache_size) {
   btc_chaindb_set_cache(chain->db, cache_size);
 }
 
+void
+btc_chain_set_prune(btc_chain_t *chain, uint64_t target) {
+  btc_chaindb_set_prune(chain->db, target);
+}
+
+static void
+btc_chain_reset_headers(btc_chain_t *chain, int32_t height) {
+  btc_buffer_reset(&chain->headers);
+
+  chain->header_height = height;
+  chain->assume_height = -1;
+}
+
+void
+btc_chain_set_assume_valid(btc_chain_t *chain, const uint8_t *hash) {
+  btc_hash_copy(chain->assume_valid, hash);
+
+  chain->assuming = !btc_hash_is_null(hash);
+
+  btc_chain_reset_headers(chain, 0);
+}
+
+void
+btc_chain_set_snapshot(btc_chain_t *chain,
+                       const char *path,
+                       const uint8_t *muhash) {
+  CHECK(btc_strcpy(chain->snapshot, sizeof(chain->snapshot), path));
+
+  if (muhash != NULL)
+    btc_hash_copy(chain->snapshot_hash, muhash);
+  else
+    btc_hash_init(chain->snapshot_hash);
+}
+
 void
 btc_chain_on_block(btc_chain_t *chain, btc_chain_block_cb *handler) {
   chain->on_block = handler;
@@ -392,15 +586,74 @@ btc_chain_maybe_sync(btc_chain_t *chain) {
   chain->synced = 1;
 }
 
+static int
+btc_chain_load_snapshot(btc_chain_t *chain) {
+  const btc_entry_t *tip = btc_chaindb_tail(chain->db);
+  const uint8_t *muhash = NULL;
+  char str[64 + 1];
+  uint8_t hash[32];
+
+  if (tip->height != 0) {
+    btc_log_warn(chain, "Ignoring UTXO snapshot (chain height is %d).",
+                        tip->height);
+    return 1;
+  }
+
+  btc_log_info(chain, "Loading UTXO snapshot from %s.", chain->snapshot);
+
+  /* Without a MuHash, defer to the network's known snapshots. */
+  if (!btc_hash_is_null(chain->snapshot_hash))
+    muhash = chain->snapshot_hash;
+
+  if (!btc_chaindb_import(chain->db, chain->snapshot, muhash, hash)) {
+    btc_log_error(chain, "Could not load UTXO snapshot: %s.",
+                         chain->snapshot);
+    return 0;
+  }
+
+  tip = btc_chaindb_tail(chain->db);
+
+  btc_base16_encode(str, hash, 32);
+
+  btc_log_info(chain, "Loaded UTXO snapshot at %H (%d).",
+                      tip->hash, tip->height);
+
+  btc_log_info(chain, "Snapshot commitment: %s.", str);
+
+  return 1;
+}
+
 int
 btc_chain_open(btc_chain_t *chain, const char *prefix, unsigned int flags) {
   btc_log_info(chain, "Chain is loading.");
 
   chain->flags = flags;
 
+  if ((flags & BTC_CHAIN_PRUNE) && (flags & BTC_CHAIN_TXINDEX)) {
+    btc_log_error(chain, "Prune mode is incompatible with -txindex.");
+    return 0;
+  }
+
+  if ((flags & BTC_CHAIN_PRUNE) && (flags & BTC_CHAIN_ADDRINDEX)) {
+    btc_log_error(chain, "Prune mode is incompatible with -addrindex.");
+    return 0;
+  }
+
+  if ((flags & BTC_CHAIN_PRUNE) && (flags & BTC_CHAIN_FILTERINDEX)) {
+    btc_log_error(chain, "Prune mode is incompatible with -blockfilterindex.");
+    return 0;
+  }
+
   if (!btc_chaindb_open(chain->db, prefix, flags))
     return 0;
 
+  if (chain->snapshot[0] != '\0') {
+    if (!btc_chain_load_snapshot(chain)) {
+      btc_chaindb_close(chain->db);
+      return 0;
+    }
+  }
+
 #if defined(_WIN32) || defined(BTC_PTHREAD)
   if (chain->threads > 0)
     chain->workers = btc_workers_create(chain->threads, 128);
@@ -410,11 +663,27 @@ btc_chain_open(btc_chain_t *chain, const char *prefix, unsigned int flags) {
   chain->height = chain->tip->height;
   chain->synced = 0;
 
+  /* Nothing re-executes the blocks below a snapshot
+     yet. That range is neither served nor pruned. */
+  if (btc_chaindb_unvalidated(chain->db) >= 0) {
+    btc_log_warn(chain, "History below height %d is not validated.",
+                        btc_chaindb_unvalidated(chain->db));
+  }
+
   btc_chain_get_deployment_state(chain, &chain->state);
 
   if (chain->flags & BTC_CHAIN_CHECKPOINTS)
     btc_log_info(chain, "Checkpoints are enabled.");
 
+  if (chain->flags & BTC_CHAIN_TXINDEX)
+    btc_log_info(chain, "Transaction index is enabled.");
+
+  if (chain->flags & BTC_CHAIN_ADDRINDEX)
+    btc_log_info(chain, "Address index is enabled.");
+
+  if (chain->flags & BTC_CHAIN_FILTERINDEX)
+    btc_log_info(chain, "Block filter index is enabled.");
+
   btc_log_info(chain, "Chain Height: %d", chain->height);
 
   btc_chain_maybe_sync(chain);
@@ -620,6 +889,55 @@ btc_chain_last_checkpoint(btc_chain_t *chain) {
   return NULL;
 }
 
+static int
+btc_chain_is_assumed(btc_chain_t *chain,
+                     const btc_block_t *block,
+                     const btc_entry_t *prev) {
+  int32_t height = prev->height + 1;
+  const btc_entry_t *assumed, *entry;
+  uint8_t hash[32];
+  int64_t now;
+
+  if (!chain->assuming)
+    return 0;
+
+  btc_header_hash(hash, &block->header);
+
+  /* Only trust the assumevalid block once it is in
+     our index or at the end of our header chain, and
+     only for its own ancestors. An unknown hash or one
+     on another fork trusts nothing. */
+  assumed = btc_chain_by_hash(chain, chain->assume_valid);
+
+  if (assumed != NULL) {
+    if (height > assumed->height)
+      return 0;
+
+    entry = btc_entry_ancestor(assumed, height);
+
+    if (entry == NULL || !btc_hash_equal(entry->hash, hash))
+      return 0;
+  } else {
+    const uint8_t *data = chain->headers.data;
+
+    if (height > chain->assume_height || height < chain->header_height)
+      return 0;
+
+    data += (size_t)(height - chain->header_height) * 32;
+
+    if (!btc_hash_equal(data, hash))
+      return 0;
+  }
+
+  /* Only trust blocks buried well in the past. */
+  now = btc_timedata_now(chain->timedata);
+
+  if ((int64_t)block->header.time > now - 14 * 24 * 60 * 60)
+    return 0;
+
+  return 1;
+}
+
 static int
 btc_chain_is_historical(btc_chain_t *chain, const btc_entry_t *prev) {
   if (chain->flags & BTC_CHAIN_CHECKPOINTS) {
@@ -642,10 +960,7 @@ btc_chain_get_ancestor(btc_chain_t *chain,
   if (btc_chaindb_is_main(chain->db, entry))
     return btc_chaindb_by_height(chain->db, height);
 
-  while (entry->height != height)
-    entry = entry->prev;
-
-  return entry;
+  return btc_entry_ancestor(entry, height);
 }
 
 static uint32_t
@@ -1375,20 +1690,63 @@ btc_chain_verify_locks(btc_chain_t *chain,
   return 1;
 }
 
+static int
+btc_chain_is_verified(btc_chain_t *chain,
+                      const btc_tx_t *tx,
+                      unsigned int flags) {
+  /* Already verified by the mempool? */
+  if (chain->sigcache == NULL)
+    return 0;
+
+  return btc_sigcache_take(chain->sigcache, tx, flags);
+}
+
+static int
+btc_chain_verify_scripts(btc_chain_t *chain,
+                         const btc_tx_t *tx,
+                         const btc_view_t *view,
+                         unsigned int flags) {
+  btc_tx_cache_t cache;
+  int ret = 1;
+  size_t i;
+
+  btc_tx_precompute(tx, &cache);
+
+  cache.keys = chain->keys;
+
+  for (i = 0; i < tx->inputs.length && ret; i++) {
+    const btc_input_t *input = tx->inputs.items[i];
+    const btc_coin_t *coin = btc_view_get(view, &input->prevout);
+
+    if (coin == NULL)
+      ret = 0;
+    else
+      ret = btc_tx_verify_input(tx, i, &coin->output, flags, &cache);
+  }
+
+  btc_tx_cache_clear(&cache);
+
+  return ret;
+}
+
 static btc_view_t *
 btc_chain_verify_inputs(btc_chain_t *chain,
                         const btc_block_t *block,
                         const btc_entry_t *prev,
-                        const btc_deployment_state_t *state) {
+                        const btc_deployment_state_t *state,
+                        int scripts) {
   const btc_header_t *hdr = &block->header;
   int32_t interval = chain->network->halving_interval;
   btc_view_t *view = btc_view_create();
   int32_t height = prev->height + 1;
   btc_verify_error_t err;
+  btc_checker_t checker;
   int64_t reward = 0;
   int sigops = 0;
   size_t i;
 
+  btc_checker_init(&checker, chain->workers, chain->keys);
+
   /* Check all transactions. */
   for (i = 0; i < block->txs.length; i++) {
     const btc_tx_t *tx = block->txs.items[i];
@@ -1403,6 +1761,12 @@ btc_chain_verify_inputs(btc_chain_t *chain,
                         0);
         goto fail;
       }
+
+      /* Start verifying scripts while we continue. */
+      if (scripts && chain->workers != NULL) {
+        if (!btc_chain_is_verified(chain, tx, state->flags))
+          btc_checker_push(&checker, tx, view, state->flags);
+      }
     }
 
     /* Verify sequence locks. */
@@ -1469,18 +1833,13 @@ btc_chain_verify_inputs(btc_chain_t *chain,
     goto fail;
   }
 
-  if (chain->workers != NULL) {
-    btc_checker_t checker;
-
-    /* Verify all transactions in parallel. */
-    btc_checker_init(&checker, chain->workers);
-
-    for (i = 1; i < block->txs.length; i++) {
-      const btc_tx_t *tx = block->txs.items[i];
-
-      btc_checker_push(&checker, tx, view, state->flags);
-    }
+  if (!scripts) {
+    /* Below the assumevalid block. */
+    return view;
+  }
 
+  if (chain->workers != NULL) {
+    /* Wait for the scripts dispatched above. */
     if (!btc_checker_verify(&checker)) {
       btc_chain_throw(chain, hdr,
                       BTC_REJECT_INVALID,
@@ -1494,7 +1853,10 @@ btc_chain_verify_inputs(btc_chain_t *chain,
     for (i = 1; i < block->txs.length; i++) {
       const btc_tx_t *tx = block->txs.items[i];
 
-      if (!btc_tx_verify(tx, view, state->flags)) {
+      if (btc_chain_is_verified(chain, tx, state->flags))
+        continue;
+
+      if (!btc_chain_verify_scripts(chain, tx, view, state->flags)) {
         btc_chain_throw(chain, hdr,
                         BTC_REJECT_INVALID,
                         "mandatory-script-verify-flag-failed",
@@ -1507,6 +1869,10 @@ btc_chain_verify_inputs(btc_chain_t *chain,
 
   return view;
 fail:
+  /* Workers may still hold our coins. */
+  if (chain->workers != NULL)
+    btc_checker_verify(&checker);
+
   btc_view_destroy(view);
   return NULL;
 }
@@ -1520,6 +1886,11 @@ btc_chain_verify_context(btc_chain_t *chain,
   if (!btc_chain_verify(chain, state, block, prev))
     return NULL;
 
+  /* Pull the block's prevouts into the coin cache in
+     parallel so the serial passes below only hit memory. */
+  if (chain->workers != NULL)
+    btc_chaindb_prefetch(chain->db, block, chain->workers);
+
   /* Skip everything if we're using checkpoints. */
   if (btc_chain_is_historical(chain, prev))
     return btc_chain_update_inputs(chain, block, prev);
@@ -1532,8 +1903,11 @@ btc_chain_verify_context(btc_chain_t *chain,
       return NULL;
   }
 
-  /* Verify scripts, spend and add coins. */
-  return btc_chain_verify_inputs(chain, block, prev, state);
+  /* Verify scripts, spend and add coins. Below the
+     assumevalid block, scripts are skipped but all
+     other input checks still apply. */
+  return btc_chain_verify_inputs(chain, block, prev, state,
+                                 !btc_chain_is_assumed(chain, block, prev));
 }
 
 static int
@@ -1805,7 +2179,7 @@ btc_chain_connect(btc_chain_t *chain,
                   const btc_block_t *block) {
   const btc_network_t *network = chain->network;
   const btc_header_t *hdr = &block->header;
-  btc_entry_t *entry = btc_entry_create();
+  btc_entry_t *entry = btc_chaindb_entry_create(chain->db);
   int64_t now = btc_time_usec();
   size_t rss;
 
@@ -1821,13 +2195,13 @@ btc_chain_connect(btc_chain_t *chain,
   if (btc_hash_compare(entry->chainwork, chain->tip->chainwork) <= 0) {
     /* Save block to an alternate chain. */
     if (!btc_chain_save_alternate(chain, entry, block)) {
-      btc_entry_destroy(entry);
+      btc_chaindb_entry_destroy(chain->db, entry);
       return NULL;
     }
   } else {
     /* Attempt to add block to the chain index. */
     if (!btc_chain_set_best_chain(chain, entry, block)) {
-      btc_entry_destroy(entry);
+      btc_chaindb_entry_destroy(chain->db, entry);
       return NULL;
     }
   }
@@ -1874,6 +2248,48 @@ btc_chain_handle_orphans(btc_chain_t *chain, const btc_entry_t *entry) {
   }
 }
 
+int
+btc_chain_read_block(btc_chain_t *chain,
+                     btc_block_t *block,
+                     const uint8_t *xp,
+                     size_t xn) {
+  btc_rawblock_t view;
+  btc_rawtx_t *raw;
+  const uint8_t *tp;
+  size_t i, tn;
+
+  /* Decode first, leaving the txids for later. The
+     merkle root check consumes them in one go, so we
+     hash every transaction at once on the workers. */
+  if (!btc_block_import_deferred(block, xp, xn))
+    return 0;
+
+  if (!btc_rawblock_import(&view, xp, xn))
+    return 0;
+
+  if (view.txs.length != block->txs.length)
+    return 0;
+
+  raw = btc_malloc(BTC_MAX(view.txs.length, 1) * sizeof(btc_rawtx_t));
+
+  tp = view.txs.data;
+  tn = view.txs.size;
+
+  /* The bytes come from a peer. Never assert on them. */
+  for (i = 0; i < view.txs.length; i++) {
+    if (!btc_rawtx_read(&raw[i], &tp, &tn)) {
+      btc_free(raw);
+      return 0;
+    }
+  }
+
+  btc_hasher_run(chain->workers, block, raw);
+
+  btc_free(raw);
+
+  return 1;
+}
+
 int
 btc_chain_add(btc_chain_t *chain,
               const btc_block_t *block,
@@ -1983,6 +2399,80 @@ btc_chain_add(btc_chain_t *chain,
   return 1;
 }
 
+void
+btc_chain_add_header(btc_chain_t *chain, const btc_header_t *hdr) {
+  btc_buffer_t *headers = &chain->headers;
+  const btc_entry_t *prev;
+  int32_t height;
+  uint8_t *last;
+  size_t size;
+
+  if (!chain->assuming)
+    return;
+
+  if (btc_chain_by_hash(chain, chain->assume_valid) != NULL) {
+    btc_buffer_clear(headers);
+    return;
+  }
+
+  /* Only keep a chain of hashes leading to the
+     assumevalid block. It is linked by hash, so
+     reaching that block proves every header in
+     it is an ancestor. */
+  prev = btc_chain_by_hash(chain, hdr->prev_block);
+
+  if (prev != NULL) {
+    btc_chain_reset_headers(chain, prev->height + 1);
+  } else {
+    if (headers->length == 0 || chain->assume_height >= 0)
+      return;
+
+    last = headers->data + headers->length - 32;
+
+    if (!btc_hash_equal(hdr->prev_block, last))
+      return;
+  }
+
+  height = chain->header_height + (int32_t)(headers->length / 32);
+  size = headers->length + 32;
+
+  if (size > headers->alloc)
+    btc_buffer_grow(headers, size < 4096 ? 4096 : size * 2);
+
+  btc_header_hash(headers->data + headers->length, hdr);
+
+  headers->length = size;
+
+  if (btc_hash_equal(headers->data + size - 32, chain->assume_valid)) {
+    btc_log_info(chain, "Found assumevalid header %H (%d).",
+                        chain->assume_valid, height);
+
+    chain->assume_height = height;
+  }
+}
+
+int
+btc_chain_get_assumed(btc_chain_t *chain, uint8_t *hash, int32_t *height) {
+  const btc_network_t *network = chain->network;
+
+  if (!chain->assuming)
+    return 0;
+
+  if (btc_chain_by_hash(chain, chain->assume_valid) != NULL)
+    return 0;
+
+  btc_hash_copy(hash, chain->assume_valid);
+
+  if (chain->assume_height >= 0)
+    *height = chain->assume_height;
+  else if (btc_hash_equal(hash, network->assume_valid.hash))
+    *height = network->assume_valid.height;
+  else
+    *height = -1;
+
+  return 1;
+}
+
 const btc_entry_t *
 btc_chain_tip(btc_chain_t *chain) {
   return chain->tip;
@@ -1993,6 +2483,11 @@ btc_chain_height(btc_chain_t *chain) {
   return chain->height;
 }
 
+const btc_coinstats_t *
+btc_chain_coinstats(btc_chain_t *chain) {
+  return btc_chaindb_coinstats(chain->db);
+}
+
 const btc_deployment_state_t *
 btc_chain_state(btc_chain_t *chain) {
   return &chain->state;
@@ -2037,6 +2532,11 @@ btc_chain_pruned(btc_chain_t *chain) {
   return (chain->flags & BTC_CHAIN_PRUNE) != 0;
 }
 
+int32_t
+btc_chain_unvalidated(btc_chain_t *chain) {
+  return btc_chaindb_unvalidated(chain->db);
+}
+
 int
 btc_chain_has_hash(btc_chain_t *chain, const uint8_t *hash) {
   return btc_chaindb_by_hash(chain->db, hash) != NULL;
@@ -2087,6 +2587,14 @@ btc_chain_get_raw_block(btc_chain_t *chain,
   return btc_chaindb_get_raw_block(chain->db, data, length, entry);
 }
 
+int
+btc_chain_get_block_data(btc_chain_t *chain,
+                         uint8_t **data,
+                         size_t *length,
+                         const btc_entry_t *entry) {
+  return btc_chaindb_get_block_data(chain->db, data, length, entry);
+}
+
 btc_view_t *
 btc_chain_get_undo(btc_chain_t *chain,
                    const btc_entry_t *entry,
@@ -2094,6 +2602,57 @@ btc_chain_get_undo(btc_chain_t *chain,
   return btc_chaindb_get_undo(chain->db, entry, block);
 }
 
+int
+btc_chain_get_tx(btc_chain_t *chain,
+                 btc_tx_t **result,
+                 const btc_entry_t **block,
+                 const uint8_t *hash) {
+  return btc_chaindb_get_tx(chain->db, result, block, hash);
+}
+
+btc_scriptiter_t *
+btc_chain_history(btc_chain_t *chain,
+                  const btc_script_t *script,
+                  int32_t start,
+                  int32_t end) {
+  return btc_chaindb_history(chain->db, script, start, end);
+}
+
+btc_scriptiter_t *
+btc_chain_unspent(btc_chain_t *chain, const btc_script_t *script) {
+  return btc_chaindb_unspent(chain->db, script);
+}
+
+int
+btc_chain_get_filter(btc_chain_t *chain,
+                     uint8_t **data,
+                     size_t *length,
+                     const btc_entry_t *entry) {
+  return btc_chaindb_get_filter(chain->db, data, length, entry->hash);
+}
+
+int
+btc_chain_get_filter_header(btc_chain_t *chain,
+                            uint8_t *filter_hash,
+                            uint8_t *header,
+                            const btc_entry_t *entry) {
+  return btc_chaindb_get_filter_header(chain->db, filter_hash,
+                                       header, entry->hash);
+}
+
+int
+btc_chain_prune(btc_chain_t *chain, int32_t height, int32_t *pruned) {
+  return btc_chaindb_prune(chain->db, height, pruned);
+}
+
+int
+btc_chain_export(btc_chain_t *chain,
+                 const char *path,
+                 uint8_t *hash,
+                 uint64_t *count) {
+  return btc_chaindb_export(chain->db, path, hash, count);
+}
+
 const uint8_t *
 btc_chain_get_orphan_root(btc_chain_t *chain, const uint8_t *hash) {
   const uint8_t *root = NULL;
@@ -14,15 +14,18 @@
 #include <mako/consensus.h>
 #include <mako/crypto/hash.h>
 #include <mako/entry.h>
+#include <mako/header.h>
 #include <mako/list.h>
 #include <mako/map.h>
 #include <mako/network.h>
+#include <mako/script.h>
 #include <mako/tx.h>
 #include <mako/util.h>
 #include <mako/vector.h>
 
 #include <io/core.h>
 #include <io/loop.h>
+#include <io/workers.h>
 
 #include <node/chaindb.h>
 
@@ -32,28 +35,60 @@
 #include "../impl.h"
 #include "../internal.h"
 
+#include "addrindex.h"
+#include "chaindb_impl.h"
+#include "database.h"
+#include "filterindex.h"
+#include "indexer.h"
+#include "snapshot.h"
+#include "txindex.h"
+
+#ifdef BTC_HAVE_SNAPPY
+#  include "../../deps/lcdb/src/util/snappy.h"
+#endif
+
 /*
  * Constants
  */
 
 #define MAX_FILE_SIZE (128 << 20)
-#define BLOCK_FILE 0
-#define UNDO_FILE 1
+
+/* Undo records in version 1 files are snappy-compressed. */
+#ifdef BTC_HAVE_SNAPPY
+#  define UNDO_VERSION 1
+#else
+#  define UNDO_VERSION 0
+#endif
+#define FLUSH_INTERVAL (60 * 60)
+#define PREFETCH_MIN 16
+#define PREFETCH_BATCH 16
+#define ARENA_CHUNK 4096
+#define INDEX_INTERVAL 10000
+#define WRITER_MAX_PENDING (64 << 20)
 
 /*
  * Database Keys
  */
 
 static uint8_t meta_key_[1] = {'R'};
+static uint8_t coins_key_[1] = {'C'};
 static uint8_t blockfile_key_[1] = {'B'};
 static uint8_t undofile_key_[1] = {'U'};
-
-static const ldb_slice_t meta_key = {meta_key_, 1, 0};
+static uint8_t stats_key_[1] = {'S'};
+static uint8_t index_key_[1] = {'I'};
+static uint8_t txindex_key_[1] = {'T'};
+static uint8_t addrindex_key_[1] = {'A'};
+static uint8_t filterindex_key_[1] = {'F'};
+
+const ldb_slice_t btc_meta_key = {meta_key_, 1, 0};
+const ldb_slice_t btc_coins_key = {coins_key_, 1, 0};
 static const ldb_slice_t blockfile_key = {blockfile_key_, 1, 0};
 static const ldb_slice_t undofile_key = {undofile_key_, 1, 0};
-
-#define ENTRY_PREFIX 'e'
-#define ENTRY_KEYLEN 33
+const ldb_slice_t btc_stats_key = {stats_key_, 1, 0};
+const ldb_slice_t btc_index_key = {index_key_, 1, 0};
+static const ldb_slice_t txindex_key = {txindex_key_, 1, 0};
+static const ldb_slice_t addrindex_key = {addrindex_key_, 1, 0};
+static const ldb_slice_t filterindex_key = {filterindex_key_, 1, 0};
 
 static uint8_t entry_min_[ENTRY_KEYLEN] = {
   ENTRY_PREFIX,
@@ -71,19 +106,16 @@ static uint8_t entry_max_[ENTRY_KEYLEN] = {
   0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
 };
 
-static const ldb_slice_t entry_min = {entry_min_, ENTRY_KEYLEN, 0};
-static const ldb_slice_t entry_max = {entry_max_, ENTRY_KEYLEN, 0};
+const ldb_slice_t btc_entry_min = {entry_min_, ENTRY_KEYLEN, 0};
+const ldb_slice_t btc_entry_max = {entry_max_, ENTRY_KEYLEN, 0};
 
-static size_t
-entry_key(uint8_t *key, const uint8_t *hash) {
+size_t
+btc_entry_key(uint8_t *key, const uint8_t *hash) {
   key[0] = ENTRY_PREFIX;
   memcpy(key + 1, hash, 32);
   return ENTRY_KEYLEN;
 }
 
-#define TIP_PREFIX 'p'
-#define TIP_KEYLEN 33
-
 static uint8_t tip_min_[TIP_KEYLEN] = {
   TIP_PREFIX,
   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
@@ -103,16 +135,13 @@ static uint8_t tip_max_[TIP_KEYLEN] = {
 BTC_UNUSED static const ldb_slice_t tip_min = {tip_min_, TIP_KEYLEN, 0};
 BTC_UNUSED static const ldb_slice_t tip_max = {tip_max_, TIP_KEYLEN, 0};
 
-static size_t
-tip_key(uint8_t *key, const uint8_t *hash) {
+size_t
+btc_tip_key(uint8_t *key, const uint8_t *hash) {
   key[0] = TIP_PREFIX;
   memcpy(key + 1, hash, 32);
   return TIP_KEYLEN;
 }
 
-#define FILE_PREFIX 'f'
-#define FILE_KEYLEN 6
-
 static uint8_t file_min_[FILE_KEYLEN] =
   {FILE_PREFIX, 0x00, 0x00, 0x00, 0x00, 0x00};
 
@@ -130,8 +159,21 @@ file_key(uint8_t *key, uint8_t type, uint32_t id) {
   return FILE_KEYLEN;
 }
 
-#define COIN_PREFIX 'c'
-#define COIN_KEYLEN 37
+static uint8_t journal_min_[JOURNAL_KEYLEN] =
+  {JOURNAL_PREFIX, 0x00, 0x00, 0x00, 0x00};
+
+static uint8_t journal_max_[JOURNAL_KEYLEN] =
+  {JOURNAL_PREFIX, 0xff, 0xff, 0xff, 0xff};
+
+static const ldb_slice_t journal_min = {journal_min_, JOURNAL_KEYLEN, 0};
+static const ldb_slice_t journal_max = {journal_max_, JOURNAL_KEYLEN, 0};
+
+static size_t
+journal_key(uint8_t *key, uint32_t seq) {
+  key[0] = JOURNAL_PREFIX;
+  btc_write32be(key + 1, seq);
+  return JOURNAL_KEYLEN;
+}
 
 static uint8_t coin_min_[COIN_KEYLEN] = {
   COIN_PREFIX,
@@ -151,11 +193,11 @@ static uint8_t coin_max_[COIN_KEYLEN] = {
   0xff, 0xff, 0xff, 0xff
 };
 
-BTC_UNUSED static const ldb_slice_t coin_min = {coin_min_, COIN_KEYLEN, 0};
-BTC_UNUSED static const ldb_slice_t coin_max = {coin_max_, COIN_KEYLEN, 0};
+const ldb_slice_t btc_coin_min = {coin_min_, COIN_KEYLEN, 0};
+const ldb_slice_t btc_coin_max = {coin_max_, COIN_KEYLEN, 0};
 
-static size_t
-coin_key(uint8_t *key, const uint8_t *hash, uint32_t index) {
+size_t
+btc_coin_key(uint8_t *key, const uint8_t *hash, uint32_t index) {
   key[0] = COIN_PREFIX;
   memcpy(key + 1, hash, 32);
   btc_write32be(key + 33, index);
@@ -166,22 +208,7 @@ coin_key(uint8_t *key, const uint8_t *hash, uint32_t index) {
  * Chain File
  */
 
-#define BTC_CHAINFILE_SIZE 37
-
-typedef struct btc_chainfile_s {
-  btc_fd_t fd;
-  uint8_t type;
-  int32_t id;
-  int32_t pos;
-  int32_t items;
-  int64_t min_time;
-  int64_t max_time;
-  int32_t min_height;
-  int32_t max_height;
-  struct btc_chainfile_s *prev;
-  struct btc_chainfile_s *next;
-  int dirty;
-} btc_chainfile_t;
+#define BTC_CHAINFILE_SIZE 38
 
 DEFINE_SERIALIZABLE_OBJECT(btc_chainfile, SCOPE_STATIC)
 
@@ -196,9 +223,10 @@ btc_chainfile_init(btc_chainfile_t *z) {
   z->max_time = -1;
   z->min_height = -1;
   z->max_height = -1;
+  z->version = 0;
   z->prev = NULL;
   z->next = NULL;
-  z->dirty = 0;
+  z->seq = 0;
 }
 
 static void
@@ -217,9 +245,10 @@ btc_chainfile_copy(btc_chainfile_t *z, const btc_chainfile_t *x) {
   z->max_time = x->max_time;
   z->min_height = x->min_height;
   z->max_height = x->max_height;
+  z->version = x->version;
   z->prev = NULL;
   z->next = NULL;
-  z->dirty = 0;
+  z->seq = 0;
 }
 
 static size_t
@@ -238,6 +267,7 @@ btc_chainfile_write(uint8_t *zp, const btc_chainfile_t *x) {
   zp = btc_int64_write(zp, x->max_time);
   zp = btc_int32_write(zp, x->min_height);
   zp = btc_int32_write(zp, x->max_height);
+  zp = btc_uint8_write(zp, x->version);
   return zp;
 }
 
@@ -267,6 +297,14 @@ btc_chainfile_read(btc_chainfile_t *z, const uint8_t **xp, size_t *xn) {
   if (!btc_int32_read(&z->max_height, xp, xn))
     return 0;
 
+  /* Files written before versioning was added. */
+  z->version = 0;
+
+  if (*xn > 0) {
+    if (!btc_uint8_read(&z->version, xp, xn))
+      return 0;
+  }
+
   return 1;
 }
 
@@ -288,324 +326,1287 @@ btc_chainfile_update(btc_chainfile_t *z, const btc_entry_t *entry) {
 }
 
 /*
- * Chain Database
+ * Descriptor Cache
  */
 
-struct btc_chaindb_s {
-  const btc_network_t *network;
-  char prefix[BTC_PATH_MAX - 31];
-  unsigned int flags;
-  size_t cache_size;
-  ldb_t *lsm;
-  ldb_lru_t *block_cache;
-  btc_hashmap_t hashes;
-  btc_vector_t heights;
-  btc_entry_t *head;
-  btc_entry_t *tail;
-  struct btc_chainfiles_s {
-    btc_chainfile_t *head;
-    btc_chainfile_t *tail;
-    size_t length;
-  } files;
-  btc_chainfile_t block;
-  btc_chainfile_t undo;
-  uint8_t *slab;
-};
+static void
+btc_fdent_close(btc_fdent_t *ent) {
+  btc_fs_close(ent->fd);
+  btc_free(ent);
+}
 
 static void
-btc_chaindb_path(btc_chaindb_t *db, char *path, int type, int id) {
-  const char *tag = (type == BLOCK_FILE ? "blk" : "rev");
+btc_fdcache_init(btc_fdcache_t *cache) {
+  btc_mutex_init(&cache->lock);
+  cache->length = 0;
+  cache->tick = 0;
+}
 
-#if defined(_WIN32)
-  sprintf(path, "%s\\blocks\\%s%05d.dat", db->prefix, tag, id);
-#else
-  sprintf(path, "%s/blocks/%s%05d.dat", db->prefix, tag, id);
-#endif
+static void
+btc_fdcache_remove(btc_fdcache_t *cache, size_t i) {
+  btc_fdent_t *ent = cache->items[i];
+
+  cache->items[i] = cache->items[--cache->length];
+
+  /* Readers still holding it close it on release. */
+  if (ent->refs > 0)
+    ent->dead = 1;
+  else
+    btc_fdent_close(ent);
 }
 
 static void
-btc_chaindb_init(btc_chaindb_t *db, const btc_network_t *network) {
-  memset(db, 0, sizeof(*db));
+btc_fdcache_evict(btc_fdcache_t *cache, int type, int32_t id) {
+  size_t i;
 
-  db->network = network;
-  db->prefix[0] = '/';
-  btc_hashmap_init(&db->hashes);
-  db->flags = BTC_CHAIN_DEFAULT_FLAGS;
-  db->cache_size = 128 << 20;
+  btc_mutex_lock(&cache->lock);
 
-  btc_vector_init(&db->heights);
+  for (i = 0; i < cache->length; i++) {
+    const btc_fdent_t *ent = cache->items[i];
 
-  db->slab = (uint8_t *)btc_malloc(24 + BTC_MAX_RAW_BLOCK_SIZE);
+    if (ent->type == type && ent->id == id) {
+      btc_fdcache_remove(cache, i);
+      break;
+    }
+  }
+
+  btc_mutex_unlock(&cache->lock);
 }
 
 static void
-btc_chaindb_clear(btc_chaindb_t *db) {
-  btc_hashmap_clear(&db->hashes);
-  btc_vector_clear(&db->heights);
-  btc_free(db->slab);
+btc_fdcache_reset(btc_fdcache_t *cache) {
+  btc_mutex_lock(&cache->lock);
 
-  memset(db, 0, sizeof(*db));
-}
+  while (cache->length > 0)
+    btc_fdcache_remove(cache, cache->length - 1);
 
-btc_chaindb_t *
-btc_chaindb_create(const btc_network_t *network) {
-  btc_chaindb_t *db = (btc_chaindb_t *)btc_malloc(sizeof(btc_chaindb_t));
-  btc_chaindb_init(db, network);
-  return db;
+  btc_mutex_unlock(&cache->lock);
 }
 
-void
-btc_chaindb_destroy(btc_chaindb_t *db) {
-  btc_chaindb_clear(db);
-  btc_free(db);
+static void
+btc_fdcache_clear(btc_fdcache_t *cache) {
+  btc_fdcache_reset(cache);
+  btc_mutex_destroy(&cache->lock);
 }
 
-static int
-btc_chaindb_load_prefix(btc_chaindb_t *db, const char *prefix) {
-  char path[BTC_PATH_MAX];
+static btc_fdent_t *
+btc_fdcache_get(btc_fdcache_t *cache, int type, int32_t id) {
+  btc_fdent_t *ret = NULL;
+  size_t i;
 
-  btc_fs_mkdir(prefix);
+  btc_mutex_lock(&cache->lock);
 
-  if (!btc_strcpy(db->prefix, sizeof(db->prefix), prefix))
-    return 0;
+  for (i = 0; i < cache->length; i++) {
+    btc_fdent_t *ent = cache->items[i];
 
-  if (!btc_path_join(path, sizeof(path), prefix, "blocks"))
-    return 0;
+    if (ent->type == type && ent->id == id) {
+      ent->refs += 1;
+      ent->tick = ++cache->tick;
+      ret = ent;
+      break;
+    }
+  }
 
-  btc_fs_mkdir(path);
+  btc_mutex_unlock(&cache->lock);
 
-  return 1;
+  return ret;
 }
 
-static int
-btc_chaindb_load_database(btc_chaindb_t *db) {
-  ldb_dbopt_t options = *ldb_dbopt_default;
-  char path[BTC_PATH_MAX];
-  int rc;
+static btc_fdent_t *
+btc_fdcache_put(btc_fdcache_t *cache, int type, int32_t id, btc_fd_t fd) {
+  btc_fdent_t *ent;
+  size_t i, j;
 
-  if (!btc_path_join(path, sizeof(path), db->prefix, "chain")) {
-    fprintf(stderr, "ldb_open: path too long\n");
-    return 0;
-  }
+  btc_mutex_lock(&cache->lock);
 
-  db->block_cache = ldb_lru_create(db->cache_size / 2);
+  /* Another reader may have opened it in the meantime. */
+  for (i = 0; i < cache->length; i++) {
+    ent = cache->items[i];
 
-  options.create_if_missing = 1;
-  options.block_cache = db->block_cache;
-  options.write_buffer_size = db->cache_size / 4;
-  options.compression = LDB_NO_COMPRESSION;
-  options.filter_policy = NULL; /* ldb_bloom_default */
-  options.use_mmap = 0;
+    if (ent->type == type && ent->id == id) {
+      ent->refs += 1;
+      ent->tick = ++cache->tick;
 
-  if (options.use_mmap == 0 || sizeof(void *) < 8) {
-    static const int sockets = 256;
-    int fdset = btc_loop_fd_setsize();
+      btc_mutex_unlock(&cache->lock);
+      btc_fs_close(fd);
 
-    if (fdset < 0) {
-      /* select(2) backend not in use. */
-    } else if (fdset >= options.max_open_files + sockets) {
-      /* Use default max_open_files. */
-    } else if (fdset >= 64 + sockets) {
-      options.max_open_files = fdset - sockets;
-    } else {
-      if (sizeof(void *) < 8)
-        options.max_open_files = 64;
-      else
-        options.use_mmap = 1;
+      return ent;
     }
   }
 
-  rc = ldb_open(path, &options, &db->lsm);
-
-  if (rc != LDB_OK) {
-    fprintf(stderr, "ldb_open: %s\n", ldb_strerror(rc));
+  /* Drop the least recently used descriptor. */
+  if (cache->length == FD_CACHE_SIZE) {
+    j = 0;
 
-    ldb_lru_destroy(db->block_cache);
-    db->block_cache = NULL;
+    for (i = 1; i < cache->length; i++) {
+      if (cache->items[i]->tick < cache->items[j]->tick)
+        j = i;
+    }
 
-    return 0;
+    btc_fdcache_remove(cache, j);
   }
 
-  return 1;
-}
+  ent = (btc_fdent_t *)btc_malloc(sizeof(btc_fdent_t));
+  ent->fd = fd;
+  ent->type = type;
+  ent->id = id;
+  ent->refs = 1;
+  ent->dead = 0;
+  ent->tick = ++cache->tick;
 
-static void
-btc_chaindb_unload_database(btc_chaindb_t *db) {
-  ldb_close(db->lsm);
-  ldb_lru_destroy(db->block_cache);
+  cache->items[cache->length++] = ent;
 
-  db->lsm = NULL;
-  db->block_cache = NULL;
+  btc_mutex_unlock(&cache->lock);
+
+  return ent;
 }
 
-static int
-btc_chaindb_load_files(btc_chaindb_t *db) {
-  char path[BTC_PATH_MAX];
-  btc_chainfile_t *file;
-  ldb_slice_t val;
-  ldb_iter_t *it;
-  int rc;
+void
+btc_fdcache_release(btc_fdcache_t *cache, btc_fdent_t *ent) {
+  int dead;
 
-  /* Read best block file. */
-  rc = ldb_get(db->lsm, &blockfile_key, &val, 0);
+  btc_mutex_lock(&cache->lock);
 
-  if (rc == LDB_OK) {
-    CHECK(btc_chainfile_import(&db->block, val.data, val.size));
-    CHECK(db->block.type == BLOCK_FILE);
+  ent->refs -= 1;
 
-    ldb_free(val.data);
-  } else {
-    CHECK(rc == LDB_NOTFOUND);
+  dead = (ent->dead && ent->refs == 0);
 
-    btc_chainfile_init(&db->block);
+  btc_mutex_unlock(&cache->lock);
 
-    db->block.type = BLOCK_FILE;
-  }
+  if (dead)
+    btc_fdent_close(ent);
+}
 
-  /* Read best undo file. */
-  rc = ldb_get(db->lsm, &undofile_key, &val, 0);
+/*
+ * I/O Writer
+ */
 
-  if (rc == LDB_OK) {
-    CHECK(btc_chainfile_import(&db->undo, val.data, val.size));
-    CHECK(db->undo.type == UNDO_FILE);
+#define WRITER_WRITE 0
+#define WRITER_CLOSE 1
+#define WRITER_ALLOC 2
+#define WRITER_COMMIT 3
+#define WRITER_SYNC 4
 
-    ldb_free(val.data);
-  } else {
-    CHECK(rc == LDB_NOTFOUND);
+static btc_iojob_t *
+btc_iojob_create(int type, btc_fd_t fd) {
+  btc_iojob_t *job = (btc_iojob_t *)btc_malloc(sizeof(btc_iojob_t));
 
-    btc_chainfile_init(&db->undo);
+  job->type = type;
+  job->fd = fd;
+  job->data = NULL;
+  job->length = 0;
+  job->next = NULL;
 
-    db->undo.type = UNDO_FILE;
-  }
+  ldb_batch_init(&job->batch);
 
-  /* Read file index and build vector. */
-  it = ldb_iterator(db->lsm, 0);
+  return job;
+}
 
-  ldb_iter_range(it, &file_min, &file_max) {
-    file = btc_chainfile_create();
-    val = ldb_iter_value(it);
+static void
+btc_iojob_destroy(btc_iojob_t *job) {
+  if (job->data != NULL)
+    btc_free(job->data);
 
-    CHECK(btc_chainfile_import(file, val.data, val.size));
+  ldb_batch_clear(&job->batch);
 
-    btc_list_push(&db->files, file, btc_chainfile_t);
-  }
+  btc_free(job);
+}
 
-  CHECK(ldb_iter_status(it) == LDB_OK);
+static int
+btc_iowriter_process(btc_iowriter_t *w, btc_iojob_t *jobs, int error) {
+  btc_fd_t *dirty = w->dirty;
+  ldb_batch_t batch;
+  btc_iojob_t *job;
+  int commit = 0;
+  int sync = 0;
+  size_t i;
 
-  ldb_iter_destroy(it);
+  ldb_batch_init(&batch);
 
-  /* Open block file for writing. */
-  btc_chaindb_path(db, path, BLOCK_FILE, db->block.id);
+  for (job = jobs; job != NULL && !error; job = job->next) {
+    switch (job->type) {
+      case WRITER_WRITE: {
+        int64_t nwrite = btc_fs_write(job->fd, job->data, job->length);
 
-  db->block.fd = btc_fs_append(path);
+        if (nwrite < 0 || (size_t)nwrite != job->length) {
+          error = 1;
+          break;
+        }
 
-  CHECK(db->block.fd != BTC_INVALID_FD);
+        for (i = 0; i < w->dirty_len; i++) {
+          if (dirty[i] == job->fd)
+            break;
+        }
 
-  /* Open undo file for writing. */
-  btc_chaindb_path(db, path, UNDO_FILE, db->undo.id);
+        if (i == w->dirty_len) {
+          if (w->dirty_len == lengthof(w->dirty)) {
+            if (!btc_fs_fsync(dirty[0]))
+              error = 1;
 
-  db->undo.fd = btc_fs_append(path);
+            dirty[0] = dirty[--w->dirty_len];
+          }
 
-  CHECK(db->undo.fd != BTC_INVALID_FD);
+          dirty[w->dirty_len++] = job->fd;
+        }
 
-  return 1;
-}
+        break;
+      }
 
-static void
-btc_chaindb_unload_files(btc_chaindb_t *db) {
-  btc_chainfile_t *file, *next;
+      case WRITER_CLOSE: {
+        for (i = 0; i < w->dirty_len; i++) {
+          if (dirty[i] == job->fd)
+            dirty[i] = dirty[--w->dirty_len];
+        }
 
-  btc_fs_fsync(db->block.fd);
-  btc_fs_fsync(db->undo.fd);
+        if (!btc_fs_fsync(job->fd))
+          error = 1;
 
-  btc_fs_close(db->block.fd);
-  btc_fs_close(db->undo.fd);
+        btc_fs_close(job->fd);
 
-  for (file = db->files.head; file != NULL; file = next) {
-    next = file->next;
-    btc_chainfile_destroy(file);
-  }
+        job->fd = BTC_INVALID_FD;
 
-  btc_list_reset(&db->files);
-}
+        break;
+      }
 
-static int
-btc_chaindb_init_index(btc_chaindb_t *db) {
-  btc_view_t *view = btc_view_create();
-  btc_entry_t *entry = btc_entry_create();
-  btc_block_t block;
+      case WRITER_ALLOC: {
+        /* Best effort. */
+        btc_fs_fallocate(job->fd, job->length);
+        break;
+      }
 
-  btc_block_init(&block);
-  btc_block_import(&block, db->network->genesis.data,
-                           db->network->genesis.length);
+      case WRITER_COMMIT: {
+        ldb_batch_append(&batch, &job->batch);
+        commit = 1;
+        break;
+      }
 
-  btc_entry_set_block(entry, &block, NULL);
+      case WRITER_SYNC: {
+        sync = 1;
+        break;
+      }
+    }
+  }
 
-  CHECK(btc_chaindb_save(db, entry, &block, view));
+  /* Files are only synced where asked, once for the
+     whole group, and always before the commit. */
+  if (sync) {
+    for (i = 0; i < w->dirty_len && !error; i++) {
+      if (!btc_fs_fsync(dirty[i]))
+        error = 1;
+    }
 
-  btc_block_clear(&block);
-  btc_view_destroy(view);
+    if (!error)
+      w->dirty_len = 0;
+  }
 
-  return 1;
-}
+  if (commit && !error) {
+    if (ldb_write(w->lsm, &batch, 0) != LDB_OK)
+      error = 1;
+  }
 
-static int
-btc_chaindb_load_index(btc_chaindb_t *db) {
-  btc_entry_t *entry, *tip;
-  btc_entry_t *gen = NULL;
-  uint8_t tip_hash[32];
-  btc_mapiter_t iter;
-  ldb_slice_t val;
-  ldb_iter_t *it;
-  int rc;
+  ldb_batch_clear(&batch);
 
-  /* Read tip hash. */
-  {
-    rc = ldb_get(db->lsm, &meta_key, &val, 0);
+  while (jobs != NULL) {
+    job = jobs;
+    jobs = jobs->next;
 
-    if (rc == LDB_NOTFOUND)
-      return btc_chaindb_init_index(db);
+    if (job->type == WRITER_CLOSE && job->fd != BTC_INVALID_FD)
+      btc_fs_close(job->fd);
 
-    CHECK(rc == LDB_OK);
-    CHECK(val.size == 32);
+    btc_iojob_destroy(job);
+  }
 
-    memcpy(tip_hash, val.data, 32);
+  return !error;
+}
 
-    ldb_free(val.data);
-  }
+static void
+iowriter_thread(void *arg) {
+  btc_iowriter_t *w = (btc_iowriter_t *)arg;
+  btc_iojob_t *jobs;
+  uint64_t queued;
+  size_t pending;
+  int error;
 
-  /* Read block index and create hash->entry map. */
-  it = ldb_iterator(db->lsm, 0);
+  btc_mutex_lock(&w->lock);
 
-  ldb_iter_range(it, &entry_min, &entry_max) {
-    entry = btc_entry_create();
-    val = ldb_iter_value(it);
+  for (;;) {
+    while (w->head == NULL && !w->stop)
+      btc_cond_wait(&w->worker, &w->lock);
 
-    CHECK(btc_entry_import(entry, val.data, val.size));
-    CHECK(btc_hashmap_put(&db->hashes, entry->hash, entry));
-  }
+    if (w->head == NULL)
+      break;
 
-  CHECK(ldb_iter_status(it) == LDB_OK);
+    /* Take everything queued so far as one group. */
+    jobs = w->head;
+    queued = w->queued;
+    pending = w->pending;
+    error = w->error;
 
-  ldb_iter_destroy(it);
+    w->head = NULL;
+    w->tail = NULL;
 
-  /* Create `prev` links and retrieve genesis block. */
-  btc_map_each(&db->hashes, iter) {
-    entry = db->hashes.vals[iter];
+    btc_mutex_unlock(&w->lock);
 
-    if (entry->height == 0) {
-      gen = entry;
-      continue;
-    }
+    error = !btc_iowriter_process(w, jobs, error);
+
+    btc_mutex_lock(&w->lock);
 
-    entry->prev = btc_hashmap_get(&db->hashes, entry->header.prev_block);
+    w->pending -= pending;
+    w->written = queued;
+    w->error |= error;
 
-    CHECK(entry->prev != NULL);
+    btc_cond_broadcast(&w->master);
   }
 
-  CHECK(gen != NULL);
+  btc_mutex_unlock(&w->lock);
+}
 
-  /* Retrieve tip. */
+static void
+btc_iowriter_init(btc_iowriter_t *w) {
+  btc_mutex_init(&w->lock);
+  btc_cond_init(&w->master);
+  btc_cond_init(&w->worker);
+
+  w->lsm = NULL;
+  w->head = NULL;
+  w->tail = NULL;
+  w->dirty_len = 0;
+  w->pending = 0;
+  w->queued = 0;
+  w->written = 0;
+  w->threaded = 0;
+  w->running = 0;
+  w->error = 0;
+  w->stop = 0;
+}
+
+static void
+btc_iowriter_clear(btc_iowriter_t *w) {
+  CHECK(!w->running);
+  CHECK(w->head == NULL);
+
+  btc_cond_destroy(&w->worker);
+  btc_cond_destroy(&w->master);
+  btc_mutex_destroy(&w->lock);
+}
+
+static void
+btc_iowriter_open(btc_iowriter_t *w, ldb_t *lsm) {
+  w->lsm = lsm;
+  w->dirty_len = 0;
+  w->error = 0;
+  w->stop = 0;
+
+#if defined(_WIN32) || defined(BTC_PTHREAD)
+  btc_thread_create(&w->thread, iowriter_thread, w);
+  w->threaded = 1;
+#endif
+
+  w->running = 1;
+}
+
+static void
+btc_iowriter_drain(btc_iowriter_t *w) {
+  /* Without threads, the queue is run inline. */
+  w->error |= !btc_iowriter_process(w, w->head, w->error);
+  w->head = NULL;
+  w->tail = NULL;
+  w->pending = 0;
+  w->written = w->queued;
+}
+
+static uint64_t
+btc_iowriter_push(btc_iowriter_t *w, btc_iojob_t *job, size_t size) {
+  uint64_t seq;
+
+  btc_mutex_lock(&w->lock);
+
+  /* Apply backpressure once too much is in flight. */
+  while (w->threaded && w->pending >= WRITER_MAX_PENDING && !w->error)
+    btc_cond_wait(&w->master, &w->lock);
+
+  if (w->error) {
+    btc_mutex_unlock(&w->lock);
+    btc_iojob_destroy(job);
+    return 0;
+  }
+
+  if (w->tail == NULL)
+    w->head = job;
+  else
+    w->tail->next = job;
+
+  w->tail = job;
+  w->pending += size;
+
+  seq = ++w->queued;
+
+  if (!w->threaded && w->pending >= WRITER_MAX_PENDING)
+    btc_iowriter_drain(w);
+
+  btc_cond_signal(&w->worker);
+  btc_mutex_unlock(&w->lock);
+
+  return seq;
+}
+
+int
+btc_iowriter_wait(btc_iowriter_t *w, uint64_t seq) {
+  int ret;
+
+  btc_mutex_lock(&w->lock);
+
+  if (!w->threaded && w->head != NULL)
+    btc_iowriter_drain(w);
+
+  while (w->written < seq)
+    btc_cond_wait(&w->master, &w->lock);
+
+  ret = !w->error;
+
+  btc_mutex_unlock(&w->lock);
+
+  return ret;
+}
+
+int
+btc_iowriter_flush(btc_iowriter_t *w) {
+  return btc_iowriter_wait(w, w->queued);
+}
+
+static void
+btc_iowriter_close(btc_iowriter_t *w) {
+  btc_iowriter_flush(w);
+
+  if (w->threaded) {
+    btc_mutex_lock(&w->lock);
+
+    w->stop = 1;
+
+    btc_cond_signal(&w->worker);
+    btc_mutex_unlock(&w->lock);
+
+    btc_thread_join(&w->thread);
+  }
+
+  w->threaded = 0;
+  w->running = 0;
+  w->lsm = NULL;
+}
+
+/*
+ * Coin Cache
+ */
+
+#define COIN_DIRTY (1 << 0) /* Differs from the database. */
+#define COIN_FRESH (1 << 1) /* Not present in the database. */
+
+/* Rough per-entry cost of the hash table itself. */
+#define COIN_OVERHEAD (sizeof(btc_outpoint_t *) + sizeof(void *) + 1)
+
+static size_t
+btc_coinent_usage(const btc_coinent_t *ent) {
+  size_t size = sizeof(btc_coinent_t) + COIN_OVERHEAD;
+
+  if (ent->coin != NULL) {
+    size += sizeof(btc_coin_t);
+    size += ent->coin->output.script.alloc;
+  }
+
+  return size;
+}
+
+static btc_coinent_t *
+btc_coinent_create(const uint8_t *hash, uint32_t index) {
+  btc_coinent_t *ent = btc_malloc(sizeof(btc_coinent_t));
+
+  btc_outpoint_set(&ent->key, hash, index);
+
+  ent->coin = NULL;
+  ent->flags = 0;
+
+  return ent;
+}
+
+static void
+btc_coinent_destroy(btc_coinent_t *ent) {
+  if (ent->coin != NULL)
+    btc_coin_destroy(ent->coin);
+
+  btc_free(ent);
+}
+
+static void
+btc_coincache_init(btc_coincache_t *cache) {
+  btc_outmap_init(&cache->map);
+  cache->usage = 0;
+  cache->limit = 0;
+}
+
+static void
+btc_coincache_reset(btc_coincache_t *cache) {
+  btc_mapiter_t it;
+
+  btc_map_each(&cache->map, it)
+    btc_coinent_destroy(cache->map.vals[it]);
+
+  btc_outmap_reset(&cache->map);
+
+  cache->usage = 0;
+}
+
+static void
+btc_coincache_clear(btc_coincache_t *cache) {
+  btc_coincache_reset(cache);
+  btc_outmap_clear(&cache->map);
+}
+
+static btc_coinent_t *
+btc_coincache_get(const btc_coincache_t *cache,
+                  const uint8_t *hash,
+                  uint32_t index) {
+  btc_outpoint_t key;
+
+  btc_outpoint_set(&key, hash, index);
+
+  return btc_outmap_get(&cache->map, &key);
+}
+
+static btc_coinent_t *
+btc_coincache_ensure(btc_coincache_t *cache,
+                     const uint8_t *hash,
+                     uint32_t index) {
+  btc_coinent_t *ent = btc_coincache_get(cache, hash, index);
+
+  if (ent == NULL) {
+    ent = btc_coinent_create(hash, index);
+
+    CHECK(btc_outmap_put(&cache->map, &ent->key, ent));
+
+    cache->usage += btc_coinent_usage(ent);
+  }
+
+  return ent;
+}
+
+static void
+btc_coincache_remove(btc_coincache_t *cache, btc_coinent_t *ent) {
+  CHECK(btc_outmap_del(&cache->map, &ent->key) == &ent->key);
+
+  cache->usage -= btc_coinent_usage(ent);
+
+  btc_coinent_destroy(ent);
+}
+
+static void
+btc_coincache_set(btc_coincache_t *cache,
+                  btc_coinent_t *ent,
+                  btc_coin_t *coin,
+                  unsigned int flags) {
+  cache->usage -= btc_coinent_usage(ent);
+
+  if (ent->coin != NULL)
+    btc_coin_destroy(ent->coin);
+
+  ent->coin = coin;
+  ent->flags = flags;
+
+  cache->usage += btc_coinent_usage(ent);
+}
+
+static void
+btc_coincache_add(btc_coincache_t *cache,
+                  const uint8_t *hash,
+                  uint32_t index,
+                  const btc_coin_t *coin) {
+  btc_coinent_t *ent = btc_coincache_get(cache, hash, index);
+  unsigned int flags = COIN_DIRTY;
+
+  if (ent == NULL) {
+    /* A coin we have never seen is either brand new or was
+       restored by a disconnect (its spend was already flushed).
+       Either way the database cannot have it. The exception is
+       the two historical BIP30 coinbases which overwrote unspent
+       outputs, so coinbases are never marked fresh. */
+    if (!coin->coinbase)
+      flags |= COIN_FRESH;
+
+    ent = btc_coincache_ensure(cache, hash, index);
+  } else {
+    flags |= ent->flags & COIN_FRESH;
+  }
+
+  btc_coincache_set(cache, ent, btc_coin_refconst(coin), flags);
+}
+
+static void
+btc_coincache_spend(btc_coincache_t *cache,
+                    const uint8_t *hash,
+                    uint32_t index) {
+  btc_coinent_t *ent = btc_coincache_ensure(cache, hash, index);
+
+  /* Never written out; nothing to delete. */
+  if (ent->flags & COIN_FRESH) {
+    btc_coincache_remove(cache, ent);
+    return;
+  }
+
+  btc_coincache_set(cache, ent, NULL, COIN_DIRTY);
+}
+
+/*
+ * Entry Arena
+ */
+
+static void
+btc_arena_init(btc_arena_t *arena) {
+  btc_vector_init(&arena->chunks);
+  arena->used = ARENA_CHUNK;
+  arena->free = NULL;
+}
+
+static void
+btc_arena_reset(btc_arena_t *arena) {
+  size_t i;
+
+  for (i = 0; i < arena->chunks.length; i++)
+    btc_free(arena->chunks.items[i]);
+
+  btc_vector_reset(&arena->chunks);
+
+  arena->used = ARENA_CHUNK;
+  arena->free = NULL;
+}
+
+static void
+btc_arena_clear(btc_arena_t *arena) {
+  btc_arena_reset(arena);
+  btc_vector_clear(&arena->chunks);
+}
+
+btc_entry_t *
+btc_arena_alloc(btc_arena_t *arena) {
+  btc_entry_t *entry;
+
+  if (arena->free != NULL) {
+    entry = arena->free;
+    arena->free = entry->next;
+  } else {
+    /* Chunks never move, so entries can point at each other. */
+    if (arena->used == ARENA_CHUNK) {
+      entry = (btc_entry_t *)btc_malloc(ARENA_CHUNK * sizeof(btc_entry_t));
+
+      btc_vector_push(&arena->chunks, entry);
+
+      arena->used = 0;
+    }
+
+    entry = btc_vector_top(&arena->chunks);
+    entry += arena->used++;
+  }
+
+  btc_entry_init(entry);
+
+  return entry;
+}
+
+static void
+btc_arena_free(btc_arena_t *arena, btc_entry_t *entry) {
+  entry->next = arena->free;
+  arena->free = entry;
+}
+
+/*
+ * Coin Stats
+ */
+
+void
+btc_coinstats_init(btc_coinstats_t *stats) {
+  btc_muhash_init(&stats->muhash);
+  stats->count = 0;
+  stats->value = 0;
+  stats->size = 0;
+}
+
+size_t
+btc_coinstats_export(uint8_t *zp, const btc_coinstats_t *x) {
+  uint8_t *sp = zp;
+
+  zp = btc_raw_write(zp, x->muhash.num, 384);
+  zp = btc_raw_write(zp, x->muhash.den, 384);
+  zp = btc_int64_write(zp, x->count);
+  zp = btc_int64_write(zp, x->value);
+  zp = btc_int64_write(zp, x->size);
+
+  return zp - sp;
+}
+
+static int
+btc_coinstats_import(btc_coinstats_t *z, const uint8_t *xp, size_t xn) {
+  if (!btc_raw_read(z->muhash.num, 384, &xp, &xn))
+    return 0;
+
+  if (!btc_raw_read(z->muhash.den, 384, &xp, &xn))
+    return 0;
+
+  if (!btc_int64_read(&z->count, &xp, &xn))
+    return 0;
+
+  if (!btc_int64_read(&z->value, &xp, &xn))
+    return 0;
+
+  if (!btc_int64_read(&z->size, &xp, &xn))
+    return 0;
+
+  return xn == 0;
+}
+
+void
+btc_coinstats_update(btc_coinstats_t *stats,
+                     const uint8_t *hash,
+                     uint32_t index,
+                     int32_t height,
+                     int coinbase,
+                     const btc_output_t *output,
+                     int sign) {
+  size_t len = 40 + btc_output_size(output);
+  uint8_t tmp[1024];
+  uint8_t *buf = tmp;
+  uint8_t *zp;
+
+  if (len > sizeof(tmp))
+    buf = (uint8_t *)btc_malloc(len);
+
+  /* Same serialization as bitcoind so the hashes are comparable. */
+  zp = btc_raw_write(buf, hash, 32);
+  zp = btc_uint32_write(zp, index);
+  zp = btc_uint32_write(zp, (uint32_t)height * 2 + (coinbase != 0));
+  zp = btc_output_write(zp, output);
+
+  if (sign > 0)
+    btc_muhash_insert(&stats->muhash, buf, zp - buf);
+  else
+    btc_muhash_remove(&stats->muhash, buf, zp - buf);
+
+  stats->count += sign;
+  stats->value += sign * output->value;
+  stats->size += sign * (int64_t)(50 + output->script.length);
+
+  if (buf != tmp)
+    btc_free(buf);
+}
+
+/*
+ * Chain Database
+ */
+
+static void
+btc_chaindb_path(btc_chaindb_t *db, char *path, int type, int id) {
+  const char *tag = (type == BLOCK_FILE ? "blk" : "rev");
+
+#if defined(_WIN32)
+  sprintf(path, "%s\\blocks\\%s%05d.dat", db->prefix, tag, id);
+#else
+  sprintf(path, "%s/blocks/%s%05d.dat", db->prefix, tag, id);
+#endif
+}
+
+static void
+btc_chaindb_init(btc_chaindb_t *db, const btc_network_t *network) {
+  memset(db, 0, sizeof(*db));
+
+  db->network = network;
+  db->prefix[0] = '/';
+  btc_hashmap_init(&db->hashes);
+  db->flags = BTC_CHAIN_DEFAULT_FLAGS;
+  db->cache_size = 128 << 20;
+  db->file_size = MAX_FILE_SIZE;
+  db->undo_version = UNDO_VERSION;
+  db->unvalidated = -1;
+
+  btc_vector_init(&db->heights);
+  btc_arena_init(&db->entries);
+  btc_fdcache_init(&db->fds);
+  btc_iowriter_init(&db->writer);
+  btc_indexer_init(&db->txindex, "txindex", &txindex_key, 1,
+                                btc_txindex_backfill);
+  btc_indexer_init(&db->addrindex, "addrindex", &addrindex_key, 1,
+                                   btc_addrindex_backfill);
+  btc_indexer_init(&db->filterindex, "filterindex", &filterindex_key, 0,
+                                     btc_filterindex_backfill);
+  btc_coincache_init(&db->coins);
+  btc_coinstats_init(&db->stats);
+
+  db->slab = (uint8_t *)btc_malloc(24 + BTC_MAX_RAW_BLOCK_SIZE);
+}
+
+static void
+btc_chaindb_clear(btc_chaindb_t *db) {
+  btc_hashmap_clear(&db->hashes);
+  btc_vector_clear(&db->heights);
+  btc_arena_clear(&db->entries);
+  btc_fdcache_clear(&db->fds);
+  btc_iowriter_clear(&db->writer);
+  btc_indexer_clear(&db->txindex);
+  btc_indexer_clear(&db->addrindex);
+  btc_indexer_clear(&db->filterindex);
+  btc_coincache_clear(&db->coins);
+  btc_free(db->slab);
+
+  memset(db, 0, sizeof(*db));
+}
+
+btc_chaindb_t *
+btc_chaindb_create(const btc_network_t *network) {
+  btc_chaindb_t *db = (btc_chaindb_t *)btc_malloc(sizeof(btc_chaindb_t));
+  btc_chaindb_init(db, network);
+  return db;
+}
+
+void
+btc_chaindb_destroy(btc_chaindb_t *db) {
+  btc_chaindb_clear(db);
+  btc_free(db);
+}
+
+static int
+btc_chaindb_load_prefix(btc_chaindb_t *db, const char *prefix) {
+  char path[BTC_PATH_MAX];
+
+  btc_fs_mkdir(prefix);
+
+  if (!btc_strcpy(db->prefix, sizeof(db->prefix), prefix))
+    return 0;
+
+  if (!btc_path_join(path, sizeof(path), prefix, "blocks"))
+    return 0;
+
+  btc_fs_mkdir(path);
+
+  return 1;
+}
+
+static int
+btc_chaindb_load_database(btc_chaindb_t *db) {
+  ldb_dbopt_t options = *ldb_dbopt_default;
+  char path[BTC_PATH_MAX];
+  int rc;
+
+  if (!btc_path_join(path, sizeof(path), db->prefix, "chain")) {
+    fprintf(stderr, "ldb_open: path too long\n");
+    return 0;
+  }
+
+  /* Most of the cache goes to coins. The
+     rest is split between the block cache
+     and the write buffer. */
+  db->coins.limit = db->cache_size - db->cache_size / 4;
+  db->block_cache = ldb_lru_create(db->cache_size / 8);
+
+  options.create_if_missing = 1;
+  options.block_cache = db->block_cache;
+  options.write_buffer_size = db->cache_size / 8;
+  options.compression = LDB_NO_COMPRESSION;
+  options.filter_policy = NULL; /* ldb_bloom_default */
+  options.use_mmap = 0;
+
+  if (options.use_mmap == 0 || sizeof(void *) < 8) {
+    static const int sockets = 256;
+    int fdset = btc_loop_fd_setsize();
+
+    if (fdset < 0) {
+      /* select(2) backend not in use. */
+    } else if (fdset >= options.max_open_files + sockets) {
+      /* Use default max_open_files. */
+    } else if (fdset >= 64 + sockets) {
+      options.max_open_files = fdset - sockets;
+    } else {
+      if (sizeof(void *) < 8)
+        options.max_open_files = 64;
+      else
+        options.use_mmap = 1;
+    }
+  }
+
+  rc = ldb_open(path, &options, &db->lsm);
+
+  if (rc != LDB_OK) {
+    fprintf(stderr, "ldb_open: %s\n", ldb_strerror(rc));
+
+    ldb_lru_destroy(db->block_cache);
+    db->block_cache = NULL;
+
+    return 0;
+  }
+
+  return 1;
+}
+
+static void
+btc_chaindb_unload_database(btc_chaindb_t *db) {
+  ldb_close(db->lsm);
+  ldb_lru_destroy(db->block_cache);
+
+  db->lsm = NULL;
+  db->block_cache = NULL;
+}
+
+static void
+btc_chaindb_prealloc(btc_chaindb_t *db, btc_chainfile_t *file) {
+  btc_iojob_t *job = btc_iojob_create(WRITER_ALLOC, file->fd);
+
+  job->length = db->file_size;
+
+  btc_iowriter_push(&db->writer, job, 0);
+}
+
+static void
+btc_chaindb_recover(btc_chaindb_t *db, btc_chainfile_t *file) {
+  uint64_t size;
+
+  CHECK(btc_fs_fsize(file->fd, &size));
+
+  /* Data written before a crash but never indexed
+     is left behind as dead space. New data must go
+     after it since the file is opened for append. */
+  if (size > (uint64_t)file->pos) {
+    CHECK(size <= INT32_MAX);
+    file->pos = size;
+  }
+
+  btc_chaindb_prealloc(db, file);
+}
+
+static int
+btc_chaindb_load_files(btc_chaindb_t *db) {
+  char path[BTC_PATH_MAX];
+  btc_chainfile_t *file;
+  ldb_slice_t val;
+  ldb_iter_t *it;
+  int rc;
+
+  /* Read best block file. */
+  rc = ldb_get(db->lsm, &blockfile_key, &val, 0);
+
+  if (rc == LDB_OK) {
+    CHECK(btc_chainfile_import(&db->block, val.data, val.size));
+    CHECK(db->block.type == BLOCK_FILE);
+
+    ldb_free(val.data);
+  } else {
+    CHECK(rc == LDB_NOTFOUND);
+
+    btc_chainfile_init(&db->block);
+
+    db->block.type = BLOCK_FILE;
+  }
+
+  /* Read best undo file. */
+  rc = ldb_get(db->lsm, &undofile_key, &val, 0);
+
+  if (rc == LDB_OK) {
+    CHECK(btc_chainfile_import(&db->undo, val.data, val.size));
+    CHECK(db->undo.type == UNDO_FILE);
+    CHECK(db->undo.version <= UNDO_VERSION);
+
+    ldb_free(val.data);
+  } else {
+    CHECK(rc == LDB_NOTFOUND);
+
+    btc_chainfile_init(&db->undo);
+
+    db->undo.type = UNDO_FILE;
+    db->undo.version = db->undo_version;
+  }
+
+  /* Read file index and build vector. */
+  it = ldb_iterator(db->lsm, 0);
+
+  ldb_iter_range(it, &file_min, &file_max) {
+    file = btc_chainfile_create();
+    val = ldb_iter_value(it);
+
+    CHECK(btc_chainfile_import(file, val.data, val.size));
+
+    btc_list_push(&db->files, file, btc_chainfile_t);
+
+    db->files.size += file->pos;
+  }
+
+  CHECK(ldb_iter_status(it) == LDB_OK);
+
+  ldb_iter_destroy(it);
+
+  /* Open block file for writing. */
+  btc_chaindb_path(db, path, BLOCK_FILE, db->block.id);
+
+  db->block.fd = btc_fs_append(path);
+
+  CHECK(db->block.fd != BTC_INVALID_FD);
+
+  /* Open undo file for writing. */
+  btc_chaindb_path(db, path, UNDO_FILE, db->undo.id);
+
+  db->undo.fd = btc_fs_append(path);
+
+  CHECK(db->undo.fd != BTC_INVALID_FD);
+
+  btc_chaindb_recover(db, &db->block);
+  btc_chaindb_recover(db, &db->undo);
+
+  return 1;
+}
+
+static void
+btc_chaindb_unload_files(btc_chaindb_t *db) {
+  btc_chainfile_t *file, *next;
+
+  btc_fs_fsync(db->block.fd);
+  btc_fs_fsync(db->undo.fd);
+
+  btc_fs_close(db->block.fd);
+  btc_fs_close(db->undo.fd);
+
+  btc_fdcache_reset(&db->fds);
+
+  for (file = db->files.head; file != NULL; file = next) {
+    next = file->next;
+    btc_chainfile_destroy(file);
+  }
+
+  btc_list_reset(&db->files);
+
+  db->files.size = 0;
+}
+
+static int
+btc_chaindb_sync_files(btc_chaindb_t *db) {
+  btc_iojob_t *job = btc_iojob_create(WRITER_SYNC, BTC_INVALID_FD);
+  return btc_iowriter_push(&db->writer, job, 0) != 0;
+}
+
+static int
+btc_chaindb_commit(btc_chaindb_t *db, ldb_batch_t *batch) {
+  size_t size = ldb_batch_approximate_size(batch);
+  btc_iojob_t *job = btc_iojob_create(WRITER_COMMIT, BTC_INVALID_FD);
+
+  /* The writer takes ownership of the batch. It is
+     written only once all preceding data is written. */
+  job->batch = *batch;
+
+  ldb_batch_init(batch);
+
+  return btc_iowriter_push(&db->writer, job, size) != 0;
+}
+
+static int
+btc_chaindb_read_index(btc_chaindb_t *db);
+
+static void
+btc_chaindb_scan_journal(btc_chaindb_t *db);
+
+static int
+btc_chaindb_write_index(btc_chaindb_t *db);
+
+int
+btc_chaindb_flush_coins(btc_chaindb_t *db) {
+  uint8_t kbuf[COIN_KEYLEN];
+  uint8_t *vbuf = db->slab;
+  ldb_slice_t key, val;
+  ldb_batch_t batch;
+  btc_mapiter_t it;
+  int ret = 0;
+
+  key.data = kbuf;
+  key.size = sizeof(kbuf);
+
+  val.data = vbuf;
+  val.size = 0;
+
+  CHECK(db->tail != NULL);
+
+  ldb_batch_init(&batch);
+
+  btc_map_each(&db->coins.map, it) {
+    const btc_coinent_t *ent = db->coins.map.vals[it];
+
+    if (!(ent->flags & COIN_DIRTY))
+      continue;
+
+    btc_coin_key(kbuf, ent->key.hash, ent->key.index);
+
+    if (ent->coin == NULL) {
+      ldb_batch_del(&batch, &key);
+    } else {
+      val.size = btc_coin_export(vbuf, ent->coin);
+
+      ldb_batch_put(&batch, &key, &val);
+    }
+  }
+
+  /* Record which tip the coins now reflect. */
+  val.data = db->tail->hash;
+  val.size = 32;
+
+  ldb_batch_put(&batch, &btc_coins_key, &val);
+
+  /* Along with the stats for that tip. */
+  val.data = vbuf;
+  val.size = btc_coinstats_export(vbuf, &db->stats);
+
+  ldb_batch_put(&batch, &btc_stats_key, &val);
+
+  /* The coins tip must never get ahead of the
+     block and undo data it would replay from. */
+  if (!btc_chaindb_sync_files(db))
+    goto fail;
+
+  if (!btc_chaindb_commit(db, &batch))
+    goto fail;
+
+  /* Coins are read straight from the database after this. */
+  if (!btc_iowriter_flush(&db->writer))
+    goto fail;
+
+  btc_coincache_reset(&db->coins);
+
+  db->flushed = db->tail;
+  db->flush_time = btc_time_sec();
+
+  /* Keep the journal replay on startup short. */
+  if (db->journal - db->journal_base >= INDEX_INTERVAL) {
+    if (!btc_chaindb_write_index(db))
+      fprintf(stderr, "chaindb: could not write block index.\n");
+  }
+
+  ret = 1;
+fail:
+  ldb_batch_clear(&batch);
+  return ret;
+}
+
+static int
+btc_chaindb_maybe_flush(btc_chaindb_t *db) {
+  if (db->coins.usage >= db->coins.limit)
+    return btc_chaindb_flush_coins(db);
+
+  /* Bound the amount of replay after a crash. */
+  if (btc_time_sec() >= db->flush_time + FLUSH_INTERVAL)
+    return btc_chaindb_flush_coins(db);
+
+  return 1;
+}
+
+static int
+btc_chaindb_load_coins(btc_chaindb_t *db);
+
+static int
+btc_chaindb_init_index(btc_chaindb_t *db) {
+  btc_entry_t *entry = btc_arena_alloc(&db->entries);
+  btc_view_t *view = btc_view_create();
+  btc_block_t block;
+
+  btc_block_init(&block);
+  btc_block_import(&block, db->network->genesis.data,
+                           db->network->genesis.length);
+
+  btc_entry_set_block(entry, &block, NULL);
+
+  CHECK(btc_chaindb_save(db, entry, &block, view));
+  CHECK(btc_chaindb_flush_coins(db));
+
+  btc_block_clear(&block);
+  btc_view_destroy(view);
+
+  return 1;
+}
+
+static void
+btc_chaindb_link_entry(btc_chaindb_t *db,
+                       btc_entry_t *entry,
+                       btc_vector_t *stack) {
+  btc_entry_t *child;
+
+  /* Walk back to the nearest linked ancestor. */
+  while (entry->prev == NULL && entry->height > 0) {
+    btc_vector_push(stack, entry);
+
+    entry = btc_hashmap_get(&db->hashes, entry->header.prev_block);
+
+    CHECK(entry != NULL);
+  }
+
+  /* Link forward from there so that every ancestor
+     has its skip pointer by the time a descendant
+     needs it. Each entry is linked only once. */
+  while (stack->length > 0) {
+    child = (btc_entry_t *)btc_vector_pop(stack);
+
+    CHECK(child->height == entry->height + 1);
+
+    child->prev = entry;
+
+    btc_entry_set_skip(child);
+
+    entry = child;
+  }
+}
+
+static int
+btc_chaindb_load_index(btc_chaindb_t *db) {
+  btc_entry_t *entry, *tip;
+  uint8_t tip_hash[32];
+  btc_vector_t stack;
+  btc_mapiter_t iter;
+  ldb_slice_t val;
+  ldb_iter_t *it;
+  int rc;
+
+  /* Read tip hash. */
+  {
+    rc = ldb_get(db->lsm, &btc_meta_key, &val, 0);
+
+    if (rc == LDB_NOTFOUND)
+      return btc_chaindb_init_index(db);
+
+    CHECK(rc == LDB_OK);
+    CHECK(val.size == 32);
+
+    memcpy(tip_hash, val.data, 32);
+
+    ldb_free(val.data);
+  }
+
+  /* Try the index snapshot before scanning every entry. */
+  if (!btc_chaindb_read_index(db)) {
+    btc_chaindb_scan_journal(db);
+
+    /* Read block index and create hash->entry map. */
+    it = ldb_iterator(db->lsm, 0);
+
+    ldb_iter_range(it, &btc_entry_min, &btc_entry_max) {
+      entry = btc_arena_alloc(&db->entries);
+      val = ldb_iter_value(it);
+
+      CHECK(btc_entry_import(entry, val.data, val.size));
+      CHECK(btc_hashmap_put(&db->hashes, entry->hash, entry));
+    }
+
+    CHECK(ldb_iter_status(it) == LDB_OK);
+
+    ldb_iter_destroy(it);
+  }
+
+  /* Link entries to their parents. Records come in
+     no particular order, so nothing is sorted here. */
+  btc_vector_init(&stack);
+
+  btc_map_each(&db->hashes, iter)
+    btc_chaindb_link_entry(db, db->hashes.vals[iter], &stack);
+
+  btc_vector_clear(&stack);
+
+  /* Retrieve tip. */
   tip = btc_hashmap_get(&db->hashes, tip_hash);
 
   CHECK(tip != NULL);
@@ -628,7 +1629,7 @@ btc_chaindb_load_index(btc_chaindb_t *db) {
     entry = entry->prev;
   } while (entry != NULL);
 
-  db->head = gen;
+  db->head = db->heights.items[0];
   db->tail = tip;
 
   return 1;
@@ -636,16 +1637,60 @@ btc_chaindb_load_index(btc_chaindb_t *db) {
 
 static void
 btc_chaindb_unload_index(btc_chaindb_t *db) {
-  btc_mapiter_t it;
-
-  btc_map_each(&db->hashes, it)
-    btc_entry_destroy(db->hashes.vals[it]);
-
   btc_hashmap_reset(&db->hashes);
   btc_vector_clear(&db->heights);
+  btc_arena_reset(&db->entries);
 
   db->head = NULL;
   db->tail = NULL;
+  db->flushed = NULL;
+  db->journal = 0;
+  db->journal_base = 0;
+  db->index_valid = 0;
+}
+
+static int
+btc_chaindb_load_stats(btc_chaindb_t *db) {
+  btc_coin_t *coin;
+  ldb_slice_t val;
+  ldb_iter_t *it;
+  int rc;
+
+  rc = ldb_get(db->lsm, &btc_stats_key, &val, 0);
+
+  if (rc == LDB_OK) {
+    CHECK(btc_coinstats_import(&db->stats, val.data, val.size));
+    ldb_free(val.data);
+    return 1;
+  }
+
+  CHECK(rc == LDB_NOTFOUND);
+
+  /* Older database: compute the stats from scratch. */
+  btc_coinstats_init(&db->stats);
+
+  coin = btc_coin_create();
+  it = ldb_iterator(db->lsm, 0);
+
+  ldb_iter_range(it, &btc_coin_min, &btc_coin_max) {
+    ldb_slice_t key = ldb_iter_key(it);
+    const uint8_t *kp = (const uint8_t *)key.data;
+
+    val = ldb_iter_value(it);
+
+    CHECK(key.size == COIN_KEYLEN);
+    CHECK(btc_coin_import(coin, val.data, val.size));
+
+    btc_coinstats_update(&db->stats, kp + 1, btc_read32be(kp + 33),
+                         coin->height, coin->coinbase, &coin->output, 1);
+  }
+
+  CHECK(ldb_iter_status(it) == LDB_OK);
+
+  ldb_iter_destroy(it);
+  btc_coin_destroy(coin);
+
+  return 1;
 }
 
 void
@@ -653,11 +1698,40 @@ btc_chaindb_set_cache(btc_chaindb_t *db, size_t cache_size) {
   db->cache_size = cache_size;
 }
 
+void
+btc_chaindb_set_prune(btc_chaindb_t *db, uint64_t target) {
+  db->prune_target = target;
+}
+
+void
+btc_chaindb_set_file_size(btc_chaindb_t *db, int32_t size) {
+  /* Smaller files let tests prune without writing gigabytes. */
+  db->file_size = size;
+}
+
+void
+btc_chaindb_set_import_limit(btc_chaindb_t *db, size_t limit) {
+  /* Lets tests stop an import partway, as a crash would. */
+  db->import_limit = limit;
+}
+
+int
+btc_chaindb_set_undo_version(btc_chaindb_t *db, int version) {
+  /* Only applies to rev files created from here on. */
+  if (version < 0 || version > UNDO_VERSION)
+    return 0;
+
+  db->undo_version = version;
+
+  return 1;
+}
+
 int
 btc_chaindb_open(btc_chaindb_t *db,
                  const char *prefix,
                  unsigned int flags) {
   db->flags = flags;
+  db->flush_time = btc_time_sec();
 
   if (!btc_chaindb_load_prefix(db, prefix))
     return 0;
@@ -665,31 +1739,70 @@ btc_chaindb_open(btc_chaindb_t *db,
   if (!btc_chaindb_load_database(db))
     return 0;
 
+  if (!btc_chaindb_load_snapshot(db))
+    return 0;
+
+  btc_iowriter_open(&db->writer, db->lsm);
+
   if (!btc_chaindb_load_files(db))
     return 0;
 
   if (!btc_chaindb_load_index(db))
     return 0;
 
+  if (!btc_chaindb_open_indexers(db))
+    return 0;
+
+  if (!btc_chaindb_load_stats(db))
+    return 0;
+
+  if (!btc_chaindb_load_coins(db))
+    return 0;
+
   return 1;
 }
 
 void
 btc_chaindb_close(btc_chaindb_t *db) {
+  btc_chaindb_close_indexers(db);
+
+  CHECK(btc_chaindb_flush_coins(db));
+
+  if (!db->index_valid || db->journal != db->journal_base) {
+    if (!btc_chaindb_write_index(db))
+      fprintf(stderr, "chaindb: could not write block index.\n");
+  }
+
+  btc_iowriter_close(&db->writer);
+
   btc_chaindb_unload_index(db);
   btc_chaindb_unload_files(db);
   btc_chaindb_unload_database(db);
 }
 
-btc_coin_t *
-btc_chaindb_coin(btc_chaindb_t *db, const uint8_t *hash, size_t index) {
+void
+btc_chaindb_abort(btc_chaindb_t *db) {
+  /* Close as a crash would, losing the coin cache
+     and the index snapshot. Tests use this to run
+     the replay on the next open. */
+  btc_chaindb_close_indexers(db);
+  btc_iowriter_close(&db->writer);
+  btc_coincache_reset(&db->coins);
+
+  btc_chaindb_unload_index(db);
+  btc_chaindb_unload_files(db);
+  btc_chaindb_unload_database(db);
+}
+
+static btc_coin_t *
+btc_chaindb_read_coin(btc_chaindb_t *db, const uint8_t *hash, uint32_t index) {
   uint8_t kbuf[COIN_KEYLEN];
   ldb_slice_t key, val;
   btc_coin_t *coin;
   int rc;
 
   key.data = kbuf;
-  key.size = coin_key(kbuf, hash, index);
+  key.size = btc_coin_key(kbuf, hash, index);
 
   rc = ldb_get(db->lsm, &key, &val, 0);
 
@@ -710,6 +1823,164 @@ btc_chaindb_coin(btc_chaindb_t *db, const uint8_t *hash, size_t index) {
   return coin;
 }
 
+btc_coin_t *
+btc_chaindb_coin(btc_chaindb_t *db, const uint8_t *hash, size_t index) {
+  btc_coinent_t *ent = btc_coincache_get(&db->coins, hash, index);
+  btc_coin_t *coin;
+
+  if (ent == NULL) {
+    coin = btc_chaindb_read_coin(db, hash, index);
+
+    if (coin == NULL)
+      return NULL;
+
+    ent = btc_coincache_ensure(&db->coins, hash, index);
+
+    btc_coincache_set(&db->coins, ent, coin, 0);
+  }
+
+  if (ent->coin == NULL)
+    return NULL;
+
+  /* The caller is free to mutate the coin. */
+  return btc_coin_clone(ent->coin);
+}
+
+/*
+ * Prefetching
+ */
+
+typedef struct btc_coinreq_s {
+  const btc_outpoint_t *prevout;
+  btc_coin_t *coin;
+} btc_coinreq_t;
+
+typedef struct btc_prefetch_s {
+  btc_chaindb_t *db;
+  btc_coinreq_t *items;
+  size_t length;
+} btc_prefetch_t;
+
+static void
+btc_prefetch_work(void *arg) {
+  btc_prefetch_t *job = arg;
+  size_t i;
+
+  /* Runs on a worker: touch lcdb only, never the cache. */
+  for (i = 0; i < job->length; i++) {
+    btc_coinreq_t *req = &job->items[i];
+
+    req->coin = btc_chaindb_read_coin(job->db, req->prevout->hash,
+                                               req->prevout->index);
+  }
+}
+
+void
+btc_chaindb_prefetch(btc_chaindb_t *db,
+                     const btc_block_t *block,
+                     btc_workers_t *pool) {
+  btc_prefetch_t *jobs = NULL;
+  btc_coinreq_t *reqs = NULL;
+  size_t i, j, total, length;
+  btc_hashset_t txids;
+  btc_workq_t batch;
+
+  btc_hashset_init(&txids);
+  btc_workq_init(&batch);
+
+  total = 0;
+
+  for (i = 0; i < block->txs.length; i++) {
+    const btc_tx_t *tx = block->txs.items[i];
+
+    btc_hashset_put(&txids, tx->hash);
+
+    if (i > 0)
+      total += tx->inputs.length;
+  }
+
+  if (total < PREFETCH_MIN)
+    goto done;
+
+  reqs = btc_malloc(total * sizeof(btc_coinreq_t));
+  length = 0;
+
+  /* Collect every prevout which is neither
+     created in this block nor already cached. */
+  for (i = 1; i < block->txs.length; i++) {
+    const btc_tx_t *tx = block->txs.items[i];
+
+    for (j = 0; j < tx->inputs.length; j++) {
+      const btc_outpoint_t *prevout = &tx->inputs.items[j]->prevout;
+
+      if (btc_hashset_has(&txids, prevout->hash))
+        continue;
+
+      if (btc_coincache_get(&db->coins, prevout->hash, prevout->index))
+        continue;
+
+      reqs[length].prevout = prevout;
+      reqs[length].coin = NULL;
+
+      length++;
+    }
+  }
+
+  if (length < PREFETCH_MIN)
+    goto done;
+
+  total = (length + PREFETCH_BATCH - 1) / PREFETCH_BATCH;
+  jobs = btc_malloc(total * sizeof(btc_prefetch_t));
+
+  for (i = 0; i < total; i++) {
+    btc_prefetch_t *job = &jobs[i];
+
+    job->db = db;
+    job->items = &reqs[i * PREFETCH_BATCH];
+    job->length = PREFETCH_BATCH;
+
+    if (i == total - 1)
+      job->length = length - i * PREFETCH_BATCH;
+
+    btc_workq_push(&batch, btc_prefetch_work, job);
+  }
+
+  btc_workers_batch(pool, &batch);
+  btc_workers_wait(pool);
+
+  /* Back on our thread: populate the cache. */
+  for (i = 0; i < length; i++) {
+    btc_coinreq_t *req = &reqs[i];
+    const btc_outpoint_t *prevout = req->prevout;
+    btc_coinent_t *ent;
+
+    if (req->coin == NULL)
+      continue;
+
+    ent = btc_coincache_get(&db->coins, prevout->hash, prevout->index);
+
+    if (ent != NULL) {
+      /* Duplicate prevout within the block. */
+      btc_coin_destroy(req->coin);
+      continue;
+    }
+
+    ent = btc_coincache_ensure(&db->coins, prevout->hash, prevout->index);
+
+    btc_coincache_set(&db->coins, ent, req->coin, 0);
+  }
+
+done:
+  if (jobs != NULL)
+    btc_free(jobs);
+
+  if (reqs != NULL)
+    btc_free(reqs);
+
+  btc_workq_clear(&batch);
+  btc_hashset_clear(&txids);
+}
+
 static btc_coin_t *
 read_coin(const btc_outpoint_t *prevout, void *arg) {
   return btc_chaindb_coin(arg, prevout->hash, prevout->index);
@@ -730,20 +2001,9 @@ btc_chaindb_fill(btc_chaindb_t *db,
 }
 
 static void
-btc_chaindb_save_view(btc_chaindb_t *db,
-                      ldb_batch_t *batch,
-                      const btc_view_t *view) {
-  uint8_t kbuf[COIN_KEYLEN];
-  uint8_t *vbuf = db->slab;
-  ldb_slice_t key, val;
+btc_chaindb_save_view(btc_chaindb_t *db, const btc_view_t *view) {
   btc_mapiter_t i, j;
 
-  key.data = kbuf;
-  key.size = sizeof(kbuf);
-
-  val.data = vbuf;
-  val.size = 0;
-
   btc_map_each(&view->map, i) {
     const uint8_t *hash = view->map.keys[i];
     const btc_coins_t *coins = view->map.vals[i];
@@ -752,55 +2012,75 @@ btc_chaindb_save_view(btc_chaindb_t *db,
       uint32_t index = coins->map.keys[j];
       const btc_coin_t *coin = coins->map.vals[j];
 
-      coin_key(kbuf, hash, index);
-
-      if (coin->spent) {
-        ldb_batch_del(batch, &key);
-      } else {
-        val.size = btc_coin_export(vbuf, coin);
-
-        ldb_batch_put(batch, &key, &val);
-      }
+      if (coin->spent)
+        btc_coincache_spend(&db->coins, hash, index);
+      else
+        btc_coincache_add(&db->coins, hash, index, coin);
     }
   }
 }
 
-static int
-btc_chaindb_read(btc_chaindb_t *db,
-                 uint8_t **raw,
-                 size_t *len,
-                 int type,
-                 int id,
-                 int pos) {
+btc_fdent_t *
+btc_chaindb_acquire(btc_chaindb_t *db, int type, int32_t id) {
   char path[BTC_PATH_MAX];
-  btc_chainfile_t *file;
-  uint8_t *data = NULL;
-  uint8_t hdr[24];
-  size_t size;
-  int ret = 0;
+  btc_fdent_t *ent;
   btc_fd_t fd;
 
+  ent = btc_fdcache_get(&db->fds, type, id);
+
+  if (ent != NULL)
+    return ent;
+
+  btc_chaindb_path(db, path, type, id);
+
+  fd = btc_fs_open(path);
+
+  if (fd == BTC_INVALID_FD)
+    return NULL;
+
+  return btc_fdcache_put(&db->fds, type, id, fd);
+}
+
+int
+btc_chaindb_sync(btc_chaindb_t *db, int type, int id) {
+  btc_chainfile_t *file;
+
   if (type == BLOCK_FILE)
     file = &db->block;
   else
     file = &db->undo;
 
-  if (id == file->id && file->dirty) {
-    btc_fs_fsync(file->fd);
-    file->dirty = 0;
-  }
+  /* The data may still be sitting in the writer's queue. */
+  if (id + 1 >= file->id)
+    return btc_iowriter_wait(&db->writer, file->seq);
 
-  btc_chaindb_path(db, path, type, id);
+  return 1;
+}
 
-  fd = btc_fs_open(path);
+static int
+btc_chaindb_pread_ex(btc_chaindb_t *db,
+                     uint8_t **raw,
+                     size_t *len,
+                     int type,
+                     int id,
+                     int pos,
+                     int strip) {
+  /* Safe to call from any thread once the data is on disk. */
+  size_t off = strip ? 0 : 24;
+  uint8_t *data = NULL;
+  btc_fdent_t *ent;
+  uint8_t hdr[24];
+  int64_t nread;
+  size_t size;
+  int ret = 0;
 
-  if (fd == BTC_INVALID_FD)
-    return 0;
+  ent = btc_chaindb_acquire(db, type, id);
 
-  if (btc_fs_seek(fd, pos) != pos)
-    goto fail;
+  if (ent == NULL)
+    return 0;
 
-  if (btc_fs_read(fd, hdr, 24) != 24)
+  /* Positional reads leave the descriptor shareable. */
+  if (btc_fs_pread(ent->fd, hdr, 24, pos) != 24)
     goto fail;
 
   size = btc_read32le(hdr + 16);
@@ -808,19 +2088,21 @@ btc_chaindb_read(btc_chaindb_t *db,
   if (size > (64 << 20))
     goto fail;
 
-  size += 24;
-  data = (uint8_t *)malloc(size);
+  /* A stripped read skips the message header. */
+  data = (uint8_t *)malloc(off + size);
 
   if (data == NULL)
     goto fail;
 
-  memcpy(data, hdr, 24);
+  memcpy(data, hdr, off);
+
+  nread = btc_fs_pread(ent->fd, data + off, size, pos + 24);
 
-  if ((size_t)btc_fs_read(fd, data + 24, size - 24) != size - 24)
+  if (nread < 0 || (size_t)nread != size)
     goto fail;
 
   *raw = data;
-  *len = size;
+  *len = off + size;
 
   data = NULL;
   ret = 1;
@@ -828,9 +2110,32 @@ fail:
   if (data != NULL)
     free(data);
 
-  btc_fs_close(fd);
+  btc_fdcache_release(&db->fds, ent);
+
+  return ret;
+}
+
+int
+btc_chaindb_pread(btc_chaindb_t *db,
+                  uint8_t **raw,
+                  size_t *len,
+                  int type,
+                  int id,
+                  int pos) {
+  return btc_chaindb_pread_ex(db, raw, len, type, id, pos, 0);
+}
+
+static int
+btc_chaindb_read(btc_chaindb_t *db,
+                 uint8_t **raw,
+                 size_t *len,
+                 int type,
+                 int id,
+                 int pos) {
+  if (!btc_chaindb_sync(db, type, id))
+    return 0;
 
-  return ret;
+  return btc_chaindb_pread(db, raw, len, type, id, pos);
 }
 
 static btc_block_t *
@@ -854,11 +2159,75 @@ btc_chaindb_read_block(btc_chaindb_t *db, const btc_entry_t *entry) {
   return block;
 }
 
+int
+btc_chaindb_version(btc_chaindb_t *db, int type, int32_t id) {
+  btc_chainfile_t *file = (type == BLOCK_FILE ? &db->block : &db->undo);
+
+  if (id == file->id)
+    return file->version;
+
+  for (file = db->files.tail; file != NULL; file = file->prev) {
+    if (file->type == type && file->id == id)
+      return file->version;
+  }
+
+  return -1;
+}
+
+btc_undo_t *
+btc_chaindb_decode_undo(const uint8_t *xp,
+                        size_t xn,
+                        int version,
+                        uint8_t *slab) {
+  /* `slab` may be NULL, in which case we allocate. */
+  btc_undo_t *undo;
+
+  (void)slab;
+
+  switch (version) {
+    case 0: {
+      undo = btc_undo_decode(xp, xn);
+      break;
+    }
+
+#ifdef BTC_HAVE_SNAPPY
+    case 1: {
+      uint8_t *raw = slab;
+      size_t size;
+
+      undo = NULL;
+
+      if (!snappy_decode_size(&size, xp, xn))
+        break;
+
+      if (slab == NULL || size > BTC_MAX_RAW_BLOCK_SIZE)
+        raw = (uint8_t *)btc_malloc(size);
+
+      if (snappy_decode(raw, xp, xn))
+        undo = btc_undo_decode(raw, size);
+
+      if (raw != slab)
+        btc_free(raw);
+
+      break;
+    }
+#endif
+
+    default: {
+      undo = NULL;
+      break;
+    }
+  }
+
+  return undo;
+}
+
 static btc_undo_t *
 btc_chaindb_read_undo(btc_chaindb_t *db, const btc_entry_t *entry) {
   btc_undo_t *undo;
   uint8_t *buf;
   size_t len;
+  int version;
 
   if (entry->undo_pos == -1)
     return btc_undo_create();
@@ -868,7 +2237,8 @@ btc_chaindb_read_undo(btc_chaindb_t *db, const btc_entry_t *entry) {
     return NULL;
   }
 
-  undo = btc_undo_decode(buf + 24, len - 24);
+  version = btc_chaindb_version(db, UNDO_FILE, entry->undo_file);
+  undo = btc_chaindb_decode_undo(buf + 24, len - 24, version, db->slab);
 
   free(buf);
 
@@ -895,9 +2265,10 @@ btc_chaindb_alloc(btc_chaindb_t *db,
   uint8_t kbuf[FILE_KEYLEN];
   char path[BTC_PATH_MAX];
   ldb_slice_t key, val;
+  btc_iojob_t *job;
   btc_fd_t fd;
 
-  if (file->pos + len <= MAX_FILE_SIZE)
+  if (file->pos + len <= (size_t)db->file_size)
     return 1;
 
   key.data = kbuf;
@@ -915,12 +2286,17 @@ btc_chaindb_alloc(btc_chaindb_t *db,
   if (fd == BTC_INVALID_FD)
     return 0;
 
-  btc_fs_fsync(file->fd);
-  btc_fs_close(file->fd);
+  /* Sync and close the old file behind any pending writes. */
+  job = btc_iojob_create(WRITER_CLOSE, file->fd);
+
+  if (!btc_iowriter_push(&db->writer, job, 0))
+    return 0;
 
   btc_list_push(&db->files, btc_chainfile_clone(file),
                             btc_chainfile_t);
 
+  db->files.size += file->pos;
+
   file->fd = fd;
   file->id++;
   file->pos = 0;
@@ -929,7 +2305,32 @@ btc_chaindb_alloc(btc_chaindb_t *db,
   file->max_time = -1;
   file->min_height = -1;
   file->max_height = -1;
-  file->dirty = 0;
+
+  if (file->type == UNDO_FILE)
+    file->version = db->undo_version;
+
+  btc_chaindb_prealloc(db, file);
+
+  return 1;
+}
+
+static int
+btc_chaindb_append(btc_chaindb_t *db,
+                   btc_chainfile_t *file,
+                   uint8_t *data,
+                   size_t len) {
+  btc_iojob_t *job = btc_iojob_create(WRITER_WRITE, file->fd);
+  uint64_t seq;
+
+  job->data = data;
+  job->length = len;
+
+  seq = btc_iowriter_push(&db->writer, job, len);
+
+  if (seq == 0)
+    return 0;
+
+  file->seq = seq;
 
   return 1;
 }
@@ -939,39 +2340,36 @@ btc_chaindb_write_block(btc_chaindb_t *db,
                         ldb_batch_t *batch,
                         btc_entry_t *entry,
                         const btc_block_t *block) {
+  size_t len = btc_block_size(block);
   uint8_t vbuf[BTC_CHAINFILE_SIZE];
-  uint8_t hash[32];
+  uint8_t *buf, hash[32];
   ldb_slice_t val;
-  size_t len;
 
-  len = btc_block_export(db->slab + 24, block);
+  /* The writer takes ownership of the buffer. */
+  buf = (uint8_t *)btc_malloc(24 + len);
+  len = btc_block_export(buf + 24, block);
 
-  btc_hash256(hash, db->slab + 24, len);
+  btc_hash256(hash, buf + 24, len);
 
   /* Store in network format. */
-  btc_uint32_write(db->slab +  0, db->network->magic);
-  btc_uint32_write(db->slab +  4, 0x636f6c62);
-  btc_uint32_write(db->slab +  8, 0x0000006b);
-  btc_uint32_write(db->slab + 12, 0x00000000);
-  btc_uint32_write(db->slab + 16, len);
+  btc_uint32_write(buf +  0, db->network->magic);
+  btc_uint32_write(buf +  4, 0x636f6c62);
+  btc_uint32_write(buf +  8, 0x0000006b);
+  btc_uint32_write(buf + 12, 0x00000000);
+  btc_uint32_write(buf + 16, len);
 
-  btc_raw_write(db->slab + 20, hash, 4);
+  btc_raw_write(buf + 20, hash, 4);
 
   len += 24;
 
-  if (!btc_chaindb_alloc(db, batch, &db->block, len))
+  if (!btc_chaindb_alloc(db, batch, &db->block, len)) {
+    btc_free(buf);
     return 0;
+  }
 
-  if ((size_t)btc_fs_write(db->block.fd, db->slab, len) != len)
+  if (!btc_chaindb_append(db, &db->block, buf, len))
     return 0;
 
-  db->block.dirty = 1;
-
-  if (should_sync(entry)) {
-    btc_fs_fsync(db->block.fd);
-    db->block.dirty = 0;
-  }
-
   entry->block_file = db->block.id;
   entry->block_pos = db->block.pos;
 
@@ -994,15 +2392,43 @@ btc_chaindb_write_undo(btc_chaindb_t *db,
                        const btc_undo_t *undo) {
   size_t len = btc_undo_size(undo);
   uint8_t vbuf[BTC_CHAINFILE_SIZE];
-  uint8_t *buf = db->slab;
-  uint8_t hash[32];
+  uint8_t *buf, hash[32];
+  size_t max = len;
   ldb_slice_t val;
-  int ret = 0;
 
-  if (len > BTC_MAX_RAW_BLOCK_SIZE)
-    buf = (uint8_t *)btc_malloc(24 + len);
+#ifdef BTC_HAVE_SNAPPY
+  if (!snappy_encode_size(&max, len))
+    return 0;
+
+  if (max < len)
+    max = len;
+#endif
+
+  /* Reserve room for either format: a rollover
+     may change the version of the active file. */
+  if (!btc_chaindb_alloc(db, batch, &db->undo, 24 + max))
+    return 0;
+
+  buf = (uint8_t *)btc_malloc(24 + max);
+
+  if (db->undo.version == 0) {
+    len = btc_undo_export(buf + 24, undo);
+  } else {
+#ifdef BTC_HAVE_SNAPPY
+    uint8_t *raw = db->slab;
 
-  len = btc_undo_export(buf + 24, undo);
+    if (len > BTC_MAX_RAW_BLOCK_SIZE)
+      raw = (uint8_t *)btc_malloc(len);
+
+    len = btc_undo_export(raw, undo);
+    len = snappy_encode(buf + 24, raw, len);
+
+    if (raw != db->slab)
+      btc_free(raw);
+#else
+    btc_abort(); /* LCOV_EXCL_LINE */
+#endif
+  }
 
   btc_hash256(hash, buf + 24, len);
 
@@ -1016,18 +2442,8 @@ btc_chaindb_write_undo(btc_chaindb_t *db,
 
   len += 24;
 
-  if (!btc_chaindb_alloc(db, batch, &db->undo, len))
-    goto fail;
-
-  if ((size_t)btc_fs_write(db->undo.fd, buf, len) != len)
-    goto fail;
-
-  db->undo.dirty = 1;
-
-  if (should_sync(entry)) {
-    btc_fs_fsync(db->undo.fd);
-    db->undo.dirty = 0;
-  }
+  if (!btc_chaindb_append(db, &db->undo, buf, len))
+    return 0;
 
   entry->undo_file = db->undo.id;
   entry->undo_pos = db->undo.pos;
@@ -1041,58 +2457,155 @@ btc_chaindb_write_undo(btc_chaindb_t *db,
 
   ldb_batch_put(batch, &undofile_key, &val);
 
-  ret = 1;
-fail:
-  if (buf != db->slab)
-    btc_free(buf);
+  return 1;
+}
 
-  return ret;
+static int32_t
+btc_chaindb_prune_height(btc_chaindb_t *db, int32_t tip, int32_t height) {
+  int32_t max = tip - db->network->block.keep_blocks;
+
+  if (height > max)
+    height = max;
+
+  /* Keep anything we would need to replay unflushed coins. */
+  if (db->flushed != NULL && height > db->flushed->height)
+    height = db->flushed->height;
+
+  return height;
 }
 
-static int
-btc_chaindb_prune_files(btc_chaindb_t *db,
+static void
+btc_chaindb_remove_file(btc_chaindb_t *db,
                         ldb_batch_t *batch,
-                        const btc_entry_t *entry) {
-  btc_chainfile_t *file, *next;
+                        btc_chainfile_t *file) {
   uint8_t kbuf[FILE_KEYLEN];
   char path[BTC_PATH_MAX];
   ldb_slice_t key;
+
+  key.data = kbuf;
+  key.size = file_key(kbuf, file->type, file->id);
+
+  ldb_batch_del(batch, &key);
+
+  btc_chaindb_path(db, path, file->type, file->id);
+
+  btc_fdcache_evict(&db->fds, file->type, file->id);
+
+  btc_fs_unlink(path);
+
+  db->files.size -= file->pos;
+
+  btc_list_remove(&db->files, file, btc_chainfile_t);
+
+  btc_chainfile_destroy(file);
+}
+
+static uint64_t
+btc_chaindb_usage(btc_chaindb_t *db) {
+  return db->files.size + db->block.pos + db->undo.pos;
+}
+
+static int
+btc_chaindb_prune_files(btc_chaindb_t *db,
+                        ldb_batch_t *batch,
+                        const btc_entry_t *entry) {
+  btc_chainfile_t *file, *oldest;
   int32_t target;
 
   if (!(db->flags & BTC_CHAIN_PRUNE))
     return 1;
 
-  if (entry->height < db->network->block.keep_blocks)
+  /* Without a target, pruning is left to the user. */
+  if (db->prune_target == 0)
     return 1;
 
-  target = entry->height - db->network->block.keep_blocks;
+  if (entry->height <= db->network->block.prune_after_height)
+    return 1;
 
-  if (target <= db->network->block.prune_after_height)
+  if (btc_chaindb_usage(db) <= db->prune_target)
     return 1;
 
-  key.data = kbuf;
-  key.size = sizeof(kbuf);
+  target = btc_chaindb_prune_height(db, entry->height, entry->height);
 
-  for (file = db->files.head; file != NULL; file = next) {
-    next = file->next;
+  /* Remove the oldest files until we are back under budget. */
+  do {
+    oldest = NULL;
 
-    if (file->max_height >= target)
-      continue;
+    for (file = db->files.head; file != NULL; file = file->next) {
+      if (file->max_height >= target)
+        continue;
+
+      if (oldest == NULL || file->max_height < oldest->max_height)
+        oldest = file;
+    }
+
+    if (oldest == NULL)
+      break;
+
+    btc_chaindb_remove_file(db, batch, oldest);
+  } while (btc_chaindb_usage(db) > db->prune_target);
+
+  return 1;
+}
 
-    file_key(kbuf, file->type, file->id);
+static void
+btc_chaindb_apply_stats(btc_chaindb_t *db,
+                        const btc_entry_t *entry,
+                        const btc_block_t *block,
+                        const btc_undo_t *undo,
+                        int sign) {
+  const btc_checkpoint_t *chk;
+  size_t i, j, k = 0;
 
-    ldb_batch_del(batch, &key);
+  /* The two duplicate coinbases (BIP30) overwrote their predecessors. */
+  chk = btc_network_bip30(db->network, entry->height);
 
-    btc_chaindb_path(db, path, file->type, file->id);
+  if (sign > 0 && chk != NULL && btc_hash_equal(chk->hash, entry->hash)) {
+    const btc_tx_t *tx = block->txs.items[0];
 
-    btc_fs_unlink(path);
+    for (j = 0; j < tx->outputs.length; j++) {
+      btc_coin_t *coin = btc_chaindb_coin(db, tx->hash, j);
 
-    btc_list_remove(&db->files, file, btc_chainfile_t);
+      if (coin == NULL)
+        continue;
 
-    btc_chainfile_destroy(file);
+      btc_coinstats_update(&db->stats, tx->hash, j, coin->height,
+                           coin->coinbase, &coin->output, -1);
+
+      btc_coin_destroy(coin);
+    }
   }
 
-  return 1;
+  for (i = 0; i < block->txs.length; i++) {
+    const btc_tx_t *tx = block->txs.items[i];
+
+    if (i > 0) {
+      for (j = 0; j < tx->inputs.length; j++) {
+        const btc_outpoint_t *prevout = &tx->inputs.items[j]->prevout;
+        const btc_coin_t *coin;
+
+        CHECK(k < undo->length);
+
+        coin = undo->items[k++];
+
+        btc_coinstats_update(&db->stats, prevout->hash, prevout->index,
+                             coin->height, coin->coinbase,
+                             &coin->output, -sign);
+      }
+    }
+
+    for (j = 0; j < tx->outputs.length; j++) {
+      const btc_output_t *output = tx->outputs.items[j];
+
+      if (btc_script_is_unspendable(&output->script))
+        continue;
+
+      btc_coinstats_update(&db->stats, tx->hash, j, entry->height,
+                           i == 0, output, sign);
+    }
+  }
+
+  CHECK(k == undo->length);
 }
 
 static int
@@ -1101,32 +2614,46 @@ btc_chaindb_connect_block(btc_chaindb_t *db,
                           btc_entry_t *entry,
                           const btc_block_t *block,
                           const btc_view_t *view) {
-  const btc_undo_t *undo;
-
-  (void)block;
+  const btc_undo_t *undo = &view->undo;
 
   /* Genesis block's coinbase is unspendable. */
-  if (entry->height == 0)
+  if (entry->height == 0) {
+    if (db->flags & BTC_CHAIN_FILTERINDEX)
+      btc_chaindb_index_filter(db, batch, entry, block, undo);
+
     return 1;
+  }
+
+  /* Update the optional indexes. */
+  if (db->flags & BTC_CHAIN_TXINDEX)
+    btc_chaindb_index_txs(db, batch, entry, block);
+
+  if (db->flags & BTC_CHAIN_ADDRINDEX)
+    btc_chaindb_index_scripts(db, batch, entry, block, undo);
+
+  /* Update the coin stats. */
+  btc_chaindb_apply_stats(db, entry, block, undo, 1);
 
   /* Commit new coin state. */
-  btc_chaindb_save_view(db, batch, view);
+  btc_chaindb_save_view(db, view);
 
   /* Write undo coins (if there are any). */
-  undo = &view->undo;
 
   if (undo->length != 0 && entry->undo_pos == -1) {
     if (!btc_chaindb_write_undo(db, batch, entry, undo))
       return 0;
   }
 
+  /* Filters may be queued by undo position. */
+  if (db->flags & BTC_CHAIN_FILTERINDEX)
+    btc_chaindb_index_filter(db, batch, entry, block, undo);
+
   /* Prune height-288 if pruning is enabled. */
   return btc_chaindb_prune_files(db, batch, entry);
 }
 
 static btc_view_t *
 btc_chaindb_disconnect_block(btc_chaindb_t *db,
-                             ldb_batch_t *batch,
                              const btc_entry_t *entry,
                              const btc_block_t *block) {
   btc_undo_t *undo = btc_chaindb_read_undo(db, entry);
@@ -1139,6 +2666,8 @@ btc_chaindb_disconnect_block(btc_chaindb_t *db,
   if (undo == NULL)
     return NULL;
 
+  btc_chaindb_apply_stats(db, entry, block, undo, -1);
+
   view = btc_view_create();
 
   /* Disconnect all transactions. */
@@ -1164,11 +2693,110 @@ btc_chaindb_disconnect_block(btc_chaindb_t *db,
   btc_undo_destroy(undo);
 
   /* Commit new coin state. */
-  btc_chaindb_save_view(db, batch, view);
+  btc_chaindb_save_view(db, view);
 
   return view;
 }
 
+static int
+btc_chaindb_replay_block(btc_chaindb_t *db, const btc_entry_t *entry) {
+  btc_block_t *block = btc_chaindb_read_block(db, entry);
+  btc_view_t *view;
+  int ret = 0;
+  size_t i;
+
+  if (block == NULL)
+    return 0;
+
+  view = btc_view_create();
+
+  for (i = 0; i < block->txs.length; i++) {
+    const btc_tx_t *tx = block->txs.items[i];
+
+    if (i > 0) {
+      if (!btc_chaindb_spend(db, view, tx))
+        goto fail;
+    }
+
+    btc_view_add(view, tx, entry->height, 0);
+  }
+
+  btc_chaindb_apply_stats(db, entry, block, &view->undo, 1);
+  btc_chaindb_save_view(db, view);
+
+  ret = 1;
+fail:
+  btc_view_destroy(view);
+  btc_block_destroy(block);
+  return ret;
+}
+
+static int
+btc_chaindb_load_coins(btc_chaindb_t *db) {
+  const btc_entry_t *entry;
+  btc_block_t *block;
+  btc_view_t *view;
+  ldb_slice_t val;
+  int32_t height;
+  int rc;
+
+  /* Read the tip our coins were last flushed at. */
+  rc = ldb_get(db->lsm, &btc_coins_key, &val, 0);
+
+  if (rc == LDB_NOTFOUND) {
+    /* Older database: coins were written with every block. */
+    db->flushed = db->tail;
+    return 1;
+  }
+
+  CHECK(rc == LDB_OK);
+  CHECK(val.size == 32);
+
+  db->flushed = btc_hashmap_get(&db->hashes, val.data);
+
+  ldb_free(val.data);
+
+  CHECK(db->flushed != NULL);
+
+  if (db->flushed == db->tail)
+    return 1;
+
+  /* Undo any blocks that were disconnected after the flush. */
+  entry = db->flushed;
+
+  while (!btc_chaindb_is_main(db, entry)) {
+    block = btc_chaindb_read_block(db, entry);
+
+    if (block == NULL)
+      goto fail;
+
+    view = btc_chaindb_disconnect_block(db, entry, block);
+
+    btc_block_destroy(block);
+
+    if (view == NULL)
+      goto fail;
+
+    btc_view_destroy(view);
+
+    entry = entry->prev;
+  }
+
+  /* Redo everything from there up to the tip. */
+  for (height = entry->height + 1; height <= db->tail->height; height++) {
+    entry = db->heights.items[height];
+
+    if (!btc_chaindb_replay_block(db, entry))
+      goto fail;
+  }
+
+  return btc_chaindb_flush_coins(db);
+fail:
+  fprintf(stderr, "Could not replay block %d for coin state.\n",
+                  entry->height);
+  return 0;
+}
+
 static int
 btc_chaindb_save_block(btc_chaindb_t *db,
                        ldb_batch_t *batch,
@@ -1187,12 +2815,44 @@ btc_chaindb_save_block(btc_chaindb_t *db,
   return btc_chaindb_connect_block(db, batch, entry, block, view);
 }
 
+btc_entry_t *
+btc_chaindb_entry_create(btc_chaindb_t *db) {
+  return btc_arena_alloc(&db->entries);
+}
+
+void
+btc_chaindb_entry_destroy(btc_chaindb_t *db, btc_entry_t *entry) {
+  /* Only for entries which were never saved. */
+  btc_arena_free(&db->entries, entry);
+}
+
+static void
+btc_chaindb_put_entry(btc_chaindb_t *db,
+                      ldb_batch_t *batch,
+                      const btc_entry_t *entry) {
+  uint8_t vbuf[BTC_ENTRY_SIZE];
+  uint8_t kbuf[ENTRY_KEYLEN];
+  ldb_slice_t key, val;
+
+  key.data = kbuf;
+  key.size = btc_entry_key(kbuf, entry->hash);
+
+  val.data = vbuf;
+  val.size = btc_entry_export(vbuf, entry);
+
+  ldb_batch_put(batch, &key, &val);
+
+  /* Journal it for the next index load. */
+  key.size = journal_key(kbuf, db->journal++);
+
+  ldb_batch_put(batch, &key, &val);
+}
+
 int
 btc_chaindb_save(btc_chaindb_t *db,
                  btc_entry_t *entry,
                  const btc_block_t *block,
                  const btc_view_t *view) {
-  uint8_t vbuf[BTC_ENTRY_SIZE];
   uint8_t kbuf[ENTRY_KEYLEN];
   ldb_slice_t key, val;
   ldb_batch_t batch;
@@ -1210,25 +2870,21 @@ btc_chaindb_save(btc_chaindb_t *db,
     goto fail;
 
   /* Write entry data. */
-  key.data = kbuf;
-  key.size = entry_key(kbuf, entry->hash);
-
-  val.data = vbuf;
-  val.size = btc_entry_export(vbuf, entry);
-
-  ldb_batch_put(&batch, &key, &val);
+  btc_chaindb_put_entry(db, &batch, entry);
 
   /* Clear old tip. */
   if (entry->height != 0) {
     key.data = kbuf;
-    key.size = tip_key(kbuf, entry->header.prev_block);
+    key.size = btc_tip_key(kbuf, entry->header.prev_block);
 
     ldb_batch_del(&batch, &key);
   }
 
   /* Write new tip. */
   key.data = kbuf;
-  key.size = tip_key(kbuf, entry->hash);
+  key.size = btc_tip_key(kbuf, entry->hash);
+
+  val.data = kbuf;
   val.size = 1;
 
   ldb_batch_put(&batch, &key, &val);
@@ -1239,11 +2895,15 @@ btc_chaindb_save(btc_chaindb_t *db,
     val.data = entry->hash;
     val.size = 32;
 
-    ldb_batch_put(&batch, &meta_key, &val);
+    ldb_batch_put(&batch, &btc_meta_key, &val);
   }
 
+  /* Sync files near the tip and every so often. */
+  if (should_sync(entry) && !btc_chaindb_sync_files(db))
+    goto fail;
+
   /* Commit transaction. */
-  if (ldb_write(db->lsm, &batch, 0) != LDB_OK)
+  if (!btc_chaindb_commit(db, &batch))
     goto fail;
 
   /* Update hashes. */
@@ -1266,7 +2926,11 @@ btc_chaindb_save(btc_chaindb_t *db,
     db->tail = entry;
   }
 
-  ret = 1;
+  /* Let the backfill make progress. */
+  btc_chaindb_poll_indexers(db);
+
+  /* Write out coins if the cache is full. */
+  ret = btc_chaindb_maybe_flush(db);
 fail:
   ldb_batch_clear(&batch);
   return ret;
@@ -1277,10 +2941,8 @@ btc_chaindb_reconnect(btc_chaindb_t *db,
                       btc_entry_t *entry,
                       const btc_block_t *block,
                       const btc_view_t *view) {
-  uint8_t vbuf[BTC_ENTRY_SIZE];
-  uint8_t kbuf[ENTRY_KEYLEN];
-  ldb_slice_t key, val;
   ldb_batch_t batch;
+  ldb_slice_t val;
   int ret = 0;
 
   /* Begin transaction. */
@@ -1291,22 +2953,16 @@ btc_chaindb_reconnect(btc_chaindb_t *db,
     goto fail;
 
   /* Re-write entry data (we may have updated the undo pos). */
-  key.data = kbuf;
-  key.size = entry_key(kbuf, entry->hash);
-
-  val.data = vbuf;
-  val.size = btc_entry_export(vbuf, entry);
-
-  ldb_batch_put(&batch, &key, &val);
+  btc_chaindb_put_entry(db, &batch, entry);
 
   /* Commit new chain state. */
   val.data = entry->hash;
   val.size = 32;
 
-  ldb_batch_put(&batch, &meta_key, &val);
+  ldb_batch_put(&batch, &btc_meta_key, &val);
 
   /* Commit transaction. */
-  if (ldb_write(db->lsm, &batch, 0) != LDB_OK)
+  if (!btc_chaindb_commit(db, &batch))
     goto fail;
 
   /* Set next pointer. */
@@ -1321,7 +2977,8 @@ btc_chaindb_reconnect(btc_chaindb_t *db,
   /* Update tip. */
   db->tail = entry;
 
-  ret = 1;
+  /* Write out coins if the cache is full. */
+  ret = btc_chaindb_maybe_flush(db);
 fail:
   ldb_batch_clear(&batch);
   return ret;
@@ -1339,7 +2996,7 @@ btc_chaindb_disconnect(btc_chaindb_t *db,
   ldb_batch_init(&batch);
 
   /* Disconnect inputs. */
-  view = btc_chaindb_disconnect_block(db, &batch, entry, block);
+  view = btc_chaindb_disconnect_block(db, entry, block);
 
   if (view == NULL)
     goto fail;
@@ -1348,10 +3005,24 @@ btc_chaindb_disconnect(btc_chaindb_t *db,
   val.data = entry->header.prev_block;
   val.size = 32;
 
-  ldb_batch_put(&batch, &meta_key, &val);
+  ldb_batch_put(&batch, &btc_meta_key, &val);
+
+  /* Keep the backfills away from this block. */
+  btc_indexer_rewind(&db->txindex, entry->height);
+  btc_indexer_rewind(&db->addrindex, entry->height);
+  btc_indexer_rewind(&db->filterindex, entry->height);
+
+  if (db->flags & BTC_CHAIN_TXINDEX)
+    btc_chaindb_unindex_txs(db, &batch, entry);
+
+  if (db->flags & BTC_CHAIN_ADDRINDEX)
+    btc_chaindb_unindex_scripts(db, &batch, entry, block, view);
+
+  if (db->flags & BTC_CHAIN_FILTERINDEX)
+    btc_chaindb_unindex_filter(db, &batch, entry);
 
   /* Commit transaction. */
-  if (ldb_write(db->lsm, &batch, 0) != LDB_OK)
+  if (!btc_chaindb_commit(db, &batch))
     goto fail;
 
   /* Set next pointer. */
@@ -1365,6 +3036,9 @@ btc_chaindb_disconnect(btc_chaindb_t *db,
   /* Revert tip. */
   db->tail = entry->prev;
 
+  /* Write out coins if the cache is full. */
+  CHECK(btc_chaindb_maybe_flush(db));
+
   ldb_batch_clear(&batch);
 
   return view;
@@ -1392,6 +3066,16 @@ btc_chaindb_height(btc_chaindb_t *db) {
   return db->tail->height;
 }
 
+const btc_coinstats_t *
+btc_chaindb_coinstats(btc_chaindb_t *db) {
+  return &db->stats;
+}
+
+int32_t
+btc_chaindb_unvalidated(btc_chaindb_t *db) {
+  return db->unvalidated;
+}
+
 const btc_entry_t *
 btc_chaindb_by_hash(btc_chaindb_t *db, const uint8_t *hash) {
   return btc_hashmap_get(&db->hashes, hash);
@@ -1416,6 +3100,7 @@ btc_chaindb_is_main(btc_chaindb_t *db, const btc_entry_t *entry) {
 int
 btc_chaindb_has_coins(btc_chaindb_t *db, const btc_tx_t *tx) {
   uint8_t kbuf[COIN_KEYLEN];
+  btc_coinent_t *ent;
   ldb_slice_t key;
   size_t i;
   int rc;
@@ -1424,7 +3109,16 @@ btc_chaindb_has_coins(btc_chaindb_t *db, const btc_tx_t *tx) {
   key.size = sizeof(kbuf);
 
   for (i = 0; i < tx->outputs.length; i++) {
-    coin_key(kbuf, tx->hash, i);
+    ent = btc_coincache_get(&db->coins, tx->hash, i);
+
+    if (ent != NULL) {
+      if (ent->coin != NULL)
+        return 1;
+
+      continue;
+    }
+
+    btc_coin_key(kbuf, tx->hash, i);
 
     rc = ldb_has(db->lsm, &key, 0);
 
@@ -1455,6 +3149,29 @@ btc_chaindb_get_raw_block(btc_chaindb_t *db,
 
 }
 
+int
+btc_chaindb_get_block_data(btc_chaindb_t *db,
+                           uint8_t **data,
+                           size_t *length,
+                           const btc_entry_t *entry) {
+  if (entry->block_pos == -1)
+    return 0;
+
+  if (!btc_chaindb_sync(db, BLOCK_FILE, entry->block_file))
+    return 0;
+
+  return btc_chaindb_pread_ex(db, data, length, BLOCK_FILE,
+                              entry->block_file, entry->block_pos, 1);
+}
+
+int
+btc_chaindb_undo_version(btc_chaindb_t *db, const btc_entry_t *entry) {
+  if (entry->undo_pos == -1)
+    return -1;
+
+  return btc_chaindb_version(db, UNDO_FILE, entry->undo_file);
+}
+
 btc_view_t *
 btc_chaindb_get_undo(btc_chaindb_t *db,
                      const btc_entry_t *entry,
@@ -1490,3 +3207,393 @@ btc_chaindb_get_undo(btc_chaindb_t *db,
 
   return view;
 }
+
+/*
+ * Pruning
+ */
+
+static int32_t
+btc_chaindb_prune_point(btc_chaindb_t *db) {
+  int32_t min = db->block.min_height;
+  btc_chainfile_t *file;
+
+  for (file = db->files.head; file != NULL; file = file->next) {
+    if (file->type != BLOCK_FILE || file->min_height == -1)
+      continue;
+
+    if (min == -1 || file->min_height < min)
+      min = file->min_height;
+  }
+
+  if (min == -1)
+    return db->tail->height;
+
+  return min - 1;
+}
+
+int
+btc_chaindb_prune(btc_chaindb_t *db, int32_t height, int32_t *pruned) {
+  btc_chainfile_t *file, *next;
+  ldb_batch_t batch;
+  int ret = 0;
+
+  if (!(db->flags & BTC_CHAIN_PRUNE))
+    return 0;
+
+  /* Leave the history below an unvalidated
+     snapshot alone until it is validated. */
+  if (height <= db->unvalidated)
+    return 0;
+
+  height = btc_chaindb_prune_height(db, db->tail->height, height);
+
+  ldb_batch_init(&batch);
+
+  for (file = db->files.head; file != NULL; file = next) {
+    next = file->next;
+
+    if (file->max_height > height)
+      continue;
+
+    btc_chaindb_remove_file(db, &batch, file);
+  }
+
+  if (!btc_chaindb_commit(db, &batch))
+    goto fail;
+
+  *pruned = btc_chaindb_prune_point(db);
+
+  ret = 1;
+fail:
+  ldb_batch_clear(&batch);
+  return ret;
+}
+
+/*
+ * Index Snapshot
+ */
+
+#define INDEX_MAGIC 0x78646e69 /* "indx" */
+#define INDEX_VERSION 1
+#define INDEX_RECORD (32 + BTC_ENTRY_SIZE)
+
+static void
+btc_chaindb_index_path(btc_chaindb_t *db, char *path, const char *ext) {
+#if defined(_WIN32)
+  sprintf(path, "%s\\blocks\\index%s", db->prefix, ext);
+#else
+  sprintf(path, "%s/blocks/index%s", db->prefix, ext);
+#endif
+}
+
+static int
+btc_record_read(btc_entry_t *z, const uint8_t **xp, size_t *xn) {
+  /* Like btc_entry_read, minus the header hashing. */
+  if (!btc_raw_read(z->hash, 32, xp, xn))
+    return 0;
+
+  if (!btc_header_read(&z->header, xp, xn))
+    return 0;
+
+  if (!btc_int32_read(&z->height, xp, xn))
+    return 0;
+
+  if (!btc_raw_read(z->chainwork, 32, xp, xn))
+    return 0;
+
+  if (!btc_int32_read(&z->block_file, xp, xn))
+    return 0;
+
+  if (!btc_int32_read(&z->block_pos, xp, xn))
+    return 0;
+
+  if (!btc_int32_read(&z->undo_file, xp, xn))
+    return 0;
+
+  if (!btc_int32_read(&z->undo_pos, xp, xn))
+    return 0;
+
+  return 1;
+}
+
+static int
+btc_chaindb_read_records(btc_chaindb_t *db, const uint8_t *checksum) {
+  const uint8_t *xp;
+  uint8_t *data = NULL;
+  char path[BTC_PATH_MAX];
+  uint32_t magic, version;
+  uint32_t network, count;
+  uint8_t hash[32];
+  btc_entry_t *entry;
+  size_t xn, len;
+  int ret = 0;
+
+  btc_chaindb_index_path(db, path, ".dat");
+
+  /* One read for the whole index. */
+  if (!btc_fs_read_file(path, &data, &len))
+    return 0;
+
+  if (len < 16 + 32)
+    goto fail;
+
+  btc_sha256(hash, data, len - 32);
+
+  if (!btc_hash_equal(hash, data + len - 32))
+    goto fail;
+
+  /* Must be the file the database last committed to. */
+  if (!btc_hash_equal(hash, checksum))
+    goto fail;
+
+  xp = data;
+  xn = len - 32;
+
+  if (!btc_uint32_read(&magic, &xp, &xn) || magic != INDEX_MAGIC)
+    goto fail;
+
+  if (!btc_uint32_read(&version, &xp, &xn) || version != INDEX_VERSION)
+    goto fail;
+
+  if (!btc_uint32_read(&network, &xp, &xn))
+    goto fail;
+
+  if (network != db->network->magic)
+    goto fail;
+
+  if (!btc_uint32_read(&count, &xp, &xn))
+    goto fail;
+
+  if (xn != (size_t)count * INDEX_RECORD)
+    goto fail;
+
+  btc_hashmap_resize(&db->hashes, count);
+
+  while (count--) {
+    entry = btc_arena_alloc(&db->entries);
+
+    CHECK(btc_record_read(entry, &xp, &xn));
+
+    if (!btc_hashmap_put(&db->hashes, entry->hash, entry))
+      goto fail;
+  }
+
+  ret = 1;
+fail:
+  btc_free(data);
+  return ret;
+}
+
+static int
+btc_chaindb_read_journal(btc_chaindb_t *db) {
+  uint8_t kbuf[JOURNAL_KEYLEN];
+  btc_entry_t *entry, tmp;
+  ldb_slice_t key, val;
+  uint32_t seq;
+  ldb_iter_t *it;
+  int ret = 1;
+
+  key.data = kbuf;
+  key.size = journal_key(kbuf, db->journal);
+
+  it = ldb_iterator(db->lsm, 0);
+
+  /* Apply every entry written after the index. */
+  ldb_iter_range(it, &key, &journal_max) {
+    key = ldb_iter_key(it);
+    val = ldb_iter_value(it);
+
+    seq = btc_read32be((uint8_t *)key.data + 1);
+
+    if (seq != db->journal || !btc_entry_import(&tmp, val.data, val.size)) {
+      ret = 0;
+      break;
+    }
+
+    entry = btc_hashmap_get(&db->hashes, tmp.hash);
+
+    if (entry == NULL) {
+      entry = btc_arena_alloc(&db->entries);
+
+      btc_entry_copy(entry, &tmp);
+
+      /* The map keys on the entry's own hash. */
+      CHECK(btc_hashmap_put(&db->hashes, entry->hash, entry));
+    } else {
+      btc_entry_copy(entry, &tmp);
+    }
+
+    db->journal++;
+  }
+
+  if (ldb_iter_status(it) != LDB_OK)
+    ret = 0;
+
+  ldb_iter_destroy(it);
+
+  return ret;
+}
+
+static int
+btc_chaindb_read_index(btc_chaindb_t *db) {
+  ldb_slice_t val;
+  int rc;
+
+  rc = ldb_get(db->lsm, &btc_index_key, &val, 0);
+
+  if (rc == LDB_NOTFOUND)
+    return 0;
+
+  CHECK(rc == LDB_OK);
+
+  if (val.size != 36) {
+    ldb_free(val.data);
+    return 0;
+  }
+
+  db->journal = btc_read32be((uint8_t *)val.data + 32);
+  db->journal_base = db->journal;
+
+  if (!btc_chaindb_read_records(db, val.data))
+    goto fail;
+
+  if (!btc_chaindb_read_journal(db))
+    goto fail;
+
+  ldb_free(val.data);
+
+  db->index_valid = 1;
+
+  return 1;
+fail:
+  ldb_free(val.data);
+
+  btc_hashmap_reset(&db->hashes);
+  btc_arena_reset(&db->entries);
+
+  db->journal = 0;
+  db->journal_base = 0;
+
+  return 0;
+}
+
+static void
+btc_chaindb_scan_journal(btc_chaindb_t *db) {
+  ldb_slice_t key;
+  ldb_iter_t *it;
+
+  it = ldb_iterator(db->lsm, 0);
+
+  /* Keep numbering after whatever is left over. */
+  ldb_iter_range(it, &journal_min, &journal_max) {
+    key = ldb_iter_key(it);
+    db->journal = btc_read32be((uint8_t *)key.data + 1) + 1;
+  }
+
+  CHECK(ldb_iter_status(it) == LDB_OK);
+
+  ldb_iter_destroy(it);
+
+  db->journal_base = db->journal;
+  db->index_valid = 0;
+}
+
+static int
+btc_chaindb_write_index(btc_chaindb_t *db) {
+  uint8_t kbuf[JOURNAL_KEYLEN];
+  uint8_t raw[INDEX_RECORD];
+  char path[BTC_PATH_MAX];
+  char tmp[BTC_PATH_MAX];
+  uint8_t checksum[36];
+  btc_snapshot_t snap;
+  ldb_slice_t key, val;
+  btc_entry_t *entry;
+  ldb_batch_t batch;
+  btc_mapiter_t it;
+  ldb_iter_t *iter;
+  uint8_t *zp;
+  int ret = 0;
+
+  /* Journal keys must be on disk before we trim them. */
+  if (!btc_iowriter_flush(&db->writer))
+    return 0;
+
+  btc_chaindb_index_path(db, path, ".dat");
+  btc_chaindb_index_path(db, tmp, ".tmp");
+
+  if (!btc_snapshot_create(&snap, tmp))
+    goto done;
+
+  if (!btc_snapshot_write32(&snap, INDEX_MAGIC))
+    goto fail;
+
+  if (!btc_snapshot_write32(&snap, INDEX_VERSION))
+    goto fail;
+
+  if (!btc_snapshot_write32(&snap, db->network->magic))
+    goto fail;
+
+  if (!btc_snapshot_write32(&snap, db->hashes.size))
+    goto fail;
+
+  /* Records are written in map order. */
+  btc_map_each(&db->hashes, it) {
+    entry = db->hashes.vals[it];
+
+    zp = btc_raw_write(raw, entry->hash, 32);
+    zp = btc_entry_write(zp, entry);
+
+    if (!btc_snapshot_write(&snap, raw, zp - raw))
+      goto fail;
+  }
+
+  if (!btc_snapshot_commit(&snap, checksum))
+    goto fail;
+
+  btc_snapshot_close(&snap);
+
+  if (!btc_fs_rename(tmp, path))
+    goto done;
+
+  /* Point the database at the new file and drop
+     the journal entries it now contains. */
+  btc_write32be(checksum + 32, db->journal);
+
+  ldb_batch_init(&batch);
+
+  val.data = checksum;
+  val.size = 36;
+
+  ldb_batch_put(&batch, &btc_index_key, &val);
+
+  key.data = kbuf;
+  key.size = journal_key(kbuf, db->journal);
+
+  iter = ldb_iterator(db->lsm, 0);
+
+  ldb_iter_range(iter, &journal_min, &key) {
+    ldb_slice_t jkey = ldb_iter_key(iter);
+
+    if (ldb_compare(db->lsm, &jkey, &key) < 0)
+      ldb_batch_del(&batch, &jkey);
+  }
+
+  CHECK(ldb_iter_status(iter) == LDB_OK);
+
+  ldb_iter_destroy(iter);
+
+  if (btc_chaindb_commit(db, &batch) && btc_iowriter_flush(&db->writer)) {
+    db->journal_base = db->journal;
+    db->index_valid = 1;
+    ret = 1;
+  }
+
+  ldb_batch_clear(&batch);
+
+  goto done;
+fail:
+  btc_snapshot_close(&snap);
+  btc_fs_unlink(tmp);
+done:
+  return ret;
+}
@@ -0,0 +1,294 @@
+/*!
+ * chaindb_impl.h - chaindb internals for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#ifndef BTC_NODE_CHAINDB_IMPL_H_
+#define BTC_NODE_CHAINDB_IMPL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <io/core.h>
+
+#include <lcdb.h>
+
+#include <mako/map.h>
+#include <mako/types.h>
+
+#include <node/chaindb.h>
+#include <node/types.h>
+
+/*
+ * Constants
+ */
+
+#define BLOCK_FILE 0
+#define UNDO_FILE 1
+#define FD_CACHE_SIZE 64
+
+/*
+ * Chain File
+ */
+
+typedef struct btc_chainfile_s {
+  btc_fd_t fd;
+  uint8_t type;
+  int32_t id;
+  int32_t pos;
+  int32_t items;
+  int64_t min_time;
+  int64_t max_time;
+  int32_t min_height;
+  int32_t max_height;
+  uint8_t version;
+  struct btc_chainfile_s *prev;
+  struct btc_chainfile_s *next;
+  uint64_t seq;
+} btc_chainfile_t;
+
+/*
+ * Descriptor Cache
+ */
+
+typedef struct btc_fdent_s {
+  btc_fd_t fd;
+  int type;
+  int32_t id;
+  int refs;
+  int dead;
+  int64_t tick;
+} btc_fdent_t;
+
+typedef struct btc_fdcache_s {
+  btc_mutex_t lock;
+  btc_fdent_t *items[FD_CACHE_SIZE];
+  size_t length;
+  int64_t tick;
+} btc_fdcache_t;
+
+/*
+ * I/O Writer
+ */
+
+typedef struct btc_iojob_s {
+  int type;
+  btc_fd_t fd;
+  uint8_t *data;
+  size_t length;
+  ldb_batch_t batch;
+  struct btc_iojob_s *next;
+} btc_iojob_t;
+
+typedef struct btc_iowriter_s {
+  btc_mutex_t lock;
+  btc_cond_t master;
+  btc_cond_t worker;
+  btc_thread_t thread;
+  ldb_t *lsm;
+  btc_iojob_t *head;
+  btc_iojob_t *tail;
+  btc_fd_t dirty[4];
+  size_t dirty_len;
+  size_t pending;
+  uint64_t queued;
+  uint64_t written;
+  int threaded;
+  int running;
+  int error;
+  int stop;
+} btc_iowriter_t;
+
+/*
+ * Coin Cache
+ */
+
+typedef struct btc_coinent_s {
+  btc_outpoint_t key;
+  btc_coin_t *coin; /* NULL if spent. */
+  unsigned int flags;
+} btc_coinent_t;
+
+typedef struct btc_coincache_s {
+  btc_outmap_t map;
+  size_t usage;
+  size_t limit;
+} btc_coincache_t;
+
+/*
+ * Entry Arena
+ */
+
+typedef struct btc_arena_s {
+  btc_vector_t chunks;
+  size_t used;
+  btc_entry_t *free;
+} btc_arena_t;
+
+/*
+ * Indexer
+ */
+
+typedef struct btc_blockloc_s {
+  int32_t height;
+  int32_t block_file;
+  int32_t block_pos;
+  int32_t undo_file;
+  int32_t undo_pos;
+  int undo_version;
+  uint64_t seq;
+} btc_blockloc_t;
+
+typedef struct btc_filterhead_s {
+  uint8_t hash[32];
+  uint8_t header[32];
+} btc_filterhead_t;
+
+struct btc_indexer_s;
+
+typedef int btc_index_cb(struct btc_indexer_s *ix,
+                         ldb_batch_t *batch,
+                         const btc_blockloc_t *loc);
+
+typedef struct btc_indexer_s {
+  const char *name;
+  const ldb_slice_t *key;
+  btc_index_cb *index;
+  btc_mutex_t lock;
+  btc_thread_t thread;
+  struct btc_chaindb_s *db;
+  btc_blockloc_t *blocks;
+  size_t alloc;
+  size_t length;
+  size_t pos;
+  size_t busy;
+  int32_t start;
+  int32_t end;
+  int discard;
+  int threaded;
+  int running;
+  int synced;
+  int stop;
+} btc_indexer_t;
+
+/*
+ * Chain Database
+ */
+
+struct btc_chaindb_s {
+  const btc_network_t *network;
+  char prefix[BTC_PATH_MAX - 31];
+  unsigned int flags;
+  size_t cache_size;
+  uint64_t prune_target;
+  int32_t file_size;
+  int undo_version;
+  ldb_t *lsm;
+  ldb_lru_t *block_cache;
+  btc_hashmap_t hashes;
+  btc_vector_t heights;
+  btc_entry_t *head;
+  btc_entry_t *tail;
+  uint32_t journal;
+  uint32_t journal_base;
+  int index_valid;
+  int32_t unvalidated;
+  size_t import_limit;
+  const btc_entry_t *flushed;
+  int64_t flush_time;
+  struct btc_chainfiles_s {
+    btc_chainfile_t *head;
+    btc_chainfile_t *tail;
+    size_t length;
+    uint64_t size;
+  } files;
+  btc_chainfile_t block;
+  btc_chainfile_t undo;
+  btc_arena_t entries;
+  btc_fdcache_t fds;
+  btc_iowriter_t writer;
+  btc_indexer_t txindex;
+  btc_indexer_t addrindex;
+  btc_indexer_t filterindex;
+  btc_filterhead_t filter_tip;
+  btc_filterhead_t filter_last;
+  btc_coincache_t coins;
+  btc_coinstats_t stats;
+  uint8_t *slab;
+};
+
+/*
+ * Descriptor Cache
+ */
+
+void
+btc_fdcache_release(btc_fdcache_t *cache, btc_fdent_t *ent);
+
+/*
+ * I/O Writer
+ */
+
+int
+btc_iowriter_wait(btc_iowriter_t *w, uint64_t seq);
+
+int
+btc_iowriter_flush(btc_iowriter_t *w);
+
+/*
+ * Entry Arena
+ */
+
+btc_entry_t *
+btc_arena_alloc(btc_arena_t *arena);
+
+/*
+ * Coin Stats
+ */
+
+void
+btc_coinstats_init(btc_coinstats_t *stats);
+
+size_t
+btc_coinstats_export(uint8_t *zp, const btc_coinstats_t *x);
+
+void
+btc_coinstats_update(btc_coinstats_t *stats,
+                     const uint8_t *hash,
+                     uint32_t index,
+                     int32_t height,
+                     int coinbase,
+                     const btc_output_t *output,
+                     int sign);
+
+/*
+ * Chain Database
+ */
+
+int
+btc_chaindb_flush_coins(btc_chaindb_t *db);
+
+btc_fdent_t *
+btc_chaindb_acquire(btc_chaindb_t *db, int type, int32_t id);
+
+int
+btc_chaindb_sync(btc_chaindb_t *db, int type, int id);
+
+int
+btc_chaindb_pread(btc_chaindb_t *db,
+                  uint8_t **raw,
+                  size_t *len,
+                  int type,
+                  int id,
+                  int pos);
+
+int
+btc_chaindb_version(btc_chaindb_t *db, int type, int32_t id);
+
+btc_undo_t *
+btc_chaindb_decode_undo(const uint8_t *xp,
+                        size_t xn,
+                        int version,
+                        uint8_t *slab);
+
+#endif /* BTC_NODE_CHAINDB_IMPL_H_ */
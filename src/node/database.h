@@ -0,0 +1,98 @@
+/*!
+ * database.h - chaindb database for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#ifndef BTC_NODE_DATABASE_H_
+#define BTC_NODE_DATABASE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <lcdb.h>
+
+/*
+ * Database Keys
+ *
+ * Layout:
+ *
+ *   R -> chain tip
+ *   C -> flushed coins tip
+ *   B -> current block file
+ *   U -> current undo file
+ *   S -> coin stats
+ *   I -> block index snapshot
+ *   X -> UTXO snapshot import in progress
+ *   V -> unvalidated UTXO snapshot height
+ *   T -> txindex tip
+ *   A -> addrindex tip
+ *   F -> filterindex tip
+ *
+ *   e[hash] -> entry
+ *   p[hash] -> chain tip
+ *   f[type][id] -> block/undo file
+ *   j[seq] -> index journal
+ *   c[hash][index] -> coin
+ *
+ *   t[hash] -> tx location
+ *   h[script-hash][height][hash] -> history
+ *   o[script-hash][hash][index] -> unspent output
+ *   g[hash] -> filter
+ *   k[hash] -> filter hash and header
+ */
+
+#define ENTRY_PREFIX 'e'
+#define ENTRY_KEYLEN 33
+
+#define TIP_PREFIX 'p'
+#define TIP_KEYLEN 33
+
+#define FILE_PREFIX 'f'
+#define FILE_KEYLEN 6
+
+#define JOURNAL_PREFIX 'j'
+#define JOURNAL_KEYLEN 5
+
+#define TX_PREFIX 't'
+#define TX_KEYLEN 33
+
+#define HISTORY_PREFIX 'h'
+#define HISTORY_KEYLEN 69
+
+#define UNSPENT_PREFIX 'o'
+#define UNSPENT_KEYLEN 69
+
+#define FILTER_PREFIX 'g'
+#define FILTER_KEYLEN 33
+
+/* Filter hash and header, kept apart from the
+   filter itself so header requests stay cheap. */
+#define FILTERHDR_PREFIX 'k'
+#define FILTERHDR_KEYLEN 33
+
+#define COIN_PREFIX 'c'
+#define COIN_KEYLEN 37
+
+/*
+ * Shared Keys
+ */
+
+extern const ldb_slice_t btc_meta_key;
+extern const ldb_slice_t btc_coins_key;
+extern const ldb_slice_t btc_stats_key;
+extern const ldb_slice_t btc_index_key;
+extern const ldb_slice_t btc_entry_min;
+extern const ldb_slice_t btc_entry_max;
+extern const ldb_slice_t btc_coin_min;
+extern const ldb_slice_t btc_coin_max;
+
+size_t
+btc_entry_key(uint8_t *key, const uint8_t *hash);
+
+size_t
+btc_tip_key(uint8_t *key, const uint8_t *hash);
+
+size_t
+btc_coin_key(uint8_t *key, const uint8_t *hash, uint32_t index);
+
+#endif /* BTC_NODE_DATABASE_H_ */
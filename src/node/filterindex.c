@@ -0,0 +1,328 @@
+/*!
+ * filterindex.c - chaindb filter index for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <mako/bip158.h>
+#include <mako/block.h>
+#include <mako/coins.h>
+#include <mako/entry.h>
+#include <mako/header.h>
+#include <mako/script.h>
+#include <mako/tx.h>
+#include <mako/util.h>
+
+#include <lcdb.h>
+
+#include "../bio.h"
+#include "../impl.h"
+#include "../internal.h"
+
+#include "chaindb_impl.h"
+#include "database.h"
+#include "filterindex.h"
+#include "indexer.h"
+
+/*
+ * Database Keys
+ */
+
+static size_t
+filter_key(uint8_t *key, const uint8_t *hash) {
+  key[0] = FILTER_PREFIX;
+  memcpy(key + 1, hash, 32);
+  return FILTER_KEYLEN;
+}
+
+static size_t
+filterhdr_key(uint8_t *key, const uint8_t *hash) {
+  key[0] = FILTERHDR_PREFIX;
+  memcpy(key + 1, hash, 32);
+  return FILTERHDR_KEYLEN;
+}
+
+/*
+ * Filter Indexing
+ */
+
+static void
+btc_filterindex_put(ldb_batch_t *batch,
+                    btc_filterhead_t *last,
+                    const uint8_t *hash,
+                    const btc_blockfilter_t *filter,
+                    const uint8_t *prev) {
+  uint8_t kbuf[FILTER_KEYLEN];
+  uint8_t vbuf[64];
+  ldb_slice_t key, val;
+
+  btc_blockfilter_hash(vbuf, filter);
+  btc_blockfilter_header(vbuf + 32, filter, prev);
+
+  key.data = kbuf;
+  key.size = filter_key(kbuf, hash);
+
+  val.data = filter->data;
+  val.size = filter->size;
+
+  ldb_batch_put(batch, &key, &val);
+
+  key.size = filterhdr_key(kbuf, hash);
+
+  val.data = vbuf;
+  val.size = 64;
+
+  ldb_batch_put(batch, &key, &val);
+
+  memcpy(last->hash, hash, 32);
+  memcpy(last->header, vbuf + 32, 32);
+}
+
+static int
+btc_filterindex_read(btc_chaindb_t *db,
+                     uint8_t *filter_hash,
+                     uint8_t *header,
+                     const uint8_t *hash) {
+  uint8_t kbuf[FILTERHDR_KEYLEN];
+  ldb_slice_t key, val;
+  int rc, ret = 0;
+
+  key.data = kbuf;
+  key.size = filterhdr_key(kbuf, hash);
+
+  rc = ldb_get(db->lsm, &key, &val, 0);
+
+  if (rc != LDB_OK) {
+    if (rc != LDB_NOTFOUND)
+      fprintf(stderr, "ldb_get: %s\n", ldb_strerror(rc));
+
+    return 0;
+  }
+
+  if (val.size == 64) {
+    if (filter_hash != NULL)
+      memcpy(filter_hash, val.data, 32);
+
+    if (header != NULL)
+      memcpy(header, (uint8_t *)val.data + 32, 32);
+
+    ret = 1;
+  }
+
+  ldb_free(val.data);
+
+  return ret;
+}
+
+static int
+btc_filterindex_prev(btc_chaindb_t *db,
+                     const btc_filterhead_t *last,
+                     uint8_t *header,
+                     const uint8_t *prev) {
+  if (btc_hash_is_null(prev)) {
+    btc_hash_init(header);
+    return 1;
+  }
+
+  if (btc_hash_equal(prev, last->hash)) {
+    btc_hash_copy(header, last->header);
+    return 1;
+  }
+
+  return btc_filterindex_read(db, NULL, header, prev);
+}
+
+void
+btc_chaindb_index_filter(btc_chaindb_t *db,
+                         ldb_batch_t *batch,
+                         const btc_entry_t *entry,
+                         const btc_block_t *block,
+                         const btc_undo_t *undo) {
+  const uint8_t *prev_block = entry->header.prev_block;
+  btc_blockfilter_t filter;
+  uint8_t prev[32];
+
+  /* Each header commits to the one before it, so the
+     backfill keeps the queue until it catches up. */
+  if (btc_indexer_push(&db->filterindex, entry))
+    return;
+
+  if (!btc_filterindex_prev(db, &db->filter_tip, prev, prev_block)) {
+    /* After a reorg, it may still be waiting to be written. */
+    btc_iowriter_flush(&db->writer);
+
+    if (!btc_filterindex_prev(db, &db->filter_tip, prev, prev_block)) {
+      fprintf(stderr, "filterindex: missing header for %d.\n",
+                      (int)entry->height - 1);
+      return;
+    }
+  }
+
+  btc_blockfilter_init(&filter);
+  btc_blockfilter_set_block(&filter, block, undo);
+
+  btc_filterindex_put(batch, &db->filter_tip, entry->hash, &filter, prev);
+
+  btc_blockfilter_clear(&filter);
+
+  btc_indexer_connect(&db->filterindex, batch, entry);
+}
+
+void
+btc_chaindb_unindex_filter(btc_chaindb_t *db,
+                           ldb_batch_t *batch,
+                           const btc_entry_t *entry) {
+  /* Filters are keyed by block hash and stay valid. */
+  btc_indexer_disconnect(&db->filterindex, batch, entry);
+}
+
+int
+btc_filterindex_backfill(btc_indexer_t *ix,
+                         ldb_batch_t *batch,
+                         const btc_blockloc_t *blk) {
+  btc_chaindb_t *db = ix->db;
+  btc_blockfilter_t filter;
+  btc_undo_t *undo = NULL;
+  uint8_t hash[32], prev[32];
+  btc_rawblock_t block;
+  const btc_coin_t *coin;
+  btc_output_t output;
+  size_t xn, in, size, len;
+  const uint8_t *xp, *ip;
+  uint8_t *data, *buf;
+  size_t i, j, k = 0;
+  btc_rawtx_t tx;
+  int ret = 0;
+
+  if (!btc_chaindb_pread(db, &data, &size, BLOCK_FILE, blk->block_file,
+                                                       blk->block_pos)) {
+    return 0;
+  }
+
+  btc_blockfilter_init(&filter);
+
+  if (blk->undo_pos == -1) {
+    undo = btc_undo_create();
+  } else if (btc_chaindb_pread(db, &buf, &len, UNDO_FILE, blk->undo_file,
+                                                          blk->undo_pos)) {
+    undo = btc_chaindb_decode_undo(buf + 24, len - 24,
+                                   blk->undo_version, NULL);
+    free(buf);
+  }
+
+  if (undo == NULL)
+    goto fail;
+
+  if (!btc_rawblock_import(&block, data + 24, size - 24))
+    goto fail;
+
+  btc_header_hash(hash, &block.header);
+  btc_blockfilter_reset(&filter, hash);
+
+  xp = block.txs.data;
+  xn = block.txs.size;
+
+  for (i = 0; i < block.txs.length; i++) {
+    CHECK(btc_rawtx_read(&tx, &xp, &xn));
+
+    if (i > 0) {
+      for (j = 0; j < tx.inputs.length; j++) {
+        if (k == undo->length)
+          goto fail;
+
+        coin = undo->items[k++];
+
+        btc_blockfilter_add(&filter, coin->output.script.data,
+                                     coin->output.script.length);
+      }
+    }
+
+    ip = tx.outputs.data;
+    in = tx.outputs.size;
+
+    for (j = 0; j < tx.outputs.length; j++) {
+      CHECK(btc_rawoutput_read(&output, &ip, &in));
+
+      if (output.script.length > 0
+          && output.script.data[0] == BTC_OP_RETURN) {
+        continue;
+      }
+
+      btc_blockfilter_add(&filter, output.script.data,
+                                   output.script.length);
+    }
+  }
+
+  if (k != undo->length)
+    goto fail;
+
+  if (!btc_filterindex_prev(db, &db->filter_last, prev,
+                            block.header.prev_block)) {
+    goto fail;
+  }
+
+  btc_blockfilter_finalize(&filter);
+
+  btc_filterindex_put(batch, &db->filter_last, hash, &filter, prev);
+
+  ret = 1;
+fail:
+  btc_blockfilter_clear(&filter);
+
+  if (undo != NULL)
+    btc_undo_destroy(undo);
+
+  free(data);
+
+  return ret;
+}
+
+int
+btc_chaindb_get_filter(btc_chaindb_t *db,
+                       uint8_t **data,
+                       size_t *length,
+                       const uint8_t *hash) {
+  uint8_t kbuf[FILTER_KEYLEN];
+  ldb_slice_t key, val;
+  int rc;
+
+  if (!(db->flags & BTC_CHAIN_FILTERINDEX))
+    return 0;
+
+  key.data = kbuf;
+  key.size = filter_key(kbuf, hash);
+
+  rc = ldb_get(db->lsm, &key, &val, 0);
+
+  if (rc != LDB_OK) {
+    if (rc != LDB_NOTFOUND)
+      fprintf(stderr, "ldb_get: %s\n", ldb_strerror(rc));
+
+    return 0;
+  }
+
+  *data = (uint8_t *)btc_malloc(val.size);
+  *length = val.size;
+
+  memcpy(*data, val.data, val.size);
+
+  ldb_free(val.data);
+
+  return 1;
+}
+
+int
+btc_chaindb_get_filter_header(btc_chaindb_t *db,
+                              uint8_t *filter_hash,
+                              uint8_t *header,
+                              const uint8_t *hash) {
+  if (!(db->flags & BTC_CHAIN_FILTERINDEX))
+    return 0;
+
+  return btc_filterindex_read(db, filter_hash, header, hash);
+}
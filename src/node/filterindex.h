@@ -0,0 +1,34 @@
+/*!
+ * filterindex.h - chaindb filter index for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#ifndef BTC_NODE_FILTERINDEX_H_
+#define BTC_NODE_FILTERINDEX_H_
+
+#include <lcdb.h>
+#include "chaindb_impl.h"
+
+/*
+ * Filter Indexing
+ */
+
+void
+btc_chaindb_index_filter(btc_chaindb_t *db,
+                         ldb_batch_t *batch,
+                         const btc_entry_t *entry,
+                         const btc_block_t *block,
+                         const btc_undo_t *undo);
+
+void
+btc_chaindb_unindex_filter(btc_chaindb_t *db,
+                           ldb_batch_t *batch,
+                           const btc_entry_t *entry);
+
+int
+btc_filterindex_backfill(btc_indexer_t *ix,
+                         ldb_batch_t *batch,
+                         const btc_blockloc_t *loc);
+
+#endif /* BTC_NODE_FILTERINDEX_H_ */
@@ -0,0 +1,364 @@
+/*!
+ * indexer.c - chaindb indexer for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <io/core.h>
+
+#include <mako/entry.h>
+#include <mako/util.h>
+
+#include <lcdb.h>
+
+#include "../bio.h"
+#include "../internal.h"
+
+#include "chaindb_impl.h"
+#include "indexer.h"
+
+/*
+ * Constants
+ */
+
+#define INDEXER_BATCH 100
+
+/*
+ * Indexer
+ */
+
+void
+btc_indexer_init(btc_indexer_t *ix,
+                 const char *name,
+                 const ldb_slice_t *key,
+                 int32_t start,
+                 btc_index_cb *index) {
+  memset(ix, 0, sizeof(*ix));
+  btc_mutex_init(&ix->lock);
+
+  ix->name = name;
+  ix->key = key;
+  ix->start = start;
+  ix->index = index;
+}
+
+void
+btc_indexer_clear(btc_indexer_t *ix) {
+  CHECK(!ix->running);
+  btc_mutex_destroy(&ix->lock);
+}
+
+static int
+btc_indexer_synced(btc_indexer_t *ix) {
+  int synced;
+
+  btc_mutex_lock(&ix->lock);
+  synced = ix->synced;
+  btc_mutex_unlock(&ix->lock);
+
+  return synced;
+}
+
+void
+btc_indexer_rewind(btc_indexer_t *ix, int32_t height) {
+  /* Called before `height` is disconnected. Anything the
+     backfill has not committed at or above it is dropped;
+     the block's replacement gets indexed live instead. */
+  btc_mutex_lock(&ix->lock);
+
+  if (ix->running && !ix->synced && height <= ix->end) {
+    ix->end = height - 1;
+
+    while (ix->length > 0 && ix->blocks[ix->length - 1].height > ix->end)
+      ix->length--;
+
+    if (ix->pos > ix->length)
+      ix->pos = ix->length;
+
+    /* The batch in progress is stale. */
+    if (ix->busy > ix->length)
+      ix->discard = 1;
+  }
+
+  btc_mutex_unlock(&ix->lock);
+}
+
+/*
+ * Indexing
+ */
+
+static void
+btc_indexer_put_tip(btc_indexer_t *ix, ldb_batch_t *batch, int32_t height) {
+  uint8_t vbuf[4];
+  ldb_slice_t val;
+
+  btc_write32le(vbuf, height);
+
+  val.data = vbuf;
+  val.size = 4;
+
+  ldb_batch_put(batch, ix->key, &val);
+}
+
+void
+btc_indexer_connect(btc_indexer_t *ix,
+                    ldb_batch_t *batch,
+                    const btc_entry_t *entry) {
+  /* The backfill owns the tip until it catches up. */
+  if (btc_indexer_synced(ix))
+    btc_indexer_put_tip(ix, batch, entry->height + 1);
+}
+
+void
+btc_indexer_disconnect(btc_indexer_t *ix,
+                       ldb_batch_t *batch,
+                       const btc_entry_t *entry) {
+  if (btc_indexer_synced(ix))
+    btc_indexer_put_tip(ix, batch, entry->height);
+}
+
+static void
+btc_blockloc_set(btc_blockloc_t *loc,
+                 btc_chaindb_t *db,
+                 const btc_entry_t *entry) {
+  loc->height = entry->height;
+  loc->block_file = entry->block_file;
+  loc->block_pos = entry->block_pos;
+  loc->undo_file = entry->undo_file;
+  loc->undo_pos = entry->undo_pos;
+  loc->undo_version = 0;
+
+  if (entry->undo_pos != -1)
+    loc->undo_version = btc_chaindb_version(db, UNDO_FILE, entry->undo_file);
+
+  /* Freshly connected blocks may not have hit the disk yet. */
+  loc->seq = db->writer.queued;
+}
+
+int
+btc_indexer_push(btc_indexer_t *ix, const btc_entry_t *entry) {
+  /* Hand a newly connected block to the backfill. Used
+     by indexes which must see blocks strictly in order. */
+  int ret = 0;
+
+  btc_mutex_lock(&ix->lock);
+
+  if (ix->running && !ix->synced) {
+    if (ix->length == ix->alloc) {
+      ix->alloc = ix->alloc == 0 ? 64 : ix->alloc * 2;
+      ix->blocks = (btc_blockloc_t *)btc_realloc(ix->blocks,
+        ix->alloc * sizeof(btc_blockloc_t));
+    }
+
+    btc_blockloc_set(&ix->blocks[ix->length++], ix->db, entry);
+
+    ix->end = entry->height;
+
+    ret = 1;
+  }
+
+  btc_mutex_unlock(&ix->lock);
+
+  return ret;
+}
+
+static int
+btc_indexer_step(btc_indexer_t *ix) {
+  btc_blockloc_t locs[INDEXER_BATCH];
+  ldb_batch_t batch;
+  size_t i, count;
+  int done, ok = 1;
+  int32_t height;
+
+  /* Work from a copy; the queue may grow meanwhile. */
+  btc_mutex_lock(&ix->lock);
+
+  count = BTC_MIN(ix->length - ix->pos, INDEXER_BATCH);
+
+  if (count > 0)
+    memcpy(locs, &ix->blocks[ix->pos], count * sizeof(btc_blockloc_t));
+
+  ix->busy = ix->pos + count;
+  ix->discard = 0;
+
+  btc_mutex_unlock(&ix->lock);
+
+  ldb_batch_init(&batch);
+
+  if (count > 0 && !btc_iowriter_wait(&ix->db->writer, locs[count - 1].seq))
+    ok = 0;
+
+  for (i = 0; i < count && ok; i++) {
+    if (!ix->index(ix, &batch, &locs[i])) {
+      fprintf(stderr, "%s: could not index block %d.\n",
+                      ix->name, (int)locs[i].height);
+      ok = 0;
+      break;
+    }
+  }
+
+  btc_mutex_lock(&ix->lock);
+
+  if (ix->discard) {
+    /* A reorg took blocks out from under us. */
+    ix->discard = 0;
+  } else if (ok) {
+    ix->pos += count;
+
+    if (ix->pos < ix->length)
+      height = ix->blocks[ix->pos].height;
+    else
+      height = ix->end + 1;
+
+    /* Record progress so a restart resumes here. */
+    btc_indexer_put_tip(ix, &batch, height);
+
+    ok = (ldb_write(ix->db->lsm, &batch, 0) == LDB_OK);
+
+    if (ok && ix->pos == ix->length)
+      ix->synced = 1;
+  }
+
+  ix->busy = 0;
+
+  done = !ok || ix->synced || ix->stop;
+
+  btc_mutex_unlock(&ix->lock);
+
+  ldb_batch_clear(&batch);
+
+  return !done;
+}
+
+static void
+indexer_thread(void *arg) {
+  btc_indexer_t *ix = (btc_indexer_t *)arg;
+
+  while (btc_indexer_step(ix))
+    ;
+}
+
+static void
+btc_indexer_poll(btc_indexer_t *ix) {
+  /* Without threads, piggyback on block connection. */
+  if (ix->running && !ix->threaded && !ix->synced && !ix->stop) {
+    if (!btc_indexer_step(ix))
+      ix->stop = !ix->synced;
+  }
+}
+
+static int
+btc_indexer_open(btc_indexer_t *ix, btc_chaindb_t *db) {
+  const btc_entry_t *entry;
+  int32_t height = ix->start;
+  ldb_slice_t val;
+  int rc;
+
+  rc = ldb_get(db->lsm, ix->key, &val, 0);
+
+  if (rc == LDB_OK) {
+    if (val.size == 4)
+      height = BTC_MAX(ix->start, (int32_t)btc_read32le(val.data));
+
+    ldb_free(val.data);
+  } else if (rc != LDB_NOTFOUND) {
+    fprintf(stderr, "ldb_get: %s\n", ldb_strerror(rc));
+    return 0;
+  }
+
+  ix->db = db;
+  ix->end = db->tail->height;
+  ix->running = 1;
+
+  if (height > ix->end) {
+    ix->synced = 1;
+    return 1;
+  }
+
+  /* Blocks connected from now on are indexed as they come
+     in. Everything up to the current tip is left to the
+     backfill, which works from a copy of the locations. */
+  ix->alloc = ix->end - height + 1;
+  ix->blocks = (btc_blockloc_t *)btc_malloc(ix->alloc
+                                            * sizeof(btc_blockloc_t));
+
+  for (; height <= ix->end; height++) {
+    entry = (btc_entry_t *)db->heights.items[height];
+
+    if (entry->block_pos == -1)
+      continue;
+
+    btc_blockloc_set(&ix->blocks[ix->length++], db, entry);
+  }
+
+#if defined(_WIN32) || defined(BTC_PTHREAD)
+  btc_thread_create(&ix->thread, indexer_thread, ix);
+  ix->threaded = 1;
+#endif
+
+  return 1;
+}
+
+static void
+btc_indexer_close(btc_indexer_t *ix) {
+  if (!ix->running)
+    return;
+
+  btc_mutex_lock(&ix->lock);
+  ix->stop = 1;
+  btc_mutex_unlock(&ix->lock);
+
+  if (ix->threaded)
+    btc_thread_join(&ix->thread);
+
+  if (ix->blocks != NULL)
+    btc_free(ix->blocks);
+
+  ix->blocks = NULL;
+  ix->alloc = 0;
+  ix->length = 0;
+  ix->pos = 0;
+  ix->threaded = 0;
+  ix->running = 0;
+  ix->synced = 0;
+  ix->stop = 0;
+}
+
+int
+btc_chaindb_open_indexers(btc_chaindb_t *db) {
+  if (db->flags & BTC_CHAIN_TXINDEX) {
+    if (!btc_indexer_open(&db->txindex, db))
+      return 0;
+  }
+
+  if (db->flags & BTC_CHAIN_ADDRINDEX) {
+    if (!btc_indexer_open(&db->addrindex, db))
+      return 0;
+  }
+
+  if (db->flags & BTC_CHAIN_FILTERINDEX) {
+    if (!btc_indexer_open(&db->filterindex, db))
+      return 0;
+  }
+
+  return 1;
+}
+
+void
+btc_chaindb_poll_indexers(btc_chaindb_t *db) {
+  btc_indexer_poll(&db->txindex);
+  btc_indexer_poll(&db->addrindex);
+  btc_indexer_poll(&db->filterindex);
+}
+
+void
+btc_chaindb_close_indexers(btc_chaindb_t *db) {
+  btc_indexer_close(&db->txindex);
+  btc_indexer_close(&db->addrindex);
+  btc_indexer_close(&db->filterindex);
+}
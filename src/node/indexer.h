@@ -0,0 +1,57 @@
+/*!
+ * indexer.h - chaindb indexer for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#ifndef BTC_NODE_INDEXER_H_
+#define BTC_NODE_INDEXER_H_
+
+#include <stdint.h>
+#include <lcdb.h>
+#include "chaindb_impl.h"
+
+/*
+ * Indexer
+ */
+
+void
+btc_indexer_init(btc_indexer_t *ix,
+                 const char *name,
+                 const ldb_slice_t *key,
+                 int32_t start,
+                 btc_index_cb *index);
+
+void
+btc_indexer_clear(btc_indexer_t *ix);
+
+void
+btc_indexer_rewind(btc_indexer_t *ix, int32_t height);
+
+void
+btc_indexer_connect(btc_indexer_t *ix,
+                    ldb_batch_t *batch,
+                    const btc_entry_t *entry);
+
+void
+btc_indexer_disconnect(btc_indexer_t *ix,
+                       ldb_batch_t *batch,
+                       const btc_entry_t *entry);
+
+int
+btc_indexer_push(btc_indexer_t *ix, const btc_entry_t *entry);
+
+/*
+ * Indexing
+ */
+
+int
+btc_chaindb_open_indexers(btc_chaindb_t *db);
+
+void
+btc_chaindb_poll_indexers(btc_chaindb_t *db);
+
+void
+btc_chaindb_close_indexers(btc_chaindb_t *db);
+
+#endif /* BTC_NODE_INDEXER_H_ */
@@ -29,8 +29,11 @@
 
 static const char *node_args[] = {
   "-?",
+  "-addrindex=",
+  "-assumevalid=",
   "-bantime=",
   "-bind=",
+  "-blockfilterindex=",
   "-blocksonly=",
   "-chain=",
   "-checkpoints=",
@@ -44,6 +47,7 @@ static const char *node_args[] = {
   "-discover=",
   "-externalip=",
   "-listen=",
+  "-loadsnapshot=",
   "-loglevel=",
   "-maxconnections=",
   "-maxinbound=",
@@ -62,11 +66,63 @@ static const char *node_args[] = {
   "-rpcpassword=",
   "-rpcport=",
   "-rpcuser=",
+  "-snapshothash=",
   "-testnet",
+  "-txindex=",
   "-upnp=",
   "-version"
 };
 
+static const char *node_usage[] = {
+  "Usage: makod [options]",
+  "",
+  "Options:",
+  "  -?                         Print this help message and exit.",
+  "  -version                   Print the version and exit.",
+  "  -conf=<file>               Config file (default: <datadir>/mako.conf).",
+  "  -datadir=<dir>             Data directory.",
+  "  -chain=<name>              main, test, regtest, signet or simnet.",
+  "  -testnet                   Same as -chain=test.",
+  "  -daemon=<0|1>              Run in the background.",
+  "  -loglevel=<level>          none, error, warning, info, debug or spam.",
+  "  -dbcache=<MiB>             Database cache, 8 to 2048 (default: 128).",
+  "  -par=<n>                   Script threads (<= 0: leave -<n> cores free).",
+  "  -checkpoints=<0|1>         Enforce checkpoints (default: 1).",
+  "  -assumevalid=<hash>        Skip scripts of ancestors of this block.",
+  "  -prune=<n>                 0 keeps all blk/rev files (default).",
+  "                             1 prunes only through pruneblockchain.",
+  "                             >= 550 keeps the files under <n> MiB.",
+  "  -txindex=<0|1>             Index transactions by hash.",
+  "  -addrindex=<0|1>           Index transactions by output script.",
+  "  -blockfilterindex=<0|1>    Index BIP158 block filters.",
+  "  -loadsnapshot=<file>       Load a UTXO snapshot on a fresh datadir.",
+  "  -snapshothash=<hash>       Expected MuHash of the snapshot's coins.",
+  "  -disablewallet=<0|1>       Do not load the wallet.",
+  "  -networkactive=<0|1>       Enable peer-to-peer networking.",
+  "  -listen=<0|1>              Accept inbound connections.",
+  "  -port=<port>               Listen on <port>.",
+  "  -bind=<addr>               Bind to <addr>. May be repeated.",
+  "  -externalip=<addr>         Advertise <addr>. May be repeated.",
+  "  -connect=<addr>            Only connect to <addr>. May be repeated.",
+  "  -proxy=<addr>              Connect through a SOCKS5 proxy.",
+  "  -onion=<0|1|addr>          Reach onion peers (through <addr>).",
+  "  -onlynet=<net>             Only connect over ipv4, ipv6 or onion.",
+  "  -maxconnections=<n>        Total peer limit.",
+  "  -maxinbound=<n>            Inbound peer limit (default: 128).",
+  "  -maxoutbound=<n>           Outbound peer limit (default: 8).",
+  "  -bantime=<sec>             Ban duration (default: 86400).",
+  "  -discover=<0|1>            Discover our own addresses.",
+  "  -upnp=<0|1>                Map the listening port with UPnP.",
+  "  -blocksonly=<0|1>          Do not relay transactions.",
+  "  -peerbloomfilters=<0|1>    Serve BIP37 bloom filters.",
+  "  -compactblocks=<0|1>       Use BIP152 compact blocks (default: 1).",
+  "  -peerblockfilters=<0|1>    Serve BIP157 block filters.",
+  "  -rpcport=<port>            Listen for RPC on <port>.",
+  "  -rpcbind=<addr>            Bind RPC to <addr>. May be repeated.",
+  "  -rpcuser=<user>            RPC username.",
+  "  -rpcpassword=<pass>        RPC password."
+};
+
 /*
  * Config
  */
@@ -102,6 +158,15 @@ set_config(btc_node_t *node, const btc_conf_t *conf) {
   btc_chain_set_threads(node->chain, conf->workers);
   btc_chain_set_cache(node->chain, (size_t)conf->cache_size << 20);
 
+  if (conf->prune > 1)
+    btc_chain_set_prune(node->chain, (uint64_t)conf->prune << 20);
+
+  if (conf->assume_valid)
+    btc_chain_set_assume_valid(node->chain, conf->assume_hash);
+
+  if (conf->snapshot[0] != '\0')
+    btc_chain_set_snapshot(node->chain, conf->snapshot, conf->snapshot_hash);
+
   btc_pool_set_port(node->pool, conf->port);
 
   for (i = 0; i < conf->bind.length; i++)
@@ -137,6 +202,15 @@ get_node_flags(const btc_conf_t *conf) {
   if (conf->prune)
     flags |= BTC_CHAIN_PRUNE;
 
+  if (conf->txindex)
+    flags |= BTC_CHAIN_TXINDEX;
+
+  if (conf->addrindex)
+    flags |= BTC_CHAIN_ADDRINDEX;
+
+  if (conf->filterindex)
+    flags |= BTC_CHAIN_FILTERINDEX;
+
   if (conf->listen)
     flags |= BTC_POOL_LISTEN;
 
@@ -167,8 +241,9 @@ get_node_flags(const btc_conf_t *conf) {
   if (conf->bip152)
     flags |= BTC_POOL_BIP152;
 
+  /* Serving filters requires the index. */
   if (conf->bip157)
-    flags |= BTC_POOL_BIP157;
+    flags |= BTC_POOL_BIP157 | BTC_CHAIN_FILTERINDEX;
 
   return flags;
 }
@@ -191,7 +266,11 @@ btc_main(const btc_conf_t *conf) {
   btc_node_t *node;
 
   if (conf->help) {
-    puts("Usage: makod [options]");
+    size_t i;
+
+    for (i = 0; i < lengthof(node_usage); i++)
+      puts(node_usage[i]);
+
     return 1;
   }
 
@@ -13,6 +13,7 @@
 #include <node/chain.h>
 #include <base/logger.h>
 #include <node/mempool.h>
+#include <base/sigcache.h>
 #include <base/timedata.h>
 
 #include <mako/block.h>
@@ -216,6 +217,7 @@ struct btc_mempool_s {
   const btc_network_t *network;
   btc_logger_t *logger;
   const btc_timedata_t *timedata;
+  btc_sigcache_t *sigcache;
   btc_chain_t *chain;
   size_t size;
   btc_hashmap_t map;
@@ -290,6 +292,11 @@ btc_mempool_set_timedata(btc_mempool_t *mp, const btc_timedata_t *td) {
   mp->timedata = td;
 }
 
+void
+btc_mempool_set_sigcache(btc_mempool_t *mp, btc_sigcache_t *cache) {
+  mp->sigcache = cache;
+}
+
 void
 btc_mempool_on_tx(btc_mempool_t *mp, btc_mempool_tx_cb *handler) {
   mp->on_tx = handler;
@@ -957,8 +964,13 @@ btc_mempool_verify_inputs(btc_mempool_t *mp,
                           unsigned int flags) {
   const btc_tx_t *tx = entry->tx;
 
-  if (btc_tx_verify(tx, view, flags))
+  if (btc_tx_verify(tx, view, flags)) {
+    /* Spare the chain from doing this again. */
+    if (mp->sigcache != NULL)
+      btc_sigcache_add(mp->sigcache, tx, flags);
+
     return 1;
+  }
 
   if (flags & BTC_SCRIPT_ONLY_STANDARD_VERIFY_FLAGS) {
     flags &= ~BTC_SCRIPT_ONLY_STANDARD_VERIFY_FLAGS;
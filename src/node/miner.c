@@ -189,8 +189,8 @@ btc_steps_push(btc_steps_t *steps, const uint8_t *step) {
 
 static void
 btc_steps_compute(btc_steps_t *steps, uint8_t *nodes, size_t size) {
-  uint8_t *left, *right, *last;
-  size_t i;
+  uint8_t *last;
+  size_t pairs;
 
   btc_steps_init(steps);
 
@@ -199,16 +199,15 @@ btc_steps_compute(btc_steps_t *steps, uint8_t *nodes, size_t size) {
 
     memset(&nodes[0 * 32], 0, 32);
 
-    for (i = 2; i < size; i += 2) {
-      left = &nodes[(i + 0) * 32];
-      right = left;
+    /* Everything right of the coinbase branch is hashed in one batch. */
+    pairs = (size - 2) / 2;
 
-      if (i + 1 < size)
-        right = &nodes[(i + 1) * 32];
+    btc_hash256_roots(&nodes[1 * 32], &nodes[2 * 32], pairs);
 
-      last = &nodes[(i / 2) * 32];
+    if (size & 1) {
+      last = &nodes[(size - 1) * 32];
 
-      btc_hash256_root(last, left, right);
+      btc_hash256_root(&nodes[(pairs + 1) * 32], last, last);
     }
 
     size = (size + 1) / 2;
@@ -20,6 +20,7 @@
 #include <node/node.h>
 #include <node/pool.h>
 #include <node/rpc.h>
+#include <base/sigcache.h>
 #include <base/timedata.h>
 
 #include <wallet/client.h>
@@ -101,6 +102,15 @@ client_get_block(void *state, const btc_entry_t *entry) {
   return btc_chain_get_block(node->chain, entry);
 }
 
+static int
+client_get_raw_block(void *state,
+                     uint8_t **data,
+                     size_t *length,
+                     const btc_entry_t *entry) {
+  btc_node_t *node = state;
+  return btc_chain_get_block_data(node->chain, data, length, entry);
+}
+
 static void
 client_send(void *state, const btc_tx_t *tx) {
   btc_node_t *node = state;
@@ -129,6 +139,7 @@ btc_node_create(const btc_network_t *network) {
   node->loop = btc_loop_create();
   node->logger = btc_logger_create();
   node->timedata = btc_timedata_create();
+  node->sigcache = btc_sigcache_create(BTC_SIGCACHE_SIZE);
   node->chain = btc_chain_create(network);
   node->mempool = btc_mempool_create(network, node->chain);
   node->miner = btc_miner_create(network, node->loop, node->chain, node->mempool);
@@ -145,6 +156,7 @@ btc_node_create(const btc_network_t *network) {
     client.by_hash = client_by_hash;
     client.by_height = client_by_height;
     client.get_block = client_get_block;
+    client.get_raw_block = client_get_raw_block;
     client.send = client_send;
     client.log = client_log;
 
@@ -165,6 +177,9 @@ btc_node_create(const btc_network_t *network) {
   btc_miner_set_timedata(node->miner, node->timedata);
   btc_pool_set_timedata(node->pool, node->timedata);
 
+  btc_chain_set_sigcache(node->chain, node->sigcache);
+  btc_mempool_set_sigcache(node->mempool, node->sigcache);
+
   btc_chain_set_context(node->chain, node);
   btc_chain_on_connect(node->chain, on_connect);
   btc_chain_on_disconnect(node->chain, on_disconnect);
@@ -187,6 +202,7 @@ btc_node_destroy(btc_node_t *node) {
   btc_miner_destroy(node->miner);
   btc_mempool_destroy(node->mempool);
   btc_chain_destroy(node->chain);
+  btc_sigcache_destroy(node->sigcache);
   btc_timedata_destroy(node->timedata);
   btc_logger_destroy(node->logger);
   btc_loop_destroy(node->loop);
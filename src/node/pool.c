@@ -20,6 +20,7 @@
 
 #include <mako/bip37.h>
 #include <mako/bip152.h>
+#include <mako/bip158.h>
 #include <mako/block.h>
 #include <mako/bloom.h>
 #include <mako/coins.h>
@@ -62,6 +63,10 @@ enum btc_peer_state {
 
 typedef void btc_parser_on_msg_cb(btc_msg_t *msg, void *arg);
 typedef void btc_parser_on_error_cb(void *arg);
+typedef int btc_parser_read_block_cb(btc_block_t *block,
+                                     const uint8_t *xp,
+                                     size_t xn,
+                                     void *arg);
 
 typedef struct btc_parser_s {
   uint32_t magic;
@@ -77,6 +82,7 @@ typedef struct btc_parser_s {
   /* Callback */
   btc_parser_on_msg_cb *on_msg;
   btc_parser_on_error_cb *on_error;
+  btc_parser_read_block_cb *read_block;
   void *arg;
 } btc_parser_t;
 
@@ -188,7 +194,7 @@ struct btc_pool_s {
   btc_hashset_t compact_map;
   int block_mode;
   int checkpoints;
-  const btc_checkpoint_t *header_tip;
+  btc_checkpoint_t header_tip;
   btc_hdrnode_t *header_head;
   btc_hdrnode_t *header_tail;
   btc_hdrnode_t *header_next;
@@ -258,6 +264,7 @@ btc_parser_init(btc_parser_t *parser, uint32_t magic) {
   parser->checksum = 0;
   parser->on_msg = NULL;
   parser->on_error = NULL;
+  parser->read_block = NULL;
   parser->arg = NULL;
 }
 
@@ -318,6 +325,7 @@ btc_parser_parse_header(btc_parser_t *parser, const uint8_t **xp, size_t *xn) {
 static int
 btc_parser_parse(btc_parser_t *parser, const uint8_t *data, size_t length) {
   btc_msg_t msg;
+  int ret;
 
   CHECK(length <= BTC_NET_MAX_MESSAGE);
 
@@ -333,7 +341,14 @@ btc_parser_parse(btc_parser_t *parser, const uint8_t *data, size_t length) {
   btc_msg_set_cmd(&msg, parser->cmd);
   btc_msg_alloc(&msg);
 
-  if (!btc_msg_import(&msg, data, length)) {
+  if (msg.type == BTC_MSG_BLOCK && parser->read_block != NULL) {
+    ret = parser->read_block((btc_block_t *)msg.body,
+                             data, length, parser->arg);
+  } else {
+    ret = btc_msg_import(&msg, data, length);
+  }
+
+  if (!ret) {
     btc_msg_clear(&msg);
     return 0;
   }
@@ -465,6 +480,12 @@ on_parse_error(void *arg) {
   btc_peer_on_parse_error((btc_peer_t *)arg);
 }
 
+static int
+on_read_block(btc_block_t *block, const uint8_t *xp, size_t xn, void *arg) {
+  btc_peer_t *peer = (btc_peer_t *)arg;
+  return btc_chain_read_block(peer->pool->chain, block, xp, xn);
+}
+
 /*
  * Peer
  */
@@ -502,6 +523,7 @@ btc_peer_create(btc_pool_t *pool) {
 
   peer->parser.on_msg = on_msg;
   peer->parser.on_error = on_parse_error;
+  peer->parser.read_block = on_read_block;
   peer->parser.arg = peer;
 
   btc_inv_init(&peer->inv_queue);
@@ -1080,7 +1102,7 @@ btc_peer_get_full_block(btc_peer_t *peer, const uint8_t *hash) {
 }
 
 static int
-btc_peer_send_merkleblock(btc_peer_t *peer, const btc_block_t *block) {
+btc_peer_send_merkleblock(btc_peer_t *peer, const btc_rawblock_t *block) {
   btc_merkleblock_t mrkl;
   btc_vector_t *txs;
   int rc = 1;
@@ -1088,13 +1110,16 @@ btc_peer_send_merkleblock(btc_peer_t *peer, const btc_block_t *block) {
 
   btc_merkleblock_init(&mrkl);
 
-  txs = btc_merkleblock_set_block(&mrkl, block, peer->spv_filter);
+  txs = btc_merkleblock_set_raw(&mrkl, block, peer->spv_filter);
 
   rc &= btc_peer_sendmsg(peer, BTC_MSG_MERKLEBLOCK, &mrkl);
 
-  for (i = 0; i < txs->length; i++)
+  for (i = 0; i < txs->length; i++) {
     rc &= btc_peer_sendmsg(peer, BTC_MSG_TX_BASE, txs->items[i]);
 
+    btc_tx_destroy(txs->items[i]);
+  }
+
   btc_merkleblock_clear(&mrkl);
   btc_vector_destroy(txs);
 
@@ -1158,6 +1183,23 @@ btc_peer_send_blocktxn(btc_peer_t *peer,
   return rc;
 }
 
+static int
+btc_peer_send_cfilter(btc_peer_t *peer,
+                      const uint8_t *hash,
+                      const uint8_t *data,
+                      size_t length) {
+  btc_cfilter_t msg;
+
+  btc_cfilter_init(&msg);
+
+  msg.filter_type = BTC_FILTER_BASIC;
+  msg.hash = hash;
+  msg.data = data;
+  msg.length = length;
+
+  return btc_peer_sendmsg(peer, BTC_MSG_CFILTER, &msg);
+}
+
 static int
 btc_peer_flush_inv(btc_peer_t *peer) {
   btc_inv_t inv;
@@ -1745,7 +1787,9 @@ btc_peer_flush_data(btc_peer_t *peer) {
 
       case BTC_INV_FILTERED_BLOCK: {
         const btc_entry_t *entry;
-        btc_block_t *block;
+        btc_rawblock_t block;
+        uint8_t *data;
+        size_t length;
 
         if (!(pool->flags & BTC_POOL_BIP37)) {
           btc_peer_debug(peer, "Peer requested a merkleblock without bip37 enabled (%N).",
@@ -1766,16 +1810,22 @@ btc_peer_flush_data(btc_peer_t *peer) {
           break;
         }
 
-        block = btc_chain_get_block(chain, entry);
+        if (!btc_chain_get_raw_block(chain, &data, &length, entry)) {
+          btc_inv_push(&nf, item);
+          break;
+        }
 
-        if (block == NULL) {
+        /* Skip the 24 byte message header. Only the
+           matching transactions are ever decoded. */
+        if (!btc_rawblock_import(&block, data + 24, length - 24)) {
+          btc_free(data);
           btc_inv_push(&nf, item);
           break;
         }
 
-        btc_peer_send_merkleblock(peer, block);
+        btc_peer_send_merkleblock(peer, &block);
 
-        btc_block_destroy(block);
+        btc_free(data);
         btc_invitem_destroy(item);
 
         blk_count += 1;
@@ -2136,7 +2186,7 @@ btc_pool_create(const btc_network_t *network,
   btc_hashset_init(&pool->compact_map);
   pool->block_mode = 0;
   pool->checkpoints = 0;
-  pool->header_tip = NULL;
+  pool->header_tip.height = -1;
   pool->header_head = NULL;
   pool->header_tail = NULL;
   pool->header_next = NULL;
@@ -2335,8 +2385,8 @@ btc_pool_discover_external(btc_pool_t *pool) {
   }
 }
 
-static const btc_checkpoint_t *
-btc_pool_next_tip(btc_pool_t *pool, int32_t height) {
+static int
+btc_pool_next_tip(btc_pool_t *pool, int32_t height, btc_checkpoint_t *tip) {
   const btc_network_t *network = pool->network;
   const btc_checkpoint_t *chk;
   size_t i;
@@ -2344,13 +2394,21 @@ btc_pool_next_tip(btc_pool_t *pool, int32_t height) {
   for (i = 0; i < network->checkpoints.length; i++) {
     chk = &network->checkpoints.items[i];
 
-    if (chk->height > height)
-      return chk;
+    if (chk->height > height) {
+      *tip = *chk;
+      return 1;
+    }
   }
 
-  btc_abort(); /* LCOV_EXCL_LINE */
+  /* Past the checkpoints, sync headers up to the
+     assumevalid block (its height may be unknown)
+     so the chain can skip scripts below it. */
+  if (btc_chain_get_assumed(pool->chain, tip->hash, &tip->height)) {
+    if (tip->height < 0 || tip->height > height)
+      return 1;
+  }
 
-  return NULL; /* LCOV_EXCL_LINE */
+  return 0;
 }
 
 static void
@@ -2363,7 +2421,7 @@ btc_pool_clear_chain(btc_pool_t *pool) {
   }
 
   pool->checkpoints = 0;
-  pool->header_tip = NULL;
+  pool->header_tip.height = -1;
   pool->header_head = NULL;
   pool->header_tail = NULL;
   pool->header_next = NULL;
@@ -2371,27 +2429,22 @@ btc_pool_clear_chain(btc_pool_t *pool) {
 
 static void
 btc_pool_reset_chain(btc_pool_t *pool) {
-  const btc_network_t *network = pool->network;
   const btc_entry_t *tip;
 
   if (!(pool->flags & BTC_POOL_CHECKPOINTS))
     return;
 
-  if (network->checkpoints.length == 0)
-    return;
-
   btc_pool_clear_chain(pool);
 
   tip = btc_chain_tip(pool->chain);
 
-  if (tip->height < network->last_checkpoint) {
+  if (btc_pool_next_tip(pool, tip->height, &pool->header_tip)) {
     pool->checkpoints = 1;
-    pool->header_tip = btc_pool_next_tip(pool, tip->height);
     pool->header_head = btc_hdrnode_create(tip->hash, tip->height);
     pool->header_tail = pool->header_head;
 
     btc_pool_info(pool, "Initialized header chain to height %d (checkpoint=%H).",
-                        tip->height, pool->header_tip->hash);
+                        tip->height, pool->header_tip.hash);
   }
 }
 
@@ -2405,6 +2458,13 @@ btc_pool_open(btc_pool_t *pool, const char *prefix, unsigned int flags) {
   if (pool->flags & BTC_POOL_BIP37)
     pool->services |= BTC_NET_SERVICE_BLOOM;
 
+  if (pool->flags & BTC_POOL_BIP157)
+    pool->services |= BTC_NET_SERVICE_COMPACT_FILTERS;
+
+  /* We lack the blocks below a UTXO snapshot. */
+  if (btc_chain_unvalidated(pool->chain) >= 0)
+    pool->services &= ~BTC_NET_SERVICE_NETWORK;
+
   btc_pool_info(pool, "Opening pool.");
 
   btc_fs_mkdir(prefix);
@@ -2606,7 +2666,7 @@ btc_pool_send_locator(btc_pool_t *pool,
   peer->block_time = btc_time_msec();
 
   if (pool->checkpoints) {
-    btc_peer_send_getheaders(peer, locator, pool->header_tip->hash);
+    btc_peer_send_getheaders(peer, locator, pool->header_tip.hash);
     return 1;
   }
 
@@ -3530,6 +3590,10 @@ btc_pool_on_getblocks(btc_pool_t *pool,
   if (entry != NULL)
     entry = entry->next;
 
+  /* Do not serve history below an unvalidated snapshot. */
+  if (entry != NULL && entry->height <= btc_chain_unvalidated(pool->chain))
+    return;
+
   stop = btc_chain_by_hash(pool->chain, msg->stop);
 
   btc_zinv_init(&blocks);
@@ -3580,6 +3644,10 @@ btc_pool_on_getheaders(btc_pool_t *pool,
     stop = entry;
   }
 
+  /* Do not serve history below an unvalidated snapshot. */
+  if (entry != NULL && entry->height <= btc_chain_unvalidated(pool->chain))
+    return;
+
   btc_headers_init(&blocks);
   btc_headers_grow(&blocks, btc_pool_inv_size(pool, entry, stop, 2000));
 
@@ -3670,20 +3738,17 @@ btc_pool_resolve_chain(btc_pool_t *pool,
     return;
   }
 
-  if (node->height < pool->network->last_checkpoint) {
-    if (node->height == pool->header_tip->height) {
-      btc_pool_info(pool, "Received checkpoint %H (%d).",
-                          node->hash, node->height);
-
-      pool->header_tip = btc_pool_next_tip(pool, node->height);
-
-      btc_peer_send_getheaders_1(peer, hash, pool->header_tip->hash);
-
-      return;
-    }
-
+  if (node->height != pool->header_tip.height) {
     btc_pool_resolve_headers(pool, peer);
     btc_pool_shift_header(pool);
+    return;
+  }
+
+  if (btc_pool_next_tip(pool, node->height, &pool->header_tip)) {
+    btc_pool_info(pool, "Received checkpoint %H (%d).",
+                        node->hash, node->height);
+
+    btc_peer_send_getheaders_1(peer, hash, pool->header_tip.hash);
 
     return;
   }
@@ -3696,6 +3761,19 @@ btc_pool_resolve_chain(btc_pool_t *pool,
   btc_pool_getblocks(pool, peer, hash, NULL);
 }
 
+static void
+btc_pool_skip_assumed(btc_pool_t *pool, btc_peer_t *peer) {
+  btc_pool_warn(pool, "Peer does not have assumevalid block %H (%N).",
+                      pool->header_tip.hash, &peer->addr);
+
+  btc_pool_info(pool, "Switching to getblocks (%N).",
+                      &peer->addr);
+
+  btc_pool_clear_chain(pool);
+
+  btc_pool_getblocks(pool, peer, NULL, NULL);
+}
+
 static void
 btc_pool_on_headers(btc_pool_t *pool,
                     btc_peer_t *peer,
@@ -3712,8 +3790,11 @@ btc_pool_on_headers(btc_pool_t *pool,
   if (!peer->loader)
     return;
 
-  if (msg->length == 0)
+  if (msg->length == 0) {
+    if (pool->header_tip.height < 0)
+      btc_pool_skip_assumed(pool, peer);
     return;
+  }
 
   if (msg->length > 2000) {
     btc_peer_increase_ban(peer, 20);
@@ -3744,8 +3825,13 @@ btc_pool_on_headers(btc_pool_t *pool,
 
     btc_header_hash(hash, hdr);
 
-    if (height == pool->header_tip->height) {
-      if (!btc_hash_equal(hash, pool->header_tip->hash)) {
+    if (pool->header_tip.height < 0) {
+      if (btc_hash_equal(hash, pool->header_tip.hash))
+        pool->header_tip.height = height;
+    }
+
+    if (height == pool->header_tip.height) {
+      if (!btc_hash_equal(hash, pool->header_tip.hash)) {
         btc_pool_warn(pool, "Peer sent an invalid checkpoint (%N).",
                             &peer->addr);
         btc_peer_close(peer);
@@ -3754,6 +3840,8 @@ btc_pool_on_headers(btc_pool_t *pool,
       checkpoint = 1;
     }
 
+    btc_chain_add_header(pool->chain, hdr);
+
     node = btc_hdrnode_create(hash, height);
 
     if (pool->header_next == NULL)
@@ -3782,8 +3870,14 @@ btc_pool_on_headers(btc_pool_t *pool,
     return;
   }
 
+  /* The peer's chain ended before the assumevalid block. */
+  if (msg->length < 2000 && pool->header_tip.height < 0) {
+    btc_pool_skip_assumed(pool, peer);
+    return;
+  }
+
   /* Request more headers. */
-  btc_peer_send_getheaders_1(peer, node->hash, pool->header_tip->hash);
+  btc_peer_send_getheaders_1(peer, node->hash, pool->header_tip.hash);
 }
 
 static void
@@ -4233,6 +4327,189 @@ btc_pool_on_blocktxn(btc_pool_t *pool,
   btc_cmpct_destroy(block);
 }
 
+static const btc_entry_t *
+btc_pool_cf_range(btc_pool_t *pool,
+                  btc_peer_t *peer,
+                  uint8_t filter_type,
+                  uint32_t start_height,
+                  const uint8_t *stop_hash,
+                  int32_t max) {
+  const btc_entry_t *stop;
+
+  if (!(pool->flags & BTC_POOL_BIP157)) {
+    btc_pool_debug(pool, "Peer requested filters without bip157 (%N).",
+                         &peer->addr);
+    btc_peer_close(peer);
+    return NULL;
+  }
+
+  if (filter_type != BTC_FILTER_BASIC) {
+    btc_pool_debug(pool, "Peer requested unknown filter type %u (%N).",
+                         filter_type, &peer->addr);
+    btc_peer_close(peer);
+    return NULL;
+  }
+
+  stop = btc_chain_by_hash(pool->chain, stop_hash);
+
+  if (stop == NULL || !btc_chain_is_main(pool->chain, stop)) {
+    btc_pool_debug(pool, "Peer requested filters for unknown block (%N).",
+                         &peer->addr);
+    btc_peer_close(peer);
+    return NULL;
+  }
+
+  if (start_height > (uint32_t)stop->height) {
+    btc_pool_debug(pool, "Peer sent invalid filter range %u-%d (%N).",
+                         start_height, stop->height, &peer->addr);
+    btc_peer_increase_ban(peer, 100);
+    return NULL;
+  }
+
+  if (stop->height - (int32_t)start_height >= max) {
+    btc_pool_debug(pool, "Peer requested too many filters %u-%d (%N).",
+                         start_height, stop->height, &peer->addr);
+    btc_peer_increase_ban(peer, 100);
+    return NULL;
+  }
+
+  return stop;
+}
+
+static void
+btc_pool_on_getcfilters(btc_pool_t *pool,
+                        btc_peer_t *peer,
+                        const btc_getcfilters_t *msg) {
+  const btc_entry_t *stop, *entry;
+  size_t length;
+  uint8_t *data;
+
+  stop = btc_pool_cf_range(pool, peer, msg->filter_type,
+                           msg->start_height, msg->stop, 1000);
+
+  if (stop == NULL)
+    return;
+
+  entry = btc_entry_ancestor(stop, msg->start_height);
+
+  for (;;) {
+    if (!btc_chain_get_filter(pool->chain, &data, &length, entry)) {
+      btc_pool_debug(pool, "Filter not indexed for %H (%N).",
+                           entry->hash, &peer->addr);
+      return;
+    }
+
+    btc_peer_send_cfilter(peer, entry->hash, data, length);
+    btc_free(data);
+
+    if (entry == stop)
+      break;
+
+    entry = entry->next;
+  }
+}
+
+static void
+btc_pool_on_getcfheaders(btc_pool_t *pool,
+                         btc_peer_t *peer,
+                         const btc_getcfilters_t *msg) {
+  const btc_entry_t *stop, *entry;
+  uint8_t prev[32], header[32];
+  btc_cfheaders_t res;
+  uint8_t *hashes;
+  size_t i = 0;
+
+  stop = btc_pool_cf_range(pool, peer, msg->filter_type,
+                           msg->start_height, msg->stop, 2000);
+
+  if (stop == NULL)
+    return;
+
+  entry = btc_entry_ancestor(stop, msg->start_height);
+
+  if (entry->prev != NULL) {
+    if (!btc_chain_get_filter_header(pool->chain, header, prev, entry->prev))
+      return;
+  } else {
+    memset(prev, 0, 32);
+  }
+
+  hashes = (uint8_t *)btc_malloc((stop->height - entry->height + 1) * 32);
+
+  btc_cfheaders_init(&res);
+
+  res.filter_type = BTC_FILTER_BASIC;
+  res.stop = stop->hash;
+  res.prev = prev;
+
+  for (;;) {
+    if (!btc_chain_get_filter_header(pool->chain, &hashes[i * 32],
+                                     header, entry)) {
+      btc_pool_debug(pool, "Filter not indexed for %H (%N).",
+                           entry->hash, &peer->addr);
+      goto done;
+    }
+
+    btc_vector_push(&res.hashes, &hashes[i * 32]);
+
+    i += 1;
+
+    if (entry == stop)
+      break;
+
+    entry = entry->next;
+  }
+
+  btc_peer_sendmsg(peer, BTC_MSG_CFHEADERS, &res);
+done:
+  btc_cfheaders_clear(&res);
+  btc_free(hashes);
+}
+
+static void
+btc_pool_on_getcfcheckpt(btc_pool_t *pool,
+                         btc_peer_t *peer,
+                         const btc_getcfcheckpt_t *msg) {
+  uint8_t hash[32], *headers;
+  const btc_entry_t *stop;
+  btc_cfcheckpt_t res;
+  int32_t height;
+  size_t i = 0;
+
+  stop = btc_pool_cf_range(pool, peer, msg->filter_type,
+                           0, msg->stop, INT32_MAX);
+
+  if (stop == NULL)
+    return;
+
+  headers = (uint8_t *)btc_malloc((stop->height / 1000 + 1) * 32);
+
+  btc_cfcheckpt_init(&res);
+
+  res.filter_type = BTC_FILTER_BASIC;
+  res.stop = stop->hash;
+
+  for (height = 1000; height <= stop->height; height += 1000) {
+    const btc_entry_t *entry = btc_entry_ancestor(stop, height);
+
+    if (!btc_chain_get_filter_header(pool->chain, hash,
+                                     &headers[i * 32], entry)) {
+      btc_pool_debug(pool, "Filter not indexed for %H (%N).",
+                           entry->hash, &peer->addr);
+      goto done;
+    }
+
+    btc_vector_push(&res.headers, &headers[i * 32]);
+
+    i += 1;
+  }
+
+  btc_peer_sendmsg(peer, BTC_MSG_CFCHECKPT, &res);
+done:
+  btc_cfcheckpt_clear(&res);
+  btc_free(headers);
+}
+
 static void
 btc_pool_on_unknown(btc_pool_t *pool,
                     btc_peer_t *peer,
@@ -4321,6 +4598,17 @@ btc_pool_on_msg(btc_pool_t *pool, btc_peer_t *peer, btc_msg_t *msg) {
     case BTC_MSG_GETBLOCKTXN:
       btc_pool_on_getblocktxn(pool, peer, (const btc_getblocktxn_t *)msg->body);
       break;
+    case BTC_MSG_GETCFILTERS:
+      btc_pool_on_getcfilters(pool, peer, (const btc_getcfilters_t *)msg->body);
+      break;
+    case BTC_MSG_GETCFHEADERS:
+      btc_pool_on_getcfheaders(pool, peer,
+                               (const btc_getcfilters_t *)msg->body);
+      break;
+    case BTC_MSG_GETCFCHECKPT:
+      btc_pool_on_getcfcheckpt(pool, peer,
+                               (const btc_getcfcheckpt_t *)msg->body);
+      break;
     case BTC_MSG_BLOCKTXN:
       btc_pool_on_blocktxn(pool, peer, (const btc_blocktxn_t *)msg->body);
       break;
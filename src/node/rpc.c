@@ -15,6 +15,7 @@
 
 #include <base/addrman.h>
 #include <node/chain.h>
+#include <node/chaindb.h>
 #include <base/logger.h>
 #include <node/mempool.h>
 #include <node/miner.h>
@@ -447,6 +448,43 @@ btc_rpc_get_depth(btc_rpc_t *rpc,
  * Blockchain
  */
 
+static void
+btc_rpc_dumptxoutset(btc_rpc_t *rpc,
+                     const json_params *params,
+                     rpc_res_t *res) {
+  const btc_entry_t *tip = btc_chain_tip(rpc->chain);
+  uint8_t hash[32], muhash[32];
+  const char *path;
+  uint64_t count;
+  json_value *obj;
+
+  if (params->help || params->length != 1)
+    THROW_MISC("dumptxoutset \"path\"");
+
+  if (!json_string_get(&path, params->values[0]))
+    THROW_TYPE(path, string);
+
+  if (btc_fs_exists(path))
+    THROW(RPC_INVALID_PARAMETER, "Path already exists");
+
+  if (!btc_chain_export(rpc->chain, path, hash, &count))
+    THROW(RPC_DATABASE_ERROR, "Could not write snapshot");
+
+  /* What the loading node passes as -snapshothash. */
+  btc_muhash_final(&btc_chain_coinstats(rpc->chain)->muhash, muhash);
+
+  obj = json_object_new(6);
+
+  json_object_push(obj, "coins_written", json_integer_new(count));
+  json_object_push(obj, "base_hash", json_hash_new(tip->hash));
+  json_object_push(obj, "base_height", json_integer_new(tip->height));
+  json_object_push(obj, "path", json_string_new(path));
+  json_object_push(obj, "txoutset_hash", json_raw_new(hash, 32));
+  json_object_push(obj, "muhash", json_hash_new(muhash));
+
+  res->result = obj;
+}
+
 static void
 btc_rpc_getbestblockhash(btc_rpc_t *rpc,
                          const json_params *params,
@@ -494,7 +532,26 @@ btc_rpc_getblock(btc_rpc_t *rpc, const json_params *params, rpc_res_t *res) {
       THROW_TYPE(verbosity, integer);
   }
 
-  if (verbosity > 0) {
+  if (verbosity == 1) {
+    btc_rawblock_t block;
+    uint8_t *data;
+    size_t length;
+
+    if (!btc_chain_get_raw_block(rpc->chain, &data, &length, entry))
+      THROW_MISC("Can't read block from disk");
+
+    /* Skip the 24 byte message header. */
+    if (!btc_rawblock_import(&block, data + 24, length - 24)) {
+      btc_free(data);
+      THROW_MISC("Can't read block from disk");
+    }
+
+    confirmations = btc_rpc_get_depth(rpc, entry, &next);
+
+    res->result = json_rawblock_new_ex(&block, entry, confirmations, next);
+
+    btc_free(data);
+  } else if (verbosity > 0) {
     btc_block_t *block = btc_chain_get_block(rpc->chain, entry);
     btc_view_t *view = NULL;
 
@@ -573,6 +630,49 @@ btc_rpc_getblockcount(btc_rpc_t *rpc,
   res->result = json_integer_new(tip->height);
 }
 
+static void
+btc_rpc_getblockfilter(btc_rpc_t *rpc,
+                       const json_params *params,
+                       rpc_res_t *res) {
+  uint8_t hash[32], filter_hash[32], header[32];
+  const btc_entry_t *entry;
+  const char *type = "basic";
+  size_t length;
+  uint8_t *data;
+
+  if (params->help || params->length < 1 || params->length > 2)
+    THROW_MISC("getblockfilter blockhash ( filtertype )");
+
+  if (!json_hash_get(hash, params->values[0]))
+    THROW_TYPE(blockhash, hash);
+
+  if (params->length > 1) {
+    if (!json_string_get(&type, params->values[1]))
+      THROW_TYPE(filtertype, string);
+  }
+
+  if (strcmp(type, "basic") != 0)
+    THROW(RPC_INVALID_ADDRESS_OR_KEY, "Unknown filtertype");
+
+  entry = btc_chain_by_hash(rpc->chain, hash);
+
+  if (entry == NULL)
+    THROW(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+
+  if (!btc_chain_get_filter_header(rpc->chain, filter_hash, header, entry))
+    THROW_MISC("Filter not found (use -blockfilterindex).");
+
+  if (!btc_chain_get_filter(rpc->chain, &data, &length, entry))
+    THROW_MISC("Filter not found (use -blockfilterindex).");
+
+  res->result = json_object_new(2);
+
+  json_object_push(res->result, "filter", json_raw_new(data, length));
+  json_object_push(res->result, "header", json_hash_new(header));
+
+  btc_free(data);
+}
+
 static void
 btc_rpc_getblockhash(btc_rpc_t *rpc,
                      const json_params *params,
@@ -756,20 +856,160 @@ static void
 btc_rpc_gettxoutsetinfo(btc_rpc_t *rpc,
                         const json_params *params,
                         rpc_res_t *res) {
-  (void)rpc;
+  const btc_entry_t *tip = btc_chain_tip(rpc->chain);
+  const btc_coinstats_t *stats = btc_chain_coinstats(rpc->chain);
+  uint8_t hash[32];
+  json_value *obj;
 
   if (params->help || params->length != 0)
     THROW_MISC("gettxoutsetinfo");
+
+  btc_muhash_final(&stats->muhash, hash);
+
+  obj = json_object_new(6);
+
+  json_object_push(obj, "height", json_integer_new(tip->height));
+  json_object_push(obj, "bestblock", json_hash_new(tip->hash));
+  json_object_push(obj, "txouts", json_integer_new(stats->count));
+  json_object_push(obj, "bogosize", json_integer_new(stats->size));
+  json_object_push(obj, "muhash", json_hash_new(hash));
+  json_object_push(obj, "total_amount", json_amount_new(stats->value));
+
+  res->result = obj;
+}
+
+static void
+btc_rpc_getaddresstxids(btc_rpc_t *rpc,
+                        const json_params *params,
+                        rpc_res_t *res) {
+  int start = 0, end = INT32_MAX;
+  btc_scriptiter_t *iter;
+  btc_address_t addr;
+  btc_script_t script;
+  json_value *obj;
+
+  if (params->help || params->length < 1 || params->length > 3)
+    THROW_MISC("getaddresstxids \"address\" ( start end )");
+
+  if (!json_address_get(&addr, params->values[0], rpc->network))
+    THROW_TYPE(address, address);
+
+  if (params->length > 1) {
+    if (!json_unsigned_get(&start, params->values[1]))
+      THROW_TYPE(start, integer);
+  }
+
+  if (params->length > 2) {
+    if (!json_unsigned_get(&end, params->values[2]))
+      THROW_TYPE(end, integer);
+  }
+
+  if (end < start)
+    THROW(RPC_INVALID_PARAMETER, "Start height is above end height");
+
+  btc_script_init(&script);
+  btc_address_get_script(&script, &addr);
+
+  iter = btc_chain_history(rpc->chain, &script, start, end);
+
+  btc_script_clear(&script);
+
+  if (iter == NULL)
+    THROW_MISC("Address index is not enabled (use -addrindex).");
+
+  res->result = json_array_new(16);
+
+  while (btc_scriptiter_next(iter)) {
+    obj = json_object_new(2);
+
+    json_object_push(obj, "txid",
+      json_hash_new(btc_scriptiter_hash(iter)));
+
+    json_object_push(obj, "height",
+      json_integer_new(btc_scriptiter_height(iter)));
+
+    json_array_push(res->result, obj);
+  }
+
+  btc_scriptiter_destroy(iter);
+}
+
+static void
+btc_rpc_getaddressutxos(btc_rpc_t *rpc,
+                        const json_params *params,
+                        rpc_res_t *res) {
+  btc_scriptiter_t *iter;
+  const btc_coin_t *coin;
+  btc_address_t addr;
+  btc_script_t script;
+  json_value *obj;
+
+  if (params->help || params->length != 1)
+    THROW_MISC("getaddressutxos \"address\"");
+
+  if (!json_address_get(&addr, params->values[0], rpc->network))
+    THROW_TYPE(address, address);
+
+  btc_script_init(&script);
+  btc_address_get_script(&script, &addr);
+
+  iter = btc_chain_unspent(rpc->chain, &script);
+
+  btc_script_clear(&script);
+
+  if (iter == NULL)
+    THROW_MISC("Address index is not enabled (use -addrindex).");
+
+  res->result = json_array_new(16);
+
+  while (btc_scriptiter_next(iter)) {
+    coin = btc_scriptiter_coin(iter);
+    obj = json_object_new(6);
+
+    json_object_push(obj, "txid",
+      json_hash_new(btc_scriptiter_hash(iter)));
+
+    json_object_push(obj, "vout",
+      json_integer_new(btc_scriptiter_index(iter)));
+
+    json_object_push(obj, "amount", json_amount_new(coin->output.value));
+    json_object_push(obj, "height", json_integer_new(coin->height));
+    json_object_push(obj, "coinbase", json_boolean_new(coin->coinbase));
+
+    json_object_push(obj, "scriptPubKey",
+      json_buffer_new(&coin->output.script));
+
+    json_array_push(res->result, obj);
+  }
+
+  btc_scriptiter_destroy(iter);
 }
 
 static void
 btc_rpc_pruneblockchain(btc_rpc_t *rpc,
                         const json_params *params,
                         rpc_res_t *res) {
-  (void)rpc;
+  int32_t pruned;
+  int height;
 
   if (params->help || params->length != 1)
     THROW_MISC("pruneblockchain height");
+
+  if (!json_unsigned_get(&height, params->values[0]))
+    THROW_TYPE(height, integer);
+
+  if (!btc_chain_pruned(rpc->chain))
+    THROW_MISC("Cannot prune blocks because node is not in prune mode.");
+
+  if (height > btc_chain_height(rpc->chain)) {
+    THROW(RPC_INVALID_PARAMETER,
+          "Blockchain is shorter than the attempted prune height.");
+  }
+
+  if (!btc_chain_prune(rpc->chain, height, &pruned))
+    THROW(RPC_DATABASE_ERROR, "Could not prune block files");
+
+  res->result = json_integer_new(pruned);
 }
 
 static void
@@ -1223,6 +1463,7 @@ static void
 btc_rpc_getrawtransaction(btc_rpc_t *rpc,
                           const json_params *params,
                           rpc_res_t *res) {
+  const btc_entry_t *block = NULL;
   const btc_mpentry_t *entry;
   btc_view_t *view = NULL;
   int verbosity = 1;
@@ -1247,7 +1488,7 @@ btc_rpc_getrawtransaction(btc_rpc_t *rpc,
 
     if (verbosity > 1)
       view = btc_mempool_view(rpc->mempool, tx);
-  } else {
+  } else if (!btc_chain_get_tx(rpc->chain, &tx, &block, hash)) {
     if (!btc_wallet_tx(&tx, rpc->wallet, hash))
       THROW_MISC("Transaction not found");
 
@@ -1257,6 +1498,8 @@ btc_rpc_getrawtransaction(btc_rpc_t *rpc,
 
   if (verbosity == 0)
     res->result = json_tx_raw(tx);
+  else if (block != NULL)
+    res->result = json_tx_new_ex(tx, view, block->hash, 0, rpc->network);
   else
     res->result = json_tx_new(tx, view, rpc->network);
 
@@ -3013,6 +3256,7 @@ static const struct {
   { "deleteaccount", btc_rpc_deleteaccount },
   { "disconnectnode", btc_rpc_disconnectnode },
   { "dumpprivkey", btc_rpc_dumpprivkey },
+  { "dumptxoutset", btc_rpc_dumptxoutset },
   { "dumpwallet", btc_rpc_dumpwallet },
   { "encryptwallet", btc_rpc_encryptwallet },
   { "estimatesmartfee", btc_rpc_estimatesmartfee },
@@ -3027,12 +3271,15 @@ static const struct {
   { "getaddednodeinfo", btc_rpc_getaddednodeinfo },
   { "getaddressesbyaccount", btc_rpc_getaddressesbyaccount },
   { "getaddressinfo", btc_rpc_getaddressinfo },
+  { "getaddresstxids", btc_rpc_getaddresstxids },
+  { "getaddressutxos", btc_rpc_getaddressutxos },
   { "getbalance", btc_rpc_getbalance },
   { "getbalances", btc_rpc_getbalances },
   { "getbestblockhash", btc_rpc_getbestblockhash },
   { "getblock", btc_rpc_getblock },
   { "getblockchaininfo", btc_rpc_getblockchaininfo },
   { "getblockcount", btc_rpc_getblockcount },
+  { "getblockfilter", btc_rpc_getblockfilter },
   { "getblockhash", btc_rpc_getblockhash },
   { "getblockheader", btc_rpc_getblockheader },
   { "getblocktemplate", btc_rpc_getblocktemplate },
@@ -0,0 +1,799 @@
+/*!
+ * snapshot.c - chaindb snapshots for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <io/core.h>
+
+#include <mako/coins.h>
+#include <mako/consensus.h>
+#include <mako/crypto/hash.h>
+#include <mako/entry.h>
+#include <mako/header.h>
+#include <mako/map.h>
+#include <mako/network.h>
+#include <mako/util.h>
+#include <mako/vector.h>
+
+#include <lcdb.h>
+
+#include "../bio.h"
+#include "../impl.h"
+#include "../internal.h"
+
+#include "chaindb_impl.h"
+#include "database.h"
+#include "snapshot.h"
+
+/*
+ * Constants
+ */
+
+#define SNAPSHOT_MAGIC 0x6f787475 /* "utxo" */
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_BUFFER (1 << 20)
+#define SNAPSHOT_BATCH 50000
+
+/*
+ * Database Keys
+ */
+
+static uint8_t import_key_[1] = {'X'};
+static uint8_t snapshot_key_[1] = {'V'};
+
+static const ldb_slice_t import_key = {import_key_, 1, 0};
+static const ldb_slice_t snapshot_key = {snapshot_key_, 1, 0};
+
+/*
+ * Snapshot File
+ */
+
+int
+btc_snapshot_create(btc_snapshot_t *snap, const char *path) {
+  snap->fd = btc_fs_create(path);
+
+  if (snap->fd == BTC_INVALID_FD)
+    return 0;
+
+  btc_sha256_init(&snap->ctx);
+
+  snap->data = (uint8_t *)btc_malloc(SNAPSHOT_BUFFER);
+  snap->pos = 0;
+  snap->length = 0;
+  snap->unread = 0;
+
+  return 1;
+}
+
+static int
+btc_snapshot_open(btc_snapshot_t *snap, const char *path) {
+  uint64_t size;
+
+  snap->fd = btc_fs_open(path);
+
+  if (snap->fd == BTC_INVALID_FD)
+    return 0;
+
+  if (!btc_fs_fsize(snap->fd, &size) || size < 32) {
+    btc_fs_close(snap->fd);
+    return 0;
+  }
+
+  btc_sha256_init(&snap->ctx);
+
+  snap->data = (uint8_t *)btc_malloc(SNAPSHOT_BUFFER);
+  snap->pos = 0;
+  snap->length = 0;
+  snap->unread = size - 32;
+
+  return 1;
+}
+
+void
+btc_snapshot_close(btc_snapshot_t *snap) {
+  btc_fs_close(snap->fd);
+  btc_free(snap->data);
+}
+
+static int
+btc_snapshot_flush(btc_snapshot_t *snap) {
+  int64_t len = snap->length;
+
+  if (btc_fs_write(snap->fd, snap->data, len) != len)
+    return 0;
+
+  snap->length = 0;
+
+  return 1;
+}
+
+int
+btc_snapshot_write(btc_snapshot_t *snap, const void *data, size_t len) {
+  const uint8_t *xp = (const uint8_t *)data;
+  size_t n;
+
+  btc_sha256_update(&snap->ctx, xp, len);
+
+  while (len > 0) {
+    if (snap->length == SNAPSHOT_BUFFER) {
+      if (!btc_snapshot_flush(snap))
+        return 0;
+    }
+
+    n = BTC_MIN(len, SNAPSHOT_BUFFER - snap->length);
+
+    memcpy(snap->data + snap->length, xp, n);
+
+    snap->length += n;
+    xp += n;
+    len -= n;
+  }
+
+  return 1;
+}
+
+int
+btc_snapshot_write32(btc_snapshot_t *snap, uint32_t x) {
+  uint8_t tmp[4];
+  btc_write32le(tmp, x);
+  return btc_snapshot_write(snap, tmp, 4);
+}
+
+static int
+btc_snapshot_write_varint(btc_snapshot_t *snap, uint64_t x) {
+  uint8_t tmp[10];
+  size_t len = btc_varint_write(tmp, x) - tmp;
+  return btc_snapshot_write(snap, tmp, len);
+}
+
+int
+btc_snapshot_commit(btc_snapshot_t *snap, uint8_t *hash) {
+  btc_sha256_final(&snap->ctx, hash);
+
+  if (!btc_snapshot_flush(snap))
+    return 0;
+
+  /* The trailing hash commits to everything before it. */
+  if (btc_fs_write(snap->fd, hash, 32) != 32)
+    return 0;
+
+  return btc_fs_fsync(snap->fd);
+}
+
+static int
+btc_snapshot_done(const btc_snapshot_t *snap) {
+  return snap->pos == snap->length && snap->unread == 0;
+}
+
+static int
+btc_snapshot_read(btc_snapshot_t *snap, void *data, size_t len) {
+  uint8_t *zp = (uint8_t *)data;
+  size_t n;
+
+  while (len > 0) {
+    if (snap->pos == snap->length) {
+      n = BTC_MIN(snap->unread, SNAPSHOT_BUFFER);
+
+      if (n == 0)
+        return 0;
+
+      if (btc_fs_read(snap->fd, snap->data, n) != (int64_t)n)
+        return 0;
+
+      snap->unread -= n;
+      snap->pos = 0;
+      snap->length = n;
+    }
+
+    n = BTC_MIN(len, snap->length - snap->pos);
+
+    memcpy(zp, snap->data + snap->pos, n);
+
+    btc_sha256_update(&snap->ctx, zp, n);
+
+    snap->pos += n;
+    zp += n;
+    len -= n;
+  }
+
+  return 1;
+}
+
+static int
+btc_snapshot_read32(btc_snapshot_t *snap, uint32_t *zp) {
+  uint8_t tmp[4];
+
+  if (!btc_snapshot_read(snap, tmp, 4))
+    return 0;
+
+  *zp = btc_read32le(tmp);
+
+  return 1;
+}
+
+static int
+btc_snapshot_read_varint(btc_snapshot_t *snap, uint64_t *zp) {
+  const uint8_t *xp;
+  uint8_t tmp[10];
+  size_t i, xn;
+
+  for (i = 0; i < sizeof(tmp); i++) {
+    if (!btc_snapshot_read(snap, &tmp[i], 1))
+      return 0;
+
+    if ((tmp[i] & 0x80) == 0)
+      break;
+  }
+
+  if (i == sizeof(tmp))
+    return 0;
+
+  xp = tmp;
+  xn = i + 1;
+
+  return btc_varint_read(zp, &xp, &xn);
+}
+
+static int
+btc_snapshot_verify(btc_snapshot_t *snap, uint8_t *hash) {
+  uint8_t expect[32];
+
+  if (!btc_snapshot_done(snap))
+    return 0;
+
+  if (btc_fs_read(snap->fd, expect, 32) != 32)
+    return 0;
+
+  btc_sha256_final(&snap->ctx, hash);
+
+  return btc_hash_equal(hash, expect);
+}
+
+/*
+ * Snapshots
+ */
+
+int
+btc_chaindb_export(btc_chaindb_t *db,
+                   const char *path,
+                   uint8_t *hash,
+                   uint64_t *count) {
+  const btc_entry_t *tip = db->tail;
+  uint8_t raw[80];
+  btc_snapshot_t snap;
+  uint8_t txid[32];
+  uint64_t total = 0;
+  uint64_t index;
+  ldb_iter_t *it;
+  int32_t height;
+  int ret = 0;
+
+  /* Everything must be on disk before we iterate. */
+  if (!btc_chaindb_flush_coins(db))
+    return 0;
+
+  if (!btc_snapshot_create(&snap, path))
+    return 0;
+
+  it = ldb_iterator(db->lsm, 0);
+
+  /* Header. */
+  if (!btc_snapshot_write32(&snap, SNAPSHOT_MAGIC))
+    goto fail;
+
+  if (!btc_snapshot_write32(&snap, SNAPSHOT_VERSION))
+    goto fail;
+
+  if (!btc_snapshot_write32(&snap, db->network->magic))
+    goto fail;
+
+  if (!btc_snapshot_write32(&snap, tip->height))
+    goto fail;
+
+  if (!btc_snapshot_write(&snap, tip->hash, 32))
+    goto fail;
+
+  /* Main chain headers (needed to rebuild the index). */
+  for (height = 0; height <= tip->height; height++) {
+    const btc_entry_t *entry = db->heights.items[height];
+
+    btc_header_write(raw, &entry->header);
+
+    if (!btc_snapshot_write(&snap, raw, sizeof(raw)))
+      goto fail;
+  }
+
+  /* Coins, grouped by txid. Each group is terminated
+     by a zero and each index is stored plus one. */
+  ldb_iter_range(it, &btc_coin_min, &btc_coin_max) {
+    ldb_slice_t key = ldb_iter_key(it);
+    ldb_slice_t val = ldb_iter_value(it);
+    const uint8_t *kp = (const uint8_t *)key.data;
+
+    CHECK(key.size == COIN_KEYLEN);
+
+    if (total == 0 || memcmp(kp + 1, txid, 32) != 0) {
+      if (total > 0 && !btc_snapshot_write_varint(&snap, 0))
+        goto fail;
+
+      memcpy(txid, kp + 1, 32);
+
+      if (!btc_snapshot_write(&snap, txid, 32))
+        goto fail;
+    }
+
+    index = btc_read32be(kp + 33);
+
+    if (!btc_snapshot_write_varint(&snap, index + 1))
+      goto fail;
+
+    if (!btc_snapshot_write_varint(&snap, val.size))
+      goto fail;
+
+    if (!btc_snapshot_write(&snap, val.data, val.size))
+      goto fail;
+
+    total += 1;
+  }
+
+  if (ldb_iter_status(it) != LDB_OK)
+    goto fail;
+
+  if (total > 0 && !btc_snapshot_write_varint(&snap, 0))
+    goto fail;
+
+  if (!btc_snapshot_commit(&snap, hash))
+    goto fail;
+
+  *count = total;
+
+  ret = 1;
+fail:
+  ldb_iter_destroy(it);
+  btc_snapshot_close(&snap);
+  return ret;
+}
+
+static int
+btc_chaindb_check_snapshot(btc_chaindb_t *db,
+                           int32_t height,
+                           const uint8_t *tip,
+                           const btc_coinstats_t *stats,
+                           const uint8_t *expect) {
+  const btc_assumeutxo_t *item;
+  uint8_t muhash[32];
+
+  /* Without an operator-supplied commitment, only
+     snapshots compiled into the network are trusted. */
+  if (expect == NULL) {
+    item = btc_network_assumeutxo(db->network, height);
+
+    if (item == NULL || !btc_hash_equal(item->hash, tip)) {
+      fprintf(stderr, "chaindb: unknown snapshot at height %d.\n",
+                      (int)height);
+      return 0;
+    }
+
+    expect = item->muhash;
+  }
+
+  btc_muhash_final(&stats->muhash, muhash);
+
+  if (!btc_hash_equal(muhash, expect)) {
+    fprintf(stderr, "chaindb: snapshot coins do not match its MuHash.\n");
+    return 0;
+  }
+
+  return 1;
+}
+
+static int
+btc_chaindb_import_step(btc_chaindb_t *db,
+                        ldb_batch_t *batch,
+                        size_t *pending) {
+  int stop = (db->import_limit > 0 && --db->import_limit == 0);
+
+  if (++*pending < SNAPSHOT_BATCH && !stop)
+    return 1;
+
+  if (ldb_write(db->lsm, batch, 0) != LDB_OK)
+    return 0;
+
+  ldb_batch_reset(batch);
+
+  *pending = 0;
+
+  return !stop;
+}
+
+static int
+btc_chaindb_read_snapshot(btc_chaindb_t *db,
+                          const char *path,
+                          const uint8_t *muhash,
+                          uint8_t *hash,
+                          btc_coinstats_t *stats,
+                          int commit) {
+  static const uint8_t one[1] = {1};
+  uint32_t magic, version, network, height, i;
+  uint8_t kbuf[COIN_KEYLEN], ebuf[BTC_ENTRY_SIZE];
+  uint8_t tip_hash[32], prev_hash[32], txid[32], digest[32];
+  btc_entry_t *entry, *prev = db->head;
+  uint8_t raw[80];
+  uint8_t *vbuf = db->slab;
+  btc_coin_t *coin = NULL;
+  ldb_slice_t key, val;
+  btc_snapshot_t snap;
+  size_t pending = 0;
+  ldb_batch_t batch;
+  btc_header_t hdr;
+  uint64_t index;
+  uint64_t size;
+  int ret = 0;
+  int first;
+
+  if (!btc_snapshot_open(&snap, path))
+    return 0;
+
+  ldb_batch_init(&batch);
+
+  /* Imported entries bypass the journal. The marker
+     goes out with the first write and is removed with
+     the last, so a reopen can tell a partial import. */
+  if (commit) {
+    val.data = (void *)one;
+    val.size = 1;
+
+    ldb_batch_del(&batch, &btc_index_key);
+    ldb_batch_put(&batch, &import_key, &val);
+
+    db->index_valid = 0;
+  }
+
+  if (!commit) {
+    coin = btc_coin_create();
+    btc_coinstats_init(stats);
+  }
+
+  /* Header. */
+  if (!btc_snapshot_read32(&snap, &magic) || magic != SNAPSHOT_MAGIC)
+    goto fail;
+
+  if (!btc_snapshot_read32(&snap, &version) || version != SNAPSHOT_VERSION)
+    goto fail;
+
+  if (!btc_snapshot_read32(&snap, &network))
+    goto fail;
+
+  if (network != db->network->magic)
+    goto fail;
+
+  if (!btc_snapshot_read32(&snap, &height) || height > INT32_MAX - 1)
+    goto fail;
+
+  if (!btc_snapshot_read(&snap, tip_hash, 32))
+    goto fail;
+
+  /* Headers. These must connect to our genesis block. */
+  btc_header_init(&hdr);
+
+  for (i = 0; i <= height; i++) {
+    if (!btc_snapshot_read(&snap, raw, sizeof(raw)))
+      goto fail;
+
+    if (!btc_header_import(&hdr, raw, sizeof(raw)))
+      goto fail;
+
+    if (i == 0) {
+      btc_header_hash(prev_hash, &hdr);
+
+      if (!btc_hash_equal(prev_hash, db->head->hash))
+        goto fail;
+
+      continue;
+    }
+
+    if (!btc_hash_equal(hdr.prev_block, prev_hash))
+      goto fail;
+
+    if (!btc_header_verify(&hdr))
+      goto fail;
+
+    btc_header_hash(prev_hash, &hdr);
+
+    if (!commit)
+      continue;
+
+    entry = btc_arena_alloc(&db->entries);
+
+    btc_entry_set_header(entry, &hdr, prev);
+
+    key.data = ebuf;
+    key.size = btc_entry_key(ebuf, entry->hash);
+
+    val.data = vbuf;
+    val.size = btc_entry_export(vbuf, entry);
+
+    ldb_batch_put(&batch, &key, &val);
+
+    CHECK(btc_hashmap_put(&db->hashes, entry->hash, entry));
+
+    prev->next = entry;
+    prev = entry;
+
+    btc_vector_push(&db->heights, entry);
+
+    if (!btc_chaindb_import_step(db, &batch, &pending))
+      goto fail;
+  }
+
+  if (!btc_hash_equal(prev_hash, tip_hash))
+    goto fail;
+
+  /* Coins. Groups must be sorted and unique. */
+  memset(txid, 0, 32);
+  first = 1;
+
+  while (!btc_snapshot_done(&snap)) {
+    uint8_t last[32];
+    int64_t prev_index = -1;
+
+    memcpy(last, txid, 32);
+
+    if (!btc_snapshot_read(&snap, txid, 32))
+      goto fail;
+
+    if (!first && memcmp(txid, last, 32) <= 0)
+      goto fail;
+
+    first = 0;
+
+    for (;;) {
+      if (!btc_snapshot_read_varint(&snap, &index))
+        goto fail;
+
+      if (index == 0)
+        break;
+
+      index -= 1;
+
+      if (index > UINT32_MAX || (int64_t)index <= prev_index)
+        goto fail;
+
+      prev_index = index;
+
+      if (!btc_snapshot_read_varint(&snap, &size))
+        goto fail;
+
+      if (size == 0 || size > BTC_MAX_RAW_BLOCK_SIZE)
+        goto fail;
+
+      if (!btc_snapshot_read(&snap, vbuf, size))
+        goto fail;
+
+      if (!commit) {
+        if (!btc_coin_import(coin, vbuf, size))
+          goto fail;
+
+        if (coin->height > (int32_t)height)
+          goto fail;
+
+        btc_coinstats_update(stats, txid, index, coin->height,
+                             coin->coinbase, &coin->output, 1);
+
+        continue;
+      }
+
+      key.data = kbuf;
+      key.size = btc_coin_key(kbuf, txid, index);
+
+      val.data = vbuf;
+      val.size = size;
+
+      ldb_batch_put(&batch, &key, &val);
+
+      if (!btc_chaindb_import_step(db, &batch, &pending))
+        goto fail;
+    }
+  }
+
+  if (!btc_snapshot_verify(&snap, digest))
+    goto fail;
+
+  if (!commit) {
+    if (!btc_chaindb_check_snapshot(db, (int32_t)height, tip_hash,
+                                    stats, muhash)) {
+      goto fail;
+    }
+
+    memcpy(hash, digest, 32);
+  } else {
+    /* The file changed between passes. */
+    if (!btc_hash_equal(digest, hash))
+      goto fail;
+  }
+
+  if (commit) {
+    /* Swap the genesis tip for the snapshot tip. */
+    key.data = kbuf;
+    key.size = btc_tip_key(kbuf, db->head->hash);
+
+    ldb_batch_del(&batch, &key);
+
+    key.size = btc_tip_key(kbuf, tip_hash);
+    val.data = (void *)one;
+    val.size = 1;
+
+    ldb_batch_put(&batch, &key, &val);
+
+    /* Chain state and coins now both reflect the tip. */
+    val.data = tip_hash;
+    val.size = 32;
+
+    ldb_batch_put(&batch, &btc_meta_key, &val);
+    ldb_batch_put(&batch, &btc_coins_key, &val);
+
+    /* Stats were computed by the first pass. */
+    val.data = vbuf;
+    val.size = btc_coinstats_export(vbuf, stats);
+
+    ldb_batch_put(&batch, &btc_stats_key, &val);
+
+    /* Nothing below the tip has been validated. */
+    btc_write32le(vbuf, height);
+
+    val.size = 4;
+
+    ldb_batch_put(&batch, &snapshot_key, &val);
+    ldb_batch_del(&batch, &import_key);
+
+    if (ldb_write(db->lsm, &batch, 0) != LDB_OK)
+      goto fail;
+
+    db->tail = prev;
+    db->flushed = prev;
+    db->stats = *stats;
+    db->unvalidated = height;
+  }
+
+  ret = 1;
+fail:
+  if (coin != NULL)
+    btc_coin_destroy(coin);
+
+  ldb_batch_clear(&batch);
+  btc_snapshot_close(&snap);
+
+  return ret;
+}
+
+int
+btc_chaindb_import(btc_chaindb_t *db,
+                   const char *path,
+                   const uint8_t *muhash,
+                   uint8_t *hash) {
+  btc_coinstats_t stats;
+
+  if (db->tail != db->head)
+    return 0;
+
+  if (!btc_chaindb_flush_coins(db))
+    return 0;
+
+  /* Check the commitments and contents before touching the database. */
+  if (!btc_chaindb_read_snapshot(db, path, muhash, hash, &stats, 0))
+    return 0;
+
+  if (!btc_chaindb_read_snapshot(db, path, NULL, hash, &stats, 1)) {
+    fprintf(stderr, "Snapshot import failed."
+                    " It will be rolled back on the next start.\n");
+    return 0;
+  }
+
+  return 1;
+}
+
+static int
+btc_chaindb_rollback_import(btc_chaindb_t *db) {
+  const uint8_t *genesis = db->network->genesis.hash;
+  size_t pending = 0;
+  ldb_batch_t batch;
+  ldb_slice_t key;
+  ldb_iter_t *it;
+  int ret = 0;
+
+  fprintf(stderr, "chaindb: rolling back an incomplete snapshot import.\n");
+
+  ldb_batch_init(&batch);
+
+  it = ldb_iterator(db->lsm, 0);
+
+  /* The import only runs on a fresh database, so
+     everything but the genesis entry goes. The tip
+     and coin keys were never moved off genesis. */
+  ldb_iter_range(it, &btc_entry_min, &btc_entry_max) {
+    key = ldb_iter_key(it);
+
+    if (btc_hash_equal((uint8_t *)key.data + 1, genesis))
+      continue;
+
+    ldb_batch_del(&batch, &key);
+
+    if (++pending == SNAPSHOT_BATCH) {
+      if (ldb_write(db->lsm, &batch, 0) != LDB_OK)
+        goto fail;
+
+      ldb_batch_reset(&batch);
+
+      pending = 0;
+    }
+  }
+
+  ldb_iter_range(it, &btc_coin_min, &btc_coin_max) {
+    key = ldb_iter_key(it);
+
+    ldb_batch_del(&batch, &key);
+
+    if (++pending == SNAPSHOT_BATCH) {
+      if (ldb_write(db->lsm, &batch, 0) != LDB_OK)
+        goto fail;
+
+      ldb_batch_reset(&batch);
+
+      pending = 0;
+    }
+  }
+
+  if (ldb_iter_status(it) != LDB_OK)
+    goto fail;
+
+  ldb_batch_del(&batch, &btc_index_key);
+  ldb_batch_del(&batch, &import_key);
+
+  if (ldb_write(db->lsm, &batch, 0) != LDB_OK)
+    goto fail;
+
+  ret = 1;
+fail:
+  ldb_iter_destroy(it);
+  ldb_batch_clear(&batch);
+  return ret;
+}
+
+int
+btc_chaindb_load_snapshot(btc_chaindb_t *db) {
+  ldb_slice_t val;
+  int rc;
+
+  db->unvalidated = -1;
+
+  rc = ldb_get(db->lsm, &import_key, &val, 0);
+
+  if (rc == LDB_OK) {
+    ldb_free(val.data);
+
+    if (!btc_chaindb_rollback_import(db))
+      return 0;
+  } else {
+    CHECK(rc == LDB_NOTFOUND);
+  }
+
+  rc = ldb_get(db->lsm, &snapshot_key, &val, 0);
+
+  if (rc == LDB_NOTFOUND)
+    return 1;
+
+  CHECK(rc == LDB_OK);
+  CHECK(val.size == 4);
+
+  db->unvalidated = (int32_t)btc_read32le(val.data);
+
+  ldb_free(val.data);
+
+  return 1;
+}
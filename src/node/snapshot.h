@@ -0,0 +1,55 @@
+/*!
+ * snapshot.h - chaindb snapshots for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#ifndef BTC_NODE_SNAPSHOT_H_
+#define BTC_NODE_SNAPSHOT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <io/core.h>
+#include <mako/crypto/hash.h>
+#include <node/types.h>
+
+/*
+ * Types
+ */
+
+typedef struct btc_snapshot_s {
+  btc_fd_t fd;
+  btc_sha256_t ctx;
+  uint8_t *data;
+  size_t pos;
+  size_t length;
+  uint64_t unread;
+} btc_snapshot_t;
+
+/*
+ * Snapshot File
+ */
+
+int
+btc_snapshot_create(btc_snapshot_t *snap, const char *path);
+
+void
+btc_snapshot_close(btc_snapshot_t *snap);
+
+int
+btc_snapshot_write(btc_snapshot_t *snap, const void *data, size_t len);
+
+int
+btc_snapshot_write32(btc_snapshot_t *snap, uint32_t x);
+
+int
+btc_snapshot_commit(btc_snapshot_t *snap, uint8_t *hash);
+
+/*
+ * Snapshot Import
+ */
+
+int
+btc_chaindb_load_snapshot(btc_chaindb_t *db);
+
+#endif /* BTC_NODE_SNAPSHOT_H_ */
@@ -0,0 +1,291 @@
+/*!
+ * txindex.c - chaindb transaction index for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <io/core.h>
+
+#include <mako/block.h>
+#include <mako/entry.h>
+#include <mako/tx.h>
+#include <mako/util.h>
+
+#include <lcdb.h>
+
+#include "../bio.h"
+#include "../impl.h"
+#include "../internal.h"
+
+#include "chaindb_impl.h"
+#include "database.h"
+#include "indexer.h"
+#include "txindex.h"
+
+/*
+ * Database Keys
+ */
+
+static size_t
+tx_key(uint8_t *key, const uint8_t *hash) {
+  key[0] = TX_PREFIX;
+  memcpy(key + 1, hash, 32);
+  return TX_KEYLEN;
+}
+
+/*
+ * Transaction Index
+ */
+
+typedef struct btc_txloc_s {
+  int32_t height;
+  int32_t file;
+  int32_t pos;
+  uint32_t offset;
+  uint32_t size;
+} btc_txloc_t;
+
+static size_t
+btc_txloc_export(uint8_t *zp, const btc_txloc_t *x) {
+  uint8_t *sp = zp;
+
+  zp = btc_varint_write(zp, x->height);
+  zp = btc_varint_write(zp, x->file);
+  zp = btc_varint_write(zp, x->pos);
+  zp = btc_varint_write(zp, x->offset);
+  zp = btc_varint_write(zp, x->size);
+
+  return zp - sp;
+}
+
+static int
+btc_txloc_import(btc_txloc_t *z, const uint8_t *xp, size_t xn) {
+  uint64_t height, file, pos, offset, size;
+
+  if (!btc_varint_read(&height, &xp, &xn))
+    return 0;
+
+  if (!btc_varint_read(&file, &xp, &xn))
+    return 0;
+
+  if (!btc_varint_read(&pos, &xp, &xn))
+    return 0;
+
+  if (!btc_varint_read(&offset, &xp, &xn))
+    return 0;
+
+  if (!btc_varint_read(&size, &xp, &xn))
+    return 0;
+
+  if (height > INT32_MAX || file > INT32_MAX || pos > INT32_MAX)
+    return 0;
+
+  if (offset > UINT32_MAX || size > UINT32_MAX)
+    return 0;
+
+  z->height = height;
+  z->file = file;
+  z->pos = pos;
+  z->offset = offset;
+  z->size = size;
+
+  return xn == 0;
+}
+
+/*
+ * Transaction Indexing
+ */
+
+void
+btc_chaindb_index_txs(btc_chaindb_t *db,
+                      ldb_batch_t *batch,
+                      const btc_entry_t *entry,
+                      const btc_block_t *block) {
+  uint8_t kbuf[TX_KEYLEN];
+  uint8_t vbuf[32];
+  ldb_slice_t key, val;
+  btc_txloc_t loc;
+  size_t i;
+
+  if (entry->block_pos == -1)
+    return;
+
+  loc.height = entry->height;
+  loc.file = entry->block_file;
+  loc.pos = entry->block_pos;
+  loc.offset = 80 + btc_size_size(block->txs.length);
+
+  key.data = kbuf;
+  key.size = TX_KEYLEN;
+
+  val.data = vbuf;
+
+  for (i = 0; i < block->txs.length; i++) {
+    const btc_tx_t *tx = block->txs.items[i];
+
+    loc.size = btc_tx_size(tx);
+
+    tx_key(kbuf, tx->hash);
+
+    val.size = btc_txloc_export(vbuf, &loc);
+
+    ldb_batch_put(batch, &key, &val);
+
+    loc.offset += loc.size;
+  }
+
+  btc_indexer_connect(&db->txindex, batch, entry);
+}
+
+void
+btc_chaindb_unindex_txs(btc_chaindb_t *db,
+                        ldb_batch_t *batch,
+                        const btc_entry_t *entry) {
+  /* Stale locations are rejected on lookup,
+     so only the tip needs to move back. */
+  btc_indexer_disconnect(&db->txindex, batch, entry);
+}
+
+int
+btc_txindex_backfill(btc_indexer_t *ix,
+                     ldb_batch_t *batch,
+                     const btc_blockloc_t *blk) {
+  uint8_t kbuf[TX_KEYLEN];
+  uint8_t vbuf[32];
+  ldb_slice_t key, val;
+  btc_rawblock_t block;
+  const uint8_t *xp;
+  uint8_t hash[32];
+  btc_txloc_t loc;
+  uint8_t *data;
+  btc_rawtx_t tx;
+  size_t i, len, xn;
+  int ret = 0;
+
+  if (!btc_chaindb_pread(ix->db, &data, &len, BLOCK_FILE, blk->block_file,
+                                                           blk->block_pos)) {
+    return 0;
+  }
+
+  /* Walk the raw block rather than decoding it. */
+  if (!btc_rawblock_import(&block, data + 24, len - 24))
+    goto fail;
+
+  loc.height = blk->height;
+  loc.file = blk->block_file;
+  loc.pos = blk->block_pos;
+
+  key.data = kbuf;
+  key.size = TX_KEYLEN;
+
+  val.data = vbuf;
+
+  xp = block.txs.data;
+  xn = block.txs.size;
+
+  for (i = 0; i < block.txs.length; i++) {
+    CHECK(btc_rawtx_read(&tx, &xp, &xn));
+
+    btc_rawtx_txid(hash, &tx);
+
+    loc.offset = tx.data - block.data;
+    loc.size = tx.size;
+
+    tx_key(kbuf, hash);
+
+    val.size = btc_txloc_export(vbuf, &loc);
+
+    ldb_batch_put(batch, &key, &val);
+  }
+
+  ret = 1;
+fail:
+  free(data);
+  return ret;
+}
+
+int
+btc_chaindb_get_tx(btc_chaindb_t *db,
+                   btc_tx_t **result,
+                   const btc_entry_t **block,
+                   const uint8_t *hash) {
+  uint8_t kbuf[TX_KEYLEN];
+  const btc_entry_t *entry;
+  uint8_t *data = NULL;
+  ldb_slice_t key, val;
+  btc_fdent_t *ent;
+  btc_txloc_t loc;
+  btc_tx_t *tx;
+  int rc, ok;
+
+  if (!(db->flags & BTC_CHAIN_TXINDEX))
+    return 0;
+
+  key.data = kbuf;
+  key.size = tx_key(kbuf, hash);
+
+  rc = ldb_get(db->lsm, &key, &val, 0);
+
+  if (rc != LDB_OK) {
+    if (rc != LDB_NOTFOUND)
+      fprintf(stderr, "ldb_get: %s\n", ldb_strerror(rc));
+
+    return 0;
+  }
+
+  ok = btc_txloc_import(&loc, val.data, val.size);
+
+  ldb_free(val.data);
+
+  if (!ok)
+    return 0;
+
+  /* Disconnected blocks leave their locations behind. */
+  entry = btc_chaindb_by_height(db, loc.height);
+
+  if (entry == NULL)
+    return 0;
+
+  if (entry->block_file != loc.file || entry->block_pos != loc.pos)
+    return 0;
+
+  if (!btc_chaindb_sync(db, BLOCK_FILE, loc.file))
+    return 0;
+
+  ent = btc_chaindb_acquire(db, BLOCK_FILE, loc.file);
+
+  if (ent == NULL)
+    return 0;
+
+  data = (uint8_t *)btc_malloc(loc.size);
+  tx = NULL;
+
+  /* A single positioned read gets us the transaction. */
+  if (btc_fs_pread(ent->fd, data, loc.size,
+                   (int64_t)loc.pos + 24 + loc.offset) == (int64_t)loc.size) {
+    tx = btc_tx_decode(data, loc.size);
+  }
+
+  btc_fdcache_release(&db->fds, ent);
+  btc_free(data);
+
+  if (tx == NULL)
+    return 0;
+
+  if (!btc_hash_equal(tx->hash, hash)) {
+    btc_tx_destroy(tx);
+    return 0;
+  }
+
+  *result = tx;
+
+  if (block != NULL)
+    *block = entry;
+
+  return 1;
+}
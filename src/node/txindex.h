@@ -0,0 +1,33 @@
+/*!
+ * txindex.h - chaindb transaction index for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#ifndef BTC_NODE_TXINDEX_H_
+#define BTC_NODE_TXINDEX_H_
+
+#include <lcdb.h>
+#include "chaindb_impl.h"
+
+/*
+ * Transaction Indexing
+ */
+
+void
+btc_chaindb_index_txs(btc_chaindb_t *db,
+                      ldb_batch_t *batch,
+                      const btc_entry_t *entry,
+                      const btc_block_t *block);
+
+void
+btc_chaindb_unindex_txs(btc_chaindb_t *db,
+                        ldb_batch_t *batch,
+                        const btc_entry_t *entry);
+
+int
+btc_txindex_backfill(btc_indexer_t *ix,
+                     ldb_batch_t *batch,
+                     const btc_blockloc_t *loc);
+
+#endif /* BTC_NODE_TXINDEX_H_ */
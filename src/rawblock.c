@@ -0,0 +1,322 @@
+/*!
+ * rawblock.c - borrowed block and tx views for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <mako/block.h>
+#include <mako/crypto/hash.h>
+#include <mako/header.h>
+#include <mako/script.h>
+#include <mako/tx.h>
+#include <mako/util.h>
+#include "impl.h"
+#include "internal.h"
+
+/*
+ * Raw Helpers
+ */
+
+static int
+btc_rawbytes_read(btc_buffer_t *z, const uint8_t **xp, size_t *xn) {
+  const uint8_t *zp;
+  size_t zn;
+
+  if (!btc_size_read(&zn, xp, xn))
+    return 0;
+
+  if (!btc_zraw_read(&zp, zn, xp, xn))
+    return 0;
+
+  btc_buffer_roset(z, zp, zn);
+
+  return 1;
+}
+
+static int
+btc_rawvec_read(btc_rawvec_t *z,
+                int (*read)(void *, const uint8_t **, size_t *),
+                void *item,
+                const uint8_t **xp,
+                size_t *xn) {
+  size_t i;
+
+  if (!btc_size_read(&z->length, xp, xn))
+    return 0;
+
+  z->data = *xp;
+
+  for (i = 0; i < z->length; i++) {
+    if (!read(item, xp, xn))
+      return 0;
+  }
+
+  z->size = *xp - z->data;
+
+  return 1;
+}
+
+static int
+read_input(void *item, const uint8_t **xp, size_t *xn) {
+  return btc_rawinput_read((btc_rawinput_t *)item, xp, xn);
+}
+
+static int
+read_output(void *item, const uint8_t **xp, size_t *xn) {
+  return btc_rawoutput_read((btc_output_t *)item, xp, xn);
+}
+
+static int
+read_item(void *item, const uint8_t **xp, size_t *xn) {
+  return btc_rawbytes_read((btc_buffer_t *)item, xp, xn);
+}
+
+/*
+ * Raw Input
+ */
+
+int
+btc_rawinput_read(btc_rawinput_t *z, const uint8_t **xp, size_t *xn) {
+  if (!btc_outpoint_read(&z->prevout, xp, xn))
+    return 0;
+
+  if (!btc_rawbytes_read(&z->script, xp, xn))
+    return 0;
+
+  if (!btc_uint32_read(&z->sequence, xp, xn))
+    return 0;
+
+  return 1;
+}
+
+int
+btc_rawinput_import(btc_rawinput_t *z, const uint8_t *xp, size_t xn) {
+  return btc_rawinput_read(z, &xp, &xn);
+}
+
+/*
+ * Raw Output
+ */
+
+int
+btc_rawoutput_read(btc_output_t *z, const uint8_t **xp, size_t *xn) {
+  if (!btc_int64_read(&z->value, xp, xn))
+    return 0;
+
+  if (!btc_rawbytes_read(&z->script, xp, xn))
+    return 0;
+
+  return 1;
+}
+
+/*
+ * Raw Witness
+ */
+
+int
+btc_rawwitness_read(btc_rawvec_t *z, const uint8_t **xp, size_t *xn) {
+  btc_buffer_t item;
+  return btc_rawvec_read(z, read_item, &item, xp, xn);
+}
+
+int
+btc_rawitem_read(btc_buffer_t *z, const uint8_t **xp, size_t *xn) {
+  return btc_rawbytes_read(z, xp, xn);
+}
+
+/*
+ * Raw Transaction
+ */
+
+int
+btc_rawtx_read(btc_rawtx_t *z, const uint8_t **xp, size_t *xn) {
+  btc_rawinput_t input;
+  btc_output_t output;
+  btc_rawvec_t stack;
+  unsigned int flags = 0;
+  int witness = 0;
+  size_t i;
+
+  z->data = *xp;
+
+  if (!btc_uint32_read(&z->version, xp, xn))
+    return 0;
+
+  if (*xn >= 2 && (*xp)[0] == 0 && (*xp)[1] != 0) {
+    flags = (*xp)[1];
+    *xp += 2;
+    *xn -= 2;
+  }
+
+  if (!btc_rawvec_read(&z->inputs, read_input, &input, xp, xn))
+    return 0;
+
+  if (!btc_rawvec_read(&z->outputs, read_output, &output, xp, xn))
+    return 0;
+
+  z->witness.data = NULL;
+  z->witness.size = 0;
+  z->witness.length = 0;
+
+  if (flags & 1) {
+    flags ^= 1;
+
+    z->witness.data = *xp;
+    z->witness.length = z->inputs.length;
+
+    for (i = 0; i < z->inputs.length; i++) {
+      if (!btc_rawwitness_read(&stack, xp, xn))
+        return 0;
+
+      if (stack.length > 0)
+        witness = 1;
+    }
+
+    /* Same rule as btc_tx_read: the flag
+       must not be set for empty witnesses. */
+    if (!witness)
+      return 0;
+
+    z->witness.size = *xp - z->witness.data;
+  }
+
+  if (flags != 0)
+    return 0;
+
+  if (!btc_uint32_read(&z->locktime, xp, xn))
+    return 0;
+
+  z->size = *xp - z->data;
+
+  return 1;
+}
+
+int
+btc_rawtx_import(btc_rawtx_t *z, const uint8_t *xp, size_t xn) {
+  return btc_rawtx_read(z, &xp, &xn);
+}
+
+btc_tx_t *
+btc_rawtx_decode(const btc_rawtx_t *tx) {
+  return btc_tx_decode(tx->data, tx->size);
+}
+
+int
+btc_rawtx_has_witness(const btc_rawtx_t *tx) {
+  return tx->witness.data != NULL;
+}
+
+int
+btc_rawtx_is_coinbase(const btc_rawtx_t *tx) {
+  btc_rawinput_t input;
+
+  if (tx->inputs.length != 1)
+    return 0;
+
+  CHECK(btc_rawinput_import(&input, tx->inputs.data, tx->inputs.size));
+
+  return btc_outpoint_is_null(&input.prevout);
+}
+
+void
+btc_rawtx_txid(uint8_t *hash, const btc_rawtx_t *tx) {
+  const uint8_t *base = tx->data + 6;
+  btc_hash256_t ctx;
+
+  if (!btc_rawtx_has_witness(tx)) {
+    btc_hash256(hash, tx->data, tx->size);
+    return;
+  }
+
+  /* Skip the marker, flag and witness data. */
+  btc_hash256_init(&ctx);
+  btc_hash256_update(&ctx, tx->data, 4);
+  btc_hash256_update(&ctx, base, tx->witness.data - base);
+  btc_hash256_update(&ctx, tx->data + tx->size - 4, 4);
+  btc_hash256_final(&ctx, hash);
+}
+
+void
+btc_rawtx_wtxid(uint8_t *hash, const btc_rawtx_t *tx) {
+  btc_hash256(hash, tx->data, tx->size);
+}
+
+void
+btc_rawtx_refresh(btc_tx_t *z, const btc_rawtx_t *tx) {
+  /* Fill in the hashes of a transaction decoded from `tx`. */
+  btc_rawtx_wtxid(z->whash, tx);
+
+  if (btc_rawtx_has_witness(tx))
+    btc_rawtx_txid(z->hash, tx);
+  else
+    btc_hash_copy(z->hash, z->whash);
+}
+
+size_t
+btc_rawtx_base_size(const btc_rawtx_t *tx) {
+  if (!btc_rawtx_has_witness(tx))
+    return tx->size;
+
+  return tx->size - 2 - tx->witness.size;
+}
+
+size_t
+btc_rawtx_witness_size(const btc_rawtx_t *tx) {
+  return tx->size - btc_rawtx_base_size(tx);
+}
+
+/*
+ * Raw Block
+ */
+
+static int
+read_tx(void *item, const uint8_t **xp, size_t *xn) {
+  return btc_rawtx_read((btc_rawtx_t *)item, xp, xn);
+}
+
+int
+btc_rawblock_read(btc_rawblock_t *z, const uint8_t **xp, size_t *xn) {
+  btc_rawtx_t tx;
+
+  z->data = *xp;
+
+  if (!btc_header_read(&z->header, xp, xn))
+    return 0;
+
+  if (!btc_rawvec_read(&z->txs, read_tx, &tx, xp, xn))
+    return 0;
+
+  z->size = *xp - z->data;
+
+  return 1;
+}
+
+int
+btc_rawblock_import(btc_rawblock_t *z, const uint8_t *xp, size_t xn) {
+  return btc_rawblock_read(z, &xp, &xn);
+}
+
+btc_block_t *
+btc_rawblock_decode(const btc_rawblock_t *blk) {
+  return btc_block_decode(blk->data, blk->size);
+}
+
+size_t
+btc_rawblock_base_size(const btc_rawblock_t *blk) {
+  const uint8_t *xp = blk->txs.data;
+  size_t xn = blk->txs.size;
+  size_t size = blk->size;
+  btc_rawtx_t tx;
+  size_t i;
+
+  for (i = 0; i < blk->txs.length; i++) {
+    CHECK(btc_rawtx_read(&tx, &xp, &xn));
+
+    size -= btc_rawtx_witness_size(&tx);
+  }
+
+  return size;
+}
@@ -111,6 +111,19 @@ static const btc_network_t regtest = {
     /* .length = */ lengthof(regtest_checkpoints)
   },
   /* .last_checkpoint = */ 0,
+  /* .assume_valid = */ {
+    0,
+    {
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    }
+  },
+  /* .assume_utxo = */ {
+    /* .items = */ NULL,
+    /* .length = */ 0
+  },
   /* .halving_interval = */ 150,
   /* .genesis = */ {
     /* .hash = */ {
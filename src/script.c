@@ -14,6 +14,7 @@
 #include <mako/encoding.h>
 #include <mako/crypto/ecc.h>
 #include <mako/crypto/hash.h>
+#include <mako/keycache.h>
 #include <mako/policy.h>
 #include <mako/script.h>
 #include <mako/tx.h>
@@ -1579,7 +1580,10 @@ validate_key(const btc_buffer_t *key, unsigned int flags, int version) {
 }
 
 static int
-checksig(const uint8_t *msg, const btc_buffer_t *sig, const btc_buffer_t *key) {
+checksig(const uint8_t *msg,
+         const btc_buffer_t *sig,
+         const btc_buffer_t *key,
+         btc_keycache_t *keys) {
   uint8_t tmp[64];
 
   if (sig->length == 0)
@@ -1591,7 +1595,7 @@ checksig(const uint8_t *msg, const btc_buffer_t *sig, const btc_buffer_t *key) {
   if (!btc_ecdsa_sig_normalize(tmp, tmp))
     return 0;
 
-  return btc_ecdsa_verify(msg, 32, tmp, key->data, key->length);
+  return btc_keycache_verify(keys, msg, tmp, key->data, key->length);
 }
 
 #define THROW(x) do { err = (x); goto done; } while (0)
@@ -1605,6 +1609,7 @@ btc_script_execute(const btc_script_t *script,
                    int64_t value,
                    int version,
                    btc_tx_cache_t *cache) {
+  btc_keycache_t *keys = cache != NULL ? cache->keys : NULL;
   int err = BTC_SCRIPT_ERR_OK;
   int opcount = 0;
   int negate = 0;
@@ -2342,7 +2347,7 @@ btc_script_execute(const btc_script_t *script,
           btc_tx_sighash(hash, tx, index, &subscript,
                          value, type, version, cache);
 
-          res = checksig(hash, sig, key);
+          res = checksig(hash, sig, key, keys);
         }
 
         if (!res && (flags & BTC_SCRIPT_VERIFY_NULLFAIL)) {
@@ -2438,7 +2443,7 @@ btc_script_execute(const btc_script_t *script,
             btc_tx_sighash(hash, tx, index, &subscript,
                            value, type, version, cache);
 
-            if (checksig(hash, sig, key)) {
+            if (checksig(hash, sig, key, keys)) {
               isig += 1;
               m -= 1;
             }
@@ -364,7 +364,7 @@ btc_tx_sign(btc_tx_t *tx,
   int total = 0;
   size_t i;
 
-  memset(&cache, 0, sizeof(cache));
+  btc_tx_cache_init(&cache);
 
   for (i = 0; i < addrs->length; i++) {
     const btc_address_t *addr = addrs->items[i];
@@ -377,6 +377,8 @@ btc_tx_sign(btc_tx_t *tx,
     btc_memzero(priv, 32);
   }
 
+  btc_tx_cache_clear(&cache);
+
   for (i = 0; i < addrs->length; i++)
     btc_address_destroy(addrs->items[i]);
 
@@ -149,6 +149,19 @@ static const btc_network_t signet = {
     /* .length = */ lengthof(signet_checkpoints)
   },
   /* .last_checkpoint = */ 60000,
+  /* .assume_valid = */ {
+    60000,
+    {
+      0xf1, 0x01, 0xc8, 0xa4, 0x0e, 0xad, 0x82, 0xf4,
+      0x22, 0x2b, 0xb8, 0x97, 0xc1, 0xce, 0x3d, 0x76,
+      0xf9, 0x35, 0xae, 0xf7, 0xb3, 0xac, 0x32, 0xe2,
+      0x4e, 0xa7, 0x66, 0xab, 0x30, 0x01, 0x00, 0x00
+    }
+  },
+  /* .assume_utxo = */ {
+    /* .items = */ NULL,
+    /* .length = */ 0
+  },
   /* .halving_interval = */ 210000,
   /* .genesis = */ {
     /* .hash = */ {
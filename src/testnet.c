@@ -645,6 +645,19 @@ static const btc_network_t testnet = {
     /* .length = */ lengthof(testnet_checkpoints)
   },
   /* .last_checkpoint = */ 2110000,
+  /* .assume_valid = */ {
+    2110000,
+    {
+      0xed, 0x2a, 0x79, 0x20, 0x83, 0x9c, 0xbb, 0x25,
+      0x59, 0x66, 0x16, 0x2e, 0x4a, 0x31, 0x55, 0x01,
+      0xa6, 0x2b, 0xde, 0x81, 0x73, 0x2e, 0x1f, 0xb9,
+      0xac, 0x30, 0x44, 0x00, 0x00, 0x00, 0x00, 0x00
+    }
+  },
+  /* .assume_utxo = */ {
+    /* .items = */ NULL,
+    /* .length = */ 0
+  },
   /* .halving_interval = */ 210000,
   /* .genesis = */ {
     /* .hash = */ {
@@ -123,17 +123,102 @@ btc_tx_refresh(btc_tx_t *tx) {
   }
 }
 
+static void
+btc_tx_hash_legacy(btc_tx_cache_t *cache, const btc_tx_t *tx) {
+  size_t size = 4 + btc_size_size(tx->inputs.length)
+              + tx->inputs.length * 41
+              + btc_outvec_size(&tx->outputs)
+              + 4;
+  size_t i, blocks = (size >> 6) + 1;
+  btc_hash256_t ctx;
+  uint8_t *zp;
+
+  /* Serialize the transaction as SIGHASH_ALL sees it
+     with no input selected: every script is empty, so
+     each input is exactly 41 bytes and the byte which
+     the selected input's script replaces is known. */
+  cache->legacy = (uint8_t *)btc_malloc(size);
+  cache->legacy_size = size;
+
+  zp = btc_uint32_write(cache->legacy, tx->version);
+  zp = btc_size_write(zp, tx->inputs.length);
+
+  cache->legacy_start = zp - cache->legacy;
+
+  for (i = 0; i < tx->inputs.length; i++) {
+    const btc_input_t *input = tx->inputs.items[i];
+
+    zp = btc_outpoint_write(zp, &input->prevout);
+    zp = btc_uint8_write(zp, 0);
+    zp = btc_uint32_write(zp, input->sequence);
+  }
+
+  zp = btc_outvec_write(zp, &tx->outputs);
+  zp = btc_uint32_write(zp, tx->locktime);
+
+  CHECK((size_t)(zp - cache->legacy) == size);
+
+  /* Keep the midstate at every block boundary so an
+     input's digest starts at the block containing it. */
+  cache->midstates = (uint32_t *)btc_malloc(blocks * 32);
+
+  btc_hash256_init(&ctx);
+
+  for (i = 0; i < blocks; i++) {
+    memcpy(&cache->midstates[i * 8], ctx.state, 32);
+
+    if (i < blocks - 1)
+      btc_hash256_update(&ctx, cache->legacy + i * 64, 64);
+  }
+
+  cache->has_legacy = 1;
+}
+
+static void
+btc_tx_sighash_legacy(uint8_t *hash,
+                      size_t index,
+                      const btc_script_t *prev,
+                      int type,
+                      const btc_tx_cache_t *cache) {
+  size_t pos = cache->legacy_start + index * 41 + 36;
+  size_t block = pos >> 6;
+  btc_hash256_t ctx;
+
+  /* Resume from the midstate preceding this input's
+     script, splice in the previous output script and
+     hash the unchanged remainder in one pass. */
+  memcpy(ctx.state, &cache->midstates[block * 8], 32);
+
+  ctx.size = block << 6;
+
+  btc_hash256_update(&ctx, cache->legacy + (block << 6), pos & 63);
+  btc_script_update_v0(&ctx, prev);
+  btc_hash256_update(&ctx, cache->legacy + pos + 1,
+                           cache->legacy_size - pos - 1);
+  btc_int32_update(&ctx, type);
+  btc_hash256_final(&ctx, hash);
+}
+
 static void
 btc_tx_sighash_v0(uint8_t *hash,
                   const btc_tx_t *tx,
                   size_t index,
                   const btc_script_t *prev,
-                  int type) {
+                  int type,
+                  const btc_tx_cache_t *cache) {
   const btc_input_t *input;
   const btc_output_t *output;
   btc_hash256_t ctx;
   size_t i;
 
+  if (cache != NULL && cache->has_legacy
+      && !(type & BTC_SIGHASH_ANYONECANPAY)
+      && (type & 0x1f) != BTC_SIGHASH_SINGLE
+      && (type & 0x1f) != BTC_SIGHASH_NONE) {
+    btc_tx_sighash_legacy(hash, index, prev, type, cache);
+    return;
+  }
+
   if ((type & 0x1f) == BTC_SIGHASH_SINGLE) {
     /**
      * Satoshi's code returned 1 as an error code.
@@ -251,6 +336,45 @@ btc_tx_sighash_v0(uint8_t *hash,
   btc_hash256_final(&ctx, hash);
 }
 
+static void
+btc_tx_hash_prevouts(uint8_t *hash, const btc_tx_t *tx) {
+  btc_hash256_t ctx;
+  size_t i;
+
+  btc_hash256_init(&ctx);
+
+  for (i = 0; i < tx->inputs.length; i++)
+    btc_outpoint_update(&ctx, &tx->inputs.items[i]->prevout);
+
+  btc_hash256_final(&ctx, hash);
+}
+
+static void
+btc_tx_hash_sequences(uint8_t *hash, const btc_tx_t *tx) {
+  btc_hash256_t ctx;
+  size_t i;
+
+  btc_hash256_init(&ctx);
+
+  for (i = 0; i < tx->inputs.length; i++)
+    btc_uint32_update(&ctx, tx->inputs.items[i]->sequence);
+
+  btc_hash256_final(&ctx, hash);
+}
+
+static void
+btc_tx_hash_outputs(uint8_t *hash, const btc_tx_t *tx) {
+  btc_hash256_t ctx;
+  size_t i;
+
+  btc_hash256_init(&ctx);
+
+  for (i = 0; i < tx->outputs.length; i++)
+    btc_output_update(&ctx, tx->outputs.items[i]);
+
+  btc_hash256_final(&ctx, hash);
+}
+
 static void
 btc_tx_sighash_v1(uint8_t *hash,
                   const btc_tx_t *tx,
@@ -264,7 +388,6 @@ btc_tx_sighash_v1(uint8_t *hash,
   uint8_t sequences[32];
   uint8_t outputs[32];
   btc_hash256_t ctx;
-  size_t i;
 
   btc_hash_init(prevouts);
   btc_hash_init(sequences);
@@ -274,12 +397,7 @@ btc_tx_sighash_v1(uint8_t *hash,
     if (cache != NULL && cache->has_prevouts) {
       btc_hash_copy(prevouts, cache->prevouts);
     } else {
-      btc_hash256_init(&ctx);
-
-      for (i = 0; i < tx->inputs.length; i++)
-        btc_outpoint_update(&ctx, &tx->inputs.items[i]->prevout);
-
-      btc_hash256_final(&ctx, prevouts);
+      btc_tx_hash_prevouts(prevouts, tx);
 
       if (cache != NULL) {
         btc_hash_copy(cache->prevouts, prevouts);
@@ -294,12 +412,7 @@ btc_tx_sighash_v1(uint8_t *hash,
     if (cache != NULL && cache->has_sequences) {
       btc_hash_copy(sequences, cache->sequences);
     } else {
-      btc_hash256_init(&ctx);
-
-      for (i = 0; i < tx->inputs.length; i++)
-        btc_uint32_update(&ctx, tx->inputs.items[i]->sequence);
-
-      btc_hash256_final(&ctx, sequences);
+      btc_tx_hash_sequences(sequences, tx);
 
       if (cache != NULL) {
         btc_hash_copy(cache->sequences, sequences);
@@ -313,12 +426,7 @@ btc_tx_sighash_v1(uint8_t *hash,
     if (cache != NULL && cache->has_outputs) {
       btc_hash_copy(outputs, cache->outputs);
     } else {
-      btc_hash256_init(&ctx);
-
-      for (i = 0; i < tx->outputs.length; i++)
-        btc_output_update(&ctx, tx->outputs.items[i]);
-
-      btc_hash256_final(&ctx, outputs);
+      btc_tx_hash_outputs(outputs, tx);
 
       if (cache != NULL) {
         btc_hash_copy(cache->outputs, outputs);
@@ -349,6 +457,57 @@ btc_tx_sighash_v1(uint8_t *hash,
   btc_hash256_final(&ctx, hash);
 }
 
+void
+btc_tx_cache_init(btc_tx_cache_t *cache) {
+  memset(cache, 0, sizeof(*cache));
+
+  cache->legacy = NULL;
+  cache->midstates = NULL;
+  cache->keys = NULL;
+}
+
+void
+btc_tx_cache_clear(btc_tx_cache_t *cache) {
+  if (cache->legacy != NULL)
+    btc_free(cache->legacy);
+
+  if (cache->midstates != NULL)
+    btc_free(cache->midstates);
+
+  btc_tx_cache_init(cache);
+}
+
+void
+btc_tx_precompute(const btc_tx_t *tx, btc_tx_cache_t *cache) {
+  size_t i, legacy = 0;
+
+  btc_tx_cache_init(cache);
+
+  for (i = 0; i < tx->inputs.length; i++) {
+    if (tx->inputs.items[i]->witness.length == 0)
+      legacy++;
+  }
+
+  /* Once filled, the cache is never written to
+     again and may be shared between threads. */
+
+  /* Building the legacy cache costs about one full
+     digest; a few inputs are cheaper to hash directly. */
+  if (legacy >= 4)
+    btc_tx_hash_legacy(cache, tx);
+
+  if (legacy == tx->inputs.length)
+    return;
+
+  btc_tx_hash_prevouts(cache->prevouts, tx);
+  btc_tx_hash_sequences(cache->sequences, tx);
+  btc_tx_hash_outputs(cache->outputs, tx);
+
+  cache->has_prevouts = 1;
+  cache->has_sequences = 1;
+  cache->has_outputs = 1;
+}
+
 void
 btc_tx_sighash(uint8_t *hash,
                const btc_tx_t *tx,
@@ -360,7 +519,7 @@ btc_tx_sighash(uint8_t *hash,
                btc_tx_cache_t *cache) {
   /* Traditional sighashing. */
   if (version == 0) {
-    btc_tx_sighash_v0(hash, tx, index, prev, type);
+    btc_tx_sighash_v0(hash, tx, index, prev, type, cache);
     return;
   }
 
@@ -378,22 +537,26 @@ btc_tx_verify(const btc_tx_t *tx, const btc_view_t *view, unsigned int flags) {
   const btc_input_t *input;
   const btc_coin_t *coin;
   btc_tx_cache_t cache;
+  int ret = 0;
   size_t i;
 
-  memset(&cache, 0, sizeof(cache));
+  btc_tx_precompute(tx, &cache);
 
   for (i = 0; i < tx->inputs.length; i++) {
     input = tx->inputs.items[i];
     coin = btc_view_get(view, &input->prevout);
 
     if (coin == NULL)
-      return 0;
+      goto fail;
 
     if (!btc_tx_verify_input(tx, i, &coin->output, flags, &cache))
-      return 0;
+      goto fail;
   }
 
-  return 1;
+  ret = 1;
+fail:
+  btc_tx_cache_clear(&cache);
+  return ret;
 }
 
 int
@@ -1002,6 +1165,71 @@ btc_tx_matches(const btc_tx_t *tx, btc_bloom_t *filter) {
   return 0;
 }
 
+int
+btc_rawtx_matches(const btc_rawtx_t *tx,
+                  const uint8_t *hash,
+                  btc_bloom_t *filter) {
+  /* Same as btc_tx_matches, without decoding. */
+  const uint8_t *xp;
+  btc_rawinput_t input;
+  btc_output_t output;
+  uint8_t raw[36];
+  int found = 0;
+  size_t i, xn;
+
+  /* 1. Test the tx hash. */
+  if (btc_bloom_has(filter, hash, 32))
+    found = 1;
+
+  /* 2. Test data elements in output scripts
+        (may need to update filter on match). */
+  btc_raw_write(raw, hash, 32);
+
+  xp = tx->outputs.data;
+  xn = tx->outputs.size;
+
+  for (i = 0; i < tx->outputs.length; i++) {
+    CHECK(btc_rawoutput_read(&output, &xp, &xn));
+
+    if (btc_script_matches(&output.script, filter)) {
+      if (filter->update == BTC_BLOOM_ALL) {
+        btc_uint32_write(raw + 32, i);
+        btc_bloom_add(filter, raw, 36);
+      } else if (filter->update == BTC_BLOOM_PUBKEY_ONLY) {
+        if (btc_script_is_p2pk(&output.script)
+            || btc_script_is_multisig(&output.script)) {
+          btc_uint32_write(raw + 32, i);
+          btc_bloom_add(filter, raw, 36);
+        }
+      }
+      found = 1;
+    }
+  }
+
+  if (found)
+    return found;
+
+  /* 3. Test prev_out structure. */
+  /* 4. Test data elements in input scripts. */
+  xp = tx->inputs.data;
+  xn = tx->inputs.size;
+
+  for (i = 0; i < tx->inputs.length; i++) {
+    CHECK(btc_rawinput_read(&input, &xp, &xn));
+
+    btc_outpoint_write(raw, &input.prevout);
+
+    if (btc_bloom_has(filter, raw, 36))
+      return 1;
+
+    if (btc_script_matches(&input.script, filter))
+      return 1;
+  }
+
+  /* 5. No match. */
+  return 0;
+}
+
 btc_vector_t *
 btc_tx_input_addrs(const btc_tx_t *tx, const btc_view_t *view) {
   btc_vector_t *out = btc_vector_create();
@@ -1279,10 +1507,8 @@ btc_tx_write(uint8_t *zp, const btc_tx_t *tx) {
 }
 
 int
-btc_tx_read(btc_tx_t *z, const uint8_t **xp, size_t *xn) {
-  const uint8_t *sp = *xp;
+btc_tx_read_deferred(btc_tx_t *z, const uint8_t **xp, size_t *xn) {
   unsigned int flags = 0;
-  int witness = 0;
   size_t i;
 
   if (!btc_uint32_read(&z->version, xp, xn))
@@ -1310,8 +1536,6 @@ btc_tx_read(btc_tx_t *z, const uint8_t **xp, size_t *xn) {
 
     if (!btc_tx_has_witness(z))
       return 0;
-
-    witness = 1;
   }
 
   if (flags != 0)
@@ -1320,7 +1544,17 @@ btc_tx_read(btc_tx_t *z, const uint8_t **xp, size_t *xn) {
   if (!btc_uint32_read(&z->locktime, xp, xn))
     return 0;
 
-  if (witness) {
+  return 1;
+}
+
+int
+btc_tx_read(btc_tx_t *z, const uint8_t **xp, size_t *xn) {
+  const uint8_t *sp = *xp;
+
+  if (!btc_tx_read_deferred(z, xp, xn))
+    return 0;
+
+  if (btc_tx_has_witness(z)) {
     btc_tx_txid(z->hash, z);
     btc_hash256(z->whash, sp, *xp - sp);
   } else {
@@ -68,6 +68,17 @@ btc_wclient_get_block(const btc_wclient_t *client, const btc_entry_t *entry) {
   return client->get_block(client->state, entry);
 }
 
+int
+btc_wclient_get_raw_block(const btc_wclient_t *client,
+                          uint8_t **data,
+                          size_t *length,
+                          const btc_entry_t *entry) {
+  if (client->get_raw_block == NULL)
+    return 0;
+
+  return client->get_raw_block(client->state, data, length, entry);
+}
+
 void
 btc_wclient_send(const btc_wclient_t *client, const btc_tx_t *tx) {
   if (client->send != NULL)
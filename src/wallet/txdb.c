@@ -708,27 +708,35 @@ hash_from_script(const uint8_t **hash, const btc_script_t *script) {
 }
 
 static int
-tx_is_ours(btc_txdb_t *txdb, const btc_tx_t *tx) {
+script_is_ours(btc_txdb_t *txdb, const btc_script_t *script) {
   const uint8_t *hash;
+
+  if (!hash_from_script(&hash, script))
+    return 0;
+
+  return btc_bloom_has(&txdb->filter, hash, 20);
+}
+
+static int
+prevout_is_ours(btc_txdb_t *txdb, const btc_outpoint_t *prevout) {
   uint8_t raw[36];
-  size_t i;
 
-  for (i = 0; i < tx->outputs.length; i++) {
-    const btc_output_t *output = tx->outputs.items[i];
+  btc_outpoint_write(raw, prevout);
 
-    if (!hash_from_script(&hash, &output->script))
-      continue;
+  return btc_bloom_has(&txdb->filter, raw, 36);
+}
 
-    if (btc_bloom_has(&txdb->filter, hash, 20))
+static int
+tx_is_ours(btc_txdb_t *txdb, const btc_tx_t *tx) {
+  size_t i;
+
+  for (i = 0; i < tx->outputs.length; i++) {
+    if (script_is_ours(txdb, &tx->outputs.items[i]->script))
       return 1;
   }
 
   for (i = 0; i < tx->inputs.length; i++) {
-    const btc_input_t *input = tx->inputs.items[i];
-
-    btc_outpoint_write(raw, &input->prevout);
-
-    if (btc_bloom_has(&txdb->filter, raw, 36))
+    if (prevout_is_ours(txdb, &tx->inputs.items[i]->prevout))
       return 1;
   }
 
@@ -778,6 +786,37 @@ btc_txdb_add(btc_txdb_t *txdb,
   return btc_txdb_insert(txdb, tx, entry, index);
 }
 
+int
+btc_txdb_is_ours(btc_txdb_t *txdb, const btc_rawtx_t *tx) {
+  /* Same as tx_is_ours, without decoding. */
+  btc_rawinput_t input;
+  btc_output_t output;
+  const uint8_t *xp;
+  size_t i, xn;
+
+  xp = tx->outputs.data;
+  xn = tx->outputs.size;
+
+  for (i = 0; i < tx->outputs.length; i++) {
+    CHECK(btc_rawoutput_read(&output, &xp, &xn));
+
+    if (script_is_ours(txdb, &output.script))
+      return 1;
+  }
+
+  xp = tx->inputs.data;
+  xn = tx->inputs.size;
+
+  for (i = 0; i < tx->inputs.length; i++) {
+    CHECK(btc_rawinput_read(&input, &xp, &xn));
+
+    if (prevout_is_ours(txdb, &input.prevout))
+      return 1;
+  }
+
+  return 0;
+}
+
 int
 btc_txdb_remove(btc_txdb_t *txdb, const uint8_t *hash) {
   ldb_t *db = txdb->db;
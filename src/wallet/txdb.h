@@ -19,6 +19,9 @@ btc_txdb_add(btc_txdb_t *txdb,
              const btc_entry_t *entry,
              int32_t index);
 
+int
+btc_txdb_is_ours(btc_txdb_t *txdb, const btc_rawtx_t *tx);
+
 int
 btc_txdb_remove(btc_txdb_t *txdb, const uint8_t *hash);
 
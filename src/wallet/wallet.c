@@ -1274,6 +1274,43 @@ btc_wallet_connect(btc_wallet_t *wallet,
   return total;
 }
 
+static int
+btc_wallet_connect_raw(btc_wallet_t *wallet,
+                       const btc_entry_t *entry,
+                       const btc_rawblock_t *block) {
+  const uint8_t *xp = block->txs.data;
+  size_t xn = block->txs.size;
+  btc_rawtx_t raw;
+  btc_tx_t *tx;
+  int total = 0;
+  size_t i;
+
+  btc_wallet_set_tip(wallet, entry);
+
+  /* Only decode what the filter says is ours. Each
+     insertion updates the filter, so later spends
+     within the block are still caught. */
+  for (i = 0; i < block->txs.length; i++) {
+    CHECK(btc_rawtx_read(&raw, &xp, &xn));
+
+    if (!btc_txdb_is_ours(wallet, &raw))
+      continue;
+
+    tx = btc_rawtx_decode(&raw);
+
+    total += btc_wallet_insert(wallet, tx, entry, i);
+
+    btc_tx_destroy(tx);
+  }
+
+  if (total > 0) {
+    btc_log(wallet, LOG_INFO, "Connected block %H (tx=%d).",
+                              entry->hash, total);
+  }
+
+  return total;
+}
+
 int
 btc_wallet_add_tx(btc_wallet_t *wallet, const btc_tx_t *tx) {
   return btc_wallet_insert(wallet, tx, NULL, -1);
@@ -1401,17 +1438,34 @@ btc_wallet_rescan(btc_wallet_t *wallet, int32_t height) {
   entry = btc_wclient_by_height(client, height);
 
   while (entry != NULL) {
-    btc_block_t *block = btc_wclient_get_block(client, entry);
-
-    if (block == NULL)
-      return 0;
+    btc_rawblock_t view;
+    btc_block_t *block;
+    uint8_t *data;
+    size_t length;
 
     btc_log(wallet, LOG_INFO, "Scanning block %H (%d).",
                               entry->hash, entry->height);
 
-    btc_wallet_connect(wallet, entry, block);
+    /* Prefer a borrowed view of the raw block. */
+    if (btc_wclient_get_raw_block(client, &data, &length, entry)) {
+      if (!btc_rawblock_import(&view, data, length)) {
+        btc_free(data);
+        return 0;
+      }
+
+      btc_wallet_connect_raw(wallet, entry, &view);
+
+      btc_free(data);
+    } else {
+      block = btc_wclient_get_block(client, entry);
 
-    btc_block_destroy(block);
+      if (block == NULL)
+        return 0;
+
+      btc_wallet_connect(wallet, entry, block);
+
+      btc_block_destroy(block);
+    }
 
     entry = btc_wclient_by_height(client, entry->height + 1);
   }
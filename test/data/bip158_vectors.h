@@ -0,0 +1,93 @@
+/*
+ * Types
+ */
+
+typedef struct bip158_vector {
+  int height;
+  const char *block;
+  const char *prev_scripts[6];
+  size_t prev_length;
+  const char *prev_header;
+  const char *filter;
+  const char *header;
+  const char *notes;
+} bip158_vector_t;
+
+/*
+ * Vectors
+ */
+
+/* Blocks 0, 2 and 3 are from the testnet vectors in BIP158
+ * (blockfilters.json). The spending vectors use testnet block
+ * 384; the second copy of it is modified to pay to OP_RETURN,
+ * to an empty script and to a script it also spends, and has
+ * one of its inputs spend an empty script. Their filters and
+ * headers were computed with an independent implementation.
+ */
+
+static const bip158_vector_t bip158_vectors[5] = {
+  {
+    0,
+    "0100000000000000000000000000000000000000000000000000000000000000000000003ba3edfd7a7b12b27ac72c3e67768f617fc81bc3888a51323a9fb8aa4b1e5e4adae5494dffff001d1aa4ae180101000000010000000000000000000000000000000000000000000000000000000000000000ffffffff4d04ffff001d0104455468652054696d65732030332f4a616e2f32303039204368616e63656c6c6f72206f6e206272696e6b206f66207365636f6e64206261696c6f757420666f722062616e6b73ffffffff0100f2052a01000000434104678afdb0fe5548271967f1a67130b7105cd6a828e03909a67962e0ea1f61deb649f6bc3f4cef38c4f35504e51ec112de5c384df7ba0b8d578a4c702b6bf11d5fac00000000",
+    {NULL},
+    0,
+    "0000000000000000000000000000000000000000000000000000000000000000",
+    "019dfca8",
+    "21584579b7eb08997773e5aeff3a7f932700042d0ed2a6129012b7d7ae81b750",
+    "Genesis block"
+  },
+  {
+    2,
+    "0100000006128e87be8b1b4dea47a7247d5528d2702c96826c7a648497e773b800000000e241352e3bec0a95a6217e10c3abb54adfa05abb12c126695595580fb92e222032e7494dffff001d00d235340101000000010000000000000000000000000000000000000000000000000000000000000000ffffffff0e0432e7494d010e062f503253482fffffffff0100f2052a010000002321038a7f6ef1c8ca0c588aa53fa860128077c9e6c11e6830f4d7ee4e763a56b7718fac00000000",
+    {NULL},
+    0,
+    "d7bdac13a59d745b1add0d2ce852f1a0442e8945fc1bf3848d3cbffd88c24fe1",
+    "0174a170",
+    "186afd11ef2b5e7e3504f2e8cbf8df28a1fd251fe53d60dff8b1467d1b386cf0",
+    ""
+  },
+  {
+    3,
+    "0100000020782a005255b657696ea057d5b98f34defcf75196f64f6eeac8026c0000000041ba5afc532aae03151b8aa87b65e1594f97504a768e010c98c0add79216247186e7494dffff001d058dc2b60101000000010000000000000000000000000000000000000000000000000000000000000000ffffffff0e0486e7494d0151062f503253482fffffffff0100f2052a01000000232103f6d9ff4c12959445ca5549c811683bf9c88e637b222dd2e0311154c4c85cf423ac00000000",
+    {NULL},
+    0,
+    "186afd11ef2b5e7e3504f2e8cbf8df28a1fd251fe53d60dff8b1467d1b386cf0",
+    "016cf7a0",
+    "8d63aadf5ab7257cb6d2316a57b16f517bff1c6388f124ec4c04af1212729d2a",
+    ""
+  },
+  {
+    384,
+    "01000000d9e737d6b012027382d48297bfa52d08eac8ff7aac62810a3bc6798900000000be2b0f66f65fd65f4d4e387b96041ee0aeadeb736b467f8b64e12663a7f8b92971844a4dffff001d016cbc400401000000010000000000000000000000000000000000000000000000000000000000000000ffffffff0f0471844a4d028e00062f503253482fffffffff0100f2052a0100000023210231066b86ea0cbddaba1aaf77a58e5f23f3b9bca1b0a62e7ce16b3cfd1fc76c97ac0000000001000000028e3430573cfde2f3e1eece8aefe661dd841bcb665d35832415bab4f75267852200000000494830450221009cca8fb1c4a34982c4e9a59fd15856404c02085f926043cfc6664924a5b9e36d02205811f85b395c43492164b8b33867d745211d8c7ffdcd1b288e56f74dbdaed15b01ffffffffe3abf5981a1bd6457ec0cdcab76cc2a176dc0d7e16f6d3781aebc684f13cc4fd00000000484730440220387bbcee99e370ea2115eaccfd8c48eb380653303b66c6946e0903fb0bbc6f8602202b2ef048519d45525413f64b727a1d85ff2cf7d91ab4607308224b4c30d5846801ffffffff0240f1f23a000000001976a9142203ca59edf66969757e6cc9238b1b36f4dc35b888acc0f218190200000017a9149eb21980dc9d413d8eac27314938b9da920ee53e8700000000010000000273a2c54d536c19f0d09156efbad18ca6f96b1e9f3bc8490342958f24ed8fc32d000000004948304502204c86e2e04b5e3d76f177f2cdd7c8170b25cb727ccf1c9b14ce9262b6bc67e9d1022100fa76b2e1f725fc59fb4e21e3c1d6678d1081c1edd381127d0263cd1bb2a5f05301ffffffffe8073a5c0a80f98e15fc02ecfd195d62a045042b273c655c8b360f6660e8e722000000006b48304502202d968075e1e15ca81fe725440dc6357e0203019725c3ca05b77cbd38bcc55d07022100c64086a70629b3075785355d8b5c557772bec9c6fc966235f930530d329a9364012102399ddd4e4baac1965efc4d882656f24866be14cf5bcf64222334f1fdd5920481ffffffff0280e2e575000000001976a9147cc78fe4251b24ae9b23a399e2160879f188336288acc05ee3a10100000017a914e371782582a4addb541362c55565d2cdf56f649887000000000100000002a30e3f1429bf2a8ed14ca6ec9f3396b8593b8bb6ac1e4d35bd435f05058094ea0000000048473044022013bd72a442a141d58cca03841700cd561130a530d38dc50ca627810ca9fe836d0220669071951d42fa90b026337523e1ff3ca42fa232ac1d4a776692e85d70638c9601ffffffff243568f2ff6bf90386a4d7576d23cd922a829c7d98ad1251d78d9e51a4df61f2000000006a47304402206a26d3be407de03fbd220b488b65833e3f4fb55164cd5aebd549af85060034d50220233a7d62ab782a2467d797e2076f043f960ce4ab1f607c2922bb146584fcab65012102cba4ce932b38dd9da53668c787d3fc3d24b37ed116d96b42c588585a8659fd56ffffffff02c0093e75000000001976a914b441d9bd1b04d752f91f14dc64ed7c7b7aee134f88acc0287edd0100000017a91409f70b896169c37981d2b54b371df0d81a136a2c8700000000",
+    {
+      "2102547b223d58eb5da7c7690748f70a3bab1509cb7578faac9032399f0b6bce31d6ac",
+      "2103fcc9ce029ad74af9fecacce68bcc775cc6efcb000a0b8cc2b3aacad4850bc4b0ac",
+      "2102a5600092acc3c2332a9d768328ad64c21f003c39a4cb8ca6cec8ec890c003c8cac",
+      "76a914b2205a4dbc1d587c5d07769977962b173eab507688ac",
+      "2102841b30b89265f8bc47af70bc6486b49e1107bbd745ec206bf4a220f677375167ac",
+      "76a914bc9f4748c8e649b2d07728988eeca64df30ad7e388ac"
+    },
+    6,
+    "0000000000000000000000000000000000000000000000000000000000000000",
+    "0d075de8d39150c3ab23bdc3fd8dc164b5e3328c306345411cb927cf6bf7d99c589ee200",
+    "bdb9af096ca69b240c0fe8b00f654c2c26235897844f235a00ff652527f1f231",
+    "Spends P2PK and P2PKH outputs"
+  },
+  {
+    384,
+    "01000000d9e737d6b012027382d48297bfa52d08eac8ff7aac62810a3bc67989000000009234c4968071d4fd6061b2df3eb180a0ef3bdebe0f453c221f407b7722d2d20b71844a4dffff001d016cbc400401000000010000000000000000000000000000000000000000000000000000000000000000ffffffff0f0471844a4d028e00062f503253482fffffffff0100f2052a0100000023210231066b86ea0cbddaba1aaf77a58e5f23f3b9bca1b0a62e7ce16b3cfd1fc76c97ac0000000001000000028e3430573cfde2f3e1eece8aefe661dd841bcb665d35832415bab4f75267852200000000494830450221009cca8fb1c4a34982c4e9a59fd15856404c02085f926043cfc6664924a5b9e36d02205811f85b395c43492164b8b33867d745211d8c7ffdcd1b288e56f74dbdaed15b01ffffffffe3abf5981a1bd6457ec0cdcab76cc2a176dc0d7e16f6d3781aebc684f13cc4fd00000000484730440220387bbcee99e370ea2115eaccfd8c48eb380653303b66c6946e0903fb0bbc6f8602202b2ef048519d45525413f64b727a1d85ff2cf7d91ab4607308224b4c30d5846801ffffffff0240f1f23a000000001976a9142203ca59edf66969757e6cc9238b1b36f4dc35b888acc0f218190200000017a9149eb21980dc9d413d8eac27314938b9da920ee53e8700000000010000000273a2c54d536c19f0d09156efbad18ca6f96b1e9f3bc8490342958f24ed8fc32d000000004948304502204c86e2e04b5e3d76f177f2cdd7c8170b25cb727ccf1c9b14ce9262b6bc67e9d1022100fa76b2e1f725fc59fb4e21e3c1d6678d1081c1edd381127d0263cd1bb2a5f05301ffffffffe8073a5c0a80f98e15fc02ecfd195d62a045042b273c655c8b360f6660e8e722000000006b48304502202d968075e1e15ca81fe725440dc6357e0203019725c3ca05b77cbd38bcc55d07022100c64086a70629b3075785355d8b5c557772bec9c6fc966235f930530d329a9364012102399ddd4e4baac1965efc4d882656f24866be14cf5bcf64222334f1fdd5920481ffffffff0280e2e575000000001976a9147cc78fe4251b24ae9b23a399e2160879f188336288acc05ee3a10100000017a914e371782582a4addb541362c55565d2cdf56f649887000000000100000002a30e3f1429bf2a8ed14ca6ec9f3396b8593b8bb6ac1e4d35bd435f05058094ea0000000048473044022013bd72a442a141d58cca03841700cd561130a530d38dc50ca627810ca9fe836d0220669071951d42fa90b026337523e1ff3ca42fa232ac1d4a776692e85d70638c9601ffffffff243568f2ff6bf90386a4d7576d23cd922a829c7d98ad1251d78d9e51a4df61f2000000006a47304402206a26d3be407de03fbd220b488b65833e3f4fb55164cd5aebd549af85060034d50220233a7d62ab782a2467d797e2076f043f960ce4ab1f607c2922bb146584fcab65012102cba4ce932b38dd9da53668c787d3fc3d24b37ed116d96b42c588585a8659fd56ffffffff05c0093e75000000001976a914b441d9bd1b04d752f91f14dc64ed7c7b7aee134f88acc0287edd0100000017a91409f70b896169c37981d2b54b371df0d81a136a2c870000000000000000066a04deadbeef00000000000000000000000000000000001976a914b2205a4dbc1d587c5d07769977962b173eab507688ac00000000",
+    {
+      "2102547b223d58eb5da7c7690748f70a3bab1509cb7578faac9032399f0b6bce31d6ac",
+      "2103fcc9ce029ad74af9fecacce68bcc775cc6efcb000a0b8cc2b3aacad4850bc4b0ac",
+      "2102a5600092acc3c2332a9d768328ad64c21f003c39a4cb8ca6cec8ec890c003c8cac",
+      "76a914b2205a4dbc1d587c5d07769977962b173eab507688ac",
+      "2102841b30b89265f8bc47af70bc6486b49e1107bbd745ec206bf4a220f677375167ac",
+      ""
+    },
+    6,
+    "0000000000000000000000000000000000000000000000000000000000000000",
+    "0c7e1479e2045beb1afb81ae80cb88fb6883bd54f5642513fe4910ec5ed6204e60",
+    "aecb96ec92d6f3a2181d921307831e78cb92440ff83cb64ab07d3fc3a9f3ef3a",
+    "Pays to OP_RETURN and empty scripts, spends an empty script"
+  }
+};
@@ -0,0 +1,180 @@
+/*!
+ * t-bip158.c - bip158 test for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mako/bip158.h>
+#include <mako/block.h>
+#include <mako/buffer.h>
+#include <mako/coins.h>
+#include <mako/script.h>
+#include <mako/util.h>
+#include <mako/vector.h>
+#include "lib/tests.h"
+#include "data/bip158_vectors.h"
+
+static void
+test_vectors(void) {
+  static uint8_t raw[4096];
+  uint8_t prev[32], expect[32], header[32];
+  btc_blockfilter_t filter;
+  btc_block_t block;
+  btc_undo_t undo;
+  size_t i, j, len;
+
+  for (i = 0; i < lengthof(bip158_vectors); i++) {
+    const bip158_vector_t *vec = &bip158_vectors[i];
+
+    btc_block_init(&block);
+    btc_undo_init(&undo);
+    btc_blockfilter_init(&filter);
+
+    len = sizeof(raw);
+
+    hex_decode(raw, &len, vec->block);
+
+    ASSERT(btc_block_import(&block, raw, len));
+
+    for (j = 0; j < vec->prev_length; j++) {
+      btc_coin_t *coin = btc_coin_create();
+
+      len = sizeof(raw);
+
+      hex_decode(raw, &len, vec->prev_scripts[j]);
+
+      btc_script_set(&coin->output.script, raw, len);
+      btc_undo_push(&undo, coin);
+    }
+
+    btc_blockfilter_set_block(&filter, &block, &undo);
+
+    len = sizeof(raw);
+
+    hex_decode(raw, &len, vec->filter);
+
+    ASSERT(filter.size == len);
+    ASSERT(memcmp(filter.data, raw, len) == 0);
+
+    /* Headers are displayed in reverse. */
+    hex_parse(expect, 32, vec->prev_header);
+
+    for (j = 0; j < 32; j++)
+      prev[j] = expect[31 - j];
+
+    hex_parse(expect, 32, vec->header);
+
+    btc_blockfilter_header(header, &filter, prev);
+
+    for (j = 0; j < 32; j++)
+      ASSERT(header[j] == expect[31 - j]);
+
+    /* Every spent script is in the filter. */
+    for (j = 0; j < undo.length; j++) {
+      const btc_script_t *script = &undo.items[j]->output.script;
+
+      if (script->length > 0)
+        ASSERT(btc_blockfilter_match(&filter, script->data, script->length));
+    }
+
+    btc_blockfilter_clear(&filter);
+    btc_undo_clear(&undo);
+    btc_block_clear(&block);
+  }
+}
+
+static void
+test_match(void) {
+  static const uint8_t hash[32] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+  btc_buffer_t items[1000];
+  btc_buffer_t other[1000];
+  btc_blockfilter_t filter;
+  btc_blockfilter_t copy;
+  btc_vector_t vec;
+  uint8_t data[8];
+  size_t i, fp = 0;
+
+  btc_blockfilter_init(&filter);
+  btc_blockfilter_init(&copy);
+  btc_vector_init(&vec);
+
+  btc_blockfilter_reset(&filter, hash);
+
+  for (i = 0; i < 1000; i++) {
+    memset(data, 0, sizeof(data));
+
+    data[0] = i & 0xff;
+    data[1] = i >> 8;
+
+    btc_buffer_init(&items[i]);
+    btc_buffer_set(&items[i], data, 8);
+
+    data[7] = 1;
+
+    btc_buffer_init(&other[i]);
+    btc_buffer_set(&other[i], data, 8);
+
+    btc_blockfilter_add(&filter, items[i].data, items[i].length);
+  }
+
+  /* Duplicates and empty items are dropped. */
+  btc_blockfilter_add(&filter, items[0].data, items[0].length);
+  btc_blockfilter_add(&filter, items[0].data, 0);
+
+  btc_blockfilter_finalize(&filter);
+
+  ASSERT(filter.n == 1000);
+
+  ASSERT(btc_blockfilter_set(&copy, hash, filter.data, filter.size));
+  ASSERT(copy.n == 1000);
+
+  for (i = 0; i < 1000; i++) {
+    ASSERT(btc_blockfilter_match(&filter, items[i].data, items[i].length));
+    ASSERT(btc_blockfilter_match(&copy, items[i].data, items[i].length));
+
+    fp += btc_blockfilter_match(&filter, other[i].data, other[i].length);
+  }
+
+  /* The false positive rate is 1 in 784931. */
+  ASSERT(fp <= 1);
+
+  for (i = 0; i < 1000; i++)
+    btc_vector_push(&vec, &other[i]);
+
+  ASSERT(btc_blockfilter_match_any(&filter, &vec) == (fp > 0));
+
+  btc_vector_push(&vec, &items[500]);
+
+  ASSERT(btc_blockfilter_match_any(&filter, &vec));
+
+  /* An empty filter matches nothing. */
+  btc_blockfilter_reset(&filter, hash);
+  btc_blockfilter_finalize(&filter);
+
+  ASSERT(filter.n == 0);
+  ASSERT(filter.size == 1 && filter.data[0] == 0);
+  ASSERT(!btc_blockfilter_match(&filter, items[0].data, items[0].length));
+  ASSERT(!btc_blockfilter_match_any(&filter, &vec));
+
+  /* Filters must at least carry a count. */
+  ASSERT(!btc_blockfilter_set(&copy, hash, filter.data, 0));
+
+  for (i = 0; i < 1000; i++) {
+    btc_buffer_clear(&items[i]);
+    btc_buffer_clear(&other[i]);
+  }
+
+  btc_vector_clear(&vec);
+  btc_blockfilter_clear(&copy);
+  btc_blockfilter_clear(&filter);
+}
+
+int
+main(void) {
+  test_vectors();
+  test_match();
+  return 0;
+}
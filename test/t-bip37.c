@@ -1,5 +1,5 @@
 /*!
- * t-stub.c - stub test for mako
+ * t-bip37.c - bip37 test for mako
  * Copyright (c) 2021, Christopher Jeffrey (MIT License).
  * https://github.com/chjj/mako
  */
@@ -7,8 +7,92 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <mako/bip37.h>
+#include <mako/block.h>
+#include <mako/bloom.h>
+#include <mako/tx.h>
+#include <mako/util.h>
+#include <mako/vector.h>
+#include "data/chain_vectors_main.h"
 #include "lib/tests.h"
 
-int main(void) {
+static void
+test_merkleblock_raw(const char *str, int filtered) {
+  static unsigned char data[65536];
+  size_t length = sizeof(data);
+  btc_merkleblock_t x, y;
+  btc_bloom_t fx, fy;
+  btc_vector_t *tx, *ty;
+  uint8_t *xp, *yp;
+  btc_rawblock_t raw;
+  btc_block_t block;
+  size_t xn, yn, i;
+
+  hex_decode(data, &length, str);
+
+  btc_block_init(&block);
+  btc_merkleblock_init(&x);
+  btc_merkleblock_init(&y);
+  btc_bloom_init(&fx);
+  btc_bloom_init(&fy);
+
+  ASSERT(btc_block_import(&block, data, length));
+  ASSERT(btc_rawblock_import(&raw, data, length));
+
+  /* Match the last transaction. */
+  btc_bloom_set(&fx, 20, 0.0001, BTC_BLOOM_ALL);
+  btc_bloom_add(&fx, block.txs.items[block.txs.length - 1]->hash, 32);
+  btc_bloom_copy(&fy, &fx);
+
+  tx = btc_merkleblock_set_block(&x, &block, filtered ? &fx : NULL);
+  ty = btc_merkleblock_set_raw(&y, &raw, filtered ? &fy : NULL);
+
+  ASSERT(tx->length == (size_t)filtered);
+  ASSERT(ty->length == tx->length);
+
+  for (i = 0; i < ty->length; i++) {
+    const btc_tx_t *a = tx->items[i];
+    btc_tx_t *b = ty->items[i];
+
+    ASSERT(btc_hash_equal(a->hash, b->hash));
+    ASSERT(btc_hash_equal(a->whash, b->whash));
+
+    btc_tx_destroy(b);
+  }
+
+  /* Filter updates must be identical. */
+  ASSERT(fx.size == fy.size);
+  ASSERT(memcmp(fx.data, fy.data, fx.size) == 0);
+
+  btc_merkleblock_encode(&xp, &xn, &x);
+  btc_merkleblock_encode(&yp, &yn, &y);
+
+  ASSERT(xn == yn);
+  ASSERT(memcmp(xp, yp, xn) == 0);
+
+  ASSERT(btc_merkleblock_verify(&y));
+  ASSERT(y.matches.length == (size_t)filtered);
+
+  free(xp);
+  free(yp);
+
+  btc_vector_destroy(tx);
+  btc_vector_destroy(ty);
+  btc_bloom_clear(&fx);
+  btc_bloom_clear(&fy);
+  btc_merkleblock_clear(&x);
+  btc_merkleblock_clear(&y);
+  btc_block_clear(&block);
+}
+
+int
+main(void) {
+  size_t i;
+
+  for (i = 0; i < lengthof(chain_vectors_main); i++) {
+    test_merkleblock_raw(chain_vectors_main[i], 0);
+    test_merkleblock_raw(chain_vectors_main[i], 1);
+  }
+
   return 0;
 }
@@ -1,5 +1,5 @@
 /*!
- * t-stub.c - stub test for mako
+ * t-block.c - block test for mako
  * Copyright (c) 2021, Christopher Jeffrey (MIT License).
  * https://github.com/chjj/mako
  */
@@ -7,8 +7,117 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <mako/block.h>
+#include <mako/header.h>
+#include <mako/tx.h>
+#include <mako/util.h>
+#include "data/chain_vectors_main.h"
 #include "lib/tests.h"
 
-int main(void) {
+static void
+test_rawblock(const char *str) {
+  static unsigned char data[65536];
+  size_t length = sizeof(data);
+  const uint8_t *xp;
+  btc_rawblock_t raw;
+  btc_block_t block;
+  uint8_t hash[32], expect[32];
+  btc_rawtx_t tx;
+  size_t xn, i;
+
+  hex_decode(data, &length, str);
+
+  btc_block_init(&block);
+
+  ASSERT(btc_block_import(&block, data, length));
+  ASSERT(btc_rawblock_import(&raw, data, length));
+
+  ASSERT(raw.data == data);
+  ASSERT(raw.size == btc_block_size(&block));
+  ASSERT(btc_rawblock_base_size(&raw) == btc_block_base_size(&block));
+  ASSERT(raw.txs.length == block.txs.length);
+
+  btc_header_hash(hash, &raw.header);
+  btc_header_hash(expect, &block.header);
+
+  ASSERT(btc_hash_equal(hash, expect));
+
+  xp = raw.txs.data;
+  xn = raw.txs.size;
+
+  for (i = 0; i < raw.txs.length; i++) {
+    const btc_tx_t *x = block.txs.items[i];
+
+    ASSERT(btc_rawtx_read(&tx, &xp, &xn));
+    ASSERT(btc_rawtx_is_coinbase(&tx) == (i == 0));
+    ASSERT(tx.inputs.length == x->inputs.length);
+    ASSERT(tx.outputs.length == x->outputs.length);
+
+    btc_rawtx_txid(hash, &tx);
+
+    ASSERT(btc_hash_equal(hash, x->hash));
+  }
+
+  ASSERT(xn == 0);
+
+  /* Truncated blocks must be rejected. */
+  ASSERT(!btc_rawblock_import(&raw, data, length - 1));
+
+  btc_block_clear(&block);
+}
+
+static void
+test_deferred(const char *str) {
+  static unsigned char data[65536];
+  size_t length = sizeof(data);
+  btc_block_t block, expect;
+  const uint8_t *xp;
+  btc_rawblock_t raw;
+  btc_rawtx_t tx;
+  size_t xn, i;
+
+  hex_decode(data, &length, str);
+
+  btc_block_init(&block);
+  btc_block_init(&expect);
+
+  ASSERT(btc_block_import(&expect, data, length));
+  ASSERT(btc_block_import_deferred(&block, data, length));
+  ASSERT(btc_rawblock_import(&raw, data, length));
+
+  ASSERT(block.txs.length == expect.txs.length);
+  ASSERT(btc_block_size(&block) == btc_block_size(&expect));
+
+  xp = raw.txs.data;
+  xn = raw.txs.size;
+
+  for (i = 0; i < raw.txs.length; i++) {
+    btc_tx_t *x = block.txs.items[i];
+    const btc_tx_t *y = expect.txs.items[i];
+
+    ASSERT(btc_rawtx_read(&tx, &xp, &xn));
+
+    btc_rawtx_refresh(x, &tx);
+
+    ASSERT(btc_hash_equal(x->hash, y->hash));
+    ASSERT(btc_hash_equal(x->whash, y->whash));
+  }
+
+  ASSERT(!btc_block_import_deferred(&block, data, length - 1));
+
+  btc_block_clear(&block);
+  btc_block_clear(&expect);
+}
+
+int
+main(void) {
+  size_t i;
+
+  for (i = 0; i < lengthof(chain_vectors_main); i++)
+    test_rawblock(chain_vectors_main[i]);
+
+  for (i = 0; i < lengthof(chain_vectors_main); i++)
+    test_deferred(chain_vectors_main[i]);
+
   return 0;
 }
@@ -5,16 +5,102 @@
  */
 
 #include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <io/core.h>
 #include <node/chain.h>
+#include <node/chaindb.h>
+#include <node/miner.h>
+#include <mako/address.h>
+#include <mako/bip158.h>
 #include <mako/block.h>
+#include <mako/coins.h>
+#include <mako/consensus.h>
+#include <mako/crypto/hash.h>
+#include <mako/entry.h>
+#include <mako/header.h>
 #include <mako/network.h>
+#include <mako/script.h>
+#include <mako/tx.h>
+#include <mako/util.h>
 #include "lib/tests.h"
 #include "data/chain_vectors_main.h"
 #include "data/chain_vectors_testnet.h"
 
 static void
-test_chain(const btc_network_t *network, const char **vectors, size_t length) {
+test_undo(btc_chain_t *chain) {
+  const btc_entry_t *entry;
+  btc_block_t *block;
+  btc_view_t *view;
+  size_t i, j;
+  int32_t height;
+
+  /* Every spent coin must come back out of the undo files. */
+  for (height = 1; height <= btc_chain_height(chain); height++) {
+    entry = btc_chain_by_height(chain, height);
+    block = btc_chain_get_block(chain, entry);
+
+    ASSERT(block != NULL);
+
+    view = btc_chain_get_undo(chain, entry, block);
+
+    ASSERT(view != NULL);
+
+    for (i = 1; i < block->txs.length; i++) {
+      const btc_tx_t *tx = block->txs.items[i];
+
+      for (j = 0; j < tx->inputs.length; j++) {
+        const btc_input_t *input = tx->inputs.items[j];
+
+        ASSERT(btc_view_get(view, &input->prevout) != NULL);
+      }
+    }
+
+    btc_view_destroy(view);
+    btc_block_destroy(block);
+  }
+}
+
+static btc_block_t *
+mine_block(btc_chain_t *chain, const btc_entry_t *prev, const btc_tx_t *tx) {
+  static const uint8_t zero[20] = {0};
+  int64_t mtp = btc_entry_median_time(prev);
+  btc_tmpl_t *bt = btc_tmpl_create();
+  btc_deployment_state_t state;
+  btc_block_t *block;
+
+  btc_chain_get_deployments(chain, &state, mtp + 1, prev);
+
+  bt->version = btc_chain_compute_version(chain, prev);
+  bt->time = mtp + 1;
+  bt->bits = btc_chain_get_target(chain, bt->time, prev);
+  bt->height = prev->height + 1;
+  bt->mtp = mtp;
+  bt->flags = state.flags;
+  bt->interval = btc_regtest->halving_interval;
+
+  btc_hash_copy(bt->prev_block, prev->hash);
+  btc_address_set_p2pkh(&bt->address, zero);
+
+  if (tx != NULL)
+    btc_tmpl_push(bt, tx, NULL);
+
+  btc_tmpl_refresh(bt);
+
+  block = btc_tmpl_mine(bt);
+
+  btc_tmpl_destroy(bt);
+
+  return block;
+}
+
+static void
+test_chain(const btc_network_t *network,
+           const char **vectors,
+           size_t length,
+           int scripts) {
+  static const uint8_t zero[32] = {0};
   unsigned int flags = BTC_BLOCK_DEFAULT_FLAGS;
   btc_chain_t *chain = btc_chain_create(network);
   unsigned char data[65536];
@@ -23,11 +109,82 @@ test_chain(const btc_network_t *network, const char **vectors, size_t length) {
 
   btc_rimraf(BTC_PREFIX);
 
+  if (scripts)
+    btc_chain_set_assume_valid(chain, zero);
+
+  ASSERT(btc_chain_open(chain, BTC_PREFIX, 0));
+
+  for (i = 0; i < length; i++) {
+    size_t size = sizeof(data);
+
+    /* Reopen twice to exercise the coin flush and
+       both ways of loading the block index. */
+    if (i == length / 3 || i == (2 * length) / 3) {
+      btc_chain_close(chain);
+      btc_chain_destroy(chain);
+
+      /* A bad snapshot falls back to a full scan. */
+      if (i == (2 * length) / 3)
+        ASSERT(btc_fs_write_file(BTC_PREFIX "/blocks/index.dat", "bad", 3));
+
+      chain = btc_chain_create(network);
+
+      if (scripts)
+        btc_chain_set_assume_valid(chain, zero);
+
+      ASSERT(btc_chain_open(chain, BTC_PREFIX, 0));
+      ASSERT(btc_chain_height(chain) == (int32_t)i);
+    }
+
+    hex_decode(data, &size, vectors[i]);
+
+    btc_block_init(&block);
+
+    ASSERT(btc_chain_read_block(chain, &block, data, size));
+    ASSERT(btc_chain_add(chain, &block, flags, -1));
+
+    btc_block_clear(&block);
+  }
+
+  test_undo(chain);
+
+  btc_chain_close(chain);
+  btc_chain_destroy(chain);
+
+  btc_rimraf(BTC_PREFIX);
+}
+
+static void
+test_txindex(const btc_network_t *network,
+             const char **vectors,
+             size_t length) {
+  unsigned int flags = BTC_BLOCK_DEFAULT_FLAGS;
+  btc_chain_t *chain = btc_chain_create(network);
+  unsigned char data[65536];
+  const btc_entry_t *entry;
+  btc_block_t block;
+  btc_tx_t *tx;
+  size_t i, j;
+  int tries;
+
+  btc_rimraf(BTC_PREFIX);
+
+  ASSERT(!btc_chain_open(chain, BTC_PREFIX, BTC_CHAIN_PRUNE
+                                          | BTC_CHAIN_TXINDEX));
+
   ASSERT(btc_chain_open(chain, BTC_PREFIX, 0));
 
   for (i = 0; i < length; i++) {
     size_t size = sizeof(data);
 
+    /* The first half is left to the backfill. */
+    if (i == length / 2) {
+      btc_chain_close(chain);
+
+      ASSERT(btc_chain_open(chain, BTC_PREFIX, BTC_CHAIN_TXINDEX));
+      ASSERT(btc_chain_height(chain) == (int32_t)i);
+    }
+
     hex_decode(data, &size, vectors[i]);
 
     btc_block_init(&block);
@@ -38,6 +195,647 @@ test_chain(const btc_network_t *network, const char **vectors, size_t length) {
     btc_block_clear(&block);
   }
 
+  for (i = 0; i < length; i++) {
+    size_t size = sizeof(data);
+
+    hex_decode(data, &size, vectors[i]);
+
+    btc_block_init(&block);
+
+    ASSERT(btc_block_import(&block, data, size));
+
+    for (j = 0; j < block.txs.length; j++) {
+      const btc_tx_t *expect = block.txs.items[j];
+
+      for (tries = 0; tries < 10000; tries++) {
+        if (btc_chain_get_tx(chain, &tx, &entry, expect->hash))
+          break;
+
+        btc_time_sleep(1);
+      }
+
+      ASSERT(tries < 10000);
+      ASSERT(entry == btc_chain_by_height(chain, i + 1));
+      ASSERT(btc_hash_equal(tx->whash, expect->whash));
+
+      btc_tx_destroy(tx);
+    }
+
+    btc_block_clear(&block);
+  }
+
+  btc_chain_close(chain);
+  btc_chain_destroy(chain);
+
+  btc_rimraf(BTC_PREFIX);
+}
+
+static int
+has_history(btc_chain_t *chain,
+            const btc_script_t *script,
+            const uint8_t *hash,
+            int32_t height) {
+  btc_scriptiter_t *iter = btc_chain_history(chain, script, height, height);
+  int found = 0;
+
+  ASSERT(iter != NULL);
+
+  while (btc_scriptiter_next(iter)) {
+    ASSERT(btc_scriptiter_height(iter) == height);
+
+    if (btc_hash_equal(btc_scriptiter_hash(iter), hash))
+      found = 1;
+  }
+
+  btc_scriptiter_destroy(iter);
+
+  return found;
+}
+
+static int
+has_unspent(btc_chain_t *chain,
+            const btc_script_t *script,
+            const uint8_t *hash,
+            uint32_t index) {
+  btc_scriptiter_t *iter = btc_chain_unspent(chain, script);
+  int found = 0;
+
+  ASSERT(iter != NULL);
+
+  while (btc_scriptiter_next(iter)) {
+    const btc_coin_t *coin = btc_scriptiter_coin(iter);
+
+    ASSERT(btc_script_equal(&coin->output.script, script));
+
+    if (btc_hash_equal(btc_scriptiter_hash(iter), hash)
+        && btc_scriptiter_index(iter) == index) {
+      found = 1;
+    }
+  }
+
+  btc_scriptiter_destroy(iter);
+
+  return found;
+}
+
+static void
+test_addrindex(const btc_network_t *network,
+               const char **vectors,
+               size_t length) {
+  unsigned int flags = BTC_BLOCK_DEFAULT_FLAGS;
+  btc_chain_t *chain = btc_chain_create(network);
+  unsigned char data[65536];
+  btc_block_t block;
+  btc_coin_t *coin;
+  size_t i, j, k;
+  int tries;
+
+  btc_rimraf(BTC_PREFIX);
+
+  ASSERT(!btc_chain_open(chain, BTC_PREFIX, BTC_CHAIN_PRUNE
+                                          | BTC_CHAIN_ADDRINDEX));
+
+  ASSERT(btc_chain_open(chain, BTC_PREFIX, 0));
+
+  for (i = 0; i < length; i++) {
+    size_t size = sizeof(data);
+
+    /* The first half is left to the backfill. */
+    if (i == length / 2) {
+      btc_chain_close(chain);
+
+      ASSERT(btc_chain_open(chain, BTC_PREFIX, BTC_CHAIN_ADDRINDEX));
+      ASSERT(btc_chain_height(chain) == (int32_t)i);
+    }
+
+    hex_decode(data, &size, vectors[i]);
+
+    btc_block_init(&block);
+
+    ASSERT(btc_block_import(&block, data, size));
+    ASSERT(btc_chain_add(chain, &block, flags, -1));
+
+    btc_block_clear(&block);
+  }
+
+  for (i = 0; i < length; i++) {
+    int32_t height = i + 1;
+    size_t size = sizeof(data);
+
+    hex_decode(data, &size, vectors[i]);
+
+    btc_block_init(&block);
+
+    ASSERT(btc_block_import(&block, data, size));
+
+    for (j = 0; j < block.txs.length; j++) {
+      const btc_tx_t *tx = block.txs.items[j];
+
+      for (k = 0; k < tx->outputs.length; k++) {
+        const btc_output_t *output = tx->outputs.items[k];
+        const btc_script_t *script = &output->script;
+
+        if (btc_script_is_unspendable(script))
+          continue;
+
+        for (tries = 0; tries < 10000; tries++) {
+          if (has_history(chain, script, tx->hash, height))
+            break;
+
+          btc_time_sleep(1);
+        }
+
+        ASSERT(tries < 10000);
+
+        coin = btc_chain_coin(chain, tx->hash, k);
+
+        ASSERT(has_unspent(chain, script, tx->hash, k) == (coin != NULL));
+
+        if (coin != NULL)
+          btc_coin_destroy(coin);
+      }
+    }
+
+    btc_block_clear(&block);
+  }
+
+  btc_chain_close(chain);
+  btc_chain_destroy(chain);
+
+  btc_rimraf(BTC_PREFIX);
+}
+
+static void
+test_filterindex(const btc_network_t *network,
+                 const char **vectors,
+                 size_t length) {
+  unsigned int flags = BTC_BLOCK_DEFAULT_FLAGS;
+  btc_chain_t *chain = btc_chain_create(network);
+  uint8_t hash[32], header[32], prev[32];
+  unsigned char data[65536];
+  btc_blockfilter_t filter;
+  const btc_entry_t *entry;
+  size_t i, j, k, len;
+  btc_block_t block;
+  uint8_t *raw;
+  int tries;
+
+  btc_rimraf(BTC_PREFIX);
+
+  ASSERT(!btc_chain_open(chain, BTC_PREFIX, BTC_CHAIN_PRUNE
+                                          | BTC_CHAIN_FILTERINDEX));
+
+  ASSERT(btc_chain_open(chain, BTC_PREFIX, 0));
+
+  for (i = 0; i < length; i++) {
+    size_t size = sizeof(data);
+
+    /* The first half is left to the backfill. */
+    if (i == length / 2) {
+      btc_chain_close(chain);
+
+      ASSERT(btc_chain_open(chain, BTC_PREFIX, BTC_CHAIN_FILTERINDEX));
+      ASSERT(btc_chain_height(chain) == (int32_t)i);
+    }
+
+    hex_decode(data, &size, vectors[i]);
+
+    btc_block_init(&block);
+
+    ASSERT(btc_block_import(&block, data, size));
+    ASSERT(btc_chain_add(chain, &block, flags, -1));
+
+    btc_block_clear(&block);
+  }
+
+  btc_blockfilter_init(&filter);
+
+  memset(prev, 0, 32);
+
+  for (i = 0; i <= length; i++) {
+    entry = btc_chain_by_height(chain, i);
+
+    ASSERT(entry != NULL);
+
+    for (tries = 0; tries < 10000; tries++) {
+      if (btc_chain_get_filter_header(chain, hash, header, entry))
+        break;
+
+      btc_time_sleep(1);
+    }
+
+    ASSERT(tries < 10000);
+    ASSERT(btc_chain_get_filter(chain, &raw, &len, entry));
+
+    ASSERT(btc_blockfilter_set(&filter, entry->hash, raw, len));
+
+    free(raw);
+
+    /* The header chain commits to every filter below it. */
+    btc_blockfilter_hash(data, &filter);
+
+    ASSERT(memcmp(data, hash, 32) == 0);
+
+    btc_blockfilter_header(data, &filter, prev);
+
+    ASSERT(memcmp(data, header, 32) == 0);
+
+    memcpy(prev, header, 32);
+
+    if (i == 0)
+      continue;
+
+    len = sizeof(data);
+
+    hex_decode(data, &len, vectors[i - 1]);
+
+    btc_block_init(&block);
+
+    ASSERT(btc_block_import(&block, data, len));
+
+    for (j = 0; j < block.txs.length; j++) {
+      const btc_tx_t *tx = block.txs.items[j];
+
+      for (k = 0; k < tx->outputs.length; k++) {
+        const btc_script_t *script = &tx->outputs.items[k]->script;
+
+        if (script->length == 0 || script->data[0] == BTC_OP_RETURN)
+          continue;
+
+        ASSERT(btc_blockfilter_match(&filter, script->data,
+                                              script->length));
+      }
+    }
+
+    btc_block_clear(&block);
+  }
+
+  btc_blockfilter_clear(&filter);
+
+  btc_chain_close(chain);
+  btc_chain_destroy(chain);
+
+  btc_rimraf(BTC_PREFIX);
+}
+
+static void
+test_snapshot(const btc_network_t *network,
+              const char **vectors,
+              size_t length) {
+  static const char *path = BTC_PREFIX ".utxo";
+  unsigned int flags = BTC_BLOCK_DEFAULT_FLAGS;
+  btc_chain_t *chain = btc_chain_create(network);
+  unsigned char data[65536];
+  uint8_t tip[32], txid[32];
+  btc_chaindb_t *db;
+  uint8_t hash1[32], hash2[32];
+  const btc_coinstats_t *stats;
+  int64_t txouts, amount;
+  uint8_t muhash[32];
+  btc_block_t block;
+  btc_coin_t *coin;
+  uint64_t count;
+  FILE *stream;
+  size_t i;
+
+  btc_rimraf(BTC_PREFIX);
+  remove(path);
+
+  ASSERT(btc_chain_open(chain, BTC_PREFIX, 0));
+
+  for (i = 0; i < length; i++) {
+    size_t size = sizeof(data);
+
+    hex_decode(data, &size, vectors[i]);
+
+    btc_block_init(&block);
+
+    ASSERT(btc_block_import(&block, data, size));
+    ASSERT(btc_chain_add(chain, &block, flags, -1));
+
+    if (i == length - 1)
+      memcpy(txid, block.txs.items[0]->hash, 32);
+
+    btc_block_clear(&block);
+  }
+
+  memcpy(tip, btc_chain_tip(chain)->hash, 32);
+
+  stats = btc_chain_coinstats(chain);
+  txouts = stats->count;
+  amount = stats->value;
+
+  btc_muhash_final(&stats->muhash, muhash);
+
+  ASSERT(amount == btc_chain_height(chain) * 50 * BTC_COIN);
+
+  ASSERT(btc_chain_export(chain, path, hash1, &count));
+  ASSERT(count > 0);
+  ASSERT(count == (uint64_t)txouts);
+
+  btc_chain_close(chain);
+  btc_chain_destroy(chain);
+
+  btc_rimraf(BTC_PREFIX);
+
+  /* The network knows no snapshot at this height. */
+  chain = btc_chain_create(network);
+
+  btc_chain_set_snapshot(chain, path, NULL);
+
+  ASSERT(!btc_chain_open(chain, BTC_PREFIX, 0));
+
+  btc_chain_destroy(chain);
+
+  /* Nor does a MuHash of some other coin set match. */
+  chain = btc_chain_create(network);
+
+  muhash[0] ^= 1;
+
+  btc_chain_set_snapshot(chain, path, muhash);
+
+  ASSERT(!btc_chain_open(chain, BTC_PREFIX, 0));
+
+  muhash[0] ^= 1;
+
+  btc_chain_destroy(chain);
+
+  /* Neither attempt wrote anything. */
+  chain = btc_chain_create(network);
+
+  ASSERT(btc_chain_open(chain, BTC_PREFIX, 0));
+  ASSERT(btc_chain_height(chain) == 0);
+  ASSERT(btc_chain_coinstats(chain)->count == 0);
+  ASSERT(btc_chain_unvalidated(chain) == -1);
+
+  btc_chain_close(chain);
+  btc_chain_destroy(chain);
+
+  /* An import cut short is rolled back on reopen. */
+  db = btc_chaindb_create(network);
+
+  btc_chaindb_set_import_limit(db, 2);
+
+  ASSERT(btc_chaindb_open(db, BTC_PREFIX, BTC_CHAIN_DEFAULT_FLAGS));
+  ASSERT(!btc_chaindb_import(db, path, muhash, hash2));
+
+  btc_chaindb_close(db);
+  btc_chaindb_destroy(db);
+
+  chain = btc_chain_create(network);
+
+  ASSERT(btc_chain_open(chain, BTC_PREFIX, 0));
+  ASSERT(btc_chain_height(chain) == 0);
+  ASSERT(btc_chain_by_height(chain, 1) == NULL);
+  ASSERT(btc_chain_by_hash(chain, tip) == NULL);
+  ASSERT(btc_chain_coin(chain, txid, 0) == NULL);
+  ASSERT(btc_chain_unvalidated(chain) == -1);
+
+  btc_chain_close(chain);
+  btc_chain_destroy(chain);
+
+  /* Load the snapshot with the operator's MuHash. */
+  chain = btc_chain_create(network);
+
+  btc_chain_set_snapshot(chain, path, muhash);
+
+  ASSERT(btc_chain_open(chain, BTC_PREFIX, 0));
+  ASSERT(btc_chain_height(chain) == (int32_t)length);
+  ASSERT(memcmp(btc_chain_tip(chain)->hash, tip, 32) == 0);
+  ASSERT(btc_chain_unvalidated(chain) == (int32_t)length);
+
+  coin = btc_chain_coin(chain, txid, 0);
+
+  ASSERT(coin != NULL);
+  ASSERT(coin->height == (int32_t)length);
+
+  btc_coin_destroy(coin);
+
+  /* The import recomputes the same stats. */
+  stats = btc_chain_coinstats(chain);
+
+  btc_muhash_final(&stats->muhash, hash2);
+
+  ASSERT(stats->count == txouts);
+  ASSERT(stats->value == amount);
+  ASSERT(memcmp(hash2, muhash, 32) == 0);
+
+  btc_chain_close(chain);
+  btc_chain_destroy(chain);
+
+  /* Reopening must not import twice. */
+  chain = btc_chain_create(network);
+
+  btc_chain_set_snapshot(chain, path, muhash);
+
+  ASSERT(btc_chain_open(chain, BTC_PREFIX, 0));
+  ASSERT(btc_chain_height(chain) == (int32_t)length);
+  ASSERT(btc_chain_unvalidated(chain) == (int32_t)length);
+
+  stats = btc_chain_coinstats(chain);
+
+  btc_muhash_final(&stats->muhash, hash2);
+
+  ASSERT(stats->count == txouts);
+  ASSERT(memcmp(hash2, muhash, 32) == 0);
+
+  btc_chain_close(chain);
+  btc_chain_destroy(chain);
+
+  btc_rimraf(BTC_PREFIX);
+
+  /* A corrupted snapshot must be rejected. */
+  stream = fopen(path, "r+b");
+
+  ASSERT(stream != NULL);
+  ASSERT(fseek(stream, 100, SEEK_SET) == 0);
+  ASSERT(fputc(0xff, stream) != EOF);
+  ASSERT(fclose(stream) == 0);
+
+  chain = btc_chain_create(network);
+
+  btc_chain_set_snapshot(chain, path, muhash);
+
+  ASSERT(!btc_chain_open(chain, BTC_PREFIX, 0));
+
+  btc_chain_destroy(chain);
+
+  btc_rimraf(BTC_PREFIX);
+  remove(path);
+}
+
+static btc_tx_t *
+unsigned_spend(const uint8_t *hash) {
+  static const uint8_t unknown[20] = {1};
+  btc_tx_t *tx = btc_tx_create();
+  btc_input_t *input = btc_input_create();
+  btc_output_t *output = btc_output_create();
+
+  btc_hash_copy(input->prevout.hash, hash);
+
+  input->prevout.index = 0;
+  output->value = 1000;
+
+  btc_script_set_p2pkh(&output->script, unknown);
+  btc_inpvec_push(&tx->inputs, input);
+  btc_outvec_push(&tx->outputs, output);
+  btc_tx_refresh(tx);
+
+  return tx;
+}
+
+static void
+test_assume_valid(int known) {
+  static const uint8_t unknown[32] = {1};
+  unsigned int flags = BTC_BLOCK_DEFAULT_FLAGS;
+  btc_chain_t *chain = btc_chain_create(btc_regtest);
+  const btc_entry_t *tip, *fork;
+  btc_block_t *block, *bad;
+  uint8_t hash[32];
+  btc_tx_t *tx;
+  int i;
+
+  btc_rimraf(BTC_PREFIX);
+
+  ASSERT(btc_chain_open(chain, BTC_PREFIX, 0));
+
+  for (i = 0; i < 101; i++) {
+    block = mine_block(chain, btc_chain_tip(chain), NULL);
+
+    ASSERT(btc_chain_add(chain, block, flags, -1));
+
+    if (i == 0)
+      btc_hash_copy(hash, block->txs.items[0]->hash);
+
+    btc_block_destroy(block);
+  }
+
+  /* Spend the first coinbase without a signature. */
+  tx = unsigned_spend(hash);
+
+  fork = btc_chain_tip(chain);
+
+  block = mine_block(chain, fork, NULL);
+  bad = mine_block(chain, fork, tx);
+
+  ASSERT(btc_chain_add(chain, block, flags, -1));
+
+  /* Scripts are not checked on an alternate chain. */
+  ASSERT(btc_chain_add(chain, bad, flags, -1));
+  ASSERT(btc_chain_tip(chain)->height == fork->height + 1);
+
+  btc_header_hash(hash, &bad->header);
+
+  btc_chain_set_assume_valid(chain, known ? hash : unknown);
+
+  btc_block_destroy(block);
+
+  /* Reorganizing onto the bad block only skips its
+     scripts if it is an ancestor of a known block. */
+  block = mine_block(chain, btc_chain_by_hash(chain, hash), NULL);
+
+  if (known) {
+    ASSERT(btc_chain_add(chain, block, flags, -1));
+    ASSERT(btc_chain_tip(chain)->height == fork->height + 2);
+  } else {
+    ASSERT(!btc_chain_add(chain, block, flags, -1));
+
+    tip = btc_chain_tip(chain);
+
+    ASSERT(tip->height == fork->height + 1);
+    ASSERT(!btc_hash_equal(tip->hash, hash));
+  }
+
+  btc_block_destroy(block);
+  btc_block_destroy(bad);
+  btc_tx_destroy(tx);
+
+  btc_chain_close(chain);
+  btc_chain_destroy(chain);
+
+  btc_rimraf(BTC_PREFIX);
+}
+
+static void
+test_assume_headers(int headers) {
+  unsigned int flags = BTC_BLOCK_DEFAULT_FLAGS;
+  btc_chain_t *chain = btc_chain_create(btc_regtest);
+  btc_block_t *blocks[3];
+  btc_entry_t entries[2];
+  const btc_entry_t *prev;
+  uint8_t hashes[2][32];
+  uint8_t hash[32];
+  btc_tx_t *txs[2];
+  int i;
+
+  btc_rimraf(BTC_PREFIX);
+
+  ASSERT(btc_chain_open(chain, BTC_PREFIX, 0));
+
+  for (i = 0; i < 101; i++) {
+    btc_block_t *block = mine_block(chain, btc_chain_tip(chain), NULL);
+
+    ASSERT(btc_chain_add(chain, block, flags, -1));
+
+    if (i < 2)
+      btc_hash_copy(hashes[i], block->txs.items[0]->hash);
+
+    btc_block_destroy(block);
+  }
+
+  txs[0] = unsigned_spend(hashes[0]);
+  txs[1] = unsigned_spend(hashes[1]);
+
+  /* Mine ahead of the index: an unsigned spend, the
+     assumevalid block, then another unsigned spend. */
+  prev = btc_chain_tip(chain);
+
+  for (i = 0; i < 3; i++) {
+    blocks[i] = mine_block(chain, prev, i == 1 ? NULL : txs[i / 2]);
+
+    if (i < 2) {
+      btc_entry_set_block(&entries[i], blocks[i], prev);
+      prev = &entries[i];
+    }
+  }
+
+  btc_header_hash(hash, &blocks[1]->header);
+  btc_chain_set_assume_valid(chain, hash);
+
+  if (headers) {
+    uint8_t target[32];
+    int32_t height;
+
+    ASSERT(btc_chain_get_assumed(chain, target, &height));
+    ASSERT(btc_hash_equal(target, hash));
+    ASSERT(height == -1);
+
+    for (i = 0; i < 3; i++)
+      btc_chain_add_header(chain, &blocks[i]->header);
+
+    ASSERT(btc_chain_get_assumed(chain, target, &height));
+    ASSERT(height == entries[1].height);
+
+    /* Scripts below the assumevalid header are skipped. */
+    ASSERT(btc_chain_add(chain, blocks[0], flags, -1));
+    ASSERT(btc_chain_add(chain, blocks[1], flags, -1));
+    ASSERT(!btc_chain_get_assumed(chain, target, &height));
+
+    /* Scripts above it are checked. */
+    ASSERT(!btc_chain_add(chain, blocks[2], flags, -1));
+    ASSERT(btc_chain_height(chain) == entries[1].height);
+  } else {
+    /* Without a header chain nothing is assumed. */
+    ASSERT(!btc_chain_add(chain, blocks[0], flags, -1));
+    ASSERT(btc_chain_height(chain) == entries[0].height - 1);
+  }
+
+  for (i = 0; i < 3; i++)
+    btc_block_destroy(blocks[i]);
+
+  btc_tx_destroy(txs[0]);
+  btc_tx_destroy(txs[1]);
+
   btc_chain_close(chain);
   btc_chain_destroy(chain);
 
@@ -46,11 +844,30 @@ test_chain(const btc_network_t *network, const char **vectors, size_t length) {
 
 int
 main(void) {
+  /* The default assumevalid block is never in our index
+     here, so scripts are verified on both networks. */
   test_chain(btc_mainnet, chain_vectors_main,
-                          lengthof(chain_vectors_main));
+                          lengthof(chain_vectors_main), 0);
 
   test_chain(btc_testnet, chain_vectors_testnet,
-                          lengthof(chain_vectors_testnet));
+                          lengthof(chain_vectors_testnet), 1);
+
+  test_assume_valid(0);
+  test_assume_valid(1);
+  test_assume_headers(0);
+  test_assume_headers(1);
+
+  test_txindex(btc_mainnet, chain_vectors_main,
+                            lengthof(chain_vectors_main));
+
+  test_addrindex(btc_mainnet, chain_vectors_main,
+                              lengthof(chain_vectors_main));
+
+  test_filterindex(btc_mainnet, chain_vectors_main,
+                                lengthof(chain_vectors_main));
+
+  test_snapshot(btc_mainnet, chain_vectors_main,
+                             lengthof(chain_vectors_main));
 
   return 0;
 }
@@ -5,22 +5,449 @@
  */
 
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <io/core.h>
 #include <node/chaindb.h>
+#include <mako/address.h>
+#include <mako/block.h>
+#include <mako/coins.h>
+#include <mako/consensus.h>
+#include <mako/crypto/hash.h>
+#include <mako/entry.h>
 #include <mako/network.h>
+#include <mako/script.h>
+#include <mako/tx.h>
+#include <mako/util.h>
 #include "lib/tests.h"
 
-int main(void) {
+static btc_block_t *
+create_block(const btc_entry_t *prev, const btc_tx_t *spend) {
+  static const uint8_t zero[32] = {0};
+  btc_block_t *block = btc_block_create();
+  btc_tx_t *tx = btc_tx_create();
+  btc_address_t addr;
+  uint8_t raw[4];
+
+  btc_address_set_p2pkh(&addr, zero);
+
+  /* Make each coinbase unique. */
+  raw[0] = (prev->height + 1) >> 0;
+  raw[1] = (prev->height + 1) >> 8;
+  raw[2] = (prev->height + 1) >> 16;
+  raw[3] = (prev->height + 1) >> 24;
+
+  btc_tx_add_input(tx, zero, (uint32_t)-1);
+  btc_script_set(&tx->inputs.items[0]->script, raw, 4);
+  btc_tx_add_output(tx, &addr, 50 * BTC_COIN);
+  btc_tx_refresh(tx);
+  btc_txvec_push(&block->txs, tx);
+
+  if (spend != NULL) {
+    tx = btc_tx_create();
+
+    btc_tx_add_input(tx, spend->hash, 0);
+    btc_tx_add_output(tx, &addr, 49 * BTC_COIN);
+    btc_tx_refresh(tx);
+    btc_txvec_push(&block->txs, tx);
+  }
+
+  /* The chaindb does not check proof of work. */
+  block->header.version = 1;
+  block->header.time = prev->header.time + 1;
+  block->header.bits = prev->header.bits;
+
+  btc_hash_copy(block->header.prev_block, prev->hash);
+  btc_block_merkle_root(block->header.merkle_root, block);
+
+  return block;
+}
+
+static const btc_entry_t *
+connect_block(btc_chaindb_t *db, const btc_block_t *block) {
+  btc_entry_t *entry = btc_chaindb_entry_create(db);
+  btc_view_t *view = btc_view_create();
+  size_t i;
+
+  btc_entry_set_block(entry, block, btc_chaindb_tail(db));
+
+  for (i = 0; i < block->txs.length; i++) {
+    const btc_tx_t *tx = block->txs.items[i];
+
+    if (i > 0)
+      ASSERT(btc_chaindb_spend(db, view, tx));
+
+    btc_view_add(view, tx, entry->height, 0);
+  }
+
+  ASSERT(btc_chaindb_save(db, entry, block, view));
+
+  btc_view_destroy(view);
+
+  return entry;
+}
+
+static void
+connect_blocks(btc_chaindb_t *db, int count) {
+  const btc_entry_t *tip;
+  btc_block_t *block;
+  btc_block_t *last;
+  int i;
+
+  tip = btc_chaindb_tail(db);
+  last = tip->height > 0 ? btc_chaindb_get_block(db, tip) : NULL;
+
+  /* Every block spends the previous coinbase. */
+  for (i = 0; i < count; i++) {
+    block = create_block(btc_chaindb_tail(db),
+                         last != NULL ? last->txs.items[0] : NULL);
+
+    connect_block(db, block);
+
+    if (last != NULL)
+      btc_block_destroy(last);
+
+    last = block;
+  }
+
+  if (last != NULL)
+    btc_block_destroy(last);
+}
+
+static void
+check_undo(btc_chaindb_t *db, int32_t start, int32_t end, int version) {
+  const btc_entry_t *entry;
+  const btc_coin_t *coin;
+  const btc_tx_t *tx;
+  btc_block_t *block;
+  btc_view_t *view;
+  int32_t height;
+
+  for (height = start; height <= end; height++) {
+    entry = btc_chaindb_by_height(db, height);
+    block = btc_chaindb_get_block(db, entry);
+
+    ASSERT(block != NULL);
+    ASSERT(block->txs.length == 2);
+    ASSERT(btc_chaindb_undo_version(db, entry) == version);
+
+    view = btc_chaindb_get_undo(db, entry, block);
+
+    ASSERT(view != NULL);
+
+    tx = block->txs.items[1];
+    coin = btc_view_get(view, &tx->inputs.items[0]->prevout);
+
+    ASSERT(coin != NULL);
+    ASSERT(coin->coinbase);
+    ASSERT(coin->height == height - 1);
+    ASSERT(coin->output.value == 50 * BTC_COIN);
+
+    btc_view_destroy(view);
+    btc_block_destroy(block);
+  }
+}
+
+static int
+has_block(btc_chaindb_t *db, int32_t height) {
+  const btc_entry_t *entry = btc_chaindb_by_height(db, height);
+  btc_block_t *block = btc_chaindb_get_block(db, entry);
+
+  if (block == NULL)
+    return 0;
+
+  btc_block_destroy(block);
+
+  return 1;
+}
+
+static void
+check_block_data(btc_chaindb_t *db, const btc_entry_t *entry) {
+  uint8_t *raw, *data;
+  size_t raw_len, len;
+
+  ASSERT(btc_chaindb_get_raw_block(db, &raw, &raw_len, entry));
+  ASSERT(btc_chaindb_get_block_data(db, &data, &len, entry));
+
+  /* The payload is the raw block without its message header. */
+  ASSERT(raw_len == len + 24);
+  ASSERT(memcmp(raw + 24, data, len) == 0);
+
+  free(data);
+  free(raw);
+}
+
+static int
+has_file(const char *tag, int32_t id) {
+  char path[64];
+
+  sprintf(path, "%s/blocks/%s%05d.dat", BTC_PREFIX, tag, (int)id);
+
+  return btc_fs_exists(path);
+}
+
+static void
+test_prune_empty(void) {
   btc_chaindb_t *db = btc_chaindb_create(btc_mainnet);
+  int32_t pruned;
 
   btc_rimraf(BTC_PREFIX);
 
   ASSERT(btc_chaindb_open(db, BTC_PREFIX, BTC_CHAIN_DEFAULT_FLAGS));
+  ASSERT(!btc_chaindb_prune(db, 0, &pruned));
+
+  btc_chaindb_close(db);
+
+  /* Nothing is prunable below keep_blocks. */
+  ASSERT(btc_chaindb_open(db, BTC_PREFIX, BTC_CHAIN_PRUNE));
+  ASSERT(btc_chaindb_prune(db, 0, &pruned));
+  ASSERT(pruned == -1);
 
   btc_chaindb_close(db);
   btc_chaindb_destroy(db);
 
   btc_rimraf(BTC_PREFIX);
+}
+
+static void
+test_undo_version(void) {
+  btc_chaindb_t *db = btc_chaindb_create(btc_regtest);
+  const btc_entry_t *entry;
+  int version;
+
+  btc_rimraf(BTC_PREFIX);
+
+  ASSERT(btc_chaindb_open(db, BTC_PREFIX, BTC_CHAIN_DEFAULT_FLAGS));
+
+  connect_blocks(db, 10);
+
+  /* A block which spends nothing has no undo record. */
+  entry = btc_chaindb_by_height(db, 1);
+
+  ASSERT(btc_chaindb_undo_version(db, entry) == -1);
+
+  /* New records are compressed wherever snappy is built in. */
+  version = btc_chaindb_set_undo_version(db, 1);
+
+  ASSERT(version || btc_chaindb_set_undo_version(db, 0));
+  ASSERT(!btc_chaindb_set_undo_version(db, 2));
 
+  check_undo(db, 2, 10, version);
+
+  btc_chaindb_close(db);
+  btc_chaindb_destroy(db);
+
+  btc_rimraf(BTC_PREFIX);
+
+  /* Write uncompressed records as older releases did. */
+  db = btc_chaindb_create(btc_regtest);
+
+  ASSERT(btc_chaindb_set_undo_version(db, 0));
+  ASSERT(btc_chaindb_open(db, BTC_PREFIX, BTC_CHAIN_DEFAULT_FLAGS));
+
+  connect_blocks(db, 10);
+  check_undo(db, 2, 10, 0);
+
+  btc_chaindb_close(db);
+  btc_chaindb_destroy(db);
+
+  /* An upgraded node keeps reading and appending to them. */
+  db = btc_chaindb_create(btc_regtest);
+
+  ASSERT(btc_chaindb_open(db, BTC_PREFIX, BTC_CHAIN_DEFAULT_FLAGS));
+
+  check_undo(db, 2, 10, 0);
+  connect_blocks(db, 10);
+  check_undo(db, 2, 20, 0);
+
+  btc_chaindb_close(db);
+  btc_chaindb_destroy(db);
+
+  btc_rimraf(BTC_PREFIX);
+}
+
+static btc_chaindb_t *
+open_pruned(const btc_network_t *network, uint64_t target) {
+  btc_chaindb_t *db = btc_chaindb_create(network);
+
+  /* Roughly a dozen blocks per file. */
+  btc_chaindb_set_file_size(db, 4096);
+  btc_chaindb_set_prune(db, target);
+
+  ASSERT(btc_chaindb_open(db, BTC_PREFIX, BTC_CHAIN_PRUNE));
+
+  return db;
+}
+
+static void
+test_prune(void) {
+  const btc_entry_t *tip;
+  btc_network_t network;
+  btc_chaindb_t *db;
+  int32_t pruned;
+  int version;
+
+  network = *btc_regtest;
+  network.block.prune_after_height = 10;
+  network.block.keep_blocks = 10;
+
+  btc_rimraf(BTC_PREFIX);
+
+  /* prune=1: files are only removed on request. Reopen
+     along the way so that the coins are flushed at 200. */
+  db = open_pruned(&network, 0);
+
+  connect_blocks(db, 200);
+
+  btc_chaindb_close(db);
+  btc_chaindb_destroy(db);
+
+  db = open_pruned(&network, 0);
+
+  connect_blocks(db, 100);
+
+  ASSERT(has_file("blk", 0));
+  ASSERT(has_file("rev", 0));
+  ASSERT(has_block(db, 1));
+
+  /* Never past the flushed coins. */
+  ASSERT(btc_chaindb_prune(db, 250, &pruned));
+  ASSERT(pruned > 0 && pruned <= 200);
+
+  ASSERT(!has_file("blk", 0));
+  ASSERT(!has_file("rev", 0));
+  ASSERT(!has_block(db, 1));
+  ASSERT(!has_block(db, pruned));
+  ASSERT(has_block(db, pruned + 1));
+  ASSERT(has_block(db, 300));
+
+  btc_chaindb_close(db);
+  btc_chaindb_destroy(db);
+
+  btc_rimraf(BTC_PREFIX);
+
+  /* prune=<MiB>: the oldest files go once we are over budget. */
+  db = open_pruned(&network, 16 << 10);
+
+  connect_blocks(db, 200);
+
+  btc_chaindb_close(db);
+  btc_chaindb_destroy(db);
+
+  db = open_pruned(&network, 16 << 10);
+  version = btc_chaindb_set_undo_version(db, 1);
+
+  connect_blocks(db, 100);
+
+  tip = btc_chaindb_tail(db);
+
+  ASSERT(tip->height == 300);
+
+  ASSERT(!has_file("blk", 0));
+  ASSERT(!has_file("rev", 0));
+  ASSERT(!has_block(db, 1));
+
+  ASSERT(has_file("blk", tip->block_file));
+  ASSERT(has_file("rev", tip->undo_file));
+
+  check_undo(db, 201, 300, version);
+
+  btc_chaindb_close(db);
+  btc_chaindb_destroy(db);
+
+  btc_rimraf(BTC_PREFIX);
+}
+
+static void
+test_replay(void) {
+  btc_chaindb_t *db = btc_chaindb_create(btc_regtest);
+  const btc_coinstats_t *stats;
+  const btc_entry_t *tip;
+  uint8_t hash[32], muhash[32];
+  uint8_t spent[32], unspent[32];
+  int64_t count, value;
+  btc_block_t *block;
+  btc_coin_t *coin;
+
+  btc_rimraf(BTC_PREFIX);
+
+  ASSERT(btc_chaindb_open(db, BTC_PREFIX, BTC_CHAIN_DEFAULT_FLAGS));
+
+  connect_blocks(db, 20);
+
+  btc_chaindb_close(db);
+  btc_chaindb_destroy(db);
+
+  /* Coins are flushed at height 20. Connect more
+     blocks and crash before the next flush. */
+  db = btc_chaindb_create(btc_regtest);
+
+  ASSERT(btc_chaindb_open(db, BTC_PREFIX, BTC_CHAIN_DEFAULT_FLAGS));
+
+  connect_blocks(db, 30);
+
+  tip = btc_chaindb_tail(db);
+  block = btc_chaindb_get_block(db, tip);
+
+  ASSERT(block != NULL);
+  ASSERT(block->txs.length == 2);
+
+  btc_hash_copy(hash, tip->hash);
+  btc_hash_copy(unspent, block->txs.items[0]->hash);
+  btc_hash_copy(spent, block->txs.items[1]->inputs.items[0]->prevout.hash);
+
+  btc_block_destroy(block);
+
+  stats = btc_chaindb_coinstats(db);
+  count = stats->count;
+  value = stats->value;
+
+  btc_muhash_final(&stats->muhash, muhash);
+
+  btc_chaindb_abort(db);
+  btc_chaindb_destroy(db);
+
+  /* The reopen replays blocks 21 to 50. */
+  db = btc_chaindb_create(btc_regtest);
+
+  ASSERT(btc_chaindb_open(db, BTC_PREFIX, BTC_CHAIN_DEFAULT_FLAGS));
+
+  tip = btc_chaindb_tail(db);
+
+  ASSERT(tip->height == 50);
+  ASSERT(btc_hash_equal(tip->hash, hash));
+
+  check_block_data(db, tip);
+
+  stats = btc_chaindb_coinstats(db);
+
+  btc_muhash_final(&stats->muhash, hash);
+
+  ASSERT(stats->count == count);
+  ASSERT(stats->value == value);
+  ASSERT(btc_hash_equal(hash, muhash));
+
+  coin = btc_chaindb_coin(db, unspent, 0);
+
+  ASSERT(coin != NULL);
+  ASSERT(coin->height == 50);
+
+  btc_coin_destroy(coin);
+
+  ASSERT(btc_chaindb_coin(db, spent, 0) == NULL);
+
+  btc_chaindb_close(db);
+  btc_chaindb_destroy(db);
+
+  btc_rimraf(BTC_PREFIX);
+}
+
+int main(void) {
+  test_prune_empty();
+  test_undo_version();
+  test_prune();
+  test_replay();
   return 0;
 }
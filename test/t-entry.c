@@ -1,5 +1,5 @@
 /*!
- * t-stub.c - stub test for mako
+ * t-entry.c - entry test for mako
  * Copyright (c) 2021, Christopher Jeffrey (MIT License).
  * https://github.com/chjj/mako
  */
@@ -7,8 +7,67 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <mako/entry.h>
 #include "lib/tests.h"
 
+static void
+test_ancestor(void) {
+  static const int32_t length = 100000;
+  btc_entry_t *entries = malloc(length * sizeof(btc_entry_t));
+  btc_entry_t *fork = malloc(1000 * sizeof(btc_entry_t));
+  int32_t i, j;
+
+  ASSERT(entries != NULL && fork != NULL);
+
+  for (i = 0; i < length; i++) {
+    btc_entry_init(&entries[i]);
+
+    entries[i].height = i;
+    entries[i].prev = i > 0 ? &entries[i - 1] : NULL;
+
+    btc_entry_set_skip(&entries[i]);
+  }
+
+  /* A side chain forking off at height 50000. */
+  for (i = 0; i < 1000; i++) {
+    btc_entry_init(&fork[i]);
+
+    fork[i].height = 50001 + i;
+    fork[i].prev = i > 0 ? &fork[i - 1] : &entries[50000];
+
+    btc_entry_set_skip(&fork[i]);
+  }
+
+  for (i = 1; i < length; i++) {
+    ASSERT(entries[i].skip != NULL);
+    ASSERT(entries[i].skip->height < i);
+    ASSERT(entries[i].skip == &entries[entries[i].skip->height]);
+  }
+
+  for (i = 0; i < length; i += 97) {
+    for (j = 0; j <= i; j += 1 + (i >> 4)) {
+      ASSERT(btc_entry_ancestor(&entries[i], j) == &entries[j]);
+    }
+
+    ASSERT(btc_entry_ancestor(&entries[i], i) == &entries[i]);
+    ASSERT(btc_entry_ancestor(&entries[i], i + 1) == NULL);
+    ASSERT(btc_entry_ancestor(&entries[i], -1) == NULL);
+  }
+
+  for (i = 0; i < 1000; i++) {
+    const btc_entry_t *tip = &fork[i];
+
+    ASSERT(btc_entry_ancestor(tip, 50001) == &fork[0]);
+    ASSERT(btc_entry_ancestor(tip, 50000) == &entries[50000]);
+    ASSERT(btc_entry_ancestor(tip, 1234) == &entries[1234]);
+    ASSERT(btc_entry_ancestor(tip, tip->height) == tip);
+  }
+
+  free(entries);
+  free(fork);
+}
+
 int main(void) {
+  test_ancestor();
   return 0;
 }
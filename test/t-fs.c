@@ -1,5 +1,5 @@
 /*!
- * t-stub.c - stub test for mako
+ * t-fs.c - filesystem test for mako
  * Copyright (c) 2021, Christopher Jeffrey (MIT License).
  * https://github.com/chjj/mako
  */
@@ -7,8 +7,91 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <io/core.h>
 #include "lib/tests.h"
 
+static void
+test_pread(void) {
+  static const char *path = BTC_PREFIX ".pread";
+  unsigned char data[256];
+  unsigned char buf[256];
+  btc_fd_t fd;
+  int i;
+
+  for (i = 0; i < 256; i++)
+    data[i] = i;
+
+  ASSERT(btc_fs_write_file(path, data, sizeof(data)));
+
+  fd = btc_fs_open(path);
+
+  ASSERT(fd != BTC_INVALID_FD);
+
+  /* Reads are independent of the file offset. */
+  ASSERT(btc_fs_pread(fd, buf, 16, 100) == 16);
+  ASSERT(memcmp(buf, data + 100, 16) == 0);
+
+  ASSERT(btc_fs_pread(fd, buf, 16, 10) == 16);
+  ASSERT(memcmp(buf, data + 10, 16) == 0);
+
+  ASSERT(btc_fs_read(fd, buf, 4) == 4);
+  ASSERT(memcmp(buf, data, 4) == 0);
+
+  /* The offset is kept wherever it was moved to. */
+  ASSERT(btc_fs_pread(fd, buf, 16, 200) == 16);
+  ASSERT(memcmp(buf, data + 200, 16) == 0);
+
+  ASSERT(btc_fs_read(fd, buf, 4) == 4);
+  ASSERT(memcmp(buf, data + 4, 4) == 0);
+
+  /* Short read at the end of the file. */
+  ASSERT(btc_fs_pread(fd, buf, 16, 250) == 6);
+  ASSERT(memcmp(buf, data + 250, 6) == 0);
+
+  ASSERT(btc_fs_pread(fd, buf, 16, 256) == 0);
+
+  btc_fs_close(fd);
+
+  ASSERT(btc_fs_unlink(path));
+}
+
+static void
+test_fallocate(void) {
+  static const char *path = BTC_PREFIX ".fallocate";
+  unsigned char buf[4];
+  uint64_t size;
+  btc_fd_t fd;
+
+  fd = btc_fs_append(path);
+
+  ASSERT(fd != BTC_INVALID_FD);
+
+  /* May be unsupported; the size must never change. */
+  btc_fs_fallocate(fd, 1 << 20);
+
+  ASSERT(btc_fs_fsize(fd, &size));
+  ASSERT(size == 0);
+
+  ASSERT(btc_fs_write(fd, "abcd", 4) == 4);
+
+  btc_fs_close(fd);
+
+  ASSERT(btc_fs_size(path, &size));
+  ASSERT(size == 4);
+
+  fd = btc_fs_open(path);
+
+  ASSERT(fd != BTC_INVALID_FD);
+  ASSERT(btc_fs_pread(fd, buf, 4, 0) == 4);
+  ASSERT(memcmp(buf, "abcd", 4) == 0);
+
+  btc_fs_close(fd);
+
+  ASSERT(btc_fs_unlink(path));
+}
+
 int main(void) {
+  test_pread();
+  test_fallocate();
   return 0;
 }
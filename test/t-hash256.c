@@ -1,5 +1,5 @@
 /*!
- * t-stub.c - stub test for mako
+ * t-hash256.c - hash256 test for mako
  * Copyright (c) 2021, Christopher Jeffrey (MIT License).
  * https://github.com/chjj/mako
  */
@@ -7,8 +7,77 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <mako/crypto/hash.h>
 #include "lib/tests.h"
 
+static const int backends[] = {
+  BTC_SHA256_GENERIC,
+  BTC_SHA256_SHANI,
+  BTC_SHA256_ARMV8,
+  BTC_SHA256_SSE2,
+  BTC_SHA256_AVX2
+};
+
+static void
+test_roots(void) {
+  static uint8_t data[37 * 64];
+  static uint8_t work[37 * 64];
+  static uint8_t expect[37 * 32];
+  static uint8_t out[37 * 32];
+  int native = btc_sha256_backend();
+  size_t i, j, count;
+
+  for (i = 0; i < sizeof(data); i++)
+    data[i] = (i * 131 + 7) & 0xff;
+
+  for (i = 0; i < 37; i++)
+    btc_hash256(&expect[i * 32], &data[i * 64], 64);
+
+  for (i = 0; i < lengthof(backends); i++) {
+    if (!btc_sha256_select(backends[i]))
+      continue;
+
+    /* Cover every remainder of the 4 and 8 lane paths. */
+    for (count = 0; count <= 37; count++) {
+      btc_hash256_roots(out, data, count);
+
+      ASSERT(memcmp(out, expect, count * 32) == 0);
+
+      memcpy(work, data, sizeof(data));
+
+      btc_hash256_roots(work, work, count);
+
+      ASSERT(memcmp(work, expect, count * 32) == 0);
+
+      /* Shifted down by one node, as the miner does. */
+      memcpy(work, data, sizeof(data));
+
+      if (count > 0) {
+        btc_hash256_roots(work + 32, work + 64, count - 1);
+
+        for (j = 1; j < count; j++) {
+          uint8_t hash[32];
+
+          btc_hash256(hash, &data[j * 64], 64);
+
+          ASSERT(memcmp(&work[j * 32], hash, 32) == 0);
+        }
+      }
+    }
+
+    for (j = 0; j < 37; j++) {
+      uint8_t hash[32];
+
+      btc_hash256_root(hash, &data[j * 64], &data[j * 64 + 32]);
+
+      ASSERT(memcmp(hash, &expect[j * 32], 32) == 0);
+    }
+  }
+
+  ASSERT(btc_sha256_select(native));
+}
+
 int main(void) {
+  test_roots();
   return 0;
 }
@@ -0,0 +1,69 @@
+/*!
+ * t-keycache.c - key cache test for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <mako/crypto/ecc.h>
+#include <mako/keycache.h>
+#include <mako/util.h>
+#include "lib/tests.h"
+
+static void
+test_keycache(void) {
+  /* Small enough that the keys below collide. */
+  btc_keycache_t *cache = btc_keycache_create(4);
+  uint8_t priv[16][32];
+  uint8_t pub[16][33];
+  uint8_t upub[65];
+  uint8_t sig[16][64];
+  uint8_t msg[32];
+  uint8_t bad[33];
+  int i, j;
+
+  memset(msg, 0xaa, 32);
+
+  for (i = 0; i < 16; i++) {
+    memset(priv[i], i + 1, 32);
+
+    ASSERT(btc_ecdsa_pubkey_create(pub[i], priv[i], 1));
+    ASSERT(btc_ecdsa_sign(sig[i], NULL, msg, 32, priv[i]));
+  }
+
+  for (j = 0; j < 3; j++) {
+    for (i = 0; i < 16; i++) {
+      ASSERT(btc_keycache_verify(cache, msg, sig[i], pub[i], 33));
+
+      /* A cached key must not verify someone else's signature. */
+      ASSERT(!btc_keycache_verify(cache, msg, sig[(i + 1) & 15], pub[i], 33));
+    }
+  }
+
+  /* Uncompressed keys bypass the cache. */
+  ASSERT(btc_ecdsa_pubkey_convert(upub, pub[0], 33, 0));
+  ASSERT(btc_keycache_verify(cache, msg, sig[0], upub, 65));
+
+  /* No square root exists for this x coordinate. */
+  memset(bad, 0, 33);
+
+  bad[0] = 0x02;
+  bad[32] = 0x05;
+
+  ASSERT(!btc_ecdsa_pubkey_verify(bad, 33));
+  ASSERT(!btc_keycache_verify(cache, msg, sig[0], bad, 33));
+  ASSERT(!btc_keycache_verify(cache, msg, sig[0], bad, 33));
+
+  /* Without a cache we fall through to plain verification. */
+  ASSERT(btc_keycache_verify(NULL, msg, sig[1], pub[1], 33));
+
+  btc_keycache_destroy(cache);
+}
+
+int
+main(void) {
+  test_keycache();
+  return 0;
+}
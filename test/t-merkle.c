@@ -1,5 +1,5 @@
 /*!
- * t-stub.c - stub test for mako
+ * t-merkle.c - merkle test for mako
  * Copyright (c) 2021, Christopher Jeffrey (MIT License).
  * https://github.com/chjj/mako
  */
@@ -7,8 +7,90 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <mako/crypto/hash.h>
+#include <mako/crypto/merkle.h>
 #include "lib/tests.h"
 
+static void
+merkle_reference(uint8_t *root, const uint8_t *leaves, size_t size) {
+  uint8_t *nodes = malloc(size * 32 + 32);
+  size_t i;
+
+  ASSERT(nodes != NULL);
+
+  memcpy(nodes, leaves, size * 32);
+
+  while (size > 1) {
+    if (size & 1) {
+      memcpy(&nodes[size * 32], &nodes[(size - 1) * 32], 32);
+      size += 1;
+    }
+
+    for (i = 0; i < size; i += 2)
+      btc_hash256_root(&nodes[(i / 2) * 32], &nodes[i * 32],
+                                             &nodes[(i + 1) * 32]);
+
+    size /= 2;
+  }
+
+  memcpy(root, nodes, 32);
+
+  free(nodes);
+}
+
+static void
+test_merkle(void) {
+  static uint8_t leaves[300 * 32];
+  static uint8_t nodes[300 * 32];
+  uint8_t expect[32];
+  uint8_t root[32];
+  size_t i, size;
+
+  for (i = 0; i < sizeof(leaves); i++)
+    leaves[i] = (i * 2654435761u) >> 24;
+
+  for (size = 1; size <= 300; size++) {
+    merkle_reference(expect, leaves, size);
+
+    memcpy(nodes, leaves, size * 32);
+
+    ASSERT(btc_merkle_root(root, nodes, size));
+    ASSERT(memcmp(root, expect, 32) == 0);
+  }
+
+  memset(root, 0xff, 32);
+
+  ASSERT(btc_merkle_root(root, nodes, 0));
+
+  for (i = 0; i < 32; i++)
+    ASSERT(root[i] == 0);
+}
+
+static void
+test_malleated(void) {
+  uint8_t leaves[6 * 32];
+  uint8_t nodes[6 * 32];
+  uint8_t expect[32];
+  uint8_t root[32];
+  size_t i;
+
+  for (i = 0; i < sizeof(leaves); i++)
+    leaves[i] = i;
+
+  /* [a, b, c] and [a, b, c, c] share a root (CVE-2012-2459). */
+  memcpy(nodes, leaves, 3 * 32);
+
+  ASSERT(btc_merkle_root(expect, nodes, 3));
+
+  memcpy(nodes, leaves, 3 * 32);
+  memcpy(&nodes[3 * 32], &leaves[2 * 32], 32);
+
+  ASSERT(!btc_merkle_root(root, nodes, 4));
+  ASSERT(memcmp(root, expect, 32) == 0);
+}
+
 int main(void) {
+  test_merkle();
+  test_malleated();
   return 0;
 }
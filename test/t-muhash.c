@@ -0,0 +1,106 @@
+/*!
+ * t-muhash.c - muhash test for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mako/crypto/hash.h>
+#include <mako/util.h>
+#include "lib/tests.h"
+
+static void
+muhash_int(btc_muhash_t *ctx, uint8_t x, int remove) {
+  uint8_t data[32];
+
+  memset(data, 0, sizeof(data));
+
+  data[0] = x;
+
+  if (remove)
+    btc_muhash_remove(ctx, data, sizeof(data));
+  else
+    btc_muhash_insert(ctx, data, sizeof(data));
+}
+
+static void
+test_muhash_vector(void) {
+  /* From bitcoin/src/test/crypto_tests.cpp. */
+  static const char *expect =
+    "10d312b100cbd32ada024a6646e40d3482fcff103668d2625f10002a607d5863";
+  uint8_t hash[32];
+  uint8_t out[32];
+  btc_muhash_t ctx;
+
+  ASSERT(btc_hash_import(hash, expect));
+
+  btc_muhash_init(&ctx);
+
+  muhash_int(&ctx, 0, 0);
+  muhash_int(&ctx, 1, 0);
+  muhash_int(&ctx, 2, 1);
+
+  btc_muhash_final(&ctx, out);
+
+  ASSERT(memcmp(out, hash, 32) == 0);
+}
+
+static void
+test_muhash_order(void) {
+  btc_muhash_t x, y, z;
+  uint8_t a[32], b[32];
+
+  /* Removal undoes insertion in any order. */
+  btc_muhash_init(&x);
+
+  muhash_int(&x, 3, 0);
+  muhash_int(&x, 4, 0);
+  muhash_int(&x, 3, 1);
+  muhash_int(&x, 5, 0);
+
+  btc_muhash_init(&y);
+
+  muhash_int(&y, 5, 0);
+  muhash_int(&y, 4, 0);
+
+  btc_muhash_final(&x, a);
+  btc_muhash_final(&y, b);
+
+  ASSERT(memcmp(a, b, 32) == 0);
+
+  /* Combining matches sequential insertion. */
+  btc_muhash_init(&z);
+
+  muhash_int(&z, 5, 0);
+
+  btc_muhash_init(&y);
+
+  muhash_int(&y, 4, 0);
+
+  btc_muhash_combine(&z, &y);
+  btc_muhash_final(&z, b);
+
+  ASSERT(memcmp(a, b, 32) == 0);
+
+  /* The empty set. */
+  btc_muhash_init(&z);
+
+  muhash_int(&z, 7, 0);
+  muhash_int(&z, 7, 1);
+
+  btc_muhash_init(&y);
+
+  btc_muhash_final(&z, a);
+  btc_muhash_final(&y, b);
+
+  ASSERT(memcmp(a, b, 32) == 0);
+}
+
+int
+main(void) {
+  test_muhash_vector();
+  test_muhash_order();
+  return 0;
+}
@@ -36,7 +36,7 @@ test_script_vector(const test_script_vector_t *vec, size_t index) {
     btc_tx_cache_t cache;
     int ret;
 
-    memset(&cache, 0, sizeof(cache));
+    btc_tx_cache_init(&cache);
 
     ret = btc_script_verify(input,
                             witness,
@@ -47,6 +47,8 @@ test_script_vector(const test_script_vector_t *vec, size_t index) {
                             flags,
                             &cache);
 
+    btc_tx_cache_clear(&cache);
+
     ASSERT(ret == vec->expected);
   }
 
@@ -1,5 +1,5 @@
 /*!
- * t-stub.c - stub test for mako
+ * t-sha256.c - sha256 test for mako
  * Copyright (c) 2021, Christopher Jeffrey (MIT License).
  * https://github.com/chjj/mako
  */
@@ -7,8 +7,149 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <mako/crypto/hash.h>
+#include <mako/encoding.h>
 #include "lib/tests.h"
 
+static const struct {
+  const char *msg;
+  const char *hash;
+} sha256_vectors[] = {
+  {
+    "",
+    "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"
+  },
+  {
+    "abc",
+    "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"
+  },
+  {
+    "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+    "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"
+  },
+  {
+    "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmn"
+    "hijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+    "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1"
+  }
+};
+
+static const int backends[] = {
+  BTC_SHA256_GENERIC,
+  BTC_SHA256_SHANI,
+  BTC_SHA256_ARMV8
+};
+
+static uint32_t
+test_rand(uint32_t *state) {
+  /* xorshift32 */
+  uint32_t x = *state;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+
+  *state = x;
+
+  return x;
+}
+
+static void
+test_vectors(void) {
+  uint8_t expect[32];
+  uint8_t out[32];
+  size_t i;
+
+  for (i = 0; i < lengthof(sha256_vectors); i++) {
+    const char *msg = sha256_vectors[i].msg;
+
+    ASSERT(btc_base16_decode(expect, sha256_vectors[i].hash, 64));
+
+    btc_sha256(out, msg, strlen(msg));
+
+    ASSERT(memcmp(out, expect, 32) == 0);
+  }
+}
+
+static void
+test_million(void) {
+  static const char *hex =
+    "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0";
+  static uint8_t data[1000];
+  uint8_t expect[32];
+  uint8_t out[32];
+  btc_sha256_t ctx;
+  int i;
+
+  memset(data, 'a', sizeof(data));
+
+  ASSERT(btc_base16_decode(expect, hex, 64));
+
+  btc_sha256_init(&ctx);
+
+  for (i = 0; i < 1000; i++)
+    btc_sha256_update(&ctx, data, sizeof(data));
+
+  btc_sha256_final(&ctx, out);
+
+  ASSERT(memcmp(out, expect, 32) == 0);
+}
+
+static void
+test_backends(void) {
+  static uint8_t data[4096];
+  uint8_t expect[32];
+  uint8_t out[32];
+  uint32_t seed = 0x2545f491;
+  int native = btc_sha256_backend();
+  btc_sha256_t ctx;
+  size_t i, j, len;
+  size_t pos, step;
+
+  for (i = 0; i < sizeof(data); i++)
+    data[i] = test_rand(&seed);
+
+  for (i = 0; i < lengthof(backends); i++) {
+    if (!btc_sha256_select(backends[i]))
+      continue;
+
+    ASSERT(btc_sha256_backend() == backends[i]);
+
+    test_vectors();
+
+    for (j = 0; j < 1000; j++) {
+      len = test_rand(&seed) % sizeof(data);
+
+      ASSERT(btc_sha256_select(BTC_SHA256_GENERIC));
+
+      btc_sha256(expect, data, len);
+
+      ASSERT(btc_sha256_select(backends[i]));
+
+      /* Feed the input in uneven chunks. */
+      btc_sha256_init(&ctx);
+
+      for (pos = 0; pos < len; pos += step) {
+        step = test_rand(&seed) % 200;
+
+        if (step > len - pos)
+          step = len - pos;
+
+        btc_sha256_update(&ctx, data + pos, step);
+      }
+
+      btc_sha256_final(&ctx, out);
+
+      ASSERT(memcmp(out, expect, 32) == 0);
+    }
+  }
+
+  ASSERT(btc_sha256_select(native));
+}
+
 int main(void) {
+  test_vectors();
+  test_million();
+  test_backends();
   return 0;
 }
@@ -0,0 +1,145 @@
+/*!
+ * t-sigcache.c - signature cache test for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <base/sigcache.h>
+#include <mako/script.h>
+#include <mako/tx.h>
+#include "lib/tests.h"
+
+#define P2SH BTC_SCRIPT_VERIFY_P2SH
+#define DERSIG BTC_SCRIPT_VERIFY_DERSIG
+#define LOW_S BTC_SCRIPT_VERIFY_LOW_S
+
+static void
+tx_init(btc_tx_t *tx, int i) {
+  btc_tx_init(tx);
+  memset(tx->whash, i, 32);
+}
+
+static void
+test_sigcache_add(void) {
+  btc_sigcache_t *cache = btc_sigcache_create(16);
+  btc_tx_t a, b;
+
+  tx_init(&a, 1);
+  tx_init(&b, 2);
+
+  ASSERT(!btc_sigcache_has(cache, &a, 0));
+  ASSERT(btc_sigcache_size(cache) == 0);
+
+  btc_sigcache_add(cache, &a, P2SH | DERSIG);
+
+  ASSERT(btc_sigcache_size(cache) == 1);
+  ASSERT(btc_sigcache_has(cache, &a, P2SH | DERSIG));
+  ASSERT(!btc_sigcache_has(cache, &b, 0));
+
+  /* A take removes the entry. */
+  ASSERT(!btc_sigcache_take(cache, &b, 0));
+  ASSERT(btc_sigcache_take(cache, &a, P2SH));
+  ASSERT(!btc_sigcache_has(cache, &a, 0));
+  ASSERT(!btc_sigcache_take(cache, &a, 0));
+  ASSERT(btc_sigcache_size(cache) == 0);
+
+  btc_sigcache_add(cache, &a, P2SH);
+  btc_sigcache_add(cache, &b, P2SH);
+  btc_sigcache_reset(cache);
+
+  ASSERT(btc_sigcache_size(cache) == 0);
+  ASSERT(!btc_sigcache_has(cache, &a, 0));
+
+  btc_tx_clear(&a);
+  btc_tx_clear(&b);
+  btc_sigcache_destroy(cache);
+}
+
+static void
+test_sigcache_flags(void) {
+  btc_sigcache_t *cache = btc_sigcache_create(16);
+  btc_tx_t tx;
+
+  tx_init(&tx, 1);
+
+  btc_sigcache_add(cache, &tx, P2SH | DERSIG);
+
+  /* Success under a set implies success under a subset. */
+  ASSERT(btc_sigcache_has(cache, &tx, 0));
+  ASSERT(btc_sigcache_has(cache, &tx, P2SH));
+  ASSERT(btc_sigcache_has(cache, &tx, DERSIG));
+  ASSERT(!btc_sigcache_has(cache, &tx, LOW_S));
+  ASSERT(!btc_sigcache_has(cache, &tx, P2SH | LOW_S));
+  ASSERT(!btc_sigcache_take(cache, &tx, P2SH | LOW_S));
+
+  /* Two verifications must not merge into a set
+     which was never checked as a whole. */
+  btc_sigcache_add(cache, &tx, LOW_S);
+
+  ASSERT(btc_sigcache_has(cache, &tx, LOW_S));
+  ASSERT(!btc_sigcache_has(cache, &tx, P2SH | LOW_S));
+  ASSERT(!btc_sigcache_has(cache, &tx, P2SH | DERSIG | LOW_S));
+
+  /* A subset does not weaken a stored superset. */
+  btc_sigcache_add(cache, &tx, P2SH | DERSIG | LOW_S);
+  btc_sigcache_add(cache, &tx, DERSIG);
+
+  ASSERT(btc_sigcache_has(cache, &tx, P2SH | DERSIG | LOW_S));
+  ASSERT(btc_sigcache_size(cache) == 1);
+
+  btc_tx_clear(&tx);
+  btc_sigcache_destroy(cache);
+}
+
+static void
+test_sigcache_evict(void) {
+  btc_sigcache_t *cache = btc_sigcache_create(4);
+  btc_tx_t txs[8];
+  int i;
+
+  for (i = 0; i < 8; i++)
+    tx_init(&txs[i], i + 1);
+
+  for (i = 0; i < 4; i++)
+    btc_sigcache_add(cache, &txs[i], P2SH);
+
+  ASSERT(btc_sigcache_size(cache) == 4);
+
+  /* The oldest entries go first. */
+  btc_sigcache_add(cache, &txs[4], P2SH);
+  btc_sigcache_add(cache, &txs[5], P2SH);
+
+  ASSERT(btc_sigcache_size(cache) == 4);
+  ASSERT(!btc_sigcache_has(cache, &txs[0], P2SH));
+  ASSERT(!btc_sigcache_has(cache, &txs[1], P2SH));
+
+  for (i = 2; i < 6; i++)
+    ASSERT(btc_sigcache_has(cache, &txs[i], P2SH));
+
+  /* Evicting an entry which was taken is harmless. */
+  ASSERT(btc_sigcache_take(cache, &txs[2], P2SH));
+
+  btc_sigcache_add(cache, &txs[6], P2SH);
+  btc_sigcache_add(cache, &txs[7], P2SH);
+
+  ASSERT(btc_sigcache_size(cache) == 4);
+  ASSERT(!btc_sigcache_has(cache, &txs[3], P2SH));
+
+  for (i = 4; i < 8; i++)
+    ASSERT(btc_sigcache_has(cache, &txs[i], P2SH));
+
+  for (i = 0; i < 8; i++)
+    btc_tx_clear(&txs[i]);
+
+  btc_sigcache_destroy(cache);
+}
+
+int main(void) {
+  test_sigcache_add();
+  test_sigcache_flags();
+  test_sigcache_evict();
+  return 0;
+}
@@ -14,6 +14,31 @@
 #include "data/sighash_vectors.h"
 #include "lib/tests.h"
 
+static void
+test_sighash_cache(btc_tx_t *tx, const btc_script_t *script, int type) {
+  uint8_t expect[32];
+  btc_tx_cache_t cache;
+  uint8_t msg[32];
+  size_t i;
+
+  /* Pad the input count so the legacy cache is built. */
+  while (tx->inputs.length < 8)
+    btc_inpvec_push(&tx->inputs, btc_input_clone(tx->inputs.items[0]));
+
+  btc_tx_precompute(tx, &cache);
+
+  ASSERT(cache.has_legacy);
+
+  for (i = 0; i < tx->inputs.length; i++) {
+    btc_tx_sighash(expect, tx, i, script, 0, type, 0, NULL);
+    btc_tx_sighash(msg, tx, i, script, 0, type, 0, &cache);
+
+    ASSERT(memcmp(msg, expect, 32) == 0);
+  }
+
+  btc_tx_cache_clear(&cache);
+}
+
 static void
 test_sighash_vector(const test_sighash_vector_t *vec, size_t index) {
   btc_script_t script;
@@ -33,6 +58,8 @@ test_sighash_vector(const test_sighash_vector_t *vec, size_t index) {
 
   ASSERT(memcmp(msg, vec->expected, 32) == 0);
 
+  test_sighash_cache(&tx, &script, vec->type);
+
   btc_tx_clear(&tx);
   btc_script_clear(&script);
 }
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <mako/buffer.h>
 #include <mako/coins.h>
 #include <mako/network.h>
 #include <mako/script.h>
@@ -17,6 +18,90 @@
 #include "data/tx_invalid_vectors.h"
 #include "lib/tests.h"
 
+static void
+test_rawtx(const uint8_t *data, size_t length, const btc_tx_t *tx) {
+  const uint8_t *xp, *wp;
+  btc_rawinput_t input;
+  btc_output_t output;
+  btc_rawvec_t stack;
+  btc_buffer_t item;
+  uint8_t hash[32];
+  size_t xn, wn, i, j;
+  btc_rawtx_t raw;
+  btc_tx_t *lazy;
+
+  ASSERT(btc_rawtx_import(&raw, data, length));
+  ASSERT(raw.size == btc_tx_size(tx));
+  ASSERT(btc_rawtx_base_size(&raw) == btc_tx_base_size(tx));
+  ASSERT(btc_rawtx_has_witness(&raw) == btc_tx_has_witness(tx));
+  ASSERT(btc_rawtx_is_coinbase(&raw) == btc_tx_is_coinbase(tx));
+  ASSERT(raw.version == tx->version);
+  ASSERT(raw.locktime == tx->locktime);
+
+  btc_rawtx_txid(hash, &raw);
+
+  ASSERT(btc_hash_equal(hash, tx->hash));
+
+  btc_rawtx_wtxid(hash, &raw);
+
+  ASSERT(btc_hash_equal(hash, tx->whash));
+
+  lazy = btc_tx_create();
+  xp = data;
+  xn = length;
+
+  ASSERT(btc_tx_read_deferred(lazy, &xp, &xn));
+  ASSERT(xn == 0);
+
+  btc_rawtx_refresh(lazy, &raw);
+
+  ASSERT(btc_hash_equal(lazy->hash, tx->hash));
+  ASSERT(btc_hash_equal(lazy->whash, tx->whash));
+
+  btc_tx_destroy(lazy);
+
+  xp = raw.inputs.data;
+  xn = raw.inputs.size;
+  wp = raw.witness.data;
+  wn = raw.witness.size;
+
+  ASSERT(raw.inputs.length == tx->inputs.length);
+
+  for (i = 0; i < raw.inputs.length; i++) {
+    const btc_input_t *x = tx->inputs.items[i];
+
+    ASSERT(btc_rawinput_read(&input, &xp, &xn));
+    ASSERT(btc_outpoint_equal(&input.prevout, &x->prevout));
+    ASSERT(btc_script_equal(&input.script, &x->script));
+    ASSERT(input.sequence == x->sequence);
+
+    if (!btc_rawtx_has_witness(&raw))
+      continue;
+
+    ASSERT(btc_rawwitness_read(&stack, &wp, &wn));
+    ASSERT(stack.length == x->witness.length);
+
+    for (j = 0; j < stack.length; j++) {
+      ASSERT(btc_rawitem_read(&item, &stack.data, &stack.size));
+      ASSERT(btc_buffer_equal(&item, x->witness.items[j]));
+    }
+  }
+
+  ASSERT(xn == 0 && wn == 0);
+
+  xp = raw.outputs.data;
+  xn = raw.outputs.size;
+
+  ASSERT(raw.outputs.length == tx->outputs.length);
+
+  for (i = 0; i < raw.outputs.length; i++) {
+    ASSERT(btc_rawoutput_read(&output, &xp, &xn));
+    ASSERT(btc_output_equal(&output, tx->outputs.items[i]));
+  }
+
+  ASSERT(xn == 0);
+}
+
 static void
 test_tx_valid_vector(const test_valid_vector_t *vec, size_t index) {
   uint8_t hash[32];
@@ -45,6 +130,8 @@ test_tx_valid_vector(const test_valid_vector_t *vec, size_t index) {
   ASSERT(btc_hash_equal(tx.hash, hash));
   ASSERT(btc_hash_equal(tx.whash, whash));
 
+  test_rawtx(vec->tx_raw, vec->tx_len, &tx);
+
   for (i = 0; i < vec->coins_len; i++) {
     coin = btc_coin_create();
 
@@ -91,6 +178,8 @@ test_tx_invalid_vector(const test_invalid_vector_t *vec, size_t index) {
   ASSERT(btc_hash_equal(tx.hash, hash));
   ASSERT(btc_hash_equal(tx.whash, whash));
 
+  test_rawtx(vec->tx_raw, vec->tx_len, &tx);
+
   for (i = 0; i < vec->coins_len; i++) {
     coin = btc_coin_create();
 
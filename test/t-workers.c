@@ -1,5 +1,5 @@
 /*!
- * t-stub.c - stub test for mako
+ * t-workers.c - workers test for mako
  * Copyright (c) 2021, Christopher Jeffrey (MIT License).
  * https://github.com/chjj/mako
  */
@@ -7,8 +7,79 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <io/workers.h>
 #include "lib/tests.h"
 
-int main(void) {
+static int counts[20000];
+
+static void
+test_work(void *arg) {
+  int *count = arg;
+  *count += 1;
+}
+
+static void
+test_batch(btc_workers_t *pool, btc_workq_t *batch, int start, int length) {
+  int i;
+
+  for (i = 0; i < length; i++)
+    btc_workq_push(batch, test_work, &counts[start + i]);
+
+  btc_workers_batch(pool, batch);
+
+  ASSERT(batch->length == 0);
+}
+
+int
+main(void) {
+  static const int sizes[] = { 1, 7, 128, 1000, 15000 };
+  btc_workers_t *pool = btc_workers_create(4, 128);
+  btc_workq_t batch, other;
+  int round, i, j;
+
+  btc_workq_init(&batch);
+  btc_workq_init(&other);
+
+  for (round = 0; round < 3; round++) {
+    memset(counts, 0, sizeof(counts));
+
+    /* The last size overflows every deque. */
+    for (i = 0, j = 0; i < (int)lengthof(sizes); i++) {
+      test_batch(pool, &batch, j, sizes[i]);
+      j += sizes[i];
+    }
+
+    for (; j < (int)lengthof(counts); j++)
+      btc_workers_add(pool, test_work, &counts[j]);
+
+    btc_workers_wait(pool);
+
+    for (j = 0; j < (int)lengthof(counts); j++)
+      ASSERT(counts[j] == 1);
+  }
+
+  /* Concatenation empties the source. */
+  memset(counts, 0, sizeof(counts));
+
+  for (i = 0; i < 100; i++) {
+    btc_workq_push(&batch, test_work, &counts[i]);
+    btc_workq_push(&other, test_work, &counts[100 + i]);
+  }
+
+  btc_workq_concat(&batch, &other);
+
+  ASSERT(batch.length == 200);
+  ASSERT(other.length == 0);
+
+  btc_workers_batch(pool, &batch);
+  btc_workers_wait(pool);
+
+  for (j = 0; j < (int)lengthof(counts); j++)
+    ASSERT(counts[j] == (j < 200));
+
+  btc_workq_clear(&other);
+  btc_workq_clear(&batch);
+  btc_workers_destroy(pool);
+
   return 0;
 }